@@ -0,0 +1,37 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+// Position-only version of shader.vert for the depth pre-pass, the shading pass tests for equal depth
+layout(location = 0) in vec3 inPosition;
+
+layout(set = 0, binding = 0) uniform UBO
+{
+    mat4 viewProjection;
+}
+ubo;
+
+// Matches Instances::DrawInstance
+struct DrawInstance
+{
+    uint instanceIndex;
+    uint materialIndex;
+};
+
+layout(std430, set = 2, binding = 0) readonly buffer Transforms
+{
+    mat4 transforms[];
+};
+
+layout(std430, set = 2, binding = 1) readonly buffer DrawInstances
+{
+    DrawInstance drawInstances[];
+};
+
+// Same computation as shader.vert, invariant in both so that the depths match exactly
+invariant gl_Position;
+
+void main()
+{
+    const mat4 transform = transforms[drawInstances[gl_InstanceIndex].instanceIndex];
+    gl_Position = ubo.viewProjection * transform * vec4(inPosition, 1.0);
+}
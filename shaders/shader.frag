@@ -1,24 +1,44 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
+#extension GL_EXT_nonuniform_qualifier : require
 
-layout(set = 1, binding = 0) uniform sampler2D baseColor;
-layout(set = 1, binding = 1) uniform sampler2D metallicRoughness;
-layout(set = 1, binding = 2) uniform sampler2D normal;
-layout(set = 1, binding = 3) uniform sampler2D emissive;
-layout(set = 1, binding = 4) uniform sampler2D occlusion;
+// Each slot is (texture array, layer), array is negative when the material has no such texture
+struct Material
+{
+    ivec2 baseColor;
+    ivec2 metallicRoughness;
+    ivec2 normal;
+    ivec2 emissive;
+    ivec2 occlusion;
+};
+
+layout(set = 1, binding = 0) uniform sampler textureSampler;
+layout(set = 1, binding = 1) uniform texture2DArray textures[];
+layout(std430, set = 1, binding = 2) readonly buffer Materials
+{
+    Material materials[];
+};
 
 layout(location = 0) in vec3 inNormal;
 layout(location = 1) in vec2 inUv;
+layout(location = 2) flat in uint inMaterialIndex;
 
 layout(location = 0) out vec4 outColor;
 
+vec4 sampleSlot(ivec2 slot, vec4 fallback)
+{
+    return slot.x < 0 ? fallback : texture(sampler2DArray(textures[nonuniformEXT(slot.x)], textureSampler), vec3(inUv, slot.y));
+}
+
 void main()
 {
+    const Material material = materials[inMaterialIndex];
+
     outColor = //
-        (texture(baseColor, inUv) * 0.8 + //
-         texture(metallicRoughness, inUv) * 0.1 + //
-         texture(normal, inUv) * 0.1 + //
-         texture(emissive, inUv))
+        (sampleSlot(material.baseColor, vec4(1.0)) * 0.8 + //
+         sampleSlot(material.metallicRoughness, vec4(0.0)) * 0.1 + //
+         sampleSlot(material.normal, vec4(0.0)) * 0.1 + //
+         sampleSlot(material.emissive, vec4(0.0)))
         * //
-        texture(occlusion, inUv);
+        sampleSlot(material.occlusion, vec4(1.0));
 }
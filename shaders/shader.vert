@@ -11,12 +11,39 @@ layout(set = 0, binding = 0) uniform UBO
 }
 ubo;
 
+// Matches Instances::DrawInstance
+struct DrawInstance
+{
+    uint instanceIndex;
+    uint materialIndex;
+};
+
+layout(std430, set = 2, binding = 0) readonly buffer Transforms
+{
+    mat4 transforms[];
+};
+
+layout(std430, set = 2, binding = 1) readonly buffer DrawInstances
+{
+    DrawInstance drawInstances[];
+};
+
 layout(location = 0) out vec3 outNormal;
 layout(location = 1) out vec2 outUv;
+layout(location = 2) flat out uint outMaterialIndex;
+
+// The depth pre-pass computes the same position in depth.vert
+invariant gl_Position;
 
 void main()
 {
-    gl_Position = ubo.viewProjection * vec4(inPosition, 1.0);
-    outNormal = inNormal;
+    // firstInstance of a draw points to its range of draw instances so that no per-draw constants are needed
+    const DrawInstance drawInstance = drawInstances[gl_InstanceIndex];
+    const mat4 transform = transforms[drawInstance.instanceIndex];
+
+    gl_Position = ubo.viewProjection * transform * vec4(inPosition, 1.0);
+    // Instances are only rotated and translated
+    outNormal = mat3(transform) * inNormal;
     outUv = inUv;
+    outMaterialIndex = drawInstance.materialIndex;
 }
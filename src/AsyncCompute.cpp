@@ -0,0 +1,448 @@
+#include "AsyncCompute.hpp"
+#include "DebugMarker.hpp"
+#include <algorithm>
+
+namespace
+{
+const uint32_t c_elementCount = 256 * 1024;
+const uint32_t c_workgroupSize = 64;
+const uint32_t c_defaultIterationCount = 256;
+const uint32_t c_computeBeginQuery = 0;
+const uint32_t c_graphicsBeginQuery = 2;
+const uint32_t c_queryCount = 4;
+
+// Matches the Workload block of workload.comp
+struct WorkloadConstants
+{
+    uint32_t elementCount;
+    uint32_t iterationCount;
+    float time;
+};
+
+bool hasTimestampBits(VkPhysicalDevice physicalDevice, uint32_t queueFamily)
+{
+    uint32_t queueFamilyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilies.data());
+    return queueFamilies[queueFamily].timestampValidBits > 0;
+}
+
+VkBufferMemoryBarrier getBufferBarrier(VkBuffer buffer, uint32_t srcFamily, uint32_t dstFamily, VkAccessFlags srcAccess, VkAccessFlags dstAccess)
+{
+    VkBufferMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier.srcAccessMask = srcAccess;
+    barrier.dstAccessMask = dstAccess;
+    barrier.srcQueueFamilyIndex = srcFamily;
+    barrier.dstQueueFamilyIndex = dstFamily;
+    barrier.buffer = buffer;
+    barrier.offset = 0;
+    barrier.size = VK_WHOLE_SIZE;
+    return barrier;
+}
+} // namespace
+
+AsyncCompute::AsyncCompute(Context& context, const std::vector<char>& shaderCode) :
+    m_context(context),
+    m_device(context.getDevice()),
+    m_memoryAllocator(context.getMemoryAllocator()),
+    m_iterationCount(c_defaultIterationCount)
+{
+    const VkPhysicalDevice physicalDevice = m_context.getPhysicalDevice();
+    const QueueFamilyIndices indices = getQueueFamilies(physicalDevice, m_context.getSurface());
+    m_graphicsFamily = static_cast<uint32_t>(indices.graphicsFamily);
+    m_computeFamily = static_cast<uint32_t>(indices.computeFamily);
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    m_timestampPeriod = properties.limits.timestampPeriod;
+    m_timestampsSupported = //
+        properties.limits.timestampComputeAndGraphics && //
+        hasTimestampBits(physicalDevice, m_graphicsFamily) && //
+        hasTimestampBits(physicalDevice, m_computeFamily);
+
+    createDescriptorSetLayout();
+    createPipeline(shaderCode);
+    createFrames();
+    createDescriptorSets();
+}
+
+AsyncCompute::~AsyncCompute()
+{
+    // Nothing waited for the last workload if no frame copied it back
+    if (m_pendingFrame != UINT32_MAX)
+    {
+        m_context.getComputeTimeline().wait(m_frames[m_pendingFrame].computeValue);
+    }
+
+    for (Frame& frame : m_frames)
+    {
+        if (m_timestampsSupported)
+        {
+            vkDestroyQueryPool(m_device, frame.queryPool, nullptr);
+        }
+        vkFreeCommandBuffers(m_device, m_context.getComputeCommandPool(), 1, &frame.commandBuffer);
+        vkUnmapMemory(m_device, frame.readbackMemory.memory);
+        vkDestroyBuffer(m_device, frame.readbackBuffer, nullptr);
+        m_memoryAllocator.release(frame.readbackMemory);
+        vkDestroyBuffer(m_device, frame.resultBuffer, nullptr);
+        m_memoryAllocator.release(frame.resultMemory);
+    }
+
+    vkDestroyDescriptorPool(m_device, m_descriptorPool, nullptr);
+    vkDestroyPipeline(m_device, m_pipeline, nullptr);
+    vkDestroyPipelineLayout(m_device, m_pipelineLayout, nullptr);
+    vkDestroyDescriptorSetLayout(m_device, m_descriptorSetLayout, nullptr);
+}
+
+void AsyncCompute::submit(uint32_t imageIndex)
+{
+    Frame& frame = m_frames[imageIndex];
+    readResults(frame);
+
+    frame.frameNumber = ++m_frameNumber;
+    frame.graphicsRecorded = false;
+    m_readbackFrame = m_pendingFrame;
+    m_pendingFrame = UINT32_MAX;
+    // When the swapchain hands out the same image twice in a row its result buffer is still waiting to be copied
+    if (!m_enabled || m_readbackFrame == imageIndex)
+    {
+        return;
+    }
+
+    frame.computeFrameNumber = frame.frameNumber;
+    recordCompute(frame);
+    frame.computeValue = m_context.submitComputeCommandBuffers({frame.commandBuffer});
+    m_pendingFrame = imageIndex;
+}
+
+// The workload of the previous frame, which has usually finished alongside that frame's graphics work
+std::vector<SemaphoreWait> AsyncCompute::getGraphicsWaits() const
+{
+    if (m_readbackFrame == UINT32_MAX)
+    {
+        return {};
+    }
+    return {{m_context.getComputeTimeline().getSemaphore(), m_frames[m_readbackFrame].computeValue, VK_PIPELINE_STAGE_TRANSFER_BIT}};
+}
+
+void AsyncCompute::beginGraphics(VkCommandBuffer cb, uint32_t imageIndex)
+{
+    // The frame's graphics submission is the next one on the graphics timeline
+    Frame& frame = m_frames[imageIndex];
+    frame.graphicsRecorded = true;
+    frame.graphicsValue = m_context.getGraphicsTimeline().getNextValue();
+
+    if (m_timestampsSupported)
+    {
+        vkCmdResetQueryPool(cb, frame.queryPool, c_graphicsBeginQuery, 2);
+        vkCmdWriteTimestamp(cb, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, frame.queryPool, c_graphicsBeginQuery);
+    }
+
+    if (m_readbackFrame == UINT32_MAX)
+    {
+        return;
+    }
+
+    Frame& readbackFrame = m_frames[m_readbackFrame];
+    readbackFrame.readbackRecorded = true;
+    readbackFrame.readbackValue = frame.graphicsValue;
+
+    DebugMarker::beginLabel(cb, "Async compute readback", DebugMarker::green);
+
+    // Acquire half of the ownership transfer, the release half is at the end of the compute command buffer
+    if (m_graphicsFamily != m_computeFamily)
+    {
+        const VkBufferMemoryBarrier acquireBarrier = getBufferBarrier(readbackFrame.resultBuffer, m_computeFamily, m_graphicsFamily, 0, VK_ACCESS_TRANSFER_READ_BIT);
+        vkCmdPipelineBarrier(cb, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 1, &acquireBarrier, 0, nullptr);
+    }
+
+    VkBufferCopy copyRegion{};
+    copyRegion.size = sizeof(float);
+    vkCmdCopyBuffer(cb, readbackFrame.resultBuffer, readbackFrame.readbackBuffer, 1, &copyRegion);
+
+    VkBufferMemoryBarrier hostBarrier = getBufferBarrier(readbackFrame.readbackBuffer, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_HOST_READ_BIT);
+    vkCmdPipelineBarrier(cb, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &hostBarrier, 0, nullptr);
+
+    DebugMarker::endLabel(cb);
+}
+
+void AsyncCompute::endGraphics(VkCommandBuffer cb, uint32_t imageIndex)
+{
+    if (m_timestampsSupported)
+    {
+        vkCmdWriteTimestamp(cb, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_frames[imageIndex].queryPool, c_graphicsBeginQuery + 1);
+    }
+}
+
+void AsyncCompute::setEnabled(bool enabled)
+{
+    m_enabled = enabled;
+}
+
+bool AsyncCompute::isEnabled() const
+{
+    return m_enabled;
+}
+
+void AsyncCompute::setIterationCount(uint32_t iterationCount)
+{
+    m_iterationCount = iterationCount;
+}
+
+uint32_t AsyncCompute::getIterationCount() const
+{
+    return m_iterationCount;
+}
+
+bool AsyncCompute::hasDedicatedQueue() const
+{
+    return m_graphicsFamily != m_computeFamily;
+}
+
+bool AsyncCompute::hasTimestamps() const
+{
+    return m_timestampsSupported;
+}
+
+const AsyncCompute::Timings& AsyncCompute::getTimings() const
+{
+    return m_timings;
+}
+
+float AsyncCompute::getResultSample() const
+{
+    return m_resultSample;
+}
+
+void AsyncCompute::createFrames()
+{
+    const uint32_t frameCount = ui32Size(m_context.getSwapchainImages());
+    m_frames.resize(frameCount);
+
+    for (Frame& frame : m_frames)
+    {
+        VkBufferCreateInfo bufferInfo{};
+        bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        bufferInfo.size = sizeof(float) * c_elementCount;
+        bufferInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+        bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+        VK_CHECK(vkCreateBuffer(m_device, &bufferInfo, nullptr, &frame.resultBuffer));
+        DebugMarker::setObjectName(VK_OBJECT_TYPE_BUFFER, (uint64_t)frame.resultBuffer, "Async compute result");
+        frame.resultMemory = m_memoryAllocator.allocateForBuffer(frame.resultBuffer, MemoryUsage::GpuOnly, MemoryCategory::Storage);
+
+        bufferInfo.size = sizeof(float);
+        bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+
+        VK_CHECK(vkCreateBuffer(m_device, &bufferInfo, nullptr, &frame.readbackBuffer));
+        DebugMarker::setObjectName(VK_OBJECT_TYPE_BUFFER, (uint64_t)frame.readbackBuffer, "Async compute readback");
+        frame.readbackMemory = m_memoryAllocator.allocateForBuffer(frame.readbackBuffer, MemoryUsage::Readback, MemoryCategory::Staging);
+
+        void* readbackData;
+        VK_CHECK(vkMapMemory(m_device, frame.readbackMemory.memory, 0, VK_WHOLE_SIZE, 0, &readbackData));
+        frame.readbackData = static_cast<float*>(readbackData);
+
+        VkCommandBufferAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.commandPool = m_context.getComputeCommandPool();
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandBufferCount = 1;
+
+        VK_CHECK(vkAllocateCommandBuffers(m_device, &allocInfo, &frame.commandBuffer));
+
+        if (m_timestampsSupported)
+        {
+            VkQueryPoolCreateInfo queryPoolInfo{};
+            queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+            queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+            queryPoolInfo.queryCount = c_queryCount;
+
+            VK_CHECK(vkCreateQueryPool(m_device, &queryPoolInfo, nullptr, &frame.queryPool));
+        }
+    }
+}
+
+void AsyncCompute::createDescriptorSetLayout()
+{
+    VkDescriptorSetLayoutBinding resultBinding{};
+    resultBinding.binding = 0;
+    resultBinding.descriptorCount = 1;
+    resultBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    resultBinding.pImmutableSamplers = nullptr;
+    resultBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = 1;
+    layoutInfo.pBindings = &resultBinding;
+
+    VK_CHECK(vkCreateDescriptorSetLayout(m_device, &layoutInfo, nullptr, &m_descriptorSetLayout));
+}
+
+void AsyncCompute::createPipeline(const std::vector<char>& shaderCode)
+{
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(WorkloadConstants);
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &m_descriptorSetLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+    VK_CHECK(vkCreatePipelineLayout(m_device, &pipelineLayoutInfo, nullptr, &m_pipelineLayout));
+
+    VkShaderModule shaderModule = createShaderModule(m_device, shaderCode);
+
+    VkComputePipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipelineInfo.stage.module = shaderModule;
+    pipelineInfo.stage.pName = "main";
+    pipelineInfo.layout = m_pipelineLayout;
+
+    VK_CHECK(vkCreateComputePipelines(m_device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &m_pipeline));
+
+    vkDestroyShaderModule(m_device, shaderModule, nullptr);
+}
+
+void AsyncCompute::createDescriptorSets()
+{
+    VkDescriptorPoolSize poolSize{};
+    poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSize.descriptorCount = ui32Size(m_frames);
+
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.poolSizeCount = 1;
+    poolInfo.pPoolSizes = &poolSize;
+    poolInfo.maxSets = ui32Size(m_frames);
+
+    VK_CHECK(vkCreateDescriptorPool(m_device, &poolInfo, nullptr, &m_descriptorPool));
+
+    for (Frame& frame : m_frames)
+    {
+        VkDescriptorSetAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        allocInfo.descriptorPool = m_descriptorPool;
+        allocInfo.descriptorSetCount = 1;
+        allocInfo.pSetLayouts = &m_descriptorSetLayout;
+
+        VK_CHECK(vkAllocateDescriptorSets(m_device, &allocInfo, &frame.descriptorSet));
+
+        VkDescriptorBufferInfo bufferInfo{};
+        bufferInfo.buffer = frame.resultBuffer;
+        bufferInfo.offset = 0;
+        bufferInfo.range = VK_WHOLE_SIZE;
+
+        VkWriteDescriptorSet descriptorWrite{};
+        descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrite.dstSet = frame.descriptorSet;
+        descriptorWrite.dstBinding = 0;
+        descriptorWrite.dstArrayElement = 0;
+        descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        descriptorWrite.descriptorCount = 1;
+        descriptorWrite.pBufferInfo = &bufferInfo;
+
+        vkUpdateDescriptorSets(m_device, 1, &descriptorWrite, 0, nullptr);
+    }
+}
+
+// Reads what the previous use of the frame left behind. The workload of a frame is copied back by the next frame's
+// graphics submission, which has been submitted by the time the frame is used again.
+void AsyncCompute::readResults(Frame& frame)
+{
+    if (!frame.graphicsRecorded)
+    {
+        return;
+    }
+
+    m_context.getGraphicsTimeline().wait(frame.graphicsValue);
+
+    const double millisecondsPerTick = m_timestampPeriod / 1'000'000.0;
+    uint64_t graphicsTimestamps[2] = {};
+    if (m_timestampsSupported)
+    {
+        VK_CHECK(vkGetQueryPoolResults(m_device, frame.queryPool, c_graphicsBeginQuery, 2, sizeof(graphicsTimestamps), graphicsTimestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT));
+        m_timings.graphicsMilliseconds = (graphicsTimestamps[1] - graphicsTimestamps[0]) * millisecondsPerTick;
+    }
+
+    if (!frame.readbackRecorded)
+    {
+        return;
+    }
+    frame.readbackRecorded = false;
+
+    // The copying submission waited for the compute one so its value covers both
+    m_context.getGraphicsTimeline().wait(frame.readbackValue);
+    m_resultSample = *frame.readbackData;
+
+    if (!m_timestampsSupported)
+    {
+        return;
+    }
+
+    uint64_t computeTimestamps[2];
+    VK_CHECK(vkGetQueryPoolResults(m_device, frame.queryPool, c_computeBeginQuery, 2, sizeof(computeTimestamps), computeTimestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT));
+    m_timings.computeMilliseconds = (computeTimestamps[1] - computeTimestamps[0]) * millisecondsPerTick;
+
+    // Both queues write timestamps on the same device timeline so the intervals can be intersected, as long as the
+    // graphics timestamps are of the workload's own frame
+    if (frame.computeFrameNumber == frame.frameNumber)
+    {
+        const uint64_t overlapBegin = std::max(computeTimestamps[0], graphicsTimestamps[0]);
+        const uint64_t overlapEnd = std::min(computeTimestamps[1], graphicsTimestamps[1]);
+        m_timings.overlapMilliseconds = overlapEnd > overlapBegin ? (overlapEnd - overlapBegin) * millisecondsPerTick : 0.0;
+    }
+}
+
+void AsyncCompute::recordCompute(Frame& frame)
+{
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+    const VkCommandBuffer cb = frame.commandBuffer;
+    VK_CHECK(vkResetCommandBuffer(cb, 0));
+    VK_CHECK(vkBeginCommandBuffer(cb, &beginInfo));
+
+    DebugMarker::beginLabel(cb, "Async compute", DebugMarker::green);
+
+    if (m_timestampsSupported)
+    {
+        vkCmdResetQueryPool(cb, frame.queryPool, c_computeBeginQuery, 2);
+        vkCmdWriteTimestamp(cb, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, frame.queryPool, c_computeBeginQuery);
+    }
+
+    // The previous contents are overwritten so the buffer is used without acquiring it back from graphics
+    WorkloadConstants constants;
+    constants.elementCount = c_elementCount;
+    constants.iterationCount = m_iterationCount;
+    constants.time = static_cast<float>(frame.frameNumber % 1000) * 0.01f;
+
+    vkCmdBindPipeline(cb, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline);
+    vkCmdBindDescriptorSets(cb, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelineLayout, 0, 1, &frame.descriptorSet, 0, nullptr);
+    vkCmdPushConstants(cb, m_pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(WorkloadConstants), &constants);
+    vkCmdDispatch(cb, (c_elementCount + c_workgroupSize - 1) / c_workgroupSize, 1, 1);
+
+    if (m_timestampsSupported)
+    {
+        vkCmdWriteTimestamp(cb, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, frame.queryPool, c_computeBeginQuery + 1);
+    }
+
+    if (m_graphicsFamily != m_computeFamily)
+    {
+        const VkBufferMemoryBarrier releaseBarrier = getBufferBarrier(frame.resultBuffer, m_computeFamily, m_graphicsFamily, VK_ACCESS_SHADER_WRITE_BIT, 0);
+        vkCmdPipelineBarrier(cb, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 1, &releaseBarrier, 0, nullptr);
+    }
+
+    DebugMarker::endLabel(cb);
+
+    VK_CHECK(vkEndCommandBuffer(cb));
+}
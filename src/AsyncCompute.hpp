@@ -0,0 +1,88 @@
+#pragma once
+
+#include "Context.hpp"
+#include "MemoryAllocator.hpp"
+#include <vector>
+#include <cstdint>
+
+// Runs a compute workload on the compute queue where it overlaps the graphics work of its frame. Every frame writes
+// its own result buffer which the compute queue family releases and the graphics queue family acquires and copies
+// back for the CPU one frame later, so only the next frame's transfers wait for the workload and only when it takes
+// longer than a frame. Timestamps on both queues measure how much the two actually overlap. Off by default, it is
+// a demonstration that costs GPU time.
+class AsyncCompute final
+{
+public:
+    struct Timings
+    {
+        double computeMilliseconds = 0.0;
+        double graphicsMilliseconds = 0.0;
+        double overlapMilliseconds = 0.0;
+    };
+
+    AsyncCompute(Context& context, const std::vector<char>& shaderCode);
+    ~AsyncCompute();
+
+    void submit(uint32_t imageIndex);
+    std::vector<SemaphoreWait> getGraphicsWaits() const;
+    void beginGraphics(VkCommandBuffer cb, uint32_t imageIndex);
+    void endGraphics(VkCommandBuffer cb, uint32_t imageIndex);
+
+    void setEnabled(bool enabled);
+    bool isEnabled() const;
+    void setIterationCount(uint32_t iterationCount);
+    uint32_t getIterationCount() const;
+    bool hasDedicatedQueue() const;
+    bool hasTimestamps() const;
+    const Timings& getTimings() const;
+    float getResultSample() const;
+
+private:
+    struct Frame
+    {
+        VkBuffer resultBuffer;
+        MemoryAllocation resultMemory;
+        VkBuffer readbackBuffer;
+        MemoryAllocation readbackMemory;
+        float* readbackData;
+        VkDescriptorSet descriptorSet;
+        VkCommandBuffer commandBuffer;
+        VkQueryPool queryPool;
+        uint64_t computeValue = 0;
+        // Graphics submission that copied the result back
+        uint64_t readbackValue = 0;
+        uint64_t graphicsValue = 0;
+        uint64_t frameNumber = 0;
+        uint64_t computeFrameNumber = 0;
+        bool readbackRecorded = false;
+        bool graphicsRecorded = false;
+    };
+
+    void createFrames();
+    void createDescriptorSetLayout();
+    void createPipeline(const std::vector<char>& shaderCode);
+    void createDescriptorSets();
+    void readResults(Frame& frame);
+    void recordCompute(Frame& frame);
+
+    Context& m_context;
+    VkDevice m_device;
+    MemoryAllocator& m_memoryAllocator;
+    uint32_t m_graphicsFamily;
+    uint32_t m_computeFamily;
+    bool m_timestampsSupported;
+    double m_timestampPeriod;
+    std::vector<Frame> m_frames;
+    VkDescriptorSetLayout m_descriptorSetLayout;
+    VkDescriptorPool m_descriptorPool;
+    VkPipelineLayout m_pipelineLayout;
+    VkPipeline m_pipeline;
+    bool m_enabled = false;
+    uint32_t m_iterationCount;
+    uint64_t m_frameNumber = 0;
+    // Frame whose workload was submitted last and isn't copied back yet, and the one the current frame copies back
+    uint32_t m_pendingFrame = UINT32_MAX;
+    uint32_t m_readbackFrame = UINT32_MAX;
+    Timings m_timings;
+    float m_resultSample = 0.0f;
+};
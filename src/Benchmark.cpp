@@ -0,0 +1,240 @@
+#include "Benchmark.hpp"
+#include "Camera.hpp"
+#include "Culling.hpp"
+#include "JobSystem.hpp"
+#include "FileReader.hpp"
+#include "Model.hpp"
+#include "RenderQueue.hpp"
+#include "Utils.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <random>
+#include <vector>
+#include <cstdio>
+
+namespace
+{
+const std::string c_benchmarkModelFilename = "DamagedHelmet.glb";
+const size_t c_syntheticItemCount = 1 << 20;
+const size_t c_syntheticGrainSize = 1024;
+const int c_syntheticIterations = 64;
+const int c_repeatCount = 5;
+const std::vector<size_t> c_cullingObjectCounts{10'000, 100'000, 1'000'000};
+// Objects fill a cube around the camera so that roughly a tenth of them is in the frustum
+const float c_cullingSceneExtent = 100.0f;
+const std::vector<size_t> c_sortDrawCounts{10'000, 100'000, 1'000'000};
+// Scenes have a few pipelines and far fewer materials than draws
+const uint32_t c_sortPipelineCount = 4;
+const uint32_t c_sortMaterialCount = 256;
+
+// Best of several runs to filter out scheduling noise
+double measureMilliseconds(const std::function<void()>& function)
+{
+    double best = 0.0;
+    for (int i = 0; i < c_repeatCount; ++i)
+    {
+        const auto startTime = std::chrono::steady_clock::now();
+        function();
+        const double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+        best = i == 0 ? milliseconds : std::min(best, milliseconds);
+    }
+    return best;
+}
+
+// Best of several runs in which only function is timed, prepare restores its input before every run
+double measureMilliseconds(const std::function<void()>& prepare, const std::function<void()>& function)
+{
+    double best = 0.0;
+    for (int i = 0; i < c_repeatCount; ++i)
+    {
+        prepare();
+        const auto startTime = std::chrono::steady_clock::now();
+        function();
+        const double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+        best = i == 0 ? milliseconds : std::min(best, milliseconds);
+    }
+    return best;
+}
+
+// Independent math per item, the same amount of work as per-object culling or animation
+void runSyntheticWorkload(JobSystem& jobSystem, std::vector<float>& results)
+{
+    jobSystem.parallelFor(results.size(), c_syntheticGrainSize, [&results](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i)
+        {
+            float value = static_cast<float>(i);
+            for (int iteration = 0; iteration < c_syntheticIterations; ++iteration)
+            {
+                value = std::sqrt(value * 1.0001f + 1.0f) + std::sin(value);
+            }
+            results[i] = value;
+        }
+    });
+}
+
+void printResult(const char* name, uint32_t threadCount, double milliseconds, double baseline)
+{
+    printf("%-10s %7u %10.2f %8.2fx\n", name, threadCount, milliseconds, baseline / milliseconds);
+}
+
+// Random boxes and spheres of about the size of a prop, the same seed every run
+void createCullingBounds(size_t objectCount, Culling::Bounds& boxes, Culling::Bounds& spheres)
+{
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> position(-c_cullingSceneExtent, c_cullingSceneExtent);
+    std::uniform_real_distribution<float> size(0.1f, 2.0f);
+    for (size_t i = 0; i < objectCount; ++i)
+    {
+        const glm::vec3 center(position(random), position(random), position(random));
+        const glm::vec3 extent(size(random), size(random), size(random));
+        Culling::addBox(boxes, center - extent, center + extent);
+        Culling::addSphere(spheres, center, size(random));
+    }
+}
+
+void printCullingResult(size_t objectCount, const char* volume, const char* kernel, double milliseconds, size_t visibleCount, double baseline)
+{
+    const double nanosecondsPerObject = milliseconds * 1'000'000.0 / static_cast<double>(objectCount);
+    printf("%9zu %-7s %-7s %10.3f %10.2f %9zu %8.2fx\n", objectCount, volume, kernel, milliseconds, nanosecondsPerObject, visibleCount, baseline / milliseconds);
+}
+
+// Random draws with the key distribution of a scene, the same seed every run
+void fillRenderQueue(size_t drawCount, RenderQueue& renderQueue)
+{
+    std::mt19937 random(1);
+    std::uniform_int_distribution<uint32_t> pipeline(0, c_sortPipelineCount - 1);
+    std::uniform_int_distribution<uint32_t> material(0, c_sortMaterialCount - 1);
+    std::uniform_real_distribution<float> depth(0.1f, 100.0f);
+    renderQueue.clear();
+    for (uint32_t i = 0; i < drawCount; ++i)
+    {
+        const uint32_t depthBucket = RenderQueue::getDepthBucket(depth(random), 0.1f, 100.0f);
+        renderQueue.push(RenderQueue::makeKey(pipeline(random), material(random), depthBucket, i), i);
+    }
+}
+
+void printSortResult(size_t drawCount, const char* method, uint32_t threadCount, double milliseconds, double baseline)
+{
+    printf("%9zu %-7s %7u %10.3f %8.2fx\n", drawCount, method, threadCount, milliseconds, baseline / milliseconds);
+}
+} // namespace
+
+namespace Benchmark
+{
+void runJobSystem()
+{
+    FileReader fileReader;
+    const FileReader::Result modelFile = fileReader.read(c_modelsFolder + c_benchmarkModelFilename).get();
+    if (!modelFile.error.empty())
+    {
+        LOGE(modelFile.error.c_str());
+    }
+    std::vector<float> results(c_syntheticItemCount);
+
+    const uint32_t maxThreadCount = JobSystem::getDefaultWorkerCount() + 1;
+    double syntheticBaseline = 0.0;
+    double modelBaseline = 0.0;
+
+    printf("%-10s %7s %10s %9s\n", "Workload", "Threads", "Time (ms)", "Speedup");
+    for (uint32_t threadCount = 1; threadCount <= maxThreadCount; ++threadCount)
+    {
+        // The calling thread takes part in every parallel-for so it counts as one of the threads
+        JobSystem jobSystem(threadCount - 1);
+
+        const double syntheticTime = measureMilliseconds([&]() {
+            runSyntheticWorkload(jobSystem, results);
+        });
+        syntheticBaseline = threadCount == 1 ? syntheticTime : syntheticBaseline;
+        printResult("Synthetic", threadCount, syntheticTime, syntheticBaseline);
+
+        const double modelTime = measureMilliseconds([&]() {
+            Model model(c_benchmarkModelFilename, modelFile.data, jobSystem);
+            if (!model.error.empty())
+            {
+                LOGE(model.error.c_str());
+            }
+        });
+        modelBaseline = threadCount == 1 ? modelTime : modelBaseline;
+        printResult("Model", threadCount, modelTime, modelBaseline);
+    }
+}
+
+void runCulling()
+{
+    Camera camera;
+    const Culling::Planes planes = camera.getFrustumPlanes();
+    const char* instructionSet = Culling::getInstructionSet();
+    std::vector<uint32_t> visible;
+
+    printf("%9s %-7s %-7s %10s %10s %9s %9s\n", "Objects", "Volume", "Kernel", "Time (ms)", "ns/object", "Visible", "Speedup");
+    for (size_t objectCount : c_cullingObjectCounts)
+    {
+        Culling::Bounds boxes;
+        Culling::Bounds spheres;
+        createCullingBounds(objectCount, boxes, spheres);
+
+        size_t visibleCount = 0;
+        const double scalarSphereTime = measureMilliseconds([&]() {
+            visibleCount = Culling::cullSpheresScalar(planes, spheres, visible);
+        });
+        printCullingResult(objectCount, "Sphere", "Scalar", scalarSphereTime, visibleCount, scalarSphereTime);
+
+        const double sphereTime = measureMilliseconds([&]() {
+            visibleCount = Culling::cullSpheres(planes, spheres, visible);
+        });
+        printCullingResult(objectCount, "Sphere", instructionSet, sphereTime, visibleCount, scalarSphereTime);
+
+        const double scalarBoxTime = measureMilliseconds([&]() {
+            visibleCount = Culling::cullBoxesScalar(planes, boxes, visible);
+        });
+        printCullingResult(objectCount, "Box", "Scalar", scalarBoxTime, visibleCount, scalarBoxTime);
+
+        const double boxTime = measureMilliseconds([&]() {
+            visibleCount = Culling::cullBoxes(planes, boxes, visible);
+        });
+        printCullingResult(objectCount, "Box", instructionSet, boxTime, visibleCount, scalarBoxTime);
+    }
+}
+
+void runSort()
+{
+    const uint32_t maxThreadCount = JobSystem::getDefaultWorkerCount() + 1;
+    JobSystem serialJobSystem(0);
+    JobSystem parallelJobSystem(maxThreadCount - 1);
+    auto isLess = [](const RenderQueue::Item& a, const RenderQueue::Item& b) {
+        return a.key < b.key;
+    };
+
+    printf("%9s %-7s %7s %10s %9s\n", "Draws", "Sort", "Threads", "Time (ms)", "Speedup");
+    for (size_t drawCount : c_sortDrawCounts)
+    {
+        RenderQueue renderQueue(serialJobSystem);
+        std::vector<RenderQueue::Item> items;
+        const double standardTime = measureMilliseconds(
+            [&]() {
+                fillRenderQueue(drawCount, renderQueue);
+                items = renderQueue.getItems();
+            },
+            [&]() {
+                std::sort(items.begin(), items.end(), isLess);
+            });
+        printSortResult(drawCount, "std", 1, standardTime, standardTime);
+
+        for (JobSystem* jobSystem : {&serialJobSystem, &parallelJobSystem})
+        {
+            RenderQueue radixQueue(*jobSystem);
+            const double radixTime = measureMilliseconds(
+                [&]() {
+                    fillRenderQueue(drawCount, radixQueue);
+                },
+                [&]() {
+                    radixQueue.sort();
+                });
+            CHECK(std::is_sorted(radixQueue.getItems().begin(), radixQueue.getItems().end(), isLess));
+            printSortResult(drawCount, "Radix", jobSystem->getWorkerCount() + 1, radixTime, standardTime);
+        }
+    }
+}
+} // namespace Benchmark
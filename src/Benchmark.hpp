@@ -0,0 +1,12 @@
+#pragma once
+
+// Command line benchmarks that run without a window or a Vulkan device
+namespace Benchmark
+{
+// Times a synthetic workload and model loading with one to all hardware threads
+void runJobSystem();
+// Times the scalar and SIMD frustum tests of boxes and spheres with 10k to 1M objects
+void runCulling();
+// Times std::sort and the radix sort of RenderQueue on one and on all hardware threads with 10k to 1M draws
+void runSort();
+} // namespace Benchmark
@@ -3,15 +3,17 @@
 #include <glm/gtx/euler_angles.hpp>
 #include <glm/gtx/transform.hpp>
 
+namespace
+{
+const float c_fov = 45.0f;
+const float c_nearClipDistance = 0.1f;
+const float c_farClipDistance = 100.0f;
+} // namespace
+
 Camera::Camera()
 {
     updateViewMatrix();
-    const float fov = 45.0f;
-    const float ratio = static_cast<float>(c_windowWidth) / static_cast<float>(c_windowHeight);
-    const float nearClipDistance = 0.1f;
-    const float farClipDistance = 100.0f;
-    m_projectionMatrix = glm::perspective(fov, ratio, nearClipDistance, farClipDistance);
-    m_projectionMatrix[1][1] *= -1; // Compensate for differences in GLM and VK systems
+    setAspectRatio(static_cast<float>(c_windowWidth) / static_cast<float>(c_windowHeight));
 }
 
 glm::vec3 Camera::getForward() const
@@ -56,6 +58,12 @@ void Camera::rotate(const glm::vec3& axis, float amount)
     updateViewMatrix();
 }
 
+void Camera::setAspectRatio(float aspectRatio)
+{
+    m_projectionMatrix = glm::perspective(c_fov, aspectRatio, c_nearClipDistance, c_farClipDistance);
+    m_projectionMatrix[1][1] *= -1; // Compensate for differences in GLM and VK systems
+}
+
 const glm::mat4x4& Camera::getViewMatrix() const
 {
     return m_viewMatrix;
@@ -66,6 +74,33 @@ const glm::mat4x4& Camera::getProjectionMatrix() const
     return m_projectionMatrix;
 }
 
+float Camera::getNearClipDistance() const
+{
+    return c_nearClipDistance;
+}
+
+float Camera::getFarClipDistance() const
+{
+    return c_farClipDistance;
+}
+
+std::array<glm::vec4, 6> Camera::getFrustumPlanes() const
+{
+    // Gribb-Hartmann: a clip space bound like -w <= x is a plane made of two rows of the view projection matrix
+    const glm::mat4 m = m_projectionMatrix * m_viewMatrix;
+    const glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+    const glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+    const glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+    const glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+    std::array<glm::vec4, 6> planes{row3 + row0, row3 - row0, row3 + row1, row3 - row1, row3 + row2, row3 - row2};
+    for (glm::vec4& plane : planes)
+    {
+        plane /= glm::length(glm::vec3(plane));
+    }
+    return planes;
+}
+
 void Camera::updateViewMatrix()
 {
     const glm::vec3 forward = getForward();
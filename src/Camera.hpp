@@ -2,6 +2,7 @@
 
 #include "Utils.hpp"
 #include <glm/glm.hpp>
+#include <array>
 
 class Camera final
 {
@@ -15,9 +16,15 @@ public:
     void setRotation(const glm::vec3& rot);
     void translate(const glm::vec3& translation);
     void rotate(const glm::vec3& axis, float amount);
+    // Width divided by height of the image that is rendered
+    void setAspectRatio(float aspectRatio);
 
     const glm::mat4x4& getViewMatrix() const;
     const glm::mat4x4& getProjectionMatrix() const;
+    float getNearClipDistance() const;
+    float getFarClipDistance() const;
+    // Left, right, bottom, top, near and far planes with normals pointing inside and normalized xyz
+    std::array<glm::vec4, 6> getFrustumPlanes() const;
 
 private:
     void updateViewMatrix();
@@ -2,12 +2,13 @@
 #include "Utils.hpp"
 
 #include <set>
+#include <array>
 #include <algorithm>
+#include <chrono>
 
 namespace
 {
 const uint64_t c_timeout = 10'000'000'000;
-const VkPresentModeKHR c_presentMode = VK_PRESENT_MODE_MAILBOX_KHR;
 
 VKAPI_ATTR VkBool32 VKAPI_CALL debugUtilsCallback(VkDebugUtilsMessageSeverityFlagBitsEXT message_severity,
                                                   VkDebugUtilsMessageTypeFlagsEXT message_type,
@@ -35,6 +36,35 @@ void glfwErrorCallback(int error, const char* description)
 {
     printf("GLFW error %d: %s\n", error, description);
 }
+
+// FIFO is the only mode that every implementation has to support
+VkPresentModeKHR choosePresentMode(const std::vector<VkPresentModeKHR>& supportedModes, VkPresentModeKHR requestedMode)
+{
+    if (std::find(supportedModes.begin(), supportedModes.end(), requestedMode) != supportedModes.end())
+    {
+        return requestedMode;
+    }
+    printf("Present mode %s is not supported, using %s\n", getPresentModeName(requestedMode), getPresentModeName(VK_PRESENT_MODE_FIFO_KHR));
+    return VK_PRESENT_MODE_FIFO_KHR;
+}
+
+// The surface either dictates the extent or leaves it to the window's framebuffer size
+VkExtent2D chooseSwapchainExtent(const VkSurfaceCapabilitiesKHR& surfaceCapabilities, GLFWwindow* window)
+{
+    if (surfaceCapabilities.currentExtent.width != UINT32_MAX)
+    {
+        return surfaceCapabilities.currentExtent;
+    }
+
+    int width;
+    int height;
+    glfwGetFramebufferSize(window, &width, &height);
+
+    VkExtent2D extent{static_cast<uint32_t>(width), static_cast<uint32_t>(height)};
+    extent.width = std::clamp(extent.width, surfaceCapabilities.minImageExtent.width, surfaceCapabilities.maxImageExtent.width);
+    extent.height = std::clamp(extent.height, surfaceCapabilities.minImageExtent.height, surfaceCapabilities.maxImageExtent.height);
+    return extent;
+}
 } // namespace
 
 Context::Context()
@@ -44,21 +74,21 @@ Context::Context()
     createWindow();
     enumeratePhysicalDevice();
     createDevice();
-    createSwapchain();
+    createMemoryAllocator();
+    createSwapchain(VK_NULL_HANDLE);
     createCommandPools();
     createSemaphores();
-    createFences();
+    createTimelines();
+    createDeletionQueue();
 }
 
 Context::~Context()
 {
     vkDeviceWaitIdle(m_device);
 
-    for (VkFence fence : m_inFlightFences)
-    {
-        vkDestroyFence(m_device, fence, nullptr);
-    }
-
+    m_deletionQueue.reset();
+    m_computeTimeline.reset();
+    m_graphicsTimeline.reset();
     vkDestroySemaphore(m_device, m_renderFinished, nullptr);
     vkDestroySemaphore(m_device, m_imageAvailable, nullptr);
     vkDestroyCommandPool(m_device, m_computeCommandPool, nullptr);
@@ -66,6 +96,7 @@ Context::~Context()
 
     vkDestroySwapchainKHR(m_device, m_swapchain, nullptr);
 
+    m_memoryAllocator.reset();
     vkDestroyDevice(m_device, nullptr);
 
     vkDestroySurfaceKHR(m_instance, m_surface, nullptr);
@@ -103,6 +134,16 @@ const std::vector<VkImage>& Context::getSwapchainImages() const
     return m_swapchainImages;
 }
 
+VkExtent2D Context::getSwapchainExtent() const
+{
+    return m_swapchainExtent;
+}
+
+uint32_t Context::getSwapchainGeneration() const
+{
+    return m_swapchainGeneration;
+}
+
 VkQueue Context::getGraphicsQueue() const
 {
     return m_graphicsQueue;
@@ -113,11 +154,66 @@ VkCommandPool Context::getGraphicsCommandPool() const
     return m_graphicsCommandPool;
 }
 
+VkQueue Context::getComputeQueue() const
+{
+    return m_computeQueue;
+}
+
+VkCommandPool Context::getComputeCommandPool() const
+{
+    return m_computeCommandPool;
+}
+
 VkSurfaceKHR Context::getSurface() const
 {
     return m_surface;
 }
 
+bool Context::isSamplerFilterMinmaxEnabled() const
+{
+    return m_samplerFilterMinmaxEnabled;
+}
+
+bool Context::isDynamicRenderingEnabled() const
+{
+    return m_dynamicRenderingEnabled;
+}
+
+bool Context::isSynchronization2Enabled() const
+{
+    return m_synchronization2Enabled;
+}
+
+bool Context::isDrawIndirectCountEnabled() const
+{
+    return m_drawIndirectCountEnabled;
+}
+
+bool Context::isPipelineStatisticsEnabled() const
+{
+    return m_pipelineStatisticsEnabled;
+}
+
+MemoryAllocator& Context::getMemoryAllocator()
+{
+    return *m_memoryAllocator;
+}
+
+Timeline& Context::getGraphicsTimeline()
+{
+    return *m_graphicsTimeline;
+}
+
+Timeline& Context::getComputeTimeline()
+{
+    return *m_computeTimeline;
+}
+
+DeletionQueue& Context::getDeletionQueue()
+{
+    return *m_deletionQueue;
+}
+
 bool Context::update()
 {
     glfwPollEvents();
@@ -139,27 +235,82 @@ glm::dvec2 Context::getCursorPosition()
 
 uint32_t Context::acquireNextSwapchainImage()
 {
-    VK_CHECK(vkAcquireNextImageKHR(m_device, m_swapchain, c_timeout, m_imageAvailable, VK_NULL_HANDLE, &m_imageIndex));
-    VK_CHECK(vkWaitForFences(m_device, 1, &m_inFlightFences[m_imageIndex], true, c_timeout));
-    VK_CHECK(vkResetFences(m_device, 1, &m_inFlightFences[m_imageIndex]));
+    using namespace std::chrono;
+    const steady_clock::time_point acquireStart = steady_clock::now();
+
+    while (true)
+    {
+        if (m_swapchainOutdated)
+        {
+            recreateSwapchain();
+        }
+
+        const VkResult acquireResult = vkAcquireNextImageKHR(m_device, m_swapchain, c_timeout, m_imageAvailable, VK_NULL_HANDLE, &m_imageIndex);
+        if (acquireResult == VK_ERROR_OUT_OF_DATE_KHR)
+        {
+            m_swapchainOutdated = true;
+            continue;
+        }
+
+        // A suboptimal acquire still signals the semaphore so the image is used and the swapchain recreated next time
+        if (acquireResult == VK_SUBOPTIMAL_KHR)
+        {
+            m_swapchainOutdated = true;
+        }
+        else
+        {
+            VK_CHECK(acquireResult);
+        }
+        break;
+    }
+
+    // Per-image resources are free once the last submission that rendered to the image has finished. Until the next
+    // submit, everything indexed by the returned image index can be read back, reset, rewritten or recreated: command
+    // pools and secondaries, queries, per-frame buffers and descriptor sets and the frame allocator's region.
+    m_graphicsTimeline->wait(m_imageTimelineValues[m_imageIndex]);
+    m_acquireMilliseconds = duration<double, std::milli>(steady_clock::now() - acquireStart).count();
+
+    m_deletionQueue->collect();
     return m_imageIndex;
 }
 
-void Context::submitCommandBuffers(const std::vector<VkCommandBuffer>& commandBuffers)
+uint64_t Context::submitCommandBuffers(const std::vector<VkCommandBuffer>& commandBuffers, const std::vector<SemaphoreWait>& waits)
 {
-    VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
+    std::vector<VkSemaphore> waitSemaphores{m_imageAvailable};
+    std::vector<uint64_t> waitValues{0};
+    std::vector<VkPipelineStageFlags> waitStages{VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
+    for (const SemaphoreWait& wait : waits)
+    {
+        waitSemaphores.push_back(wait.semaphore);
+        waitValues.push_back(wait.value);
+        waitStages.push_back(wait.stage);
+    }
+
+    // Presentation only takes binary semaphores so renderFinished is signaled alongside the timeline
+    const uint64_t signalValue = m_graphicsTimeline->advance();
+    const std::array<VkSemaphore, 2> signalSemaphores{m_graphicsTimeline->getSemaphore(), m_renderFinished};
+    const std::array<uint64_t, 2> signalValues{signalValue, 0};
+
+    VkTimelineSemaphoreSubmitInfo timelineInfo{};
+    timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timelineInfo.waitSemaphoreValueCount = ui32Size(waitValues);
+    timelineInfo.pWaitSemaphoreValues = waitValues.data();
+    timelineInfo.signalSemaphoreValueCount = ui32Size(signalValues);
+    timelineInfo.pSignalSemaphoreValues = signalValues.data();
 
     VkSubmitInfo submitInfo{};
     submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    submitInfo.waitSemaphoreCount = 1;
-    submitInfo.pWaitSemaphores = &m_imageAvailable;
-    submitInfo.pWaitDstStageMask = waitStages;
+    submitInfo.pNext = &timelineInfo;
+    submitInfo.waitSemaphoreCount = ui32Size(waitSemaphores);
+    submitInfo.pWaitSemaphores = waitSemaphores.data();
+    submitInfo.pWaitDstStageMask = waitStages.data();
     submitInfo.commandBufferCount = ui32Size(commandBuffers);
     submitInfo.pCommandBuffers = commandBuffers.data();
-    submitInfo.signalSemaphoreCount = 1;
-    submitInfo.pSignalSemaphores = &m_renderFinished;
+    submitInfo.signalSemaphoreCount = ui32Size(signalSemaphores);
+    submitInfo.pSignalSemaphores = signalSemaphores.data();
 
-    VK_CHECK(vkQueueSubmit(m_graphicsQueue, 1, &submitInfo, m_inFlightFences[m_imageIndex]));
+    VK_CHECK(vkQueueSubmit(m_graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE));
+    m_imageTimelineValues[m_imageIndex] = signalValue;
 
     VkPresentInfoKHR presentInfo{};
     presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
@@ -170,7 +321,61 @@ void Context::submitCommandBuffers(const std::vector<VkCommandBuffer>& commandBu
     presentInfo.pImageIndices = &m_imageIndex;
     presentInfo.pResults = nullptr;
 
-    VK_CHECK(vkQueuePresentKHR(m_presentQueue, &presentInfo));
+    const VkResult presentResult = vkQueuePresentKHR(m_presentQueue, &presentInfo);
+    if (presentResult == VK_ERROR_OUT_OF_DATE_KHR || presentResult == VK_SUBOPTIMAL_KHR)
+    {
+        m_swapchainOutdated = true;
+    }
+    else
+    {
+        VK_CHECK(presentResult);
+    }
+
+    return signalValue;
+}
+
+uint64_t Context::submitComputeCommandBuffers(const std::vector<VkCommandBuffer>& commandBuffers)
+{
+    const uint64_t signalValue = m_computeTimeline->advance();
+    const VkSemaphore signalSemaphore = m_computeTimeline->getSemaphore();
+
+    VkTimelineSemaphoreSubmitInfo timelineInfo{};
+    timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timelineInfo.signalSemaphoreValueCount = 1;
+    timelineInfo.pSignalSemaphoreValues = &signalValue;
+
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.pNext = &timelineInfo;
+    submitInfo.commandBufferCount = ui32Size(commandBuffers);
+    submitInfo.pCommandBuffers = commandBuffers.data();
+    submitInfo.signalSemaphoreCount = 1;
+    submitInfo.pSignalSemaphores = &signalSemaphore;
+
+    VK_CHECK(vkQueueSubmit(m_computeQueue, 1, &submitInfo, VK_NULL_HANDLE));
+
+    return signalValue;
+}
+
+void Context::setPresentMode(VkPresentModeKHR presentMode)
+{
+    m_requestedPresentMode = presentMode;
+    m_swapchainOutdated = m_swapchainOutdated || presentMode != m_presentMode;
+}
+
+VkPresentModeKHR Context::getPresentMode() const
+{
+    return m_presentMode;
+}
+
+const std::vector<VkPresentModeKHR>& Context::getSupportedPresentModes() const
+{
+    return m_supportedPresentModes;
+}
+
+double Context::getAcquireMilliseconds() const
+{
+    return m_acquireMilliseconds;
 }
 
 void Context::initGLFW()
@@ -222,7 +427,7 @@ void Context::createInstance()
 void Context::createWindow()
 {
     glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-    glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
+    glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
     m_window = glfwCreateWindow(c_windowWidth, c_windowHeight, "Vulkan", nullptr, nullptr);
     CHECK(m_window);
     glfwSetWindowPos(m_window, 1200, 200);
@@ -231,9 +436,15 @@ void Context::createWindow()
         static_cast<Context*>(glfwGetWindowUserPointer(window))->handleKey(window, key, scancode, action, mods);
     };
 
+    // Not every platform reports a resize through the swapchain so it is tracked from the window too
+    auto framebufferSizeCallback = [](GLFWwindow* window, int /*width*/, int /*height*/) {
+        static_cast<Context*>(glfwGetWindowUserPointer(window))->handleFramebufferResize();
+    };
+
     //glfwSetInputMode(m_window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
     glfwSetWindowUserPointer(m_window, this);
     glfwSetKeyCallback(m_window, keyCallback);
+    glfwSetFramebufferSizeCallback(m_window, framebufferSizeCallback);
 
     VK_CHECK(glfwCreateWindowSurface(m_instance, m_window, nullptr, &m_surface));
 }
@@ -247,6 +458,11 @@ void Context::handleKey(GLFWwindow* /*window*/, int key, int /*scancode*/, int a
     m_keyEvents.push_back({key, action});
 }
 
+void Context::handleFramebufferResize()
+{
+    m_swapchainOutdated = true;
+}
+
 void Context::enumeratePhysicalDevice()
 {
     uint32_t deviceCount = 0;
@@ -294,15 +510,83 @@ void Context::createDevice()
         queueCreateInfos.push_back(queueCreateInfo);
     }
 
-    VkPhysicalDeviceFeatures deviceFeatures{};
+    // 1.3 features can only be queried from a device that supports 1.3
+    const bool vulkan13Supported = m_physicalDeviceProperties.apiVersion >= VK_API_VERSION_1_3;
+    VkPhysicalDeviceVulkan13Features supportedFeatures13{};
+    supportedFeatures13.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+
+    VkPhysicalDeviceVulkan12Features supportedFeatures12{};
+    supportedFeatures12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    supportedFeatures12.pNext = vulkan13Supported ? &supportedFeatures13 : nullptr;
+
+    VkPhysicalDeviceFeatures2 supportedFeatures{};
+    supportedFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    supportedFeatures.pNext = &supportedFeatures12;
+    vkGetPhysicalDeviceFeatures2(m_physicalDevice, &supportedFeatures);
+
+    // Descriptor indexing is core in 1.2 but the bindless bits are still optional features
+    CHECK(supportedFeatures.features.shaderSampledImageArrayDynamicIndexing);
+    CHECK(supportedFeatures12.descriptorIndexing);
+    CHECK(supportedFeatures12.runtimeDescriptorArray);
+    CHECK(supportedFeatures12.descriptorBindingPartiallyBound);
+    CHECK(supportedFeatures12.descriptorBindingSampledImageUpdateAfterBind);
+    CHECK(supportedFeatures12.shaderSampledImageArrayNonUniformIndexing);
+    CHECK(supportedFeatures12.timelineSemaphore);
+    // GPU-driven draws: many commands per indirect call and the start of their draw instances in firstInstance
+    CHECK(supportedFeatures.features.multiDrawIndirect);
+    CHECK(supportedFeatures.features.drawIndirectFirstInstance);
+
+    VkPhysicalDeviceVulkan12Features deviceFeatures12{};
+    deviceFeatures12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    deviceFeatures12.descriptorIndexing = VK_TRUE;
+    deviceFeatures12.runtimeDescriptorArray = VK_TRUE;
+    deviceFeatures12.descriptorBindingPartiallyBound = VK_TRUE;
+    deviceFeatures12.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+    deviceFeatures12.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+    deviceFeatures12.timelineSemaphore = VK_TRUE;
+    // Min and max reduction samplers are optional, occlusion culling is disabled without them
+    m_samplerFilterMinmaxEnabled = supportedFeatures12.samplerFilterMinmax;
+    deviceFeatures12.samplerFilterMinmax = supportedFeatures12.samplerFilterMinmax;
+    // GPU culling draws only the non-empty commands with a count from a buffer, or every command without it
+    m_drawIndirectCountEnabled = supportedFeatures12.drawIndirectCount;
+    deviceFeatures12.drawIndirectCount = m_drawIndirectCountEnabled;
+
+    // Dynamic rendering is optional, render passes and framebuffers are used without it
+    VkPhysicalDeviceVulkan13Features deviceFeatures13{};
+    deviceFeatures13.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+    m_dynamicRenderingEnabled = vulkan13Supported && supportedFeatures13.dynamicRendering;
+    deviceFeatures13.dynamicRendering = m_dynamicRenderingEnabled;
+    // The render graph batches its barriers with synchronization2 and falls back to the original barriers
+    m_synchronization2Enabled = vulkan13Supported && supportedFeatures13.synchronization2;
+    deviceFeatures13.synchronization2 = m_synchronization2Enabled;
+    deviceFeatures12.pNext = vulkan13Supported ? &deviceFeatures13 : nullptr;
+
+    VkPhysicalDeviceFeatures2 deviceFeatures{};
+    deviceFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    deviceFeatures.pNext = &deviceFeatures12;
+    deviceFeatures.features.shaderSampledImageArrayDynamicIndexing = VK_TRUE;
+    deviceFeatures.features.multiDrawIndirect = VK_TRUE;
+    deviceFeatures.features.drawIndirectFirstInstance = VK_TRUE;
+    // Overdraw statistics of the scene, each scene secondary runs a query of its own
+    m_pipelineStatisticsEnabled = supportedFeatures.features.pipelineStatisticsQuery;
+    deviceFeatures.features.pipelineStatisticsQuery = m_pipelineStatisticsEnabled;
+
+    // Budget tracking is optional, without it the memory allocator estimates budgets from heap sizes
+    std::vector<const char*> deviceExtensions = c_deviceExtensions;
+    m_memoryBudgetSupported = isDeviceExtensionSupported(m_physicalDevice, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    if (m_memoryBudgetSupported)
+    {
+        deviceExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    }
 
     VkDeviceCreateInfo createInfo{};
     createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+    createInfo.pNext = &deviceFeatures;
     createInfo.queueCreateInfoCount = ui32Size(queueCreateInfos);
     createInfo.pQueueCreateInfos = queueCreateInfos.data();
-    createInfo.pEnabledFeatures = &deviceFeatures;
-    createInfo.enabledExtensionCount = ui32Size(c_deviceExtensions);
-    createInfo.ppEnabledExtensionNames = c_deviceExtensions.data();
+    createInfo.pEnabledFeatures = nullptr;
+    createInfo.enabledExtensionCount = ui32Size(deviceExtensions);
+    createInfo.ppEnabledExtensionNames = deviceExtensions.data();
     createInfo.enabledLayerCount = ui32Size(c_validationLayers);
     createInfo.ppEnabledLayerNames = c_validationLayers.data();
 
@@ -313,7 +597,12 @@ void Context::createDevice()
     vkGetDeviceQueue(m_device, indices.presentFamily, 0, &m_presentQueue);
 }
 
-void Context::createSwapchain()
+void Context::createMemoryAllocator()
+{
+    m_memoryAllocator.reset(new MemoryAllocator(m_device, m_physicalDevice, m_memoryBudgetSupported));
+}
+
+void Context::createSwapchain(VkSwapchainKHR oldSwapchain)
 {
     const SwapchainCapabilities capabilities = getSwapchainCapabilities(m_physicalDevice, m_surface);
 
@@ -324,17 +613,17 @@ void Context::createSwapchain()
     }
     CHECK(formatAvailable);
 
-    const auto foundPresentMode = std::find(std::begin(capabilities.presentModes), std::end(capabilities.presentModes), c_presentMode);
-    CHECK(foundPresentMode != std::end(capabilities.presentModes));
+    m_supportedPresentModes = capabilities.presentModes;
+    m_presentMode = choosePresentMode(capabilities.presentModes, m_requestedPresentMode);
+    m_requestedPresentMode = m_presentMode;
 
-    const VkExtent2D extent{c_windowWidth, c_windowHeight};
-    CHECK(extent.width <= capabilities.surfaceCapabilities.maxImageExtent.width);
-    CHECK(extent.width >= capabilities.surfaceCapabilities.minImageExtent.width);
-    CHECK(extent.height <= capabilities.surfaceCapabilities.maxImageExtent.height);
-    CHECK(extent.height >= capabilities.surfaceCapabilities.minImageExtent.height);
+    m_swapchainExtent = chooseSwapchainExtent(capabilities.surfaceCapabilities, m_window);
+    CHECK(m_swapchainExtent.width > 0 && m_swapchainExtent.height > 0);
 
-    CHECK(c_swapchainImageCount > capabilities.surfaceCapabilities.minImageCount);
-    CHECK(c_swapchainImageCount < capabilities.surfaceCapabilities.maxImageCount);
+    // Max image count 0 means that there is no limit
+    const uint32_t maxImageCount = capabilities.surfaceCapabilities.maxImageCount;
+    CHECK(c_swapchainImageCount >= capabilities.surfaceCapabilities.minImageCount);
+    CHECK(maxImageCount == 0 || c_swapchainImageCount <= maxImageCount);
 
     const QueueFamilyIndices indices = getQueueFamilies(m_physicalDevice, m_surface);
     uint32_t queueFamilyIndices[] = {(uint32_t)indices.graphicsFamily, (uint32_t)indices.presentFamily};
@@ -346,7 +635,7 @@ void Context::createSwapchain()
     createInfo.minImageCount = c_swapchainImageCount;
     createInfo.imageFormat = c_surfaceFormat.format;
     createInfo.imageColorSpace = c_surfaceFormat.colorSpace;
-    createInfo.imageExtent = extent;
+    createInfo.imageExtent = m_swapchainExtent;
     createInfo.imageArrayLayers = 1;
     createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
     createInfo.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
@@ -354,9 +643,9 @@ void Context::createSwapchain()
     createInfo.pQueueFamilyIndices = nullptr;
     createInfo.preTransform = capabilities.surfaceCapabilities.currentTransform;
     createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
-    createInfo.presentMode = c_presentMode;
+    createInfo.presentMode = m_presentMode;
     createInfo.clipped = VK_TRUE;
-    createInfo.oldSwapchain = VK_NULL_HANDLE;
+    createInfo.oldSwapchain = oldSwapchain;
 
     VK_CHECK(vkCreateSwapchainKHR(m_device, &createInfo, nullptr, &m_swapchain));
 
@@ -367,6 +656,31 @@ void Context::createSwapchain()
     vkGetSwapchainImagesKHR(m_device, m_swapchain, &queriedImageCount, m_swapchainImages.data());
 }
 
+void Context::recreateSwapchain()
+{
+    // A minimized window has no area to present to so this blocks until it is restored
+    int width = 0;
+    int height = 0;
+    glfwGetFramebufferSize(m_window, &width, &height);
+    while (width == 0 || height == 0)
+    {
+        glfwWaitEvents();
+        glfwGetFramebufferSize(m_window, &width, &height);
+    }
+
+    // Submitted frames and pending presents may still use the old images, presents can only be waited through the queue
+    m_graphicsTimeline->wait(m_graphicsTimeline->getLastSubmittedValue());
+    VK_CHECK(vkQueueWaitIdle(m_presentQueue));
+
+    const VkSwapchainKHR oldSwapchain = m_swapchain;
+    createSwapchain(oldSwapchain);
+    vkDestroySwapchainKHR(m_device, oldSwapchain, nullptr);
+
+    m_swapchainOutdated = false;
+    ++m_swapchainGeneration;
+    printf("Swapchain recreated %ux%u %s\n", m_swapchainExtent.width, m_swapchainExtent.height, getPresentModeName(m_presentMode));
+}
+
 void Context::createCommandPools()
 {
     const QueueFamilyIndices indices = getQueueFamilies(m_physicalDevice, m_surface);
@@ -391,17 +705,14 @@ void Context::createSemaphores()
     VK_CHECK(vkCreateSemaphore(m_device, &semaphoreInfo, nullptr, &m_renderFinished));
 }
 
-void Context::createFences()
+void Context::createTimelines()
 {
-    m_inFlightFences.resize(m_swapchainImages.size());
-
-    VkFenceCreateInfo createInfo{};
-    createInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-    createInfo.pNext = nullptr;
-    createInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+    m_graphicsTimeline.reset(new Timeline(m_device));
+    m_computeTimeline.reset(new Timeline(m_device));
+    m_imageTimelineValues.resize(m_swapchainImages.size(), 0);
+}
 
-    for (VkFence& fence : m_inFlightFences)
-    {
-        vkCreateFence(m_device, &createInfo, nullptr, &fence);
-    }
+void Context::createDeletionQueue()
+{
+    m_deletionQueue.reset(new DeletionQueue(m_device, *m_memoryAllocator, *m_graphicsTimeline, *m_computeTimeline));
 }
@@ -1,9 +1,13 @@
 #pragma once
 
 #include "VulkanUtils.hpp"
+#include "MemoryAllocator.hpp"
+#include "Timeline.hpp"
+#include "DeletionQueue.hpp"
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
 #include <vector>
+#include <memory>
 
 class Context final
 {
@@ -22,27 +26,56 @@ public:
     VkDevice getDevice() const;
     VkInstance getInstance() const;
     const std::vector<VkImage>& getSwapchainImages() const;
+    VkExtent2D getSwapchainExtent() const;
+    // Incremented every time the swapchain is recreated, resources that depend on it are then rebuilt
+    uint32_t getSwapchainGeneration() const;
     VkQueue getGraphicsQueue() const;
     VkCommandPool getGraphicsCommandPool() const;
+    VkQueue getComputeQueue() const;
+    VkCommandPool getComputeCommandPool() const;
     VkSurfaceKHR getSurface() const;
+    bool isSamplerFilterMinmaxEnabled() const;
+    bool isDynamicRenderingEnabled() const;
+    bool isSynchronization2Enabled() const;
+    bool isDrawIndirectCountEnabled() const;
+    bool isPipelineStatisticsEnabled() const;
+    MemoryAllocator& getMemoryAllocator();
+    Timeline& getGraphicsTimeline();
+    Timeline& getComputeTimeline();
+    DeletionQueue& getDeletionQueue();
 
     bool update();
     std::vector<KeyEvent> getKeyEvents();
     glm::dvec2 getCursorPosition();
+    // Recreates the swapchain first when it is out of date, everything submitted before has then finished. Waits for
+    // the last submission that used the returned image so that its per-frame resources are free.
     uint32_t acquireNextSwapchainImage();
-    void submitCommandBuffers(const std::vector<VkCommandBuffer>& commandBuffers);
+    // Both return the value that the submission signals on the timeline of its queue
+    uint64_t submitCommandBuffers(const std::vector<VkCommandBuffer>& commandBuffers, const std::vector<SemaphoreWait>& waits = {});
+    uint64_t submitComputeCommandBuffers(const std::vector<VkCommandBuffer>& commandBuffers);
+
+    // Takes effect when the next image is acquired, falls back to FIFO when the mode is not supported
+    void setPresentMode(VkPresentModeKHR presentMode);
+    VkPresentModeKHR getPresentMode() const;
+    const std::vector<VkPresentModeKHR>& getSupportedPresentModes() const;
+    // Time the last acquire blocked for a free image, grows with the number of frames the present mode queues
+    double getAcquireMilliseconds() const;
 
 private:
     void initGLFW();
     void createInstance();
     void createWindow();
     void handleKey(GLFWwindow* /*window*/, int key, int /*scancode*/, int action, int /*mods*/);
+    void handleFramebufferResize();
     void enumeratePhysicalDevice();
     void createDevice();
-    void createSwapchain();
+    void createMemoryAllocator();
+    void createSwapchain(VkSwapchainKHR oldSwapchain);
+    void recreateSwapchain();
     void createCommandPools();
     void createSemaphores();
-    void createFences();
+    void createTimelines();
+    void createDeletionQueue();
 
     VkInstance m_instance;
     VkDebugUtilsMessengerEXT m_debugMessenger;
@@ -54,15 +87,32 @@ private:
     VkPhysicalDevice m_physicalDevice;
     VkPhysicalDeviceProperties m_physicalDeviceProperties;
     VkDevice m_device;
+    bool m_memoryBudgetSupported = false;
+    bool m_samplerFilterMinmaxEnabled = false;
+    bool m_dynamicRenderingEnabled = false;
+    bool m_synchronization2Enabled = false;
+    bool m_drawIndirectCountEnabled = false;
+    bool m_pipelineStatisticsEnabled = false;
+    std::unique_ptr<MemoryAllocator> m_memoryAllocator;
     VkQueue m_graphicsQueue;
     VkQueue m_computeQueue;
     VkQueue m_presentQueue;
     VkSwapchainKHR m_swapchain;
     std::vector<VkImage> m_swapchainImages;
+    VkExtent2D m_swapchainExtent;
+    uint32_t m_swapchainGeneration = 0;
+    bool m_swapchainOutdated = false;
+    VkPresentModeKHR m_requestedPresentMode = VK_PRESENT_MODE_MAILBOX_KHR;
+    VkPresentModeKHR m_presentMode;
+    std::vector<VkPresentModeKHR> m_supportedPresentModes;
+    double m_acquireMilliseconds = 0.0;
     VkCommandPool m_graphicsCommandPool;
     VkCommandPool m_computeCommandPool;
     VkSemaphore m_imageAvailable;
     VkSemaphore m_renderFinished;
-    std::vector<VkFence> m_inFlightFences;
+    std::unique_ptr<Timeline> m_graphicsTimeline;
+    std::unique_ptr<Timeline> m_computeTimeline;
+    std::vector<uint64_t> m_imageTimelineValues;
+    std::unique_ptr<DeletionQueue> m_deletionQueue;
     uint32_t m_imageIndex;
 };
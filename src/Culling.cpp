@@ -0,0 +1,261 @@
+#include "Culling.hpp"
+#include <cmath>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define CULLING_AVX
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define CULLING_SSE
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define CULLING_NEON
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace
+{
+// Padding objects have negative sizes so that no plane distance is ever large enough for them to pass
+const float c_paddingSize = -1.0e30f;
+
+uint32_t countTrailingZeros(uint32_t mask)
+{
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return static_cast<uint32_t>(index);
+#else
+    return static_cast<uint32_t>(__builtin_ctz(mask));
+#endif
+}
+
+// Writes an index for every set bit of a lane mask, visible needs room for all lanes
+size_t appendVisible(uint32_t mask, size_t first, uint32_t* visible, size_t count)
+{
+    while (mask != 0)
+    {
+        visible[count++] = static_cast<uint32_t>(first + countTrailingZeros(mask));
+        mask &= mask - 1;
+    }
+    return count;
+}
+
+void appendObject(Culling::Bounds& bounds, const glm::vec3& center, const glm::vec3& extent, float radius)
+{
+    if (bounds.count == bounds.radius.size())
+    {
+        const size_t size = bounds.count + Culling::c_batchSize;
+        bounds.centerX.resize(size, 0.0f);
+        bounds.centerY.resize(size, 0.0f);
+        bounds.centerZ.resize(size, 0.0f);
+        bounds.extentX.resize(size, c_paddingSize);
+        bounds.extentY.resize(size, c_paddingSize);
+        bounds.extentZ.resize(size, c_paddingSize);
+        bounds.radius.resize(size, c_paddingSize);
+    }
+
+    const size_t i = bounds.count++;
+    bounds.centerX[i] = center.x;
+    bounds.centerY[i] = center.y;
+    bounds.centerZ[i] = center.z;
+    bounds.extentX[i] = extent.x;
+    bounds.extentY[i] = extent.y;
+    bounds.extentZ[i] = extent.z;
+    bounds.radius[i] = radius;
+}
+
+// The same operation order as the lanes below so that both give the same results
+float getPlaneDistance(const glm::vec4& plane, const Culling::Bounds& bounds, size_t i)
+{
+    return bounds.centerX[i] * plane.x + (bounds.centerY[i] * plane.y + (bounds.centerZ[i] * plane.z + plane.w));
+}
+
+float getBoxRadius(const glm::vec4& plane, const Culling::Bounds& bounds, size_t i)
+{
+    return bounds.extentX[i] * std::abs(plane.x) + (bounds.extentY[i] * std::abs(plane.y) + bounds.extentZ[i] * std::abs(plane.z));
+}
+
+template<bool boxes>
+size_t cullScalar(const Culling::Planes& planes, const Culling::Bounds& bounds, std::vector<uint32_t>& visible)
+{
+    visible.resize(bounds.count);
+    size_t count = 0;
+    for (size_t i = 0; i < bounds.count; ++i)
+    {
+        bool inside = true;
+        for (const glm::vec4& plane : planes)
+        {
+            const float radius = boxes ? getBoxRadius(plane, bounds, i) : bounds.radius[i];
+            inside = inside && getPlaneDistance(plane, bounds, i) + radius >= 0.0f;
+        }
+        visible[count] = static_cast<uint32_t>(i);
+        count += inside ? 1 : 0;
+    }
+    visible.resize(count);
+    return count;
+}
+
+#if defined(CULLING_AVX)
+using Lanes = __m256;
+const size_t c_laneCount = 8;
+const char* c_instructionSet = "AVX";
+
+Lanes load(const float* data) { return _mm256_loadu_ps(data); }
+Lanes broadcast(float value) { return _mm256_set1_ps(value); }
+Lanes multiply(Lanes a, Lanes b) { return _mm256_mul_ps(a, b); }
+Lanes multiplyAdd(Lanes a, Lanes b, Lanes c) { return _mm256_add_ps(_mm256_mul_ps(a, b), c); }
+Lanes isInside(Lanes distance, Lanes radius) { return _mm256_cmp_ps(_mm256_add_ps(distance, radius), _mm256_setzero_ps(), _CMP_GE_OQ); }
+Lanes bitAnd(Lanes a, Lanes b) { return _mm256_and_ps(a, b); }
+uint32_t getMask(Lanes a) { return static_cast<uint32_t>(_mm256_movemask_ps(a)); }
+#elif defined(CULLING_SSE)
+using Lanes = __m128;
+const size_t c_laneCount = 4;
+const char* c_instructionSet = "SSE2";
+
+Lanes load(const float* data) { return _mm_loadu_ps(data); }
+Lanes broadcast(float value) { return _mm_set1_ps(value); }
+Lanes multiply(Lanes a, Lanes b) { return _mm_mul_ps(a, b); }
+Lanes multiplyAdd(Lanes a, Lanes b, Lanes c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+Lanes isInside(Lanes distance, Lanes radius) { return _mm_cmpge_ps(_mm_add_ps(distance, radius), _mm_setzero_ps()); }
+Lanes bitAnd(Lanes a, Lanes b) { return _mm_and_ps(a, b); }
+uint32_t getMask(Lanes a) { return static_cast<uint32_t>(_mm_movemask_ps(a)); }
+#elif defined(CULLING_NEON)
+using Lanes = float32x4_t;
+const size_t c_laneCount = 4;
+const char* c_instructionSet = "NEON";
+
+Lanes load(const float* data) { return vld1q_f32(data); }
+Lanes broadcast(float value) { return vdupq_n_f32(value); }
+Lanes multiply(Lanes a, Lanes b) { return vmulq_f32(a, b); }
+Lanes multiplyAdd(Lanes a, Lanes b, Lanes c) { return vaddq_f32(vmulq_f32(a, b), c); }
+Lanes isInside(Lanes distance, Lanes radius) { return vreinterpretq_f32_u32(vcgeq_f32(vaddq_f32(distance, radius), vdupq_n_f32(0.0f))); }
+Lanes bitAnd(Lanes a, Lanes b) { return vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(a), vreinterpretq_u32_f32(b))); }
+
+uint32_t getMask(Lanes a)
+{
+    const uint32x4_t bits = {1, 2, 4, 8};
+    return vaddvq_u32(vandq_u32(vreinterpretq_u32_f32(a), bits));
+}
+#endif
+
+#if defined(CULLING_AVX) || defined(CULLING_SSE) || defined(CULLING_NEON)
+static_assert(Culling::c_batchSize % c_laneCount == 0, "Bounds padding must cover whole lanes");
+
+// Tests c_laneCount objects against one plane per step, the planes are broadcast once up front
+template<bool boxes>
+size_t cullLanes(const Culling::Planes& planes, const Culling::Bounds& bounds, std::vector<uint32_t>& visible)
+{
+    Lanes normalX[6];
+    Lanes normalY[6];
+    Lanes normalZ[6];
+    Lanes distance[6];
+    Lanes absNormalX[6];
+    Lanes absNormalY[6];
+    Lanes absNormalZ[6];
+    for (size_t p = 0; p < planes.size(); ++p)
+    {
+        normalX[p] = broadcast(planes[p].x);
+        normalY[p] = broadcast(planes[p].y);
+        normalZ[p] = broadcast(planes[p].z);
+        distance[p] = broadcast(planes[p].w);
+        absNormalX[p] = broadcast(std::abs(planes[p].x));
+        absNormalY[p] = broadcast(std::abs(planes[p].y));
+        absNormalZ[p] = broadcast(std::abs(planes[p].z));
+    }
+
+    visible.resize(bounds.radius.size());
+    size_t count = 0;
+    for (size_t i = 0; i < bounds.count; i += c_laneCount)
+    {
+        const Lanes centerX = load(&bounds.centerX[i]);
+        const Lanes centerY = load(&bounds.centerY[i]);
+        const Lanes centerZ = load(&bounds.centerZ[i]);
+
+        Lanes inside{};
+        for (size_t p = 0; p < planes.size(); ++p)
+        {
+            const Lanes planeDistance = multiplyAdd(centerX, normalX[p], multiplyAdd(centerY, normalY[p], multiplyAdd(centerZ, normalZ[p], distance[p])));
+            Lanes radius;
+            if constexpr (boxes)
+            {
+                const Lanes extentZ = multiply(load(&bounds.extentZ[i]), absNormalZ[p]);
+                radius = multiplyAdd(load(&bounds.extentX[i]), absNormalX[p], multiplyAdd(load(&bounds.extentY[i]), absNormalY[p], extentZ));
+            }
+            else
+            {
+                radius = load(&bounds.radius[i]);
+            }
+            const Lanes planeInside = isInside(planeDistance, radius);
+            inside = p == 0 ? planeInside : bitAnd(inside, planeInside);
+        }
+        count = appendVisible(getMask(inside), i, visible.data(), count);
+    }
+    visible.resize(count);
+    return count;
+}
+#else
+const char* c_instructionSet = "Scalar";
+#endif
+} // namespace
+
+namespace Culling
+{
+void clear(Bounds& bounds)
+{
+    bounds.centerX.clear();
+    bounds.centerY.clear();
+    bounds.centerZ.clear();
+    bounds.extentX.clear();
+    bounds.extentY.clear();
+    bounds.extentZ.clear();
+    bounds.radius.clear();
+    bounds.count = 0;
+}
+
+void addBox(Bounds& bounds, const glm::vec3& min, const glm::vec3& max)
+{
+    const glm::vec3 extent = (max - min) * 0.5f;
+    appendObject(bounds, (min + max) * 0.5f, extent, glm::length(extent));
+}
+
+void addSphere(Bounds& bounds, const glm::vec3& center, float radius)
+{
+    appendObject(bounds, center, glm::vec3(radius), radius);
+}
+
+size_t cullSpheres(const Planes& planes, const Bounds& bounds, std::vector<uint32_t>& visible)
+{
+#if defined(CULLING_AVX) || defined(CULLING_SSE) || defined(CULLING_NEON)
+    return cullLanes<false>(planes, bounds, visible);
+#else
+    return cullScalar<false>(planes, bounds, visible);
+#endif
+}
+
+size_t cullBoxes(const Planes& planes, const Bounds& bounds, std::vector<uint32_t>& visible)
+{
+#if defined(CULLING_AVX) || defined(CULLING_SSE) || defined(CULLING_NEON)
+    return cullLanes<true>(planes, bounds, visible);
+#else
+    return cullScalar<true>(planes, bounds, visible);
+#endif
+}
+
+size_t cullSpheresScalar(const Planes& planes, const Bounds& bounds, std::vector<uint32_t>& visible)
+{
+    return cullScalar<false>(planes, bounds, visible);
+}
+
+size_t cullBoxesScalar(const Planes& planes, const Bounds& bounds, std::vector<uint32_t>& visible)
+{
+    return cullScalar<true>(planes, bounds, visible);
+}
+
+const char* getInstructionSet()
+{
+    return c_instructionSet;
+}
+} // namespace Culling
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <array>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// Frustum tests of many bounding volumes at once. The volumes are stored as a structure of arrays so that the SIMD
+// kernels load the same component of several objects with one instruction.
+namespace Culling
+{
+// Planes as returned by Camera::getFrustumPlanes
+using Planes = std::array<glm::vec4, 6>;
+
+// Objects processed per kernel iteration, the widest SIMD width that is supported
+const size_t c_batchSize = 8;
+
+// Every object has a box given by its center and half extents and a sphere around the same center. The arrays are
+// padded to a multiple of c_batchSize with objects that never pass so that the kernels have no scalar tail.
+struct Bounds
+{
+    std::vector<float> centerX;
+    std::vector<float> centerY;
+    std::vector<float> centerZ;
+    std::vector<float> extentX;
+    std::vector<float> extentY;
+    std::vector<float> extentZ;
+    std::vector<float> radius;
+    size_t count = 0;
+};
+
+void clear(Bounds& bounds);
+// The sphere of a box encloses its corners
+void addBox(Bounds& bounds, const glm::vec3& min, const glm::vec3& max);
+// The box of a sphere encloses the sphere
+void addSphere(Bounds& bounds, const glm::vec3& center, float radius);
+
+// Write the indices of the objects that intersect the frustum to visible in ascending order and return their number
+size_t cullSpheres(const Planes& planes, const Bounds& bounds, std::vector<uint32_t>& visible);
+size_t cullBoxes(const Planes& planes, const Bounds& bounds, std::vector<uint32_t>& visible);
+// One object at a time, reference for the kernels above
+size_t cullSpheresScalar(const Planes& planes, const Bounds& bounds, std::vector<uint32_t>& visible);
+size_t cullBoxesScalar(const Planes& planes, const Bounds& bounds, std::vector<uint32_t>& visible);
+
+// Instruction set the kernels were compiled for
+const char* getInstructionSet();
+} // namespace Culling
@@ -0,0 +1,123 @@
+#include "DeletionQueue.hpp"
+#include "Timeline.hpp"
+
+DeletionQueue::DeletionQueue(VkDevice device, MemoryAllocator& memoryAllocator, Timeline& graphicsTimeline, Timeline& computeTimeline) :
+    m_device(device),
+    m_memoryAllocator(memoryAllocator),
+    m_graphicsTimeline(graphicsTimeline),
+    m_computeTimeline(computeTimeline)
+{
+}
+
+DeletionQueue::~DeletionQueue()
+{
+    flush();
+}
+
+void DeletionQueue::destroyBuffer(VkBuffer buffer)
+{
+    push([this, buffer]() {
+        vkDestroyBuffer(m_device, buffer, nullptr);
+    });
+}
+
+void DeletionQueue::destroyImage(VkImage image)
+{
+    push([this, image]() {
+        vkDestroyImage(m_device, image, nullptr);
+    });
+}
+
+void DeletionQueue::destroyImageView(VkImageView imageView)
+{
+    push([this, imageView]() {
+        vkDestroyImageView(m_device, imageView, nullptr);
+    });
+}
+
+void DeletionQueue::destroySampler(VkSampler sampler)
+{
+    push([this, sampler]() {
+        vkDestroySampler(m_device, sampler, nullptr);
+    });
+}
+
+void DeletionQueue::destroyPipeline(VkPipeline pipeline)
+{
+    push([this, pipeline]() {
+        vkDestroyPipeline(m_device, pipeline, nullptr);
+    });
+}
+
+void DeletionQueue::destroyPipelineLayout(VkPipelineLayout pipelineLayout)
+{
+    push([this, pipelineLayout]() {
+        vkDestroyPipelineLayout(m_device, pipelineLayout, nullptr);
+    });
+}
+
+void DeletionQueue::destroyDescriptorSetLayout(VkDescriptorSetLayout descriptorSetLayout)
+{
+    push([this, descriptorSetLayout]() {
+        vkDestroyDescriptorSetLayout(m_device, descriptorSetLayout, nullptr);
+    });
+}
+
+void DeletionQueue::destroyDescriptorPool(VkDescriptorPool descriptorPool)
+{
+    push([this, descriptorPool]() {
+        vkDestroyDescriptorPool(m_device, descriptorPool, nullptr);
+    });
+}
+
+void DeletionQueue::freeDescriptorSet(VkDescriptorPool descriptorPool, VkDescriptorSet descriptorSet)
+{
+    push([this, descriptorPool, descriptorSet]() {
+        VK_CHECK(vkFreeDescriptorSets(m_device, descriptorPool, 1, &descriptorSet));
+    });
+}
+
+void DeletionQueue::releaseMemory(MemoryAllocation& allocation)
+{
+    MemoryAllocation retired = allocation;
+    allocation = MemoryAllocation{};
+    push([this, retired]() mutable {
+        m_memoryAllocator.release(retired);
+    });
+}
+
+void DeletionQueue::push(std::function<void()> deleter)
+{
+    Entry entry;
+    entry.graphicsValue = m_graphicsTimeline.getLastSubmittedValue();
+    entry.computeValue = m_computeTimeline.getLastSubmittedValue();
+    entry.deleter = std::move(deleter);
+    m_entries.push_back(std::move(entry));
+}
+
+// Entries are retired in submission order so the first one that isn't finished ends the collection
+void DeletionQueue::collect()
+{
+    while (!m_entries.empty())
+    {
+        const Entry& entry = m_entries.front();
+        if (!m_graphicsTimeline.isCompleted(entry.graphicsValue) || !m_computeTimeline.isCompleted(entry.computeValue))
+        {
+            return;
+        }
+        entry.deleter();
+        m_entries.pop_front();
+    }
+}
+
+void DeletionQueue::flush()
+{
+    m_graphicsTimeline.wait(m_graphicsTimeline.getLastSubmittedValue());
+    m_computeTimeline.wait(m_computeTimeline.getLastSubmittedValue());
+    collect();
+}
+
+size_t DeletionQueue::getPendingCount() const
+{
+    return m_entries.size();
+}
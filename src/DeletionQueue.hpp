@@ -0,0 +1,50 @@
+#pragma once
+
+#include "VulkanUtils.hpp"
+#include "MemoryAllocator.hpp"
+#include <deque>
+#include <functional>
+#include <cstdint>
+
+// Destroys Vulkan objects once the GPU has finished every submission that could have used them. Objects are
+// retired with the last submitted values of the graphics and compute timelines, so anything submitted before the
+// call may still use them but nothing submitted after it may. collect is called once per frame.
+class DeletionQueue final
+{
+public:
+    DeletionQueue(VkDevice device, MemoryAllocator& memoryAllocator, Timeline& graphicsTimeline, Timeline& computeTimeline);
+    ~DeletionQueue();
+
+    void destroyBuffer(VkBuffer buffer);
+    void destroyImage(VkImage image);
+    void destroyImageView(VkImageView imageView);
+    void destroySampler(VkSampler sampler);
+    void destroyPipeline(VkPipeline pipeline);
+    void destroyPipelineLayout(VkPipelineLayout pipelineLayout);
+    void destroyDescriptorSetLayout(VkDescriptorSetLayout descriptorSetLayout);
+    void destroyDescriptorPool(VkDescriptorPool descriptorPool);
+    // The pool must have been created with VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT
+    void freeDescriptorSet(VkDescriptorPool descriptorPool, VkDescriptorSet descriptorSet);
+    // Resets allocation so that the caller can't release it twice
+    void releaseMemory(MemoryAllocation& allocation);
+    void push(std::function<void()> deleter);
+
+    void collect();
+    // Waits for everything submitted so far and destroys all retired objects
+    void flush();
+    size_t getPendingCount() const;
+
+private:
+    struct Entry
+    {
+        uint64_t graphicsValue;
+        uint64_t computeValue;
+        std::function<void()> deleter;
+    };
+
+    VkDevice m_device;
+    MemoryAllocator& m_memoryAllocator;
+    Timeline& m_graphicsTimeline;
+    Timeline& m_computeTimeline;
+    std::deque<Entry> m_entries;
+};
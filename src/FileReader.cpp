@@ -0,0 +1,463 @@
+#include "FileReader.hpp"
+#include "Utils.hpp"
+
+#include <fstream>
+#include <algorithm>
+#include <cstring>
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#define HAS_IO_URING 1
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#else
+#define HAS_IO_URING 0
+#endif
+
+namespace
+{
+// Reads are split at aligned offsets so that large files are fetched with many requests in flight
+const uint64_t c_chunkSize = 1024 * 1024;
+const unsigned int c_queueDepth = 64;
+const unsigned int c_workerCount = 8;
+} // namespace
+
+#if HAS_IO_URING
+// Minimal io_uring wrapper on top of the raw syscalls so that liburing is not needed
+class FileReader::IoUring
+{
+public:
+    IoUring() = default;
+
+    ~IoUring()
+    {
+        if (m_sqes)
+        {
+            munmap(m_sqes, m_sqesSize);
+        }
+        if (m_cqRing && m_cqRing != m_sqRing)
+        {
+            munmap(m_cqRing, m_cqRingSize);
+        }
+        if (m_sqRing)
+        {
+            munmap(m_sqRing, m_sqRingSize);
+        }
+        if (m_fd >= 0)
+        {
+            close(m_fd);
+        }
+    }
+
+    bool initialize(unsigned int entries)
+    {
+        io_uring_params params{};
+        m_fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+        if (m_fd < 0)
+        {
+            return false;
+        }
+
+        // IORING_OP_READ needs 5.6, fast poll arrived in 5.7 and is used as the version check
+        if (!(params.features & IORING_FEAT_FAST_POLL))
+        {
+            return false;
+        }
+
+        m_sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+        m_cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        const bool singleMmap = params.features & IORING_FEAT_SINGLE_MMAP;
+        if (singleMmap)
+        {
+            m_sqRingSize = std::max(m_sqRingSize, m_cqRingSize);
+            m_cqRingSize = m_sqRingSize;
+        }
+
+        m_sqRing = mmap(nullptr, m_sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_SQ_RING);
+        if (m_sqRing == MAP_FAILED)
+        {
+            m_sqRing = nullptr;
+            return false;
+        }
+
+        m_cqRing = singleMmap ? m_sqRing : mmap(nullptr, m_cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_CQ_RING);
+        if (m_cqRing == MAP_FAILED)
+        {
+            m_cqRing = nullptr;
+            return false;
+        }
+
+        m_sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+        void* sqes = mmap(nullptr, m_sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_SQES);
+        if (sqes == MAP_FAILED)
+        {
+            return false;
+        }
+        m_sqes = static_cast<io_uring_sqe*>(sqes);
+
+        char* sq = static_cast<char*>(m_sqRing);
+        m_sqTail = reinterpret_cast<unsigned int*>(sq + params.sq_off.tail);
+        m_sqMask = *reinterpret_cast<unsigned int*>(sq + params.sq_off.ring_mask);
+        m_sqArray = reinterpret_cast<unsigned int*>(sq + params.sq_off.array);
+
+        char* cq = static_cast<char*>(m_cqRing);
+        m_cqHead = reinterpret_cast<unsigned int*>(cq + params.cq_off.head);
+        m_cqTail = reinterpret_cast<unsigned int*>(cq + params.cq_off.tail);
+        m_cqMask = *reinterpret_cast<unsigned int*>(cq + params.cq_off.ring_mask);
+        m_cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+
+        return true;
+    }
+
+    void prepareRead(int fd, void* destination, uint32_t size, uint64_t offset, uint64_t userData)
+    {
+        const unsigned int tail = *m_sqTail;
+        const unsigned int index = tail & m_sqMask;
+
+        io_uring_sqe& sqe = m_sqes[index];
+        std::memset(&sqe, 0, sizeof(sqe));
+        sqe.opcode = IORING_OP_READ;
+        sqe.fd = fd;
+        sqe.addr = reinterpret_cast<uint64_t>(destination);
+        sqe.len = size;
+        sqe.off = offset;
+        sqe.user_data = userData;
+
+        m_sqArray[index] = index;
+        __atomic_store_n(m_sqTail, tail + 1, __ATOMIC_RELEASE);
+        ++m_unsubmitted;
+    }
+
+    // Submits prepared reads and blocks until at least one has completed
+    bool submitAndWait()
+    {
+        int result;
+        do
+        {
+            result = static_cast<int>(syscall(__NR_io_uring_enter, m_fd, m_unsubmitted, 1, IORING_ENTER_GETEVENTS, nullptr, 0));
+        } while (result < 0 && errno == EINTR);
+
+        if (result < 0)
+        {
+            return false;
+        }
+        m_unsubmitted -= std::min<unsigned int>(m_unsubmitted, static_cast<unsigned int>(result));
+        return true;
+    }
+
+    template<typename F>
+    void forEachCompletion(F&& callback)
+    {
+        unsigned int head = *m_cqHead;
+        const unsigned int tail = __atomic_load_n(m_cqTail, __ATOMIC_ACQUIRE);
+        for (; head != tail; ++head)
+        {
+            const io_uring_cqe& cqe = m_cqes[head & m_cqMask];
+            callback(cqe.user_data, cqe.res);
+        }
+        __atomic_store_n(m_cqHead, head, __ATOMIC_RELEASE);
+    }
+
+private:
+    int m_fd = -1;
+    void* m_sqRing = nullptr;
+    void* m_cqRing = nullptr;
+    size_t m_sqRingSize = 0;
+    size_t m_cqRingSize = 0;
+    size_t m_sqesSize = 0;
+    io_uring_sqe* m_sqes = nullptr;
+    unsigned int* m_sqTail = nullptr;
+    unsigned int m_sqMask = 0;
+    unsigned int* m_sqArray = nullptr;
+    unsigned int* m_cqHead = nullptr;
+    unsigned int* m_cqTail = nullptr;
+    unsigned int m_cqMask = 0;
+    io_uring_cqe* m_cqes = nullptr;
+    unsigned int m_unsubmitted = 0;
+};
+#else
+class FileReader::IoUring
+{
+};
+#endif
+
+FileReader::FileReader()
+{
+#if HAS_IO_URING
+    m_ioUring.reset(new IoUring());
+    if (m_ioUring->initialize(c_queueDepth))
+    {
+        m_threads.emplace_back(&FileReader::ioUringLoop, this);
+        return;
+    }
+    m_ioUring.reset();
+#endif
+
+    for (unsigned int i = 0; i < c_workerCount; ++i)
+    {
+        m_threads.emplace_back(&FileReader::workerLoop, this);
+    }
+}
+
+FileReader::~FileReader()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_quit = true;
+    }
+    m_condition.notify_all();
+
+    for (std::thread& thread : m_threads)
+    {
+        thread.join();
+    }
+}
+
+std::future<FileReader::Result> FileReader::read(const std::filesystem::path& path)
+{
+    std::shared_ptr<Request> request = std::make_shared<Request>();
+    request->path = path;
+    std::future<Result> future = request->promise.get_future();
+
+    if (m_ioUring)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_newRequests.push_back(request);
+        }
+        m_condition.notify_all();
+    }
+    else
+    {
+        pushTask([this, request]() { openForWorkers(request); });
+    }
+
+    return future;
+}
+
+bool FileReader::usesIoUring() const
+{
+    return m_ioUring != nullptr;
+}
+
+std::vector<FileReader::Chunk> FileReader::splitIntoChunks(const std::shared_ptr<Request>& request, uint64_t fileSize)
+{
+    request->data.resize(static_cast<size_t>(fileSize));
+
+    std::vector<Chunk> chunks;
+    for (uint64_t offset = 0; offset < fileSize; offset += c_chunkSize)
+    {
+        chunks.push_back(Chunk{request, offset, std::min(c_chunkSize, fileSize - offset)});
+    }
+    request->remainingChunks = chunks.size();
+
+    if (chunks.empty())
+    {
+        request->promise.set_value(Result());
+    }
+    return chunks;
+}
+
+void FileReader::completeChunk(const std::shared_ptr<Request>& request)
+{
+    if (--request->remainingChunks == 0)
+    {
+#if HAS_IO_URING
+        if (request->fd >= 0)
+        {
+            close(request->fd);
+        }
+#endif
+        Result result;
+        {
+            std::lock_guard<std::mutex> lock(request->errorMutex);
+            result.error = request->error;
+        }
+        if (result.error.empty())
+        {
+            result.data = std::move(request->data);
+        }
+        request->promise.set_value(std::move(result));
+    }
+}
+
+void FileReader::failChunk(const std::shared_ptr<Request>& request, const std::string& error)
+{
+    {
+        std::lock_guard<std::mutex> lock(request->errorMutex);
+        if (request->error.empty())
+        {
+            request->error = error;
+        }
+    }
+    completeChunk(request);
+}
+
+// For requests that fail before any chunk is in flight
+void FileReader::failRequest(const std::shared_ptr<Request>& request, const std::string& error)
+{
+    Result result;
+    result.error = error;
+    request->promise.set_value(std::move(result));
+}
+
+void FileReader::ioUringLoop()
+{
+#if HAS_IO_URING
+    std::deque<Chunk> pendingChunks;
+    unsigned int inFlight = 0;
+
+    while (true)
+    {
+        std::deque<std::shared_ptr<Request>> newRequests;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            if (inFlight == 0 && pendingChunks.empty())
+            {
+                m_condition.wait(lock, [this]() { return m_quit || !m_newRequests.empty(); });
+                if (m_newRequests.empty())
+                {
+                    return;
+                }
+            }
+            newRequests.swap(m_newRequests);
+        }
+
+        for (const std::shared_ptr<Request>& request : newRequests)
+        {
+            openForIoUring(request, pendingChunks);
+        }
+
+        // Chunks are owned by the ring while in flight and released when their completion is reaped
+        while (!pendingChunks.empty() && inFlight < c_queueDepth)
+        {
+            Chunk* chunk = new Chunk(std::move(pendingChunks.front()));
+            pendingChunks.pop_front();
+            char* destination = chunk->request->data.data() + chunk->offset;
+            m_ioUring->prepareRead(chunk->request->fd, destination, static_cast<uint32_t>(chunk->size), chunk->offset, reinterpret_cast<uint64_t>(chunk));
+            ++inFlight;
+        }
+
+        if (inFlight == 0)
+        {
+            continue;
+        }
+
+        CHECK(m_ioUring->submitAndWait());
+
+        m_ioUring->forEachCompletion([&](uint64_t userData, int32_t result) {
+            std::unique_ptr<Chunk> chunk(reinterpret_cast<Chunk*>(userData));
+            --inFlight;
+
+            if (result <= 0)
+            {
+                failChunk(chunk->request, "Failed to read " + chunk->request->path.string() + ", error " + std::to_string(-result));
+                return;
+            }
+
+            // Short reads are continued from where they stopped
+            if (static_cast<uint64_t>(result) < chunk->size)
+            {
+                chunk->offset += result;
+                chunk->size -= result;
+                pendingChunks.push_front(std::move(*chunk));
+                return;
+            }
+
+            completeChunk(chunk->request);
+        });
+    }
+#endif
+}
+
+void FileReader::openForIoUring(const std::shared_ptr<Request>& request, std::deque<Chunk>& chunks)
+{
+#if HAS_IO_URING
+    request->fd = open(request->path.string().c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat fileStat;
+    if (request->fd < 0 || fstat(request->fd, &fileStat) != 0)
+    {
+        if (request->fd >= 0)
+        {
+            close(request->fd);
+        }
+        failRequest(request, "Failed to open " + request->path.string());
+        return;
+    }
+
+    posix_fadvise(request->fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    const std::vector<Chunk> fileChunks = splitIntoChunks(request, static_cast<uint64_t>(fileStat.st_size));
+    chunks.insert(chunks.end(), fileChunks.begin(), fileChunks.end());
+
+    if (fileChunks.empty())
+    {
+        close(request->fd);
+    }
+#endif
+}
+
+void FileReader::workerLoop()
+{
+    while (true)
+    {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_condition.wait(lock, [this]() { return m_quit || !m_tasks.empty(); });
+            if (m_tasks.empty())
+            {
+                return;
+            }
+            task = std::move(m_tasks.front());
+            m_tasks.pop_front();
+        }
+        task();
+    }
+}
+
+void FileReader::pushTask(std::function<void()> task)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_tasks.push_back(std::move(task));
+    }
+    m_condition.notify_one();
+}
+
+void FileReader::openForWorkers(const std::shared_ptr<Request>& request)
+{
+    std::error_code error;
+    const uintmax_t fileSize = std::filesystem::file_size(request->path, error);
+    if (error)
+    {
+        failRequest(request, "Failed to open " + request->path.string());
+        return;
+    }
+
+    for (const Chunk& chunk : splitIntoChunks(request, fileSize))
+    {
+        pushTask([this, chunk]() { readChunk(chunk); });
+    }
+}
+
+void FileReader::readChunk(const Chunk& chunk)
+{
+    std::ifstream file(chunk.request->path, std::ios::binary);
+    if (file.is_open())
+    {
+        file.seekg(static_cast<std::streamoff>(chunk.offset));
+        file.read(chunk.request->data.data() + chunk.offset, static_cast<std::streamsize>(chunk.size));
+    }
+    if (!file.is_open() || static_cast<uint64_t>(file.gcount()) != chunk.size)
+    {
+        failChunk(chunk.request, "Failed to read " + chunk.request->path.string());
+        return;
+    }
+
+    completeChunk(chunk.request);
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <filesystem>
+#include <future>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <atomic>
+#include <string>
+#include <cstdint>
+
+// Reads whole files asynchronously in large chunks that are in flight at the same time.
+// Uses io_uring on Linux when the kernel allows it, otherwise a pool of blocking reader threads.
+// Files that can't be opened or read complete with an error instead of data, the caller decides whether that is fatal.
+class FileReader final
+{
+public:
+    using Data = std::vector<char>;
+
+    struct Result
+    {
+        Data data;
+        // Empty when the whole file was read
+        std::string error;
+    };
+
+    FileReader();
+    ~FileReader();
+
+    std::future<Result> read(const std::filesystem::path& path);
+    bool usesIoUring() const;
+
+private:
+    struct Request
+    {
+        std::filesystem::path path;
+        std::promise<Result> promise;
+        Data data;
+        std::atomic<size_t> remainingChunks{0};
+        int fd = -1;
+        // First error of the chunks, the request completes once all of them have
+        std::mutex errorMutex;
+        std::string error;
+    };
+
+    struct Chunk
+    {
+        std::shared_ptr<Request> request;
+        uint64_t offset;
+        uint64_t size;
+    };
+
+    class IoUring;
+
+    std::vector<Chunk> splitIntoChunks(const std::shared_ptr<Request>& request, uint64_t fileSize);
+    void completeChunk(const std::shared_ptr<Request>& request);
+    void failChunk(const std::shared_ptr<Request>& request, const std::string& error);
+    void failRequest(const std::shared_ptr<Request>& request, const std::string& error);
+
+    void ioUringLoop();
+    void openForIoUring(const std::shared_ptr<Request>& request, std::deque<Chunk>& chunks);
+
+    void workerLoop();
+    void pushTask(std::function<void()> task);
+    void openForWorkers(const std::shared_ptr<Request>& request);
+    void readChunk(const Chunk& chunk);
+
+    std::unique_ptr<IoUring> m_ioUring;
+    std::vector<std::thread> m_threads;
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    std::deque<std::shared_ptr<Request>> m_newRequests;
+    std::deque<std::function<void()>> m_tasks;
+    bool m_quit = false;
+};
@@ -0,0 +1,73 @@
+#include "FrameAllocator.hpp"
+#include "DebugMarker.hpp"
+#include <algorithm>
+
+namespace
+{
+VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+} // namespace
+
+FrameAllocator::FrameAllocator(VkDevice device, VkPhysicalDevice physicalDevice, MemoryAllocator& memoryAllocator, uint32_t frameCount, VkDeviceSize frameSize) :
+    m_device(device),
+    m_memoryAllocator(memoryAllocator)
+{
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    const VkPhysicalDeviceLimits& limits = properties.limits;
+    m_alignment = std::max(limits.minUniformBufferOffsetAlignment, limits.minStorageBufferOffsetAlignment);
+    m_frameSize = alignUp(frameSize, m_alignment);
+
+    VkBufferCreateInfo bufferInfo{};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = m_frameSize * frameCount;
+    bufferInfo.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    VK_CHECK(vkCreateBuffer(m_device, &bufferInfo, nullptr, &m_buffer));
+    DebugMarker::setObjectName(VK_OBJECT_TYPE_BUFFER, (uint64_t)m_buffer, "Frame allocator");
+
+    // Device local host visible memory is used when there is budget for it so that the GPU reads from its own memory
+    m_memory = m_memoryAllocator.allocateForBuffer(m_buffer, MemoryUsage::Dynamic, MemoryCategory::Uniform);
+
+    void* mappedData;
+    VK_CHECK(vkMapMemory(m_device, m_memory.memory, 0, VK_WHOLE_SIZE, 0, &mappedData));
+    m_mappedData = static_cast<unsigned char*>(mappedData);
+}
+
+FrameAllocator::~FrameAllocator()
+{
+    vkUnmapMemory(m_device, m_memory.memory);
+    vkDestroyBuffer(m_device, m_buffer, nullptr);
+    m_memoryAllocator.release(m_memory);
+}
+
+void FrameAllocator::beginFrame(uint32_t frameIndex)
+{
+    m_frameBegin = m_frameSize * frameIndex;
+    m_offset = m_frameBegin;
+}
+
+FrameAllocator::Allocation FrameAllocator::allocate(VkDeviceSize size)
+{
+    const VkDeviceSize offset = alignUp(m_offset, m_alignment);
+    CHECK(offset + size <= m_frameBegin + m_frameSize);
+    m_offset = offset + size;
+
+    Allocation allocation;
+    allocation.data = m_mappedData + offset;
+    allocation.offset = static_cast<uint32_t>(offset);
+    return allocation;
+}
+
+VkBuffer FrameAllocator::getBuffer() const
+{
+    return m_buffer;
+}
+
+VkDeviceSize FrameAllocator::getFrameSize() const
+{
+    return m_frameSize;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "VulkanUtils.hpp"
+#include "MemoryAllocator.hpp"
+#include <cstring>
+
+// Linear allocator for data that lives for one frame. The buffer is split into one region per frame in flight
+// and stays mapped for its whole lifetime. Allocations are aligned so that their offsets can be used as
+// dynamic offsets of uniform and storage buffer descriptors.
+class FrameAllocator final
+{
+public:
+    struct Allocation
+    {
+        void* data;
+        uint32_t offset;
+    };
+
+    FrameAllocator(VkDevice device, VkPhysicalDevice physicalDevice, MemoryAllocator& memoryAllocator, uint32_t frameCount, VkDeviceSize frameSize);
+    ~FrameAllocator();
+
+    // The region of frameIndex must no longer be in use by the GPU
+    void beginFrame(uint32_t frameIndex);
+    Allocation allocate(VkDeviceSize size);
+
+    template<typename T>
+    uint32_t push(const T& value)
+    {
+        const Allocation allocation = allocate(sizeof(T));
+        std::memcpy(allocation.data, &value, sizeof(T));
+        return allocation.offset;
+    }
+
+    VkBuffer getBuffer() const;
+    VkDeviceSize getFrameSize() const;
+
+private:
+    VkDevice m_device;
+    MemoryAllocator& m_memoryAllocator;
+    VkBuffer m_buffer;
+    MemoryAllocation m_memory;
+    unsigned char* m_mappedData;
+    VkDeviceSize m_frameSize;
+    VkDeviceSize m_alignment;
+    VkDeviceSize m_frameBegin = 0;
+    VkDeviceSize m_offset = 0;
+};
@@ -8,6 +8,10 @@
 
 namespace
 {
+// The GUI blends over the scene's color and neither tests nor writes depth
+const AttachmentOps c_colorOps{"GUI", "Swapchain color", VK_ATTACHMENT_LOAD_OP_LOAD, VK_ATTACHMENT_STORE_OP_STORE};
+const AttachmentOps c_depthOps{"GUI", "Depth", VK_ATTACHMENT_LOAD_OP_DONT_CARE, VK_ATTACHMENT_STORE_OP_DONT_CARE};
+
 void imguiCallback(VkResult r)
 {
     if (r == 0)
@@ -19,16 +23,24 @@ void imguiCallback(VkResult r)
 }
 } // namespace
 
+bool GUI::isDynamicRenderingSupported()
+{
+#ifdef IMGUI_IMPL_VULKAN_HAS_DYNAMIC_RENDERING
+    return true;
+#else
+    return false;
+#endif
+}
+
 GUI::GUI(const InitData& initData)
 {
     m_device = initData.device;
 
-    createRenderPass(initData.colorFormat, initData.depthFormat);
-
-    int width;
-    int height;
-    glfwGetFramebufferSize(initData.glfwWindow, &width, &height);
-    m_extent = {static_cast<unsigned int>(width), static_cast<unsigned int>(height)};
+    CHECK(!initData.dynamicRendering || isDynamicRenderingSupported());
+    if (!initData.dynamicRendering)
+    {
+        createRenderPass(initData.colorFormat, initData.depthFormat);
+    }
 
     IMGUI_CHECKVERSION();
     ImGui::CreateContext();
@@ -49,12 +61,16 @@ GUI::GUI(const InitData& initData)
     imguiInitInfo.MSAASamples = VK_SAMPLE_COUNT_1_BIT;
     imguiInitInfo.Allocator = nullptr;
     imguiInitInfo.CheckVkResultFn = imguiCallback;
+#ifdef IMGUI_IMPL_VULKAN_HAS_DYNAMIC_RENDERING
+    imguiInitInfo.UseDynamicRendering = initData.dynamicRendering;
+    imguiInitInfo.ColorAttachmentFormat = initData.colorFormat;
+#endif
 
     CHECK(ImGui_ImplVulkan_Init(&imguiInitInfo, m_renderPass));
 
     const SingleTimeCommand command = beginSingleTimeCommands(initData.graphicsCommandPool, m_device);
     ImGui_ImplVulkan_CreateFontsTexture(command.commandBuffer);
-    endSingleTimeCommands(initData.graphicsQueue, command);
+    endSingleTimeCommands(initData.graphicsQueue, *initData.graphicsTimeline, command);
     ImGui_ImplVulkan_DestroyFontUploadObjects();
 }
 
@@ -74,25 +90,68 @@ void GUI::beginFrame()
     ImGui::NewFrame();
 }
 
-void GUI::endFrame(VkCommandBuffer commandBuffer, VkFramebuffer framebuffer)
+void GUI::endFrame()
 {
     ImGui::Render();
+}
+
+void GUI::recordRenderPass(VkCommandBuffer commandBuffer, VkFramebuffer framebuffer, VkExtent2D extent) const
+{
+    CHECK(m_renderPass != VK_NULL_HANDLE);
 
     VkRenderPassBeginInfo renderPassInfo{};
     renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
     renderPassInfo.renderPass = m_renderPass;
     renderPassInfo.framebuffer = framebuffer;
     renderPassInfo.renderArea.offset = {0, 0};
-    renderPassInfo.renderArea.extent = m_extent;
+    renderPassInfo.renderArea.extent = extent;
     renderPassInfo.clearValueCount = 0;
     renderPassInfo.pClearValues = nullptr;
 
     vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+    recordDraws(commandBuffer);
+    vkCmdEndRenderPass(commandBuffer);
+}
+
+// The backend's dynamic rendering pipeline has no depth format so the GUI can't draw in a rendering with the scene's
+// depth attachment, only the color attachment is loaded again
+void GUI::recordRendering(VkCommandBuffer commandBuffer, VkImageView colorImageView, VkExtent2D extent) const
+{
+    CHECK(m_renderPass == VK_NULL_HANDLE);
+
+    VkRenderingAttachmentInfo colorAttachment{};
+    colorAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+    colorAttachment.imageView = colorImageView;
+    colorAttachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    colorAttachment.loadOp = c_colorOps.loadOp;
+    colorAttachment.storeOp = c_colorOps.storeOp;
+
+    VkRenderingInfo renderingInfo{};
+    renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
+    renderingInfo.renderArea.offset = {0, 0};
+    renderingInfo.renderArea.extent = extent;
+    renderingInfo.layerCount = 1;
+    renderingInfo.colorAttachmentCount = 1;
+    renderingInfo.pColorAttachments = &colorAttachment;
+
+    vkCmdBeginRendering(commandBuffer, &renderingInfo);
+    recordDraws(commandBuffer);
+    vkCmdEndRendering(commandBuffer);
+}
 
+void GUI::recordDraws(VkCommandBuffer commandBuffer) const
+{
     ImDrawData* drawData = ImGui::GetDrawData();
     ImGui_ImplVulkan_RenderDrawData(drawData, commandBuffer);
+}
 
-    vkCmdEndRenderPass(commandBuffer);
+std::vector<AttachmentOps> GUI::getAttachmentOps() const
+{
+    if (m_renderPass == VK_NULL_HANDLE)
+    {
+        return {c_colorOps};
+    }
+    return {c_colorOps, c_depthOps};
 }
 
 void GUI::createRenderPass(VkFormat colorFormat, VkFormat depthFormat)
@@ -105,14 +164,6 @@ void GUI::createRenderPass(VkFormat colorFormat, VkFormat depthFormat)
     depthAttachmentRef.attachment = 1;
     depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
 
-    VkSubpassDependency dependency{};
-    dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-    dependency.dstSubpass = 0;
-    dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    dependency.srcAccessMask = 0;
-    dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-
     VkSubpassDescription subpass{};
     subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
     subpass.colorAttachmentCount = 1;
@@ -122,20 +173,22 @@ void GUI::createRenderPass(VkFormat colorFormat, VkFormat depthFormat)
     VkAttachmentDescription colorAttachment{};
     colorAttachment.format = colorFormat;
     colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
-    colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
-    colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-    colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+    colorAttachment.loadOp = c_colorOps.loadOp;
+    colorAttachment.storeOp = c_colorOps.storeOp;
+    colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
     colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-    colorAttachment.initialLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
-    colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    // The caller transitions the attachments and orders the pass after the scene
+    colorAttachment.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    colorAttachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
     VkAttachmentDescription depthAttachment{};
     depthAttachment.format = depthFormat;
     depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
-    depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
-    depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-    depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
-    depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_STORE;
+    // Only there to keep the pass compatible with the scene pass, whose depth is either discarded or already used
+    depthAttachment.loadOp = c_depthOps.loadOp;
+    depthAttachment.storeOp = c_depthOps.storeOp;
+    depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
     depthAttachment.initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
     depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
 
@@ -146,8 +199,6 @@ void GUI::createRenderPass(VkFormat colorFormat, VkFormat depthFormat)
     renderPassInfo.pAttachments = attachments.data();
     renderPassInfo.subpassCount = 1;
     renderPassInfo.pSubpasses = &subpass;
-    renderPassInfo.dependencyCount = 1;
-    renderPassInfo.pDependencies = &dependency;
 
     VK_CHECK(vkCreateRenderPass(m_device, &renderPassInfo, nullptr, &m_renderPass));
 }
\ No newline at end of file
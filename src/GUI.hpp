@@ -1,10 +1,14 @@
 #pragma once
 
+#include "VulkanUtils.hpp"
 #include <imgui.h>
 #include <imgui_impl_glfw.h>
 #include <imgui_impl_vulkan.h>
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
+#include <vector>
+
+class Timeline;
 
 class GUI final
 {
@@ -17,23 +21,38 @@ public:
         VkInstance instance;
         int graphicsFamily;
         VkQueue graphicsQueue;
+        Timeline* graphicsTimeline;
         VkFormat colorFormat;
         VkFormat depthFormat;
         GLFWwindow* glfwWindow;
         uint32_t imageCount;
         VkDescriptorPool descriptorPool;
+        // Creates the pipeline for dynamic rendering instead of the GUI's own render pass
+        bool dynamicRendering;
     };
 
+    // Whether the ImGui backend was built with dynamic rendering support
+    static bool isDynamicRenderingSupported();
+
     GUI(const InitData& initData);
     ~GUI();
 
     void beginFrame();
-    void endFrame(VkCommandBuffer commandBuffer, VkFramebuffer framebuffer);
+    // Builds the draw data of the frame, one of the record functions draws it afterwards
+    void endFrame();
+    // Draws in a render pass of its own that loads the attachments the scene pass stored, both stay in their
+    // attachment layouts
+    void recordRenderPass(VkCommandBuffer commandBuffer, VkFramebuffer framebuffer, VkExtent2D extent) const;
+    // Draws in a rendering of its own that loads the color attachment, only with dynamic rendering
+    void recordRendering(VkCommandBuffer commandBuffer, VkImageView colorImageView, VkExtent2D extent) const;
+    // Draws in the render pass the command buffer is in, for example a secondary that continues the scene pass
+    void recordDraws(VkCommandBuffer commandBuffer) const;
+    // Ops of the pass of its own, drawing in the scene pass adds none
+    std::vector<AttachmentOps> getAttachmentOps() const;
 
 private:
     void createRenderPass(VkFormat colorFormat, VkFormat depthFormat);
 
     VkDevice m_device;
-    VkRenderPass m_renderPass;
-    VkExtent2D m_extent;
+    VkRenderPass m_renderPass = VK_NULL_HANDLE;
 };
@@ -0,0 +1,241 @@
+#include "GeometryPool.hpp"
+#include "DeletionQueue.hpp"
+#include "DebugMarker.hpp"
+#include "Model.hpp"
+#include "Utils.hpp"
+#include <algorithm>
+
+namespace
+{
+const uint32_t c_initialVertexCapacity = 256 * 1024;
+const uint32_t c_initialIndexCapacity = 1024 * 1024;
+} // namespace
+
+GeometryPool::GeometryPool(Context& context) :
+    m_context(context),
+    m_device(context.getDevice()),
+    m_memoryAllocator(context.getMemoryAllocator())
+{
+    createBuffers(c_initialVertexCapacity, c_initialIndexCapacity);
+    m_vertexRanges = RangeAllocator(c_initialVertexCapacity);
+    m_indexRanges = RangeAllocator(c_initialIndexCapacity);
+}
+
+GeometryPool::~GeometryPool()
+{
+    vkDestroyBuffer(m_device, m_indexBuffer, nullptr);
+    m_memoryAllocator.release(m_indexMemory);
+    vkDestroyBuffer(m_device, m_positionBuffer, nullptr);
+    m_memoryAllocator.release(m_positionMemory);
+    vkDestroyBuffer(m_device, m_vertexBuffer, nullptr);
+    m_memoryAllocator.release(m_vertexMemory);
+}
+
+uint32_t GeometryPool::allocate(uint32_t vertexCount, uint32_t indexCount)
+{
+    uint32_t vertexOffset = m_vertexRanges.allocate(vertexCount);
+    uint32_t firstIndex = m_indexRanges.allocate(indexCount);
+    if (vertexOffset == RangeAllocator::c_invalidOffset || firstIndex == RangeAllocator::c_invalidOffset)
+    {
+        // Packing alone helps when the free space is only fragmented, otherwise the buffers double
+        if (vertexOffset != RangeAllocator::c_invalidOffset)
+        {
+            m_vertexRanges.free(vertexOffset, vertexCount);
+        }
+        if (firstIndex != RangeAllocator::c_invalidOffset)
+        {
+            m_indexRanges.free(firstIndex, indexCount);
+        }
+
+        auto getCapacity = [](const RangeAllocator& ranges, uint32_t count) {
+            const uint32_t required = ranges.getUsedSize() + count;
+            return required <= ranges.getCapacity() ? ranges.getCapacity() : std::max(required, ranges.getCapacity() * 2);
+        };
+        repack(getCapacity(m_vertexRanges, vertexCount), getCapacity(m_indexRanges, indexCount));
+
+        vertexOffset = m_vertexRanges.allocate(vertexCount);
+        firstIndex = m_indexRanges.allocate(indexCount);
+        CHECK(vertexOffset != RangeAllocator::c_invalidOffset && firstIndex != RangeAllocator::c_invalidOffset);
+    }
+
+    uint32_t handle;
+    if (m_freeHandles.empty())
+    {
+        handle = ui32Size(m_allocations);
+        m_allocations.emplace_back();
+    }
+    else
+    {
+        handle = m_freeHandles.back();
+        m_freeHandles.pop_back();
+    }
+
+    Allocation& allocation = m_allocations[handle];
+    allocation.vertexOffset = vertexOffset;
+    allocation.vertexCount = vertexCount;
+    allocation.firstIndex = firstIndex;
+    allocation.indexCount = indexCount;
+    allocation.live = true;
+    return handle;
+}
+
+void GeometryPool::free(uint32_t allocation)
+{
+    Allocation& range = m_allocations[allocation];
+    CHECK(range.live);
+    m_vertexRanges.free(range.vertexOffset, range.vertexCount);
+    m_indexRanges.free(range.firstIndex, range.indexCount);
+    range.live = false;
+    m_freeHandles.push_back(allocation);
+}
+
+void GeometryPool::compact()
+{
+    repack(m_vertexRanges.getCapacity(), m_indexRanges.getCapacity());
+}
+
+int32_t GeometryPool::getVertexOffset(uint32_t allocation) const
+{
+    return static_cast<int32_t>(m_allocations[allocation].vertexOffset);
+}
+
+uint32_t GeometryPool::getFirstIndex(uint32_t allocation) const
+{
+    return m_allocations[allocation].firstIndex;
+}
+
+VkBuffer GeometryPool::getVertexBuffer() const
+{
+    return m_vertexBuffer;
+}
+
+VkBuffer GeometryPool::getPositionBuffer() const
+{
+    return m_positionBuffer;
+}
+
+VkBuffer GeometryPool::getIndexBuffer() const
+{
+    return m_indexBuffer;
+}
+
+uint32_t GeometryPool::getGeneration() const
+{
+    return m_generation;
+}
+
+GeometryPool::Stats GeometryPool::getStats() const
+{
+    Stats stats;
+    stats.vertexCapacity = m_vertexRanges.getCapacity();
+    stats.usedVertices = m_vertexRanges.getUsedSize();
+    stats.largestFreeVertexRange = m_vertexRanges.getLargestFreeRange();
+    stats.indexCapacity = m_indexRanges.getCapacity();
+    stats.usedIndices = m_indexRanges.getUsedSize();
+    stats.largestFreeIndexRange = m_indexRanges.getLargestFreeRange();
+    stats.allocationCount = ui32Size(m_allocations) - ui32Size(m_freeHandles);
+    stats.repackCount = m_repackCount;
+    return stats;
+}
+
+// Frames in flight keep drawing from the old buffers so they go to the deletion queue. The copy is waited for so that
+// the old buffers are retired after the last command that reads them has been submitted.
+void GeometryPool::repack(uint32_t vertexCapacity, uint32_t indexCapacity)
+{
+    const VkBuffer oldVertexBuffer = m_vertexBuffer;
+    const VkBuffer oldPositionBuffer = m_positionBuffer;
+    const VkBuffer oldIndexBuffer = m_indexBuffer;
+    MemoryAllocation oldVertexMemory = m_vertexMemory;
+    MemoryAllocation oldPositionMemory = m_positionMemory;
+    MemoryAllocation oldIndexMemory = m_indexMemory;
+    createBuffers(vertexCapacity, indexCapacity);
+    m_vertexRanges = RangeAllocator(vertexCapacity);
+    m_indexRanges = RangeAllocator(indexCapacity);
+
+    std::vector<VkBufferCopy> vertexRegions;
+    std::vector<VkBufferCopy> positionRegions;
+    std::vector<VkBufferCopy> indexRegions;
+    for (Allocation& allocation : m_allocations)
+    {
+        if (!allocation.live)
+        {
+            continue;
+        }
+
+        // Allocating the live ranges in order from empty ranges packs them
+        const uint32_t vertexOffset = m_vertexRanges.allocate(allocation.vertexCount);
+        const uint32_t firstIndex = m_indexRanges.allocate(allocation.indexCount);
+        if (allocation.vertexCount > 0)
+        {
+            vertexRegions.push_back({sizeof(Model::Vertex) * allocation.vertexOffset, sizeof(Model::Vertex) * vertexOffset, sizeof(Model::Vertex) * allocation.vertexCount});
+            positionRegions.push_back({sizeof(glm::vec3) * allocation.vertexOffset, sizeof(glm::vec3) * vertexOffset, sizeof(glm::vec3) * allocation.vertexCount});
+        }
+        if (allocation.indexCount > 0)
+        {
+            indexRegions.push_back({sizeof(Model::Index) * allocation.firstIndex, sizeof(Model::Index) * firstIndex, sizeof(Model::Index) * allocation.indexCount});
+        }
+        allocation.vertexOffset = vertexOffset;
+        allocation.firstIndex = firstIndex;
+    }
+
+    const SingleTimeCommand command = beginSingleTimeCommands(m_context.getGraphicsCommandPool(), m_device);
+
+    // Uploads submitted earlier may still be writing the old buffers
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    vkCmdPipelineBarrier(command.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+    if (!vertexRegions.empty())
+    {
+        vkCmdCopyBuffer(command.commandBuffer, oldVertexBuffer, m_vertexBuffer, ui32Size(vertexRegions), vertexRegions.data());
+        vkCmdCopyBuffer(command.commandBuffer, oldPositionBuffer, m_positionBuffer, ui32Size(positionRegions), positionRegions.data());
+    }
+    if (!indexRegions.empty())
+    {
+        vkCmdCopyBuffer(command.commandBuffer, oldIndexBuffer, m_indexBuffer, ui32Size(indexRegions), indexRegions.data());
+    }
+
+    barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT;
+    vkCmdPipelineBarrier(command.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+    endSingleTimeCommands(m_context.getGraphicsQueue(), m_context.getGraphicsTimeline(), command);
+
+    DeletionQueue& deletionQueue = m_context.getDeletionQueue();
+    deletionQueue.destroyBuffer(oldVertexBuffer);
+    deletionQueue.releaseMemory(oldVertexMemory);
+    deletionQueue.destroyBuffer(oldPositionBuffer);
+    deletionQueue.releaseMemory(oldPositionMemory);
+    deletionQueue.destroyBuffer(oldIndexBuffer);
+    deletionQueue.releaseMemory(oldIndexMemory);
+
+    ++m_generation;
+    ++m_repackCount;
+}
+
+void GeometryPool::createBuffers(uint32_t vertexCapacity, uint32_t indexCapacity)
+{
+    VkBufferCreateInfo bufferInfo{};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = sizeof(Model::Vertex) * vertexCapacity;
+    bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    VK_CHECK(vkCreateBuffer(m_device, &bufferInfo, nullptr, &m_vertexBuffer));
+    DebugMarker::setObjectName(VK_OBJECT_TYPE_BUFFER, (uint64_t)m_vertexBuffer, "Geometry pool vertices");
+    m_vertexMemory = m_memoryAllocator.allocateForBuffer(m_vertexBuffer, MemoryUsage::GpuOnly, MemoryCategory::Geometry);
+
+    bufferInfo.size = sizeof(glm::vec3) * vertexCapacity;
+
+    VK_CHECK(vkCreateBuffer(m_device, &bufferInfo, nullptr, &m_positionBuffer));
+    DebugMarker::setObjectName(VK_OBJECT_TYPE_BUFFER, (uint64_t)m_positionBuffer, "Geometry pool positions");
+    m_positionMemory = m_memoryAllocator.allocateForBuffer(m_positionBuffer, MemoryUsage::GpuOnly, MemoryCategory::Geometry);
+
+    bufferInfo.size = sizeof(Model::Index) * indexCapacity;
+    bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
+
+    VK_CHECK(vkCreateBuffer(m_device, &bufferInfo, nullptr, &m_indexBuffer));
+    DebugMarker::setObjectName(VK_OBJECT_TYPE_BUFFER, (uint64_t)m_indexBuffer, "Geometry pool indices");
+    m_indexMemory = m_memoryAllocator.allocateForBuffer(m_indexBuffer, MemoryUsage::GpuOnly, MemoryCategory::Geometry);
+}
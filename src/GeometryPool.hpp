@@ -0,0 +1,78 @@
+#pragma once
+
+#include "Context.hpp"
+#include "MemoryAllocator.hpp"
+#include "RangeAllocator.hpp"
+#include <glm/glm.hpp>
+#include <vector>
+#include <cstdint>
+
+// Vertices and indices of every scene in one vertex and one index buffer, so all draws share the same binds and can
+// be batched into one indirect call. Scenes get ranges of both buffers and draw with firstIndex and vertexOffset.
+// When a request doesn't fit, the live ranges are packed into new buffers, grown if needed. That moves ranges, so
+// owners look their offsets up again whenever the generation changes.
+// Positions are also kept in a buffer of their own at the same vertex offsets, for passes that only need depth.
+class GeometryPool final
+{
+public:
+    struct Stats
+    {
+        uint32_t vertexCapacity = 0;
+        uint32_t usedVertices = 0;
+        uint32_t largestFreeVertexRange = 0;
+        uint32_t indexCapacity = 0;
+        uint32_t usedIndices = 0;
+        uint32_t largestFreeIndexRange = 0;
+        uint32_t allocationCount = 0;
+        uint32_t repackCount = 0;
+    };
+
+    GeometryPool(Context& context);
+    ~GeometryPool();
+
+    // Returns a handle for the offsets, waits for the GPU when existing ranges have to be moved
+    uint32_t allocate(uint32_t vertexCount, uint32_t indexCount);
+    // No submitted work may use the ranges anymore, owners free them through the deletion queue
+    void free(uint32_t allocation);
+    // Packs the live ranges to the start of new buffers of the same size and waits for the copy
+    void compact();
+
+    int32_t getVertexOffset(uint32_t allocation) const;
+    uint32_t getFirstIndex(uint32_t allocation) const;
+    VkBuffer getVertexBuffer() const;
+    // Only the positions of the vertices, owners fill both buffers
+    VkBuffer getPositionBuffer() const;
+    VkBuffer getIndexBuffer() const;
+    // Changes whenever the buffers or the offsets change, recorded draws of an older generation are outdated
+    uint32_t getGeneration() const;
+    Stats getStats() const;
+
+private:
+    struct Allocation
+    {
+        uint32_t vertexOffset = 0;
+        uint32_t vertexCount = 0;
+        uint32_t firstIndex = 0;
+        uint32_t indexCount = 0;
+        bool live = false;
+    };
+
+    void repack(uint32_t vertexCapacity, uint32_t indexCapacity);
+    void createBuffers(uint32_t vertexCapacity, uint32_t indexCapacity);
+
+    Context& m_context;
+    VkDevice m_device;
+    MemoryAllocator& m_memoryAllocator;
+    VkBuffer m_vertexBuffer = VK_NULL_HANDLE;
+    MemoryAllocation m_vertexMemory;
+    VkBuffer m_positionBuffer = VK_NULL_HANDLE;
+    MemoryAllocation m_positionMemory;
+    VkBuffer m_indexBuffer = VK_NULL_HANDLE;
+    MemoryAllocation m_indexMemory;
+    RangeAllocator m_vertexRanges;
+    RangeAllocator m_indexRanges;
+    std::vector<Allocation> m_allocations;
+    std::vector<uint32_t> m_freeHandles;
+    uint32_t m_generation = 0;
+    uint32_t m_repackCount = 0;
+};
@@ -0,0 +1,828 @@
+#include "GpuCulling.hpp"
+#include "Scene.hpp"
+#include "Instances.hpp"
+#include "DeletionQueue.hpp"
+#include "DebugMarker.hpp"
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+namespace
+{
+const uint32_t c_workgroupSize = 64;
+const uint32_t c_pyramidWorkgroupSize = 8;
+// Avoids growing the draw buffers one object at a time for small scenes
+const uint32_t c_minCapacity = 256;
+const uint32_t c_bindingCount = 8;
+const uint32_t c_pyramidBindingCount = 2;
+// Visible count followed by the frustum and occlusion culled counts and the number of compacted draw commands
+const uint32_t c_counterCount = 4;
+const VkDeviceSize c_drawCountOffset = sizeof(uint32_t) * 3;
+const uint32_t c_maxPyramidLevels = 16;
+const VkFormat c_pyramidFormat = VK_FORMAT_R32_SFLOAT;
+// Begin and end timestamps of the culling, the scene pass and the pyramid
+const uint32_t c_cullQuery = 0;
+const uint32_t c_sceneQuery = 2;
+const uint32_t c_pyramidQuery = 4;
+const uint32_t c_queryCount = 6;
+
+// Matches the Cull block of cull.comp
+struct CullData
+{
+    std::array<glm::vec4, 6> planes;
+    glm::mat4 pyramidViewProjection;
+    glm::vec2 pyramidSize;
+    uint32_t objectCount;
+    uint32_t occlusionEnabled;
+    uint32_t instanceCount;
+    uint32_t firstIndexBase;
+    int32_t vertexOffsetBase;
+};
+
+// Matches the Level block of pyramid.comp
+struct PyramidConstants
+{
+    glm::vec2 size;
+};
+
+VkMemoryBarrier getMemoryBarrier(VkAccessFlags srcAccess, VkAccessFlags dstAccess)
+{
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = srcAccess;
+    barrier.dstAccessMask = dstAccess;
+    return barrier;
+}
+
+bool supportsMaxReduction(VkPhysicalDevice physicalDevice, VkFormat format)
+{
+    VkFormatProperties properties;
+    vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &properties);
+    const VkFormatFeatureFlags required = VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_MINMAX_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+    return (properties.optimalTilingFeatures & required) == required;
+}
+
+// A power of two size makes every texel of a level exactly 2x2 texels of the level above
+uint32_t getPreviousPowerOfTwo(uint32_t value)
+{
+    uint32_t result = 1;
+    while (result * 2 <= value)
+    {
+        result *= 2;
+    }
+    return result;
+}
+} // namespace
+
+GpuCulling::GpuCulling(Context& context, const std::vector<char>& cullShaderCode, const std::vector<char>& pyramidShaderCode) :
+    m_context(context),
+    m_device(context.getDevice()),
+    m_memoryAllocator(context.getMemoryAllocator())
+{
+    const VkPhysicalDevice physicalDevice = m_context.getPhysicalDevice();
+    m_occlusionSupported = m_context.isSamplerFilterMinmaxEnabled() &&
+        supportsMaxReduction(physicalDevice, c_depthFormat) &&
+        supportsMaxReduction(physicalDevice, c_pyramidFormat);
+    m_occlusionCulling = m_occlusionSupported;
+    if (!m_occlusionSupported)
+    {
+        LOGW("Max reduction samplers are not supported, occlusion culling is disabled");
+    }
+    m_drawCountSupported = m_context.isDrawIndirectCountEnabled();
+    if (!m_drawCountSupported)
+    {
+        LOGW("Draw indirect count is not supported, the draw commands of every object are drawn");
+    }
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    m_timestampsSupported = properties.limits.timestampComputeAndGraphics == VK_TRUE;
+    m_timestampPeriod = properties.limits.timestampPeriod;
+
+    createSampler();
+    createDescriptorSetLayouts();
+    createPipelines(cullShaderCode, pyramidShaderCode);
+    createFrames();
+}
+
+GpuCulling::~GpuCulling()
+{
+    // The device is idle and the deletion queue is flushed before the device is destroyed
+    destroyPyramid();
+
+    for (Frame& frame : m_frames)
+    {
+        if (m_timestampsSupported)
+        {
+            vkDestroyQueryPool(m_device, frame.queryPool, nullptr);
+        }
+        vkUnmapMemory(m_device, frame.cullMemory.memory);
+        vkDestroyBuffer(m_device, frame.cullBuffer, nullptr);
+        m_memoryAllocator.release(frame.cullMemory);
+        vkUnmapMemory(m_device, frame.readbackMemory.memory);
+        vkDestroyBuffer(m_device, frame.readbackBuffer, nullptr);
+        m_memoryAllocator.release(frame.readbackMemory);
+        vkDestroyBuffer(m_device, frame.countBuffer, nullptr);
+        m_memoryAllocator.release(frame.countMemory);
+        vkDestroyBuffer(m_device, frame.drawBuffer, nullptr);
+        m_memoryAllocator.release(frame.drawMemory);
+    }
+
+    vkDestroyDescriptorPool(m_device, m_descriptorPool, nullptr);
+    vkDestroyPipeline(m_device, m_pyramidPipeline, nullptr);
+    vkDestroyPipelineLayout(m_device, m_pyramidPipelineLayout, nullptr);
+    if (m_drawCountSupported)
+    {
+        vkDestroyPipeline(m_device, m_compactPipeline, nullptr);
+    }
+    vkDestroyPipeline(m_device, m_pipeline, nullptr);
+    vkDestroyPipelineLayout(m_device, m_pipelineLayout, nullptr);
+    vkDestroyDescriptorSetLayout(m_device, m_pyramidDescriptorSetLayout, nullptr);
+    vkDestroyDescriptorSetLayout(m_device, m_descriptorSetLayout, nullptr);
+    vkDestroySampler(m_device, m_sampler, nullptr);
+}
+
+void GpuCulling::setDepthImage(VkImageView depthImageView, VkExtent2D extent)
+{
+    destroyPyramid();
+
+    m_pyramidExtent.width = getPreviousPowerOfTwo(extent.width);
+    m_pyramidExtent.height = getPreviousPowerOfTwo(extent.height);
+    // The new pyramid holds nothing until the next frame has been drawn
+    m_pyramidValid = false;
+    createPyramid(depthImageView);
+}
+
+// Results of the frame's previous submission are read before its buffers and set change
+bool GpuCulling::prepare(uint32_t imageIndex, const Scene& scene, const Instances& instances)
+{
+    Frame& frame = m_frames[imageIndex];
+    readResults(frame);
+
+    const uint32_t objectCount = ui32Size(scene.getPrimitives());
+    const bool grow = objectCount > frame.capacity;
+    if (grow)
+    {
+        createDrawBuffer(frame, std::max(objectCount, frame.capacity * 2));
+    }
+
+    // Rewriting the descriptors is cheaper than tracking whether the buffers or the pyramid are still the same
+    const bool countChanged = frame.objectCount != objectCount;
+    frame.objectCount = objectCount;
+    frame.instanceCount = instances.getCount();
+    frame.firstIndexBase = scene.getFirstIndex();
+    frame.vertexOffsetBase = scene.getVertexOffset();
+    updateDescriptorSet(frame, scene.getObjectBuffer(), instances.getTransformBuffer(), instances.getDrawInstanceBuffer(imageIndex));
+
+    return grow || countChanged;
+}
+
+void GpuCulling::recordCulling(VkCommandBuffer cb, uint32_t imageIndex, const Culling::Planes& planes, VkBuffer binBuffer)
+{
+    Frame& frame = m_frames[imageIndex];
+    updateBinDescriptor(frame, binBuffer);
+    frame.recorded = true;
+    frame.occlusionCulled = m_occlusionCulling && m_pyramidValid;
+    frame.pyramidRecorded = false;
+    // Only the frame right after the pyramid was built may use it
+    m_pyramidValid = false;
+
+    CullData cullData;
+    cullData.planes = planes;
+    cullData.pyramidViewProjection = m_pyramidViewProjection;
+    cullData.pyramidSize = glm::vec2(m_pyramidExtent.width, m_pyramidExtent.height);
+    cullData.objectCount = frame.objectCount;
+    cullData.occlusionEnabled = frame.occlusionCulled ? 1 : 0;
+    cullData.instanceCount = frame.instanceCount;
+    cullData.firstIndexBase = frame.firstIndexBase;
+    cullData.vertexOffsetBase = frame.vertexOffsetBase;
+    std::memcpy(frame.cullData, &cullData, sizeof(CullData));
+
+    if (m_timestampsSupported)
+    {
+        vkCmdResetQueryPool(cb, frame.queryPool, 0, c_queryCount);
+        vkCmdWriteTimestamp(cb, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, frame.queryPool, c_cullQuery);
+    }
+
+    // Clears the instance counts of the draw commands, the shader writes the other fields
+    vkCmdFillBuffer(cb, frame.countBuffer, 0, sizeof(uint32_t) * c_counterCount, 0);
+    if (frame.objectCount > 0)
+    {
+        vkCmdFillBuffer(cb, binBuffer, 0, sizeof(VkDrawIndexedIndirectCommand) * frame.objectCount, 0);
+    }
+    const VkMemoryBarrier clearBarrier = getMemoryBarrier(VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+    vkCmdPipelineBarrier(cb, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &clearBarrier, 0, nullptr, 0, nullptr);
+
+    vkCmdBindPipeline(cb, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline);
+    vkCmdBindDescriptorSets(cb, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelineLayout, 0, 1, &frame.descriptorSet, 0, nullptr);
+    // c_maxDrawInstances keeps the group count within the guaranteed limit of 65535
+    const uint32_t invocationCount = frame.objectCount * frame.instanceCount;
+    if (invocationCount > 0)
+    {
+        vkCmdDispatch(cb, (invocationCount + c_workgroupSize - 1) / c_workgroupSize, 1, 1);
+    }
+
+    // The instance counts are final once every instance has been culled, the compaction runs per object after it
+    if (m_drawCountSupported && frame.objectCount > 0)
+    {
+        const VkMemoryBarrier binBarrier = getMemoryBarrier(VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+        vkCmdPipelineBarrier(cb, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &binBarrier, 0, nullptr, 0, nullptr);
+
+        vkCmdBindPipeline(cb, VK_PIPELINE_BIND_POINT_COMPUTE, m_compactPipeline);
+        vkCmdDispatch(cb, (frame.objectCount + c_workgroupSize - 1) / c_workgroupSize, 1, 1);
+    }
+
+    // Only the counts, the render graph makes the draw commands and draw instances visible to the scene
+    const VkMemoryBarrier cullBarrier = getMemoryBarrier(VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT);
+    vkCmdPipelineBarrier(cb, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &cullBarrier, 0, nullptr, 0, nullptr);
+
+    // Read back for statistics when the frame is used next
+    VkBufferCopy copyRegion{};
+    copyRegion.size = sizeof(uint32_t) * c_counterCount;
+    vkCmdCopyBuffer(cb, frame.countBuffer, frame.readbackBuffer, 1, &copyRegion);
+
+    const VkMemoryBarrier hostBarrier = getMemoryBarrier(VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_HOST_READ_BIT);
+    vkCmdPipelineBarrier(cb, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &hostBarrier, 0, nullptr, 0, nullptr);
+
+    if (m_timestampsSupported)
+    {
+        vkCmdWriteTimestamp(cb, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, frame.queryPool, c_cullQuery + 1);
+    }
+}
+
+void GpuCulling::recordDraws(VkCommandBuffer cb, uint32_t imageIndex) const
+{
+    const Frame& frame = m_frames[imageIndex];
+    if (m_drawCountSupported)
+    {
+        vkCmdDrawIndexedIndirectCount(cb, frame.drawBuffer, 0, frame.countBuffer, c_drawCountOffset, frame.objectCount, sizeof(VkDrawIndexedIndirectCommand));
+        return;
+    }
+
+    // Objects without visible instances are draws with an instance count of zero
+    vkCmdDrawIndexedIndirect(cb, frame.drawBuffer, 0, frame.objectCount, sizeof(VkDrawIndexedIndirectCommand));
+}
+
+void GpuCulling::recordSceneBegin(VkCommandBuffer cb, uint32_t imageIndex)
+{
+    if (m_timestampsSupported)
+    {
+        vkCmdWriteTimestamp(cb, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, m_frames[imageIndex].queryPool, c_sceneQuery);
+    }
+}
+
+void GpuCulling::recordSceneEnd(VkCommandBuffer cb, uint32_t imageIndex)
+{
+    if (m_timestampsSupported)
+    {
+        vkCmdWriteTimestamp(cb, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_frames[imageIndex].queryPool, c_sceneQuery + 1);
+    }
+}
+
+void GpuCulling::recordDepthPyramid(VkCommandBuffer cb, uint32_t imageIndex, const glm::mat4& viewProjection)
+{
+    if (!m_occlusionCulling)
+    {
+        return;
+    }
+
+    Frame& frame = m_frames[imageIndex];
+    frame.pyramidRecorded = true;
+
+    if (m_timestampsSupported)
+    {
+        vkCmdWriteTimestamp(cb, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, frame.queryPool, c_pyramidQuery);
+    }
+
+    vkCmdBindPipeline(cb, VK_PIPELINE_BIND_POINT_COMPUTE, m_pyramidPipeline);
+
+    for (uint32_t level = 0; level < m_pyramidDescriptorSets.size(); ++level)
+    {
+        const uint32_t width = std::max(m_pyramidExtent.width >> level, 1u);
+        const uint32_t height = std::max(m_pyramidExtent.height >> level, 1u);
+
+        PyramidConstants constants;
+        constants.size = glm::vec2(width, height);
+
+        vkCmdBindDescriptorSets(cb, VK_PIPELINE_BIND_POINT_COMPUTE, m_pyramidPipelineLayout, 0, 1, &m_pyramidDescriptorSets[level], 0, nullptr);
+        vkCmdPushConstants(cb, m_pyramidPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PyramidConstants), &constants);
+        vkCmdDispatch(cb, (width + c_pyramidWorkgroupSize - 1) / c_pyramidWorkgroupSize, (height + c_pyramidWorkgroupSize - 1) / c_pyramidWorkgroupSize, 1);
+
+        // The next level reads this one, the render graph makes the last one visible to the next frame's cull
+        if (level + 1 < m_pyramidDescriptorSets.size())
+        {
+            const VkMemoryBarrier levelBarrier = getMemoryBarrier(VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT);
+            vkCmdPipelineBarrier(cb, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &levelBarrier, 0, nullptr, 0, nullptr);
+        }
+    }
+
+    if (m_timestampsSupported)
+    {
+        vkCmdWriteTimestamp(cb, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, frame.queryPool, c_pyramidQuery + 1);
+    }
+
+    m_pyramidValid = true;
+    m_pyramidViewProjection = viewProjection;
+}
+
+void GpuCulling::setOcclusionCulling(bool enabled)
+{
+    m_occlusionCulling = enabled && m_occlusionSupported;
+}
+
+bool GpuCulling::isOcclusionCullingEnabled() const
+{
+    return m_occlusionCulling;
+}
+
+bool GpuCulling::isOcclusionCullingSupported() const
+{
+    return m_occlusionSupported;
+}
+
+bool GpuCulling::isDrawCountSupported() const
+{
+    return m_drawCountSupported;
+}
+
+VkBuffer GpuCulling::getDrawBuffer(uint32_t imageIndex) const
+{
+    return m_frames[imageIndex].drawBuffer;
+}
+
+VkDeviceSize GpuCulling::getBinBufferSize(uint32_t imageIndex) const
+{
+    return sizeof(VkDrawIndexedIndirectCommand) * m_frames[imageIndex].capacity;
+}
+
+VkBuffer GpuCulling::getCountBuffer(uint32_t imageIndex) const
+{
+    return m_frames[imageIndex].countBuffer;
+}
+
+VkImage GpuCulling::getPyramidImage() const
+{
+    return m_pyramidImage;
+}
+
+const GpuCulling::Statistics& GpuCulling::getStatistics() const
+{
+    return m_statistics;
+}
+
+// Without max reduction the sampler only keeps the pyramid descriptors valid, nothing samples through it
+void GpuCulling::createSampler()
+{
+    VkSamplerReductionModeCreateInfo reductionInfo{};
+    reductionInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_REDUCTION_MODE_CREATE_INFO;
+    reductionInfo.reductionMode = VK_SAMPLER_REDUCTION_MODE_MAX;
+
+    VkSamplerCreateInfo samplerInfo{};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.pNext = m_occlusionSupported ? &reductionInfo : nullptr;
+    samplerInfo.magFilter = m_occlusionSupported ? VK_FILTER_LINEAR : VK_FILTER_NEAREST;
+    samplerInfo.minFilter = m_occlusionSupported ? VK_FILTER_LINEAR : VK_FILTER_NEAREST;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.minLod = 0.0f;
+    samplerInfo.maxLod = static_cast<float>(c_maxPyramidLevels);
+
+    VK_CHECK(vkCreateSampler(m_device, &samplerInfo, nullptr, &m_sampler));
+}
+
+void GpuCulling::createDescriptorSetLayouts()
+{
+    // Objects, draw commands, counts, cull data, the depth pyramid, transforms, draw instances and compacted draw commands
+    std::array<VkDescriptorSetLayoutBinding, c_bindingCount> bindings{};
+    for (uint32_t i = 0; i < c_bindingCount; ++i)
+    {
+        bindings[i].binding = i;
+        bindings[i].descriptorCount = 1;
+        bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindings[i].pImmutableSamplers = nullptr;
+        bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+    bindings[3].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    bindings[4].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = ui32Size(bindings);
+    layoutInfo.pBindings = bindings.data();
+
+    VK_CHECK(vkCreateDescriptorSetLayout(m_device, &layoutInfo, nullptr, &m_descriptorSetLayout));
+
+    // The depth buffer or the level above and the level that is written
+    std::array<VkDescriptorSetLayoutBinding, c_pyramidBindingCount> pyramidBindings{};
+    for (uint32_t i = 0; i < c_pyramidBindingCount; ++i)
+    {
+        pyramidBindings[i].binding = i;
+        pyramidBindings[i].descriptorCount = 1;
+        pyramidBindings[i].pImmutableSamplers = nullptr;
+        pyramidBindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+    pyramidBindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    pyramidBindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+
+    layoutInfo.bindingCount = ui32Size(pyramidBindings);
+    layoutInfo.pBindings = pyramidBindings.data();
+
+    VK_CHECK(vkCreateDescriptorSetLayout(m_device, &layoutInfo, nullptr, &m_pyramidDescriptorSetLayout));
+}
+
+void GpuCulling::createPipelines(const std::vector<char>& cullShaderCode, const std::vector<char>& pyramidShaderCode)
+{
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &m_descriptorSetLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 0;
+    pipelineLayoutInfo.pPushConstantRanges = nullptr;
+
+    VK_CHECK(vkCreatePipelineLayout(m_device, &pipelineLayoutInfo, nullptr, &m_pipelineLayout));
+
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(PyramidConstants);
+
+    pipelineLayoutInfo.pSetLayouts = &m_pyramidDescriptorSetLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+    VK_CHECK(vkCreatePipelineLayout(m_device, &pipelineLayoutInfo, nullptr, &m_pyramidPipelineLayout));
+
+    VkShaderModule cullShaderModule = createShaderModule(m_device, cullShaderCode);
+    VkShaderModule pyramidShaderModule = createShaderModule(m_device, pyramidShaderCode);
+
+    VkComputePipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipelineInfo.stage.module = cullShaderModule;
+    pipelineInfo.stage.pName = "main";
+    pipelineInfo.layout = m_pipelineLayout;
+
+    VK_CHECK(vkCreateComputePipelines(m_device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &m_pipeline));
+
+    // The same shader with c_compact set appends the non-empty draw commands
+    if (m_drawCountSupported)
+    {
+        const VkBool32 compact = VK_TRUE;
+        VkSpecializationMapEntry mapEntry{};
+        mapEntry.constantID = 0;
+        mapEntry.offset = 0;
+        mapEntry.size = sizeof(VkBool32);
+
+        VkSpecializationInfo specializationInfo{};
+        specializationInfo.mapEntryCount = 1;
+        specializationInfo.pMapEntries = &mapEntry;
+        specializationInfo.dataSize = sizeof(VkBool32);
+        specializationInfo.pData = &compact;
+
+        pipelineInfo.stage.pSpecializationInfo = &specializationInfo;
+        VK_CHECK(vkCreateComputePipelines(m_device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &m_compactPipeline));
+        pipelineInfo.stage.pSpecializationInfo = nullptr;
+    }
+
+    pipelineInfo.stage.module = pyramidShaderModule;
+    pipelineInfo.layout = m_pyramidPipelineLayout;
+
+    VK_CHECK(vkCreateComputePipelines(m_device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &m_pyramidPipeline));
+
+    vkDestroyShaderModule(m_device, pyramidShaderModule, nullptr);
+    vkDestroyShaderModule(m_device, cullShaderModule, nullptr);
+}
+
+void GpuCulling::createFrames()
+{
+    const uint32_t frameCount = ui32Size(m_context.getSwapchainImages());
+    m_frames.resize(frameCount);
+
+    std::array<VkDescriptorPoolSize, 3> poolSizes{};
+    poolSizes[0].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSizes[0].descriptorCount = 6 * frameCount;
+    poolSizes[1].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    poolSizes[1].descriptorCount = frameCount;
+    poolSizes[2].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    poolSizes[2].descriptorCount = frameCount;
+
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.poolSizeCount = ui32Size(poolSizes);
+    poolInfo.pPoolSizes = poolSizes.data();
+    poolInfo.maxSets = frameCount;
+
+    VK_CHECK(vkCreateDescriptorPool(m_device, &poolInfo, nullptr, &m_descriptorPool));
+
+    for (Frame& frame : m_frames)
+    {
+        VkBufferCreateInfo bufferInfo{};
+        bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        bufferInfo.size = sizeof(uint32_t) * c_counterCount;
+        bufferInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+        bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+        VK_CHECK(vkCreateBuffer(m_device, &bufferInfo, nullptr, &frame.countBuffer));
+        DebugMarker::setObjectName(VK_OBJECT_TYPE_BUFFER, (uint64_t)frame.countBuffer, "GPU culling draw count");
+        frame.countMemory = m_memoryAllocator.allocateForBuffer(frame.countBuffer, MemoryUsage::GpuOnly, MemoryCategory::Storage);
+
+        bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+
+        VK_CHECK(vkCreateBuffer(m_device, &bufferInfo, nullptr, &frame.readbackBuffer));
+        DebugMarker::setObjectName(VK_OBJECT_TYPE_BUFFER, (uint64_t)frame.readbackBuffer, "GPU culling readback");
+        frame.readbackMemory = m_memoryAllocator.allocateForBuffer(frame.readbackBuffer, MemoryUsage::Readback, MemoryCategory::Staging);
+
+        void* readbackData;
+        VK_CHECK(vkMapMemory(m_device, frame.readbackMemory.memory, 0, VK_WHOLE_SIZE, 0, &readbackData));
+        frame.readbackData = static_cast<uint32_t*>(readbackData);
+
+        bufferInfo.size = sizeof(CullData);
+        bufferInfo.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
+
+        VK_CHECK(vkCreateBuffer(m_device, &bufferInfo, nullptr, &frame.cullBuffer));
+        DebugMarker::setObjectName(VK_OBJECT_TYPE_BUFFER, (uint64_t)frame.cullBuffer, "GPU culling data");
+        frame.cullMemory = m_memoryAllocator.allocateForBuffer(frame.cullBuffer, MemoryUsage::Dynamic, MemoryCategory::Uniform);
+        VK_CHECK(vkMapMemory(m_device, frame.cullMemory.memory, 0, VK_WHOLE_SIZE, 0, &frame.cullData));
+
+        createDrawBuffer(frame, c_minCapacity);
+
+        VkDescriptorSetAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        allocInfo.descriptorPool = m_descriptorPool;
+        allocInfo.descriptorSetCount = 1;
+        allocInfo.pSetLayouts = &m_descriptorSetLayout;
+
+        VK_CHECK(vkAllocateDescriptorSets(m_device, &allocInfo, &frame.descriptorSet));
+
+        if (m_timestampsSupported)
+        {
+            VkQueryPoolCreateInfo queryPoolInfo{};
+            queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+            queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+            queryPoolInfo.queryCount = c_queryCount;
+
+            VK_CHECK(vkCreateQueryPool(m_device, &queryPoolInfo, nullptr, &frame.queryPool));
+        }
+    }
+}
+
+// The old buffer may still be read by a frame in flight so it goes to the deletion queue
+void GpuCulling::createDrawBuffer(Frame& frame, uint32_t capacity)
+{
+    if (frame.drawBuffer != VK_NULL_HANDLE)
+    {
+        DeletionQueue& deletionQueue = m_context.getDeletionQueue();
+        deletionQueue.destroyBuffer(frame.drawBuffer);
+        deletionQueue.releaseMemory(frame.drawMemory);
+    }
+
+    // The bins are cleared before culling, compacted commands are only written up to the draw count
+    VkBufferCreateInfo bufferInfo{};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = sizeof(VkDrawIndexedIndirectCommand) * capacity;
+    bufferInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT;
+    bufferInfo.usage |= m_drawCountSupported ? 0 : VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    VK_CHECK(vkCreateBuffer(m_device, &bufferInfo, nullptr, &frame.drawBuffer));
+    DebugMarker::setObjectName(VK_OBJECT_TYPE_BUFFER, (uint64_t)frame.drawBuffer, "GPU culling draw commands");
+    frame.drawMemory = m_memoryAllocator.allocateForBuffer(frame.drawBuffer, MemoryUsage::GpuOnly, MemoryCategory::Storage);
+    frame.capacity = capacity;
+}
+
+// The pyramid stays in the general layout so that its levels are written and sampled without transitions
+void GpuCulling::createPyramid(VkImageView depthImageView)
+{
+    const uint32_t largestSide = std::max(m_pyramidExtent.width, m_pyramidExtent.height);
+    uint32_t levelCount = 1;
+    while ((largestSide >> levelCount) > 0 && levelCount < c_maxPyramidLevels)
+    {
+        ++levelCount;
+    }
+
+    VkImageCreateInfo imageInfo{};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.extent.width = m_pyramidExtent.width;
+    imageInfo.extent.height = m_pyramidExtent.height;
+    imageInfo.extent.depth = 1;
+    imageInfo.mipLevels = levelCount;
+    imageInfo.arrayLayers = 1;
+    imageInfo.format = c_pyramidFormat;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    imageInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    VK_CHECK(vkCreateImage(m_device, &imageInfo, nullptr, &m_pyramidImage));
+    DebugMarker::setObjectName(VK_OBJECT_TYPE_IMAGE, (uint64_t)m_pyramidImage, "Depth pyramid");
+    m_pyramidMemory = m_memoryAllocator.allocateForImage(m_pyramidImage, MemoryUsage::GpuOnly, MemoryCategory::RenderTargets);
+
+    VkImageViewCreateInfo viewInfo{};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = m_pyramidImage;
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = c_pyramidFormat;
+    viewInfo.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, levelCount, 0, 1};
+
+    VK_CHECK(vkCreateImageView(m_device, &viewInfo, nullptr, &m_pyramidImageView));
+
+    m_pyramidLevelViews.resize(levelCount);
+    for (uint32_t level = 0; level < levelCount; ++level)
+    {
+        viewInfo.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, level, 1, 0, 1};
+        VK_CHECK(vkCreateImageView(m_device, &viewInfo, nullptr, &m_pyramidLevelViews[level]));
+    }
+
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = m_pyramidImage;
+    barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, levelCount, 0, 1};
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+    const SingleTimeCommand command = beginSingleTimeCommands(m_context.getGraphicsCommandPool(), m_device);
+    vkCmdPipelineBarrier(command.commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+    endSingleTimeCommands(m_context.getGraphicsQueue(), m_context.getGraphicsTimeline(), command);
+
+    // Without occlusion culling the pyramid is never built, it only fills the binding of the cull shader
+    if (!m_occlusionSupported)
+    {
+        return;
+    }
+
+    std::array<VkDescriptorPoolSize, c_pyramidBindingCount> poolSizes{};
+    poolSizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    poolSizes[0].descriptorCount = levelCount;
+    poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    poolSizes[1].descriptorCount = levelCount;
+
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.poolSizeCount = ui32Size(poolSizes);
+    poolInfo.pPoolSizes = poolSizes.data();
+    poolInfo.maxSets = levelCount;
+
+    VK_CHECK(vkCreateDescriptorPool(m_device, &poolInfo, nullptr, &m_pyramidDescriptorPool));
+
+    const std::vector<VkDescriptorSetLayout> layouts(levelCount, m_pyramidDescriptorSetLayout);
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = m_pyramidDescriptorPool;
+    allocInfo.descriptorSetCount = levelCount;
+    allocInfo.pSetLayouts = layouts.data();
+
+    m_pyramidDescriptorSets.resize(levelCount);
+    VK_CHECK(vkAllocateDescriptorSets(m_device, &allocInfo, m_pyramidDescriptorSets.data()));
+
+    for (uint32_t level = 0; level < levelCount; ++level)
+    {
+        VkDescriptorImageInfo inputInfo{};
+        inputInfo.sampler = m_sampler;
+        inputInfo.imageView = level == 0 ? depthImageView : m_pyramidLevelViews[level - 1];
+        inputInfo.imageLayout = level == 0 ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_GENERAL;
+
+        VkDescriptorImageInfo outputInfo{};
+        outputInfo.imageView = m_pyramidLevelViews[level];
+        outputInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+        std::array<VkWriteDescriptorSet, c_pyramidBindingCount> descriptorWrites{};
+        for (uint32_t i = 0; i < c_pyramidBindingCount; ++i)
+        {
+            descriptorWrites[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            descriptorWrites[i].dstSet = m_pyramidDescriptorSets[level];
+            descriptorWrites[i].dstBinding = i;
+            descriptorWrites[i].dstArrayElement = 0;
+            descriptorWrites[i].descriptorCount = 1;
+        }
+        descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        descriptorWrites[0].pImageInfo = &inputInfo;
+        descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+        descriptorWrites[1].pImageInfo = &outputInfo;
+
+        vkUpdateDescriptorSets(m_device, ui32Size(descriptorWrites), descriptorWrites.data(), 0, nullptr);
+    }
+}
+
+// Frames in flight may still sample the pyramid so everything goes to the deletion queue
+void GpuCulling::destroyPyramid()
+{
+    if (m_pyramidImage == VK_NULL_HANDLE)
+    {
+        return;
+    }
+
+    DeletionQueue& deletionQueue = m_context.getDeletionQueue();
+    deletionQueue.destroyDescriptorPool(m_pyramidDescriptorPool);
+    for (VkImageView levelView : m_pyramidLevelViews)
+    {
+        deletionQueue.destroyImageView(levelView);
+    }
+    deletionQueue.destroyImageView(m_pyramidImageView);
+    deletionQueue.destroyImage(m_pyramidImage);
+    deletionQueue.releaseMemory(m_pyramidMemory);
+
+    m_pyramidDescriptorPool = VK_NULL_HANDLE;
+    m_pyramidDescriptorSets.clear();
+    m_pyramidLevelViews.clear();
+    m_pyramidImageView = VK_NULL_HANDLE;
+    m_pyramidImage = VK_NULL_HANDLE;
+}
+
+void GpuCulling::updateDescriptorSet(Frame& frame, VkBuffer objectBuffer, VkBuffer transformBuffer, VkBuffer drawInstanceBuffer)
+{
+    // The pyramid binding has no buffer and the bins are written when culling is recorded. Without draw indirect
+    // count nothing is compacted and the draw buffer only fills the binding.
+    const std::array<VkBuffer, c_bindingCount> buffers{objectBuffer, VK_NULL_HANDLE, frame.countBuffer, frame.cullBuffer, VK_NULL_HANDLE, transformBuffer, drawInstanceBuffer, frame.drawBuffer};
+
+    std::array<VkDescriptorBufferInfo, c_bindingCount> bufferInfos{};
+    std::array<VkWriteDescriptorSet, c_bindingCount> descriptorWrites{};
+    for (uint32_t i = 0; i < c_bindingCount; ++i)
+    {
+        descriptorWrites[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrites[i].dstSet = frame.descriptorSet;
+        descriptorWrites[i].dstBinding = i;
+        descriptorWrites[i].dstArrayElement = 0;
+        descriptorWrites[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        descriptorWrites[i].descriptorCount = 1;
+        bufferInfos[i].buffer = buffers[i];
+        bufferInfos[i].offset = 0;
+        bufferInfos[i].range = VK_WHOLE_SIZE;
+        descriptorWrites[i].pBufferInfo = &bufferInfos[i];
+    }
+    descriptorWrites[3].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+
+    VkDescriptorImageInfo pyramidInfo{};
+    pyramidInfo.sampler = m_sampler;
+    pyramidInfo.imageView = m_pyramidImageView;
+    pyramidInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+    descriptorWrites[4].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    descriptorWrites[4].pBufferInfo = nullptr;
+    descriptorWrites[4].pImageInfo = &pyramidInfo;
+
+    // Everything but the bins
+    vkUpdateDescriptorSets(m_device, 1, &descriptorWrites[0], 0, nullptr);
+    vkUpdateDescriptorSets(m_device, c_bindingCount - 2, &descriptorWrites[2], 0, nullptr);
+}
+
+// The set isn't bound yet in the command buffer that is recorded and the frame's last submission has finished
+void GpuCulling::updateBinDescriptor(Frame& frame, VkBuffer binBuffer)
+{
+    VkDescriptorBufferInfo bufferInfo{};
+    bufferInfo.buffer = binBuffer;
+    bufferInfo.offset = 0;
+    bufferInfo.range = VK_WHOLE_SIZE;
+
+    VkWriteDescriptorSet descriptorWrite{};
+    descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    descriptorWrite.dstSet = frame.descriptorSet;
+    descriptorWrite.dstBinding = 1;
+    descriptorWrite.dstArrayElement = 0;
+    descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    descriptorWrite.descriptorCount = 1;
+    descriptorWrite.pBufferInfo = &bufferInfo;
+
+    vkUpdateDescriptorSets(m_device, 1, &descriptorWrite, 0, nullptr);
+}
+
+// Reads what the previous submission of the frame wrote
+void GpuCulling::readResults(Frame& frame)
+{
+    if (!frame.recorded)
+    {
+        return;
+    }
+    frame.recorded = false;
+
+    m_statistics.visibleCount = frame.readbackData[0];
+    m_statistics.frustumCulledCount = frame.readbackData[1];
+    m_statistics.occlusionCulledCount = frame.readbackData[2];
+    m_statistics.drawCount = m_drawCountSupported ? frame.readbackData[3] : frame.objectCount;
+
+    if (!m_timestampsSupported)
+    {
+        return;
+    }
+
+    // Pyramid queries that were reset but not written would never become available
+    const uint32_t queryCount = frame.pyramidRecorded ? c_queryCount : c_pyramidQuery;
+    std::array<uint64_t, c_queryCount> timestamps{};
+    VK_CHECK(vkGetQueryPoolResults(m_device, frame.queryPool, 0, queryCount, sizeof(timestamps), timestamps.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT));
+
+    const double millisecondsPerTick = m_timestampPeriod / 1'000'000.0;
+    m_statistics.cullMilliseconds = (timestamps[c_cullQuery + 1] - timestamps[c_cullQuery]) * millisecondsPerTick;
+    m_statistics.sceneMilliseconds = (timestamps[c_sceneQuery + 1] - timestamps[c_sceneQuery]) * millisecondsPerTick;
+    m_statistics.pyramidMilliseconds = frame.pyramidRecorded ? (timestamps[c_pyramidQuery + 1] - timestamps[c_pyramidQuery]) * millisecondsPerTick : 0.0;
+    if (!frame.occlusionCulled)
+    {
+        m_statistics.unoccludedSceneMilliseconds = m_statistics.sceneMilliseconds;
+    }
+}
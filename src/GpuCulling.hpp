@@ -0,0 +1,140 @@
+#pragma once
+
+#include "Context.hpp"
+#include "MemoryAllocator.hpp"
+#include "Culling.hpp"
+#include <glm/glm.hpp>
+#include <vector>
+#include <cstdint>
+
+class Scene;
+class Instances;
+
+// Culls every instance of every object of a scene in a compute shader. Each object has an indirect draw command
+// whose instance count is the number of its visible instances, the draw instances they read are written to the
+// frame's buffer of Instances. A second dispatch appends the commands with visible instances to a compacted list and
+// counts them, the scene draws it with the count from the buffer, so the per-object commands are only needed while
+// culling. Without draw indirect count support every object's command is drawn, empty ones included. The CPU does no
+// per-object work. Every frame in flight has its own command and count buffers, they grow when a larger scene is drawn.
+// Objects are tested against the view frustum and against a depth pyramid built from the depth buffer of the previous
+// frame. Objects that only just became visible through camera movement may show up one frame late.
+class GpuCulling final
+{
+public:
+    // Results of the last frame that has been read back
+    struct Statistics
+    {
+        // Instances of objects
+        uint32_t visibleCount = 0;
+        uint32_t frustumCulledCount = 0;
+        uint32_t occlusionCulledCount = 0;
+        // Indirect draws the scene executed, every object without draw indirect count support
+        uint32_t drawCount = 0;
+        double cullMilliseconds = 0.0;
+        double sceneMilliseconds = 0.0;
+        double pyramidMilliseconds = 0.0;
+        // Scene pass of the last frame drawn without occlusion culling, a reference for the time it saves
+        double unoccludedSceneMilliseconds = 0.0;
+    };
+
+    GpuCulling(Context& context, const std::vector<char>& cullShaderCode, const std::vector<char>& pyramidShaderCode);
+    ~GpuCulling();
+
+    // The pyramid is rebuilt for the new depth buffer, the image must be sampleable and the view depth only when
+    // occlusion culling is supported. Otherwise the depth buffer is never read and the view may be null.
+    void setDepthImage(VkImageView depthImageView, VkExtent2D extent);
+    // Must be called before recording the frame, returns true when recorded draws of the frame are outdated
+    bool prepare(uint32_t imageIndex, const Scene& scene, const Instances& instances);
+    // Outside of a render pass, fills the frame's draw commands and counts. The caller orders the draws after it.
+    // binBuffer holds the draw command of every object, it is the draw buffer itself without draw indirect count.
+    void recordCulling(VkCommandBuffer cb, uint32_t imageIndex, const Culling::Planes& planes, VkBuffer binBuffer);
+    // Inside of a render pass with the scene's pipeline, buffers and descriptor sets bound
+    void recordDraws(VkCommandBuffer cb, uint32_t imageIndex) const;
+    // Outside of a render pass around the pass that draws the scene
+    void recordSceneBegin(VkCommandBuffer cb, uint32_t imageIndex);
+    void recordSceneEnd(VkCommandBuffer cb, uint32_t imageIndex);
+    // After the scene pass with the depth image in the read only depth layout, the caller orders the next frame's
+    // cull after it
+    void recordDepthPyramid(VkCommandBuffer cb, uint32_t imageIndex, const glm::mat4& viewProjection);
+
+    void setOcclusionCulling(bool enabled);
+    bool isOcclusionCullingEnabled() const;
+    bool isOcclusionCullingSupported() const;
+    bool isDrawCountSupported() const;
+    // The draw commands the scene reads, recreated when the frame's capacity grows in prepare
+    VkBuffer getDrawBuffer(uint32_t imageIndex) const;
+    // The bins are only needed while culling when the commands are compacted, the caller provides them then
+    VkDeviceSize getBinBufferSize(uint32_t imageIndex) const;
+    // Holds the statistics and the draw count, read for the draws and copied for the statistics
+    VkBuffer getCountBuffer(uint32_t imageIndex) const;
+    // All levels are in the general layout
+    VkImage getPyramidImage() const;
+    const Statistics& getStatistics() const;
+
+private:
+    struct Frame
+    {
+        // The compacted commands with draw indirect count support, otherwise the bins of every object
+        VkBuffer drawBuffer = VK_NULL_HANDLE;
+        MemoryAllocation drawMemory;
+        VkBuffer countBuffer;
+        MemoryAllocation countMemory;
+        VkBuffer readbackBuffer;
+        MemoryAllocation readbackMemory;
+        uint32_t* readbackData;
+        VkBuffer cullBuffer;
+        MemoryAllocation cullMemory;
+        void* cullData;
+        VkDescriptorSet descriptorSet;
+        VkQueryPool queryPool;
+        uint32_t objectCount = 0;
+        uint32_t instanceCount = 0;
+        uint32_t firstIndexBase = 0;
+        int32_t vertexOffsetBase = 0;
+        uint32_t capacity = 0;
+        bool recorded = false;
+        bool occlusionCulled = false;
+        bool pyramidRecorded = false;
+    };
+
+    void createSampler();
+    void createDescriptorSetLayouts();
+    void createPipelines(const std::vector<char>& cullShaderCode, const std::vector<char>& pyramidShaderCode);
+    void createFrames();
+    void createDrawBuffer(Frame& frame, uint32_t capacity);
+    void createPyramid(VkImageView depthImageView);
+    void destroyPyramid();
+    void updateDescriptorSet(Frame& frame, VkBuffer objectBuffer, VkBuffer transformBuffer, VkBuffer drawInstanceBuffer);
+    void updateBinDescriptor(Frame& frame, VkBuffer binBuffer);
+    void readResults(Frame& frame);
+
+    Context& m_context;
+    VkDevice m_device;
+    MemoryAllocator& m_memoryAllocator;
+    bool m_occlusionSupported;
+    bool m_drawCountSupported;
+    bool m_timestampsSupported;
+    double m_timestampPeriod;
+    std::vector<Frame> m_frames;
+    VkSampler m_sampler;
+    VkDescriptorSetLayout m_descriptorSetLayout;
+    VkDescriptorSetLayout m_pyramidDescriptorSetLayout;
+    VkDescriptorPool m_descriptorPool;
+    VkPipelineLayout m_pipelineLayout;
+    VkPipeline m_pipeline;
+    VkPipeline m_compactPipeline = VK_NULL_HANDLE;
+    VkPipelineLayout m_pyramidPipelineLayout;
+    VkPipeline m_pyramidPipeline;
+    VkImage m_pyramidImage = VK_NULL_HANDLE;
+    MemoryAllocation m_pyramidMemory;
+    VkImageView m_pyramidImageView = VK_NULL_HANDLE;
+    std::vector<VkImageView> m_pyramidLevelViews;
+    VkDescriptorPool m_pyramidDescriptorPool = VK_NULL_HANDLE;
+    std::vector<VkDescriptorSet> m_pyramidDescriptorSets;
+    VkExtent2D m_pyramidExtent{};
+    bool m_occlusionCulling = true;
+    // Whether the pyramid holds the depth of the last frame, seen from m_pyramidViewProjection
+    bool m_pyramidValid = false;
+    glm::mat4 m_pyramidViewProjection{1.0f};
+    Statistics m_statistics;
+};
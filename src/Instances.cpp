@@ -0,0 +1,291 @@
+#include "Instances.hpp"
+#include "DeletionQueue.hpp"
+#include "DebugMarker.hpp"
+#include "Utils.hpp"
+#include <glm/gtc/constants.hpp>
+#include <glm/gtx/transform.hpp>
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <random>
+
+namespace
+{
+// Same layout for every run so that measurements are comparable
+const uint32_t c_scatterSeed = 1234;
+// Distance between neighboring copies relative to the size of the model
+const float c_spacing = 1.5f;
+// Keeps copies of an empty or flat model apart
+const float c_minModelSize = 0.01f;
+const uint32_t c_bindingCount = 2;
+} // namespace
+
+Instances::Instances(Context& context) :
+    m_context(context),
+    m_device(context.getDevice()),
+    m_memoryAllocator(context.getMemoryAllocator())
+{
+    createDescriptorSetLayout();
+    createFrames();
+    scatter(1, glm::vec3(0.0f), glm::vec3(0.0f));
+}
+
+Instances::~Instances()
+{
+    for (Frame& frame : m_frames)
+    {
+        destroyDrawInstanceBuffers(frame);
+    }
+
+    vkDestroyBuffer(m_device, m_transformBuffer, nullptr);
+    m_memoryAllocator.release(m_transformMemory);
+
+    vkDestroyDescriptorPool(m_device, m_descriptorPool, nullptr);
+    vkDestroyDescriptorSetLayout(m_device, m_descriptorSetLayout, nullptr);
+}
+
+void Instances::scatter(uint32_t count, const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+{
+    CHECK(count > 0);
+
+    // The cube grows with the number of copies so that their density stays the same
+    const float modelSize = std::max(glm::length(boundsMax - boundsMin), c_minModelSize);
+    const float halfSide = 0.5f * c_spacing * modelSize * std::cbrt(static_cast<float>(count));
+
+    std::mt19937 random(c_scatterSeed);
+    std::uniform_real_distribution<float> position(-halfSide, halfSide);
+    std::uniform_real_distribution<float> angle(0.0f, glm::two_pi<float>());
+
+    m_transforms.resize(count);
+    m_transforms[0] = glm::mat4(1.0f);
+    for (uint32_t i = 1; i < count; ++i)
+    {
+        const glm::vec3 translation(position(random), position(random), position(random));
+        m_transforms[i] = glm::translate(translation) * glm::rotate(angle(random), c_up);
+    }
+
+    createTransformBuffer();
+}
+
+bool Instances::prepare(uint32_t imageIndex, uint32_t drawInstanceCapacity)
+{
+    Frame& frame = m_frames[imageIndex];
+    const uint32_t capacity = std::min(drawInstanceCapacity, c_maxDrawInstances);
+    const bool grow = capacity > frame.capacity;
+    if (grow)
+    {
+        destroyDrawInstanceBuffers(frame);
+        createDrawInstanceBuffers(frame, std::min(std::max(capacity, frame.capacity * 2), c_maxDrawInstances));
+    }
+
+    // Recorded scene commands bind the set so it is only written when something changed
+    if (!grow && frame.transformGeneration == m_transformGeneration)
+    {
+        return false;
+    }
+
+    updateDescriptorSet(frame);
+    return true;
+}
+
+Instances::DrawInstance* Instances::getUploadData(uint32_t imageIndex)
+{
+    return m_frames[imageIndex].uploadData;
+}
+
+void Instances::recordUpload(VkCommandBuffer cb, uint32_t imageIndex, uint32_t count)
+{
+    if (count == 0)
+    {
+        return;
+    }
+
+    const Frame& frame = m_frames[imageIndex];
+    VkBufferCopy copyRegion{};
+    copyRegion.size = sizeof(DrawInstance) * count;
+    vkCmdCopyBuffer(cb, frame.uploadBuffer, frame.drawInstanceBuffer, 1, &copyRegion);
+}
+
+uint32_t Instances::getCount() const
+{
+    return ui32Size(m_transforms);
+}
+
+const std::vector<glm::mat4>& Instances::getTransforms() const
+{
+    return m_transforms;
+}
+
+VkBuffer Instances::getTransformBuffer() const
+{
+    return m_transformBuffer;
+}
+
+VkBuffer Instances::getDrawInstanceBuffer(uint32_t imageIndex) const
+{
+    return m_frames[imageIndex].drawInstanceBuffer;
+}
+
+VkDescriptorSetLayout Instances::getDescriptorSetLayout() const
+{
+    return m_descriptorSetLayout;
+}
+
+VkDescriptorSet Instances::getDescriptorSet(uint32_t imageIndex) const
+{
+    return m_frames[imageIndex].descriptorSet;
+}
+
+void Instances::createDescriptorSetLayout()
+{
+    // Transforms and draw instances
+    std::array<VkDescriptorSetLayoutBinding, c_bindingCount> bindings{};
+    for (uint32_t i = 0; i < c_bindingCount; ++i)
+    {
+        bindings[i].binding = i;
+        bindings[i].descriptorCount = 1;
+        bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindings[i].pImmutableSamplers = nullptr;
+        bindings[i].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+    }
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = ui32Size(bindings);
+    layoutInfo.pBindings = bindings.data();
+
+    VK_CHECK(vkCreateDescriptorSetLayout(m_device, &layoutInfo, nullptr, &m_descriptorSetLayout));
+}
+
+void Instances::createFrames()
+{
+    const uint32_t frameCount = ui32Size(m_context.getSwapchainImages());
+    m_frames.resize(frameCount);
+
+    VkDescriptorPoolSize poolSize{};
+    poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSize.descriptorCount = c_bindingCount * frameCount;
+
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.poolSizeCount = 1;
+    poolInfo.pPoolSizes = &poolSize;
+    poolInfo.maxSets = frameCount;
+
+    VK_CHECK(vkCreateDescriptorPool(m_device, &poolInfo, nullptr, &m_descriptorPool));
+
+    for (Frame& frame : m_frames)
+    {
+        createDrawInstanceBuffers(frame, 1);
+
+        VkDescriptorSetAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        allocInfo.descriptorPool = m_descriptorPool;
+        allocInfo.descriptorSetCount = 1;
+        allocInfo.pSetLayouts = &m_descriptorSetLayout;
+
+        VK_CHECK(vkAllocateDescriptorSets(m_device, &allocInfo, &frame.descriptorSet));
+    }
+}
+
+void Instances::createDrawInstanceBuffers(Frame& frame, uint32_t capacity)
+{
+    VkBufferCreateInfo bufferInfo{};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = sizeof(DrawInstance) * capacity;
+    bufferInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    VK_CHECK(vkCreateBuffer(m_device, &bufferInfo, nullptr, &frame.drawInstanceBuffer));
+    DebugMarker::setObjectName(VK_OBJECT_TYPE_BUFFER, (uint64_t)frame.drawInstanceBuffer, "Draw instances");
+    frame.drawInstanceMemory = m_memoryAllocator.allocateForBuffer(frame.drawInstanceBuffer, MemoryUsage::GpuOnly, MemoryCategory::Storage);
+
+    bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+
+    VK_CHECK(vkCreateBuffer(m_device, &bufferInfo, nullptr, &frame.uploadBuffer));
+    DebugMarker::setObjectName(VK_OBJECT_TYPE_BUFFER, (uint64_t)frame.uploadBuffer, "Draw instance upload");
+    frame.uploadMemory = m_memoryAllocator.allocateForBuffer(frame.uploadBuffer, MemoryUsage::Dynamic, MemoryCategory::Staging);
+
+    void* uploadData;
+    VK_CHECK(vkMapMemory(m_device, frame.uploadMemory.memory, 0, VK_WHOLE_SIZE, 0, &uploadData));
+    frame.uploadData = static_cast<DrawInstance*>(uploadData);
+    frame.capacity = capacity;
+}
+
+// Other frames don't use the buffers of this one
+void Instances::destroyDrawInstanceBuffers(Frame& frame)
+{
+    vkUnmapMemory(m_device, frame.uploadMemory.memory);
+    vkDestroyBuffer(m_device, frame.uploadBuffer, nullptr);
+    m_memoryAllocator.release(frame.uploadMemory);
+    vkDestroyBuffer(m_device, frame.drawInstanceBuffer, nullptr);
+    m_memoryAllocator.release(frame.drawInstanceMemory);
+}
+
+// Frames in flight still read the old transforms so they go to the deletion queue, every frame's descriptor set is
+// rewritten by its next prepare
+void Instances::createTransformBuffer()
+{
+    if (m_transformBuffer != VK_NULL_HANDLE)
+    {
+        DeletionQueue& deletionQueue = m_context.getDeletionQueue();
+        deletionQueue.destroyBuffer(m_transformBuffer);
+        deletionQueue.releaseMemory(m_transformMemory);
+    }
+
+    const VkDeviceSize bufferSize = sizeof(glm::mat4) * m_transforms.size();
+    StagingBuffer stagingBuffer = m_memoryAllocator.createStagingBuffer(m_transforms.data(), bufferSize);
+
+    VkBufferCreateInfo bufferInfo{};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = bufferSize;
+    bufferInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    VK_CHECK(vkCreateBuffer(m_device, &bufferInfo, nullptr, &m_transformBuffer));
+    DebugMarker::setObjectName(VK_OBJECT_TYPE_BUFFER, (uint64_t)m_transformBuffer, "Instance transforms");
+    m_transformMemory = m_memoryAllocator.allocateForBuffer(m_transformBuffer, MemoryUsage::GpuOnly, MemoryCategory::Geometry);
+
+    const SingleTimeCommand command = beginSingleTimeCommands(m_context.getGraphicsCommandPool(), m_device);
+
+    VkBufferCopy copyRegion{};
+    copyRegion.size = bufferSize;
+    vkCmdCopyBuffer(command.commandBuffer, stagingBuffer.buffer, m_transformBuffer, 1, &copyRegion);
+
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    const VkPipelineStageFlags dstStages = VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    vkCmdPipelineBarrier(command.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, dstStages, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+    endSingleTimeCommands(m_context.getGraphicsQueue(), m_context.getGraphicsTimeline(), command);
+    m_memoryAllocator.releaseStagingBuffer(stagingBuffer);
+
+    ++m_transformGeneration;
+}
+
+void Instances::updateDescriptorSet(Frame& frame)
+{
+    const std::array<VkBuffer, c_bindingCount> buffers{m_transformBuffer, frame.drawInstanceBuffer};
+
+    std::array<VkDescriptorBufferInfo, c_bindingCount> bufferInfos{};
+    std::array<VkWriteDescriptorSet, c_bindingCount> descriptorWrites{};
+    for (uint32_t i = 0; i < c_bindingCount; ++i)
+    {
+        bufferInfos[i].buffer = buffers[i];
+        bufferInfos[i].offset = 0;
+        bufferInfos[i].range = VK_WHOLE_SIZE;
+
+        descriptorWrites[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrites[i].dstSet = frame.descriptorSet;
+        descriptorWrites[i].dstBinding = i;
+        descriptorWrites[i].dstArrayElement = 0;
+        descriptorWrites[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        descriptorWrites[i].descriptorCount = 1;
+        descriptorWrites[i].pBufferInfo = &bufferInfos[i];
+    }
+
+    vkUpdateDescriptorSets(m_device, ui32Size(descriptorWrites), descriptorWrites.data(), 0, nullptr);
+    frame.transformGeneration = m_transformGeneration;
+}
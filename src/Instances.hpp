@@ -0,0 +1,76 @@
+#pragma once
+
+#include "Context.hpp"
+#include "MemoryAllocator.hpp"
+#include <glm/glm.hpp>
+#include <vector>
+#include <cstdint>
+
+// Upper limit for primitives times instances, every pair may need an entry in the draw instances of a frame
+const uint32_t c_maxDrawInstances = 1 << 21;
+
+// Copies of the scene drawn with instanced draws. Every copy has a transform in a storage buffer and every frame has
+// a list of (instance, material) pairs that its draws index with gl_InstanceIndex. The list is uploaded after CPU
+// culling or written by GpuCulling. Set 2 of the scene pipeline points to both buffers.
+class Instances final
+{
+public:
+    // Matches the DrawInstance struct of shader.vert and cull.comp
+    struct DrawInstance
+    {
+        uint32_t instanceIndex;
+        uint32_t materialIndex;
+    };
+
+    Instances(Context& context);
+    ~Instances();
+
+    // Scatters count copies of a model with the given bounds around the origin, the first copy is at the origin.
+    // Waits for the upload of the transforms.
+    void scatter(uint32_t count, const glm::vec3& boundsMin, const glm::vec3& boundsMax);
+    // Must be called before recording the frame, returns true when the frame's descriptor set was rewritten
+    bool prepare(uint32_t imageIndex, uint32_t drawInstanceCapacity);
+    // Room for the capacity given to prepare, copied to the draw instance buffer by recordUpload
+    DrawInstance* getUploadData(uint32_t imageIndex);
+    // Outside of a render pass, only for draw instances written by the CPU. The caller orders the draws after it.
+    void recordUpload(VkCommandBuffer cb, uint32_t imageIndex, uint32_t count);
+
+    uint32_t getCount() const;
+    const std::vector<glm::mat4>& getTransforms() const;
+    VkBuffer getTransformBuffer() const;
+    VkBuffer getDrawInstanceBuffer(uint32_t imageIndex) const;
+    VkDescriptorSetLayout getDescriptorSetLayout() const;
+    VkDescriptorSet getDescriptorSet(uint32_t imageIndex) const;
+
+private:
+    struct Frame
+    {
+        VkBuffer drawInstanceBuffer = VK_NULL_HANDLE;
+        MemoryAllocation drawInstanceMemory;
+        VkBuffer uploadBuffer = VK_NULL_HANDLE;
+        MemoryAllocation uploadMemory;
+        DrawInstance* uploadData = nullptr;
+        uint32_t capacity = 0;
+        VkDescriptorSet descriptorSet;
+        // Transforms the descriptor set points to
+        uint64_t transformGeneration = 0;
+    };
+
+    void createDescriptorSetLayout();
+    void createFrames();
+    void createDrawInstanceBuffers(Frame& frame, uint32_t capacity);
+    void destroyDrawInstanceBuffers(Frame& frame);
+    void createTransformBuffer();
+    void updateDescriptorSet(Frame& frame);
+
+    Context& m_context;
+    VkDevice m_device;
+    MemoryAllocator& m_memoryAllocator;
+    std::vector<glm::mat4> m_transforms;
+    VkBuffer m_transformBuffer = VK_NULL_HANDLE;
+    MemoryAllocation m_transformMemory;
+    uint64_t m_transformGeneration = 0;
+    VkDescriptorSetLayout m_descriptorSetLayout;
+    VkDescriptorPool m_descriptorPool;
+    std::vector<Frame> m_frames;
+};
@@ -0,0 +1,370 @@
+#include "JobSystem.hpp"
+#include "Utils.hpp"
+#include <algorithm>
+#include <chrono>
+
+class JobSystem::Job
+{
+public:
+    JobFunction function;
+    bool mainThread = false;
+    std::atomic<size_t> pendingDependencies{0};
+    std::atomic<bool> done{false};
+    std::mutex mutex;
+    std::vector<JobHandle> continuations;
+};
+
+namespace
+{
+const std::chrono::microseconds c_waitPollInterval{200};
+
+thread_local const JobSystem* t_owner = nullptr;
+thread_local int t_workerIndex = -1;
+} // namespace
+
+uint32_t JobSystem::getDefaultWorkerCount()
+{
+    const uint32_t hardwareThreads = std::thread::hardware_concurrency();
+    return hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+}
+
+JobSystem::JobSystem(uint32_t workerCount) :
+    m_mainThreadId(std::this_thread::get_id())
+{
+    for (uint32_t i = 0; i < workerCount; ++i)
+    {
+        m_queues.emplace_back(new WorkerQueue());
+    }
+    for (uint32_t i = 0; i < workerCount; ++i)
+    {
+        m_workers.emplace_back(&JobSystem::workerLoop, this, i);
+    }
+}
+
+JobSystem::~JobSystem()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_sleepMutex);
+        m_quit = true;
+    }
+    m_sleepCondition.notify_all();
+
+    for (std::thread& worker : m_workers)
+    {
+        worker.join();
+    }
+}
+
+JobSystem::JobHandle JobSystem::schedule(JobFunction function, const std::vector<JobHandle>& dependencies)
+{
+    return createJob(std::move(function), false, dependencies);
+}
+
+JobSystem::JobHandle JobSystem::scheduleOnMainThread(JobFunction function, const std::vector<JobHandle>& dependencies)
+{
+    return createJob(std::move(function), true, dependencies);
+}
+
+void JobSystem::wait(const JobHandle& job)
+{
+    // Without workers nothing else would run the jobs the waited one depends on
+    const bool mainThread = std::this_thread::get_id() == m_mainThreadId;
+    const bool runAnyJob = !mainThread || m_workers.empty();
+    while (!job->done)
+    {
+        if (mainThread)
+        {
+            runMainThreadJobs();
+        }
+        if (job->done)
+        {
+            break;
+        }
+
+        if (runAnyJob ? !runOneJob() : !runQueuedJob(job))
+        {
+            // The main thread polls for the job to become runnable rather than waking up for every queued job
+            std::unique_lock<std::mutex> lock(m_sleepMutex);
+            m_sleepCondition.wait_for(lock, c_waitPollInterval, [this, &job, runAnyJob]() {
+                return job->done || (runAnyJob && m_queuedJobs > 0);
+            });
+        }
+    }
+}
+
+void JobSystem::wait(const std::vector<JobHandle>& jobs)
+{
+    for (const JobHandle& job : jobs)
+    {
+        wait(job);
+    }
+}
+
+bool JobSystem::isDone(const JobHandle& job) const
+{
+    return job->done;
+}
+
+void JobSystem::parallelFor(size_t count, size_t grainSize, const RangeFunction& function)
+{
+    if (count == 0)
+    {
+        return;
+    }
+
+    grainSize = std::max<size_t>(grainSize, 1);
+    const size_t chunkCount = (count + grainSize - 1) / grainSize;
+
+    // Helpers and the calling thread take chunks from a shared counter so uneven chunks balance themselves
+    std::atomic<size_t> nextChunk{0};
+    auto runChunks = [&]() {
+        for (size_t chunk = nextChunk++; chunk < chunkCount; chunk = nextChunk++)
+        {
+            const size_t begin = chunk * grainSize;
+            function(begin, std::min(count, begin + grainSize));
+        }
+    };
+
+    const size_t helperCount = std::min(chunkCount - 1, m_queues.size());
+    std::vector<JobHandle> helpers;
+    for (size_t i = 0; i < helperCount; ++i)
+    {
+        helpers.push_back(schedule(runChunks));
+    }
+
+    runChunks();
+    wait(helpers);
+}
+
+void JobSystem::runMainThreadJobs()
+{
+    CHECK(std::this_thread::get_id() == m_mainThreadId);
+
+    for (;;)
+    {
+        JobHandle job;
+        {
+            std::lock_guard<std::mutex> lock(m_mainThreadQueue.mutex);
+            if (m_mainThreadQueue.jobs.empty())
+            {
+                return;
+            }
+            job = std::move(m_mainThreadQueue.jobs.front());
+            m_mainThreadQueue.jobs.pop_front();
+        }
+        execute(job);
+    }
+}
+
+uint32_t JobSystem::getWorkerCount() const
+{
+    return static_cast<uint32_t>(m_workers.size());
+}
+
+JobSystem::JobHandle JobSystem::createJob(JobFunction function, bool mainThread, const std::vector<JobHandle>& dependencies)
+{
+    JobHandle job = std::make_shared<Job>();
+    job->function = std::move(function);
+    job->mainThread = mainThread;
+
+    // The extra count keeps the job from being enqueued while dependencies are still being added
+    job->pendingDependencies = dependencies.size() + 1;
+    for (const JobHandle& dependency : dependencies)
+    {
+        bool added = false;
+        {
+            std::lock_guard<std::mutex> lock(dependency->mutex);
+            if (!dependency->done)
+            {
+                dependency->continuations.push_back(job);
+                added = true;
+            }
+        }
+        if (!added)
+        {
+            --job->pendingDependencies;
+        }
+    }
+
+    if (--job->pendingDependencies == 0)
+    {
+        enqueue(job);
+    }
+    return job;
+}
+
+void JobSystem::enqueue(const JobHandle& job)
+{
+    if (job->mainThread)
+    {
+        std::lock_guard<std::mutex> lock(m_mainThreadQueue.mutex);
+        m_mainThreadQueue.jobs.push_back(job);
+        return;
+    }
+
+    // Workers keep the jobs they create to themselves until someone steals them, other threads inject them
+    WorkerQueue& queue = t_owner == this ? *m_queues[t_workerIndex] : m_injectionQueue;
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.jobs.push_back(job);
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_sleepMutex);
+        ++m_queuedJobs;
+    }
+    m_sleepCondition.notify_one();
+}
+
+JobSystem::JobHandle JobSystem::findJob()
+{
+    auto popBack = [this](WorkerQueue& queue) -> JobHandle {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.jobs.empty())
+        {
+            return nullptr;
+        }
+        JobHandle job = std::move(queue.jobs.back());
+        queue.jobs.pop_back();
+        --m_queuedJobs;
+        return job;
+    };
+
+    auto popFront = [this](WorkerQueue& queue) -> JobHandle {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.jobs.empty())
+        {
+            return nullptr;
+        }
+        JobHandle job = std::move(queue.jobs.front());
+        queue.jobs.pop_front();
+        --m_queuedJobs;
+        return job;
+    };
+
+    const bool isWorker = t_owner == this;
+    if (isWorker)
+    {
+        if (JobHandle job = popBack(*m_queues[t_workerIndex]))
+        {
+            return job;
+        }
+    }
+
+    if (JobHandle job = popFront(m_injectionQueue))
+    {
+        return job;
+    }
+
+    // Steal the oldest job of another worker, it is the most likely to spawn more work
+    const size_t queueCount = m_queues.size();
+    const size_t start = isWorker ? static_cast<size_t>(t_workerIndex) + 1 : 0;
+    for (size_t i = 0; i < queueCount; ++i)
+    {
+        const size_t victim = (start + i) % queueCount;
+        if (isWorker && victim == static_cast<size_t>(t_workerIndex))
+        {
+            continue;
+        }
+        if (JobHandle job = popFront(*m_queues[victim]))
+        {
+            return job;
+        }
+    }
+
+    return nullptr;
+}
+
+// Removes the job from whichever queue holds it, false when it is running, done or still waiting for dependencies
+bool JobSystem::takeJob(const JobHandle& job)
+{
+    auto take = [this, &job](WorkerQueue& queue) -> bool {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        const auto found = std::find(queue.jobs.begin(), queue.jobs.end(), job);
+        if (found == queue.jobs.end())
+        {
+            return false;
+        }
+        queue.jobs.erase(found);
+        --m_queuedJobs;
+        return true;
+    };
+
+    if (take(m_injectionQueue))
+    {
+        return true;
+    }
+    for (const std::unique_ptr<WorkerQueue>& queue : m_queues)
+    {
+        if (take(*queue))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+void JobSystem::execute(const JobHandle& job)
+{
+    job->function();
+
+    std::vector<JobHandle> continuations;
+    {
+        std::lock_guard<std::mutex> lock(job->mutex);
+        job->done = true;
+        continuations.swap(job->continuations);
+    }
+
+    for (const JobHandle& continuation : continuations)
+    {
+        if (--continuation->pendingDependencies == 0)
+        {
+            enqueue(continuation);
+        }
+    }
+
+    // Wakes up threads that wait for this job
+    {
+        std::lock_guard<std::mutex> lock(m_sleepMutex);
+    }
+    m_sleepCondition.notify_all();
+}
+
+bool JobSystem::runOneJob()
+{
+    JobHandle job = findJob();
+    if (!job)
+    {
+        return false;
+    }
+    execute(job);
+    return true;
+}
+
+bool JobSystem::runQueuedJob(const JobHandle& job)
+{
+    if (!takeJob(job))
+    {
+        return false;
+    }
+    execute(job);
+    return true;
+}
+
+void JobSystem::workerLoop(uint32_t workerIndex)
+{
+    t_owner = this;
+    t_workerIndex = static_cast<int>(workerIndex);
+
+    while (!m_quit)
+    {
+        if (runOneJob())
+        {
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(m_sleepMutex);
+        m_sleepCondition.wait(lock, [this]() {
+            return m_quit || m_queuedJobs > 0;
+        });
+    }
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <cstdint>
+
+// Work-stealing scheduler. Every worker owns a deque, it pushes and pops its own jobs from the back and steals
+// from the front of the others. Jobs can depend on other jobs and only become runnable when those are done.
+// Jobs scheduled for the main thread run in runMainThreadJobs, which is for APIs like GLFW that are main thread only.
+// Workers that wait for a job run other jobs meanwhile so waiting inside a job doesn't deadlock. The main thread only
+// runs the jobs it waits for, so a frame waiting for its own jobs never picks up a model parse or an image decode.
+class JobSystem final
+{
+public:
+    class Job;
+    using JobHandle = std::shared_ptr<Job>;
+    using JobFunction = std::function<void()>;
+    using RangeFunction = std::function<void(size_t begin, size_t end)>;
+
+    // One worker per hardware thread besides the calling thread
+    static uint32_t getDefaultWorkerCount();
+
+    // With zero workers jobs only run when some thread waits for them
+    explicit JobSystem(uint32_t workerCount = getDefaultWorkerCount());
+    ~JobSystem();
+
+    JobHandle schedule(JobFunction function, const std::vector<JobHandle>& dependencies = {});
+    JobHandle scheduleOnMainThread(JobFunction function, const std::vector<JobHandle>& dependencies = {});
+    void wait(const JobHandle& job);
+    void wait(const std::vector<JobHandle>& jobs);
+    bool isDone(const JobHandle& job) const;
+
+    // Calls function for [0, count) in chunks of at most grainSize and returns when all chunks are done
+    void parallelFor(size_t count, size_t grainSize, const RangeFunction& function);
+
+    // Runs the jobs scheduled on the main thread, must be called from the thread that created the job system
+    void runMainThreadJobs();
+
+    uint32_t getWorkerCount() const;
+
+private:
+    struct WorkerQueue
+    {
+        std::mutex mutex;
+        std::deque<JobHandle> jobs;
+    };
+
+    JobHandle createJob(JobFunction function, bool mainThread, const std::vector<JobHandle>& dependencies);
+    void enqueue(const JobHandle& job);
+    JobHandle findJob();
+    bool takeJob(const JobHandle& job);
+    void execute(const JobHandle& job);
+    bool runOneJob();
+    bool runQueuedJob(const JobHandle& job);
+    void workerLoop(uint32_t workerIndex);
+
+    std::thread::id m_mainThreadId;
+    std::vector<std::unique_ptr<WorkerQueue>> m_queues;
+    std::vector<std::thread> m_workers;
+    WorkerQueue m_injectionQueue;
+    WorkerQueue m_mainThreadQueue;
+    std::mutex m_sleepMutex;
+    std::condition_variable m_sleepCondition;
+    std::atomic<uint64_t> m_queuedJobs{0};
+    std::atomic<bool> m_quit{false};
+};
@@ -0,0 +1,390 @@
+#include "MemoryAllocator.hpp"
+#include "DebugMarker.hpp"
+#include <algorithm>
+#include <bitset>
+#include <cstring>
+#include <fstream>
+#include <cinttypes>
+
+namespace
+{
+// Without VK_EXT_memory_budget only this fraction of a heap is used so that other processes have room
+const double c_heapBudgetFraction = 0.8;
+
+// Types with these flags need extra features and are never picked, except lazily allocated ones for transient attachments
+const VkMemoryPropertyFlags c_excludedFlags = //
+    VK_MEMORY_PROPERTY_PROTECTED_BIT | //
+    VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT | //
+    VK_MEMORY_PROPERTY_DEVICE_COHERENT_BIT_AMD;
+
+struct UsagePolicy
+{
+    VkMemoryPropertyFlags required;
+    VkMemoryPropertyFlags preferred;
+    VkMemoryPropertyFlags avoided;
+};
+
+UsagePolicy getUsagePolicy(MemoryUsage usage)
+{
+    const VkMemoryPropertyFlags hostVisibleCoherent = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    switch (usage)
+    {
+    case MemoryUsage::GpuOnly:
+        return {0, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT};
+    case MemoryUsage::Upload:
+        return {hostVisibleCoherent, 0, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT};
+    case MemoryUsage::Dynamic:
+        return {hostVisibleCoherent, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VK_MEMORY_PROPERTY_HOST_CACHED_BIT};
+    case MemoryUsage::Readback:
+        return {hostVisibleCoherent, VK_MEMORY_PROPERTY_HOST_CACHED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT};
+    case MemoryUsage::Transient:
+        return {0, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT};
+    }
+    LOGE("Unknown memory usage");
+    return {};
+}
+
+size_t countBits(VkMemoryPropertyFlags flags)
+{
+    return std::bitset<32>(flags).count();
+}
+
+void addToStats(MemoryAllocator::Stats& stats, VkDeviceSize size)
+{
+    stats.current += size;
+    stats.peak = std::max(stats.peak, stats.current);
+    ++stats.allocationCount;
+}
+
+void removeFromStats(MemoryAllocator::Stats& stats, VkDeviceSize size)
+{
+    CHECK(stats.current >= size && stats.allocationCount > 0);
+    stats.current -= size;
+    --stats.allocationCount;
+}
+
+std::string statsToJson(const MemoryAllocator::Stats& stats)
+{
+    char buffer[128];
+    snprintf(buffer, sizeof(buffer), "{\"current\": %" PRIu64 ", \"peak\": %" PRIu64 ", \"allocations\": %u}", //
+             static_cast<uint64_t>(stats.current),
+             static_cast<uint64_t>(stats.peak),
+             stats.allocationCount);
+    return buffer;
+}
+} // namespace
+
+const char* MemoryAllocator::getCategoryName(MemoryCategory category)
+{
+    switch (category)
+    {
+    case MemoryCategory::Geometry:
+        return "Geometry";
+    case MemoryCategory::Textures:
+        return "Textures";
+    case MemoryCategory::RenderTargets:
+        return "Render targets";
+    case MemoryCategory::Staging:
+        return "Staging";
+    case MemoryCategory::Uniform:
+        return "Uniform";
+    case MemoryCategory::Storage:
+        return "Storage";
+    case MemoryCategory::Count:
+        break;
+    }
+    return "Unknown";
+}
+
+MemoryAllocator::MemoryAllocator(VkDevice device, VkPhysicalDevice physicalDevice, bool memoryBudgetSupported) :
+    m_device(device),
+    m_physicalDevice(physicalDevice),
+    m_memoryBudgetSupported(memoryBudgetSupported)
+{
+    vkGetPhysicalDeviceMemoryProperties(m_physicalDevice, &m_memoryProperties);
+
+    m_heapBudgets.resize(m_memoryProperties.memoryHeapCount);
+    for (uint32_t i = 0; i < m_memoryProperties.memoryHeapCount; ++i)
+    {
+        const VkMemoryHeap& heap = m_memoryProperties.memoryHeaps[i];
+        m_heapBudgets[i].size = heap.size;
+        m_heapBudgets[i].deviceLocal = (heap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+    }
+    updateBudgets();
+
+    printf("Memory budget tracking: %s\n", m_memoryBudgetSupported ? "VK_EXT_memory_budget" : "heap size");
+}
+
+MemoryAllocation MemoryAllocator::allocate(const VkMemoryRequirements& requirements, MemoryUsage usage, MemoryCategory category)
+{
+    CHECK(category != MemoryCategory::Count);
+
+    updateBudgets();
+
+    const std::vector<uint32_t> candidates = getCandidateTypes(requirements.memoryTypeBits, usage);
+    CHECK(!candidates.empty());
+
+    // The first pass stays within the budgets, the second one leaves it to the driver whether memory can be oversubscribed
+    for (const bool withinBudget : {true, false})
+    {
+        for (uint32_t typeIndex : candidates)
+        {
+            const uint32_t heapIndex = m_memoryProperties.memoryTypes[typeIndex].heapIndex;
+            if (withinBudget && !fitsBudget(heapIndex, requirements.size))
+            {
+                continue;
+            }
+
+            VkMemoryAllocateInfo allocInfo{};
+            allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+            allocInfo.allocationSize = requirements.size;
+            allocInfo.memoryTypeIndex = typeIndex;
+
+            VkDeviceMemory memory;
+            const VkResult result = vkAllocateMemory(m_device, &allocInfo, nullptr, &memory);
+            if (result == VK_ERROR_OUT_OF_DEVICE_MEMORY || result == VK_ERROR_OUT_OF_HOST_MEMORY)
+            {
+                continue;
+            }
+            VK_CHECK(result);
+
+            HeapBudget& heapBudget = m_heapBudgets[heapIndex];
+            heapBudget.allocated += requirements.size;
+            heapBudget.peak = std::max(heapBudget.peak, heapBudget.allocated);
+            if (!m_memoryBudgetSupported)
+            {
+                heapBudget.usage = heapBudget.allocated;
+            }
+            addToStats(m_categoryStats[static_cast<size_t>(category)], requirements.size);
+
+            MemoryAllocation allocation;
+            allocation.memory = memory;
+            allocation.size = requirements.size;
+            allocation.typeIndex = typeIndex;
+            allocation.category = category;
+            return allocation;
+        }
+
+        if (withinBudget)
+        {
+            LOGW("No memory type has budget left for the allocation, allocating over budget");
+        }
+    }
+
+    LOGE("Out of device memory");
+    return {};
+}
+
+MemoryAllocation MemoryAllocator::allocateForBuffer(VkBuffer buffer, MemoryUsage usage, MemoryCategory category)
+{
+    VkMemoryRequirements memRequirements;
+    vkGetBufferMemoryRequirements(m_device, buffer, &memRequirements);
+
+    const MemoryAllocation allocation = allocate(memRequirements, usage, category);
+    VK_CHECK(vkBindBufferMemory(m_device, buffer, allocation.memory, 0));
+    return allocation;
+}
+
+MemoryAllocation MemoryAllocator::allocateForImage(VkImage image, MemoryUsage usage, MemoryCategory category)
+{
+    VkMemoryRequirements memRequirements;
+    vkGetImageMemoryRequirements(m_device, image, &memRequirements);
+
+    const MemoryAllocation allocation = allocate(memRequirements, usage, category);
+    VK_CHECK(vkBindImageMemory(m_device, image, allocation.memory, 0));
+    return allocation;
+}
+
+void MemoryAllocator::release(MemoryAllocation& allocation)
+{
+    if (allocation.memory == VK_NULL_HANDLE)
+    {
+        return;
+    }
+
+    vkFreeMemory(m_device, allocation.memory, nullptr);
+
+    HeapBudget& heapBudget = m_heapBudgets[m_memoryProperties.memoryTypes[allocation.typeIndex].heapIndex];
+    heapBudget.allocated -= allocation.size;
+    if (!m_memoryBudgetSupported)
+    {
+        heapBudget.usage = heapBudget.allocated;
+    }
+    removeFromStats(m_categoryStats[static_cast<size_t>(allocation.category)], allocation.size);
+
+    allocation = MemoryAllocation{};
+}
+
+StagingBuffer MemoryAllocator::createStagingBuffer(const void* data, VkDeviceSize size)
+{
+    VkBufferCreateInfo bufferInfo{};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = size;
+    bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    StagingBuffer stagingBuffer;
+    VK_CHECK(vkCreateBuffer(m_device, &bufferInfo, nullptr, &stagingBuffer.buffer));
+    DebugMarker::setObjectName(VK_OBJECT_TYPE_BUFFER, (uint64_t)stagingBuffer.buffer, "Staging buffer");
+
+    stagingBuffer.allocation = allocateForBuffer(stagingBuffer.buffer, MemoryUsage::Upload, MemoryCategory::Staging);
+    DebugMarker::setObjectName(VK_OBJECT_TYPE_DEVICE_MEMORY, (uint64_t)stagingBuffer.allocation.memory, "Staging buffer memory");
+
+    void* dst;
+    VK_CHECK(vkMapMemory(m_device, stagingBuffer.allocation.memory, 0, size, 0, &dst));
+    std::memcpy(dst, data, static_cast<size_t>(size));
+    vkUnmapMemory(m_device, stagingBuffer.allocation.memory);
+
+    return stagingBuffer;
+}
+
+void MemoryAllocator::releaseStagingBuffer(StagingBuffer& stagingBuffer)
+{
+    vkDestroyBuffer(m_device, stagingBuffer.buffer, nullptr);
+    release(stagingBuffer.allocation);
+}
+
+bool MemoryAllocator::isHostVisible(const MemoryAllocation& allocation) const
+{
+    return (m_memoryProperties.memoryTypes[allocation.typeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0;
+}
+
+bool MemoryAllocator::isDeviceLocal(const MemoryAllocation& allocation) const
+{
+    return (m_memoryProperties.memoryTypes[allocation.typeIndex].propertyFlags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) != 0;
+}
+
+bool MemoryAllocator::isLazilyAllocated(const MemoryAllocation& allocation) const
+{
+    return (m_memoryProperties.memoryTypes[allocation.typeIndex].propertyFlags & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT) != 0;
+}
+
+bool MemoryAllocator::hasMemoryBudget() const
+{
+    return m_memoryBudgetSupported;
+}
+
+const std::vector<MemoryAllocator::HeapBudget>& MemoryAllocator::getHeapBudgets()
+{
+    updateBudgets();
+    return m_heapBudgets;
+}
+
+const MemoryAllocator::Stats& MemoryAllocator::getCategoryStats(MemoryCategory category) const
+{
+    return m_categoryStats[static_cast<size_t>(category)];
+}
+
+const MemoryAllocator::Stats& MemoryAllocator::getHostAssetStats() const
+{
+    return m_hostAssetStats;
+}
+
+void MemoryAllocator::addHostAssetMemory(size_t size)
+{
+    addToStats(m_hostAssetStats, size);
+}
+
+void MemoryAllocator::removeHostAssetMemory(size_t size)
+{
+    removeFromStats(m_hostAssetStats, size);
+}
+
+std::string MemoryAllocator::toJson()
+{
+    updateBudgets();
+
+    std::string json = "{\n  \"heaps\": [\n";
+    for (size_t i = 0; i < m_heapBudgets.size(); ++i)
+    {
+        const HeapBudget& heap = m_heapBudgets[i];
+        char buffer[256];
+        snprintf(buffer, sizeof(buffer), //
+                 "    {\"size\": %" PRIu64 ", \"budget\": %" PRIu64 ", \"usage\": %" PRIu64 ", \"allocated\": %" PRIu64 ", \"peak\": %" PRIu64 ", \"deviceLocal\": %s}",
+                 static_cast<uint64_t>(heap.size),
+                 static_cast<uint64_t>(heap.budget),
+                 static_cast<uint64_t>(heap.usage),
+                 static_cast<uint64_t>(heap.allocated),
+                 static_cast<uint64_t>(heap.peak),
+                 heap.deviceLocal ? "true" : "false");
+        json += buffer;
+        json += i + 1 < m_heapBudgets.size() ? ",\n" : "\n";
+    }
+    json += "  ],\n  \"categories\": {\n";
+    for (size_t i = 0; i < m_categoryStats.size(); ++i)
+    {
+        json += "    \"" + std::string(getCategoryName(static_cast<MemoryCategory>(i))) + "\": " + statsToJson(m_categoryStats[i]);
+        json += i + 1 < m_categoryStats.size() ? ",\n" : "\n";
+    }
+    json += "  },\n  \"hostAssets\": " + statsToJson(m_hostAssetStats) + "\n}\n";
+    return json;
+}
+
+void MemoryAllocator::writeJson(const std::string& filename)
+{
+    std::ofstream file(filename);
+    CHECK(file.is_open());
+    file << toJson();
+    printf("Wrote memory statistics to %s\n", filename.c_str());
+}
+
+void MemoryAllocator::updateBudgets()
+{
+    if (!m_memoryBudgetSupported)
+    {
+        for (HeapBudget& heapBudget : m_heapBudgets)
+        {
+            heapBudget.budget = static_cast<VkDeviceSize>(heapBudget.size * c_heapBudgetFraction);
+            heapBudget.usage = heapBudget.allocated;
+        }
+        return;
+    }
+
+    VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties{};
+    budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+
+    VkPhysicalDeviceMemoryProperties2 memoryProperties{};
+    memoryProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+    memoryProperties.pNext = &budgetProperties;
+    vkGetPhysicalDeviceMemoryProperties2(m_physicalDevice, &memoryProperties);
+
+    for (size_t i = 0; i < m_heapBudgets.size(); ++i)
+    {
+        m_heapBudgets[i].budget = budgetProperties.heapBudget[i];
+        m_heapBudgets[i].usage = budgetProperties.heapUsage[i];
+    }
+}
+
+std::vector<uint32_t> MemoryAllocator::getCandidateTypes(uint32_t typeBits, MemoryUsage usage) const
+{
+    const UsagePolicy policy = getUsagePolicy(usage);
+    // Lazily allocated types are only offered for images with the transient attachment usage
+    const VkMemoryPropertyFlags excludedFlags = usage == MemoryUsage::Transient ? c_excludedFlags & ~VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT : c_excludedFlags;
+
+    std::vector<uint32_t> candidates;
+    for (uint32_t i = 0; i < m_memoryProperties.memoryTypeCount; ++i)
+    {
+        const VkMemoryPropertyFlags flags = m_memoryProperties.memoryTypes[i].propertyFlags;
+        if ((typeBits & (1u << i)) && (flags & policy.required) == policy.required && (flags & excludedFlags) == 0)
+        {
+            candidates.push_back(i);
+        }
+    }
+
+    // Fewest avoided flags first, then most preferred flags. Ties keep the driver's order which lists faster types first.
+    auto rank = [this, &policy](uint32_t typeIndex) {
+        const VkMemoryPropertyFlags flags = m_memoryProperties.memoryTypes[typeIndex].propertyFlags;
+        return std::make_pair(countBits(flags & policy.avoided), -static_cast<int>(countBits(flags & policy.preferred)));
+    };
+    std::stable_sort(candidates.begin(), candidates.end(), [&rank](uint32_t a, uint32_t b) {
+        return rank(a) < rank(b);
+    });
+
+    return candidates;
+}
+
+bool MemoryAllocator::fitsBudget(uint32_t heapIndex, VkDeviceSize size) const
+{
+    const HeapBudget& heapBudget = m_heapBudgets[heapIndex];
+    return heapBudget.usage + size <= heapBudget.budget;
+}
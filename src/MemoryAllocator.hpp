@@ -0,0 +1,103 @@
+#pragma once
+
+#include "VulkanUtils.hpp"
+#include <vector>
+#include <array>
+#include <string>
+
+enum class MemoryUsage
+{
+    GpuOnly, // Filled by transfers or the GPU, prefers device local memory
+    Upload, // Staging data written once by the CPU, avoids device local memory
+    Dynamic, // Rewritten by the CPU every frame, prefers device local host visible memory (ReBAR) when it is in budget
+    Readback, // Written by the GPU and read by the CPU, prefers cached host memory
+    Transient // Attachments whose contents never leave a render pass, prefers lazily allocated memory (tile memory)
+};
+
+enum class MemoryCategory
+{
+    Geometry,
+    Textures,
+    RenderTargets,
+    Staging,
+    Uniform,
+    Storage, // Buffers the GPU writes every frame, such as draw instances and indirect draws
+    Count
+};
+
+struct MemoryAllocation
+{
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkDeviceSize size = 0;
+    uint32_t typeIndex = 0;
+    MemoryCategory category = MemoryCategory::Count;
+};
+
+struct StagingBuffer
+{
+    VkBuffer buffer;
+    MemoryAllocation allocation;
+};
+
+// Picks memory types by usage from cached memory properties and keeps allocations within the heap budgets.
+// Budgets come from VK_EXT_memory_budget when the device supports it, otherwise from a fraction of the heap size.
+// Every allocation is also accounted to a category, host memory of loaded assets is reported by the owner.
+class MemoryAllocator final
+{
+public:
+    struct HeapBudget
+    {
+        VkDeviceSize size = 0;
+        VkDeviceSize budget = 0;
+        VkDeviceSize usage = 0; // Usage of the whole process with VK_EXT_memory_budget, otherwise the same as allocated
+        VkDeviceSize allocated = 0;
+        VkDeviceSize peak = 0;
+        bool deviceLocal = false;
+    };
+
+    struct Stats
+    {
+        VkDeviceSize current = 0;
+        VkDeviceSize peak = 0;
+        uint32_t allocationCount = 0;
+    };
+
+    MemoryAllocator(VkDevice device, VkPhysicalDevice physicalDevice, bool memoryBudgetSupported);
+
+    static const char* getCategoryName(MemoryCategory category);
+
+    MemoryAllocation allocate(const VkMemoryRequirements& requirements, MemoryUsage usage, MemoryCategory category);
+    MemoryAllocation allocateForBuffer(VkBuffer buffer, MemoryUsage usage, MemoryCategory category);
+    MemoryAllocation allocateForImage(VkImage image, MemoryUsage usage, MemoryCategory category);
+    void release(MemoryAllocation& allocation);
+
+    StagingBuffer createStagingBuffer(const void* data, VkDeviceSize size);
+    void releaseStagingBuffer(StagingBuffer& stagingBuffer);
+
+    bool isHostVisible(const MemoryAllocation& allocation) const;
+    bool isDeviceLocal(const MemoryAllocation& allocation) const;
+    bool isLazilyAllocated(const MemoryAllocation& allocation) const;
+    bool hasMemoryBudget() const;
+    const std::vector<HeapBudget>& getHeapBudgets();
+
+    const Stats& getCategoryStats(MemoryCategory category) const;
+    const Stats& getHostAssetStats() const;
+    void addHostAssetMemory(size_t size);
+    void removeHostAssetMemory(size_t size);
+
+    std::string toJson();
+    void writeJson(const std::string& filename);
+
+private:
+    void updateBudgets();
+    std::vector<uint32_t> getCandidateTypes(uint32_t typeBits, MemoryUsage usage) const;
+    bool fitsBudget(uint32_t heapIndex, VkDeviceSize size) const;
+
+    VkDevice m_device;
+    VkPhysicalDevice m_physicalDevice;
+    bool m_memoryBudgetSupported;
+    VkPhysicalDeviceMemoryProperties m_memoryProperties;
+    std::vector<HeapBudget> m_heapBudgets;
+    std::array<Stats, static_cast<size_t>(MemoryCategory::Count)> m_categoryStats;
+    Stats m_hostAssetStats;
+};
@@ -0,0 +1,587 @@
+#include "Meshopt.hpp"
+
+#include <cstring>
+#include <cstdint>
+#include <cmath>
+
+namespace
+{
+const unsigned char c_vertexHeader = 0xa0;
+const unsigned char c_indexHeader = 0xe0;
+const unsigned char c_sequenceHeader = 0xd0;
+const size_t c_vertexBlockSizeBytes = 8192;
+const size_t c_vertexBlockMaxSize = 256;
+const size_t c_byteGroupSize = 16;
+const size_t c_tailMaxSize = 32;
+const size_t c_maxVertexStride = 256;
+
+size_t getVertexBlockSize(size_t stride)
+{
+    size_t result = c_vertexBlockSizeBytes / stride;
+    result &= ~(c_byteGroupSize - 1);
+    return result < c_vertexBlockMaxSize ? result : c_vertexBlockMaxSize;
+}
+
+unsigned char unzigzag8(unsigned char v)
+{
+    return static_cast<unsigned char>(-(v & 1) ^ (v >> 1));
+}
+
+// Byte groups are 16 deltas encoded with 0, 2, 4 or 8 bits each, values that don't fit are escaped to a trailing byte
+const unsigned char* decodeBytesGroup(const unsigned char* data, const unsigned char* dataEnd, unsigned char* buffer, int bitsLog2)
+{
+    if (bitsLog2 == 0)
+    {
+        std::memset(buffer, 0, c_byteGroupSize);
+        return data;
+    }
+
+    if (bitsLog2 == 3)
+    {
+        if (static_cast<size_t>(dataEnd - data) < c_byteGroupSize)
+        {
+            return nullptr;
+        }
+        std::memcpy(buffer, data, c_byteGroupSize);
+        return data + c_byteGroupSize;
+    }
+
+    const unsigned int bits = bitsLog2 == 1 ? 2 : 4;
+    const unsigned int escape = (1u << bits) - 1;
+    const size_t packedSize = c_byteGroupSize * bits / 8;
+    if (static_cast<size_t>(dataEnd - data) < packedSize)
+    {
+        return nullptr;
+    }
+
+    const unsigned char* escaped = data + packedSize;
+    for (size_t i = 0; i < c_byteGroupSize; ++i)
+    {
+        const unsigned int bitOffset = static_cast<unsigned int>(i) * bits;
+        const unsigned int value = (data[bitOffset / 8] >> (8 - bits - bitOffset % 8)) & escape;
+        if (value == escape)
+        {
+            if (escaped >= dataEnd)
+            {
+                return nullptr;
+            }
+            buffer[i] = *escaped++;
+        }
+        else
+        {
+            buffer[i] = static_cast<unsigned char>(value);
+        }
+    }
+    return escaped;
+}
+
+const unsigned char* decodeBytes(const unsigned char* data, const unsigned char* dataEnd, unsigned char* buffer, size_t bufferSize)
+{
+    const unsigned char* header = data;
+    const size_t headerSize = (bufferSize / c_byteGroupSize + 3) / 4;
+    if (static_cast<size_t>(dataEnd - data) < headerSize)
+    {
+        return nullptr;
+    }
+    data += headerSize;
+
+    for (size_t i = 0; i < bufferSize && data; i += c_byteGroupSize)
+    {
+        const size_t headerOffset = i / c_byteGroupSize;
+        const int bitsLog2 = (header[headerOffset / 4] >> ((headerOffset % 4) * 2)) & 3;
+        data = decodeBytesGroup(data, dataEnd, buffer + i, bitsLog2);
+    }
+    return data;
+}
+
+const unsigned char* decodeVertexBlock(const unsigned char* data, const unsigned char* dataEnd, unsigned char* vertexData, size_t count, size_t stride, unsigned char* lastVertex)
+{
+    unsigned char buffer[c_vertexBlockMaxSize];
+    const size_t countAligned = (count + c_byteGroupSize - 1) & ~(c_byteGroupSize - 1);
+
+    for (size_t k = 0; k < stride; ++k)
+    {
+        data = decodeBytes(data, dataEnd, buffer, countAligned);
+        if (!data)
+        {
+            return nullptr;
+        }
+
+        unsigned char previous = lastVertex[k];
+        for (size_t i = 0; i < count; ++i)
+        {
+            previous = static_cast<unsigned char>(unzigzag8(buffer[i]) + previous);
+            vertexData[i * stride + k] = previous;
+        }
+        lastVertex[k] = previous;
+    }
+    return data;
+}
+
+bool decodeVByte(const unsigned char*& data, const unsigned char* dataEnd, unsigned int& value)
+{
+    if (data >= dataEnd)
+    {
+        return false;
+    }
+
+    const unsigned char lead = *data++;
+    value = lead & 127;
+    if (lead < 128)
+    {
+        return true;
+    }
+
+    unsigned int shift = 7;
+    for (int i = 0; i < 4; ++i)
+    {
+        if (data >= dataEnd)
+        {
+            return false;
+        }
+        const unsigned char group = *data++;
+        value |= static_cast<unsigned int>(group & 127) << shift;
+        shift += 7;
+        if (group < 128)
+        {
+            break;
+        }
+    }
+    return true;
+}
+
+bool decodeIndex(const unsigned char*& data, const unsigned char* dataEnd, unsigned int& last)
+{
+    unsigned int v;
+    if (!decodeVByte(data, dataEnd, v))
+    {
+        return false;
+    }
+    last += (v >> 1) ^ (0u - (v & 1));
+    return true;
+}
+
+void writeIndex(unsigned char* destination, size_t i, size_t stride, unsigned int index)
+{
+    if (stride == 2)
+    {
+        const uint16_t value = static_cast<uint16_t>(index);
+        std::memcpy(destination + i * 2, &value, sizeof(value));
+    }
+    else
+    {
+        std::memcpy(destination + i * 4, &index, sizeof(index));
+    }
+}
+
+struct TriangleFifos
+{
+    unsigned int edges[16][2];
+    unsigned int vertices[16];
+    size_t edgeOffset = 0;
+    size_t vertexOffset = 0;
+
+    TriangleFifos()
+    {
+        std::memset(edges, -1, sizeof(edges));
+        std::memset(vertices, -1, sizeof(vertices));
+    }
+
+    void pushVertex(unsigned int v, bool advance = true)
+    {
+        vertices[vertexOffset] = v;
+        vertexOffset = (vertexOffset + (advance ? 1 : 0)) & 15;
+    }
+
+    void pushEdge(unsigned int a, unsigned int b)
+    {
+        edges[edgeOffset][0] = a;
+        edges[edgeOffset][1] = b;
+        edgeOffset = (edgeOffset + 1) & 15;
+    }
+};
+
+int16_t roundToInt16(float v)
+{
+    return static_cast<int16_t>(static_cast<int>(v + (v >= 0.0f ? 0.5f : -0.5f)));
+}
+
+template<typename T>
+void decodeFilterOctahedral(unsigned char* data, size_t count, size_t stride)
+{
+    const float maxValue = static_cast<float>((1 << (sizeof(T) * 8 - 1)) - 1);
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        T v[4];
+        std::memcpy(v, data + i * stride, sizeof(v));
+
+        // The third component stores 1.0 at the same precision so that z can be reconstructed
+        float x = static_cast<float>(v[0]);
+        float y = static_cast<float>(v[1]);
+        const float z = static_cast<float>(v[2]) - std::fabs(x) - std::fabs(y);
+
+        const float t = z >= 0.0f ? 0.0f : z;
+        x += x >= 0.0f ? t : -t;
+        y += y >= 0.0f ? t : -t;
+
+        const float scale = maxValue / std::sqrt(x * x + y * y + z * z);
+        v[0] = static_cast<T>(roundToInt16(x * scale));
+        v[1] = static_cast<T>(roundToInt16(y * scale));
+        v[2] = static_cast<T>(roundToInt16(z * scale));
+        std::memcpy(data + i * stride, v, sizeof(v));
+    }
+}
+
+void decodeFilterQuaternion(unsigned char* data, size_t count)
+{
+    const float scale = 1.0f / std::sqrt(2.0f);
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        int16_t v[4];
+        std::memcpy(v, data + i * 8, sizeof(v));
+
+        // Scale is stored in the high bits of the last component, the low bits select the dropped component
+        const float s = scale / static_cast<float>(v[3] | 3);
+        const float x = static_cast<float>(v[0]) * s;
+        const float y = static_cast<float>(v[1]) * s;
+        const float z = static_cast<float>(v[2]) * s;
+        const float ww = 1.0f - x * x - y * y - z * z;
+        const float w = std::sqrt(ww >= 0.0f ? ww : 0.0f);
+        const int qc = v[3] & 3;
+
+        v[(qc + 1) & 3] = roundToInt16(x * 32767.0f);
+        v[(qc + 2) & 3] = roundToInt16(y * 32767.0f);
+        v[(qc + 3) & 3] = roundToInt16(z * 32767.0f);
+        v[(qc + 0) & 3] = roundToInt16(w * 32767.0f);
+        std::memcpy(data + i * 8, v, sizeof(v));
+    }
+}
+
+void decodeFilterExponential(unsigned char* data, size_t count)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        uint32_t v;
+        std::memcpy(&v, data + i * 4, sizeof(v));
+
+        // 24-bit signed mantissa and 8-bit signed exponent
+        const int32_t mantissa = static_cast<int32_t>(v << 8) >> 8;
+        const int32_t exponent = static_cast<int32_t>(v) >> 24;
+        const float f = std::ldexp(static_cast<float>(mantissa), exponent);
+        std::memcpy(data + i * 4, &f, sizeof(f));
+    }
+}
+} // namespace
+
+bool parseMeshoptMode(const std::string& name, MeshoptMode& mode)
+{
+    if (name == "ATTRIBUTES")
+    {
+        mode = MeshoptMode::Attributes;
+    }
+    else if (name == "TRIANGLES")
+    {
+        mode = MeshoptMode::Triangles;
+    }
+    else if (name == "INDICES")
+    {
+        mode = MeshoptMode::Indices;
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+bool parseMeshoptFilter(const std::string& name, MeshoptFilter& filter)
+{
+    if (name.empty() || name == "NONE")
+    {
+        filter = MeshoptFilter::None;
+    }
+    else if (name == "OCTAHEDRAL")
+    {
+        filter = MeshoptFilter::Octahedral;
+    }
+    else if (name == "QUATERNION")
+    {
+        filter = MeshoptFilter::Quaternion;
+    }
+    else if (name == "EXPONENTIAL")
+    {
+        filter = MeshoptFilter::Exponential;
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+bool decodeMeshoptVertexBuffer(unsigned char* destination, size_t count, size_t stride, const unsigned char* buffer, size_t bufferSize)
+{
+    if (stride == 0 || stride > c_maxVertexStride || stride % 4 != 0)
+    {
+        return false;
+    }
+
+    const size_t tailSize = stride < c_tailMaxSize ? c_tailMaxSize : stride;
+    if (bufferSize < 1 + tailSize || buffer[0] != c_vertexHeader)
+    {
+        return false;
+    }
+
+    const unsigned char* data = buffer + 1;
+    const unsigned char* dataEnd = buffer + bufferSize - tailSize;
+
+    // The tail holds the baseline vertex that the deltas of the first block are relative to
+    unsigned char lastVertex[c_maxVertexStride];
+    std::memcpy(lastVertex, buffer + bufferSize - stride, stride);
+
+    const size_t blockSize = getVertexBlockSize(stride);
+    for (size_t offset = 0; offset < count; offset += blockSize)
+    {
+        const size_t blockCount = offset + blockSize < count ? blockSize : count - offset;
+        data = decodeVertexBlock(data, dataEnd, destination + offset * stride, blockCount, stride, lastVertex);
+        if (!data)
+        {
+            return false;
+        }
+    }
+
+    return data == dataEnd;
+}
+
+bool decodeMeshoptIndexBuffer(unsigned char* destination, size_t count, size_t stride, const unsigned char* buffer, size_t bufferSize)
+{
+    if (count % 3 != 0 || (stride != 2 && stride != 4))
+    {
+        return false;
+    }
+
+    // Header, one code byte per triangle and a 16 byte auxiliary code table at the end
+    if (bufferSize < 1 + count / 3 + 16 || (buffer[0] & 0xf0) != c_indexHeader)
+    {
+        return false;
+    }
+
+    const int version = buffer[0] & 0x0f;
+    if (version > 1)
+    {
+        return false;
+    }
+
+    const int fecMax = version >= 1 ? 13 : 15;
+    const unsigned char* code = buffer + 1;
+    const unsigned char* data = code + count / 3;
+    const unsigned char* dataEnd = buffer + bufferSize - 16;
+    const unsigned char* codeAuxTable = dataEnd;
+
+    TriangleFifos fifos;
+    unsigned int next = 0;
+    unsigned int last = 0;
+
+    for (size_t i = 0; i < count; i += 3)
+    {
+        if (data > dataEnd)
+        {
+            return false;
+        }
+
+        const unsigned char codeTri = *code++;
+        unsigned int a;
+        unsigned int b;
+        unsigned int c;
+
+        if (codeTri < 0xf0)
+        {
+            // Triangle shares an edge with one of the recent triangles
+            const int fe = codeTri >> 4;
+            a = fifos.edges[(fifos.edgeOffset - 1 - fe) & 15][0];
+            b = fifos.edges[(fifos.edgeOffset - 1 - fe) & 15][1];
+
+            const int fec = codeTri & 15;
+            if (fec < fecMax)
+            {
+                c = fec == 0 ? next++ : fifos.vertices[(fifos.vertexOffset - 1 - fec) & 15];
+                fifos.pushVertex(c, fec == 0);
+            }
+            else
+            {
+                if (fec != 15)
+                {
+                    // 13 and 14 encode -1 and +1 relative to the last free index
+                    last += fec == 13 ? -1 : 1;
+                }
+                else if (!decodeIndex(data, dataEnd, last))
+                {
+                    return false;
+                }
+                c = last;
+                fifos.pushVertex(c);
+            }
+
+            fifos.pushEdge(c, b);
+            fifos.pushEdge(a, c);
+        }
+        else
+        {
+            int fea;
+            int feb;
+            int fec;
+            if (codeTri < 0xfe)
+            {
+                const unsigned char codeAux = codeAuxTable[codeTri & 15];
+                fea = 0;
+                feb = codeAux >> 4;
+                fec = codeAux & 15;
+            }
+            else
+            {
+                if (data >= dataEnd)
+                {
+                    return false;
+                }
+                const unsigned char codeAux = *data++;
+                fea = codeTri == 0xfe ? 0 : 15;
+                feb = codeAux >> 4;
+                fec = codeAux & 15;
+
+                // Reset is encoded as zero aux code outside of the table
+                if (codeAux == 0)
+                {
+                    next = 0;
+                }
+            }
+
+            // Indices that are new are taken in order before any free index is decoded, matching the encoder
+            a = fea == 0 ? next++ : 0;
+            b = feb == 0 ? next++ : fifos.vertices[(fifos.vertexOffset - feb) & 15];
+            c = fec == 0 ? next++ : fifos.vertices[(fifos.vertexOffset - fec) & 15];
+
+            if (fea == 15 && !decodeIndex(data, dataEnd, last))
+            {
+                return false;
+            }
+            a = fea == 15 ? last : a;
+            if (feb == 15 && !decodeIndex(data, dataEnd, last))
+            {
+                return false;
+            }
+            b = feb == 15 ? last : b;
+            if (fec == 15 && !decodeIndex(data, dataEnd, last))
+            {
+                return false;
+            }
+            c = fec == 15 ? last : c;
+
+            fifos.pushVertex(a);
+            fifos.pushVertex(b, feb == 0 || feb == 15);
+            fifos.pushVertex(c, fec == 0 || fec == 15);
+
+            fifos.pushEdge(b, a);
+            fifos.pushEdge(c, b);
+            fifos.pushEdge(a, c);
+        }
+
+        writeIndex(destination, i + 0, stride, a);
+        writeIndex(destination, i + 1, stride, b);
+        writeIndex(destination, i + 2, stride, c);
+    }
+
+    return data == dataEnd;
+}
+
+bool decodeMeshoptIndexSequence(unsigned char* destination, size_t count, size_t stride, const unsigned char* buffer, size_t bufferSize)
+{
+    if (stride != 2 && stride != 4)
+    {
+        return false;
+    }
+
+    // Header, at least one byte per index and a 4 byte tail
+    if (bufferSize < 1 + count + 4 || (buffer[0] & 0xf0) != c_sequenceHeader)
+    {
+        return false;
+    }
+
+    const int version = buffer[0] & 0x0f;
+    if (version > 1)
+    {
+        return false;
+    }
+
+    const unsigned char* data = buffer + 1;
+    const unsigned char* dataEnd = buffer + bufferSize - 4;
+    unsigned int last[2] = {0, 0};
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        unsigned int v;
+        if (!decodeVByte(data, dataEnd, v))
+        {
+            return false;
+        }
+
+        // Lowest bit selects one of the two baselines, the rest is a zigzag delta
+        const unsigned int baseline = v & 1;
+        v >>= 1;
+        last[baseline] += (v >> 1) ^ (0u - (v & 1));
+        writeIndex(destination, i, stride, last[baseline]);
+    }
+
+    return data == dataEnd;
+}
+
+bool applyMeshoptFilter(unsigned char* data, size_t count, size_t stride, MeshoptFilter filter)
+{
+    switch (filter)
+    {
+    case MeshoptFilter::None:
+        return true;
+    case MeshoptFilter::Octahedral:
+        if (stride == 4)
+        {
+            decodeFilterOctahedral<int8_t>(data, count, stride);
+            return true;
+        }
+        if (stride == 8)
+        {
+            decodeFilterOctahedral<int16_t>(data, count, stride);
+            return true;
+        }
+        return false;
+    case MeshoptFilter::Quaternion:
+        if (stride != 8)
+        {
+            return false;
+        }
+        decodeFilterQuaternion(data, count);
+        return true;
+    case MeshoptFilter::Exponential:
+        if (stride % 4 != 0)
+        {
+            return false;
+        }
+        decodeFilterExponential(data, count * stride / 4);
+        return true;
+    }
+    return false;
+}
+
+bool decodeMeshoptBuffer(unsigned char* destination, size_t count, size_t stride, const unsigned char* buffer, size_t bufferSize, MeshoptMode mode, MeshoptFilter filter)
+{
+    switch (mode)
+    {
+    case MeshoptMode::Attributes:
+        return decodeMeshoptVertexBuffer(destination, count, stride, buffer, bufferSize) && applyMeshoptFilter(destination, count, stride, filter);
+    case MeshoptMode::Triangles:
+        return filter == MeshoptFilter::None && decodeMeshoptIndexBuffer(destination, count, stride, buffer, bufferSize);
+    case MeshoptMode::Indices:
+        return filter == MeshoptFilter::None && decodeMeshoptIndexSequence(destination, count, stride, buffer, bufferSize);
+    }
+    return false;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// Decoders for the EXT_meshopt_compression bitstream (version 0)
+
+enum class MeshoptMode
+{
+    Attributes,
+    Triangles,
+    Indices
+};
+
+enum class MeshoptFilter
+{
+    None,
+    Octahedral,
+    Quaternion,
+    Exponential
+};
+
+bool parseMeshoptMode(const std::string& name, MeshoptMode& mode);
+bool parseMeshoptFilter(const std::string& name, MeshoptFilter& filter);
+
+bool decodeMeshoptVertexBuffer(unsigned char* destination, size_t count, size_t stride, const unsigned char* buffer, size_t bufferSize);
+bool decodeMeshoptIndexBuffer(unsigned char* destination, size_t count, size_t stride, const unsigned char* buffer, size_t bufferSize);
+bool decodeMeshoptIndexSequence(unsigned char* destination, size_t count, size_t stride, const unsigned char* buffer, size_t bufferSize);
+bool applyMeshoptFilter(unsigned char* data, size_t count, size_t stride, MeshoptFilter filter);
+
+// Decodes count elements of stride bytes into destination which must hold count * stride bytes
+bool decodeMeshoptBuffer(unsigned char* destination, size_t count, size_t stride, const unsigned char* buffer, size_t bufferSize, MeshoptMode mode, MeshoptFilter filter);
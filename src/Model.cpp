@@ -1,13 +1,21 @@
 #include "Model.hpp"
 #include "Utils.hpp"
+#include "Meshopt.hpp"
+#include "JobSystem.hpp"
 
 #define STB_IMAGE_IMPLEMENTATION
 #define TINYGLTF_NOEXCEPTION
 #include <tiny_gltf.h>
 
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+
 #include <string>
 #include <cstring>
 #include <unordered_map>
+#include <algorithm>
+#include <chrono>
+#include <limits>
 
 namespace
 {
@@ -29,6 +37,40 @@ const std::unordered_map<int, size_t> c_typeCounts{
     {TINYGLTF_TYPE_VEC4, 4},
 };
 
+const std::string c_meshoptExtension = "EXT_meshopt_compression";
+const std::string c_meshQuantizationExtension = "KHR_mesh_quantization";
+const std::string c_dracoExtension = "KHR_draco_mesh_compression";
+
+// Decoded contents of compressed buffer views, empty for views that are read from the buffer directly
+using DecodedBufferViews = std::vector<std::vector<unsigned char>>;
+
+// Encoded image files by image index, tinygltf only collects them so that they can be decoded in parallel
+using EncodedImages = std::vector<std::vector<unsigned char>>;
+
+struct AccessorView
+{
+    const unsigned char* data;
+    size_t stride;
+};
+
+// A mesh as placed by a node of the scene
+struct MeshInstance
+{
+    int mesh;
+    glm::mat4 matrix;
+};
+
+struct MeshoptJob
+{
+    size_t bufferView;
+    const unsigned char* source;
+    size_t sourceSize;
+    size_t count;
+    size_t stride;
+    MeshoptMode mode;
+    MeshoptFilter filter;
+};
+
 size_t getAccessorElementSizeInBytes(const tinygltf::Accessor& accessor)
 {
     const size_t componentTypeSize = c_componentTypeSizes.at(accessor.componentType);
@@ -36,66 +78,454 @@ size_t getAccessorElementSizeInBytes(const tinygltf::Accessor& accessor)
     return componentTypeSize * typeCount;
 }
 
-std::vector<Model::Vertex> loadVertices(const tinygltf::Model& model)
+size_t getExtensionNumber(const tinygltf::Value& extension, const char* key, size_t defaultValue)
 {
-    std::vector<Model::Vertex> vertices;
-    for (const auto& [attributeName, attributeIndex] : model.meshes[0].primitives[0].attributes)
+    if (!extension.Has(key))
+    {
+        return defaultValue;
+    }
+    const tinygltf::Value& value = extension.Get(key);
+    CHECK(value.IsNumber());
+    return static_cast<size_t>(value.IsInt() ? value.Get<int>() : value.Get<double>());
+}
+
+std::string getExtensionString(const tinygltf::Value& extension, const char* key)
+{
+    return extension.Has(key) ? extension.Get(key).Get<std::string>() : std::string();
+}
+
+// Returns an error message for files that need what the loader doesn't support
+std::string checkExtensions(const tinygltf::Model& model)
+{
+    for (const std::string& extension : model.extensionsRequired)
+    {
+        if (extension != c_meshoptExtension && extension != c_meshQuantizationExtension)
+        {
+            return "Required extension " + extension + " is not supported";
+        }
+    }
+
+    for (const tinygltf::Mesh& mesh : model.meshes)
+    {
+        for (const tinygltf::Primitive& primitive : mesh.primitives)
+        {
+            if (primitive.extensions.count(c_dracoExtension))
+            {
+                return "KHR_draco_mesh_compression is not supported, use EXT_meshopt_compression instead";
+            }
+        }
+    }
+    return std::string();
+}
+
+// False when a compressed view references data outside its buffer or uses an unknown mode or filter
+bool getMeshoptJobs(const tinygltf::Model& model, std::vector<MeshoptJob>& jobs)
+{
+    for (size_t i = 0; i < model.bufferViews.size(); ++i)
+    {
+        const auto found = model.bufferViews[i].extensions.find(c_meshoptExtension);
+        if (found == model.bufferViews[i].extensions.end())
+        {
+            continue;
+        }
+
+        const tinygltf::Value& extension = found->second;
+        const size_t bufferIndex = getExtensionNumber(extension, "buffer", model.buffers.size());
+        if (bufferIndex >= model.buffers.size())
+        {
+            return false;
+        }
+        const std::vector<unsigned char>& buffer = model.buffers[bufferIndex].data;
+
+        MeshoptJob job;
+        job.bufferView = i;
+        const size_t byteOffset = getExtensionNumber(extension, "byteOffset", 0);
+        job.sourceSize = getExtensionNumber(extension, "byteLength", 0);
+        if (byteOffset + job.sourceSize > buffer.size())
+        {
+            return false;
+        }
+        job.source = buffer.data() + byteOffset;
+        job.count = getExtensionNumber(extension, "count", 0);
+        job.stride = getExtensionNumber(extension, "byteStride", 0);
+        if (!parseMeshoptMode(getExtensionString(extension, "mode"), job.mode) || !parseMeshoptFilter(getExtensionString(extension, "filter"), job.filter))
+        {
+            return false;
+        }
+        jobs.push_back(job);
+    }
+    return true;
+}
+
+// Each compressed buffer view is a sequential stream so views are decoded in parallel rather than chunks of a view.
+// Returns an error message when the compressed data is invalid.
+std::string decodeBufferViews(const tinygltf::Model& model, JobSystem& jobSystem, DecodedBufferViews& decoded)
+{
+    decoded.resize(model.bufferViews.size());
+    std::vector<MeshoptJob> jobs;
+    if (!getMeshoptJobs(model, jobs))
+    {
+        return "Invalid EXT_meshopt_compression buffer view";
+    }
+    if (jobs.empty())
+    {
+        return std::string();
+    }
+
+    // Largest first so that a big view doesn't end up last on a single thread
+    std::sort(jobs.begin(), jobs.end(), [](const MeshoptJob& a, const MeshoptJob& b) {
+        return a.count * a.stride > b.count * b.stride;
+    });
+
+    size_t compressedSize = 0;
+    size_t decodedSize = 0;
+    for (const MeshoptJob& job : jobs)
+    {
+        decoded[job.bufferView].resize(job.count * job.stride);
+        compressedSize += job.sourceSize;
+        decodedSize += job.count * job.stride;
+    }
+
+    const auto startTime = std::chrono::steady_clock::now();
+
+    std::vector<char> results(jobs.size(), 0);
+    jobSystem.parallelFor(jobs.size(), 1, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i)
+        {
+            const MeshoptJob& job = jobs[i];
+            results[i] = decodeMeshoptBuffer(decoded[job.bufferView].data(), job.count, job.stride, job.source, job.sourceSize, job.mode, job.filter);
+        }
+    });
+
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+
+    for (size_t i = 0; i < jobs.size(); ++i)
+    {
+        if (!results[i])
+        {
+            return "Invalid EXT_meshopt_compression data in buffer view " + std::to_string(jobs[i].bufferView);
+        }
+    }
+
+    const double megabyte = 1024.0 * 1024.0;
+    printf("Decoded %zu meshopt buffer views on %zu threads, %.2f MB -> %.2f MB in %.2f ms (%.1f MB/s)\n",
+           jobs.size(),
+           std::min<size_t>(jobs.size(), jobSystem.getWorkerCount() + 1),
+           compressedSize / megabyte,
+           decodedSize / megabyte,
+           seconds * 1000.0,
+           seconds > 0.0 ? decodedSize / megabyte / seconds : 0.0);
+
+    return std::string();
+}
+
+AccessorView getAccessorView(const tinygltf::Model& model, const DecodedBufferViews& decoded, const tinygltf::Accessor& accessor)
+{
+    CHECK(accessor.bufferView >= 0);
+    CHECK(accessor.sparse.isSparse == false);
+    const tinygltf::BufferView& bufferView = model.bufferViews[accessor.bufferView];
+    const std::vector<unsigned char>& decodedData = decoded[accessor.bufferView];
+
+    const unsigned char* viewData = nullptr;
+    size_t viewSize = 0;
+    if (decodedData.empty())
     {
-        const tinygltf::Accessor& accessor = model.accessors[attributeIndex];
-        const tinygltf::BufferView& bufferView = model.bufferViews[accessor.bufferView];
         const tinygltf::Buffer& buffer = model.buffers[bufferView.buffer];
+        CHECK(bufferView.byteOffset + bufferView.byteLength <= buffer.data.size());
+        viewData = buffer.data.data() + bufferView.byteOffset;
+        viewSize = bufferView.byteLength;
+    }
+    else
+    {
+        viewData = decodedData.data();
+        viewSize = decodedData.size();
+    }
+
+    const size_t elementSizeInBytes = getAccessorElementSizeInBytes(accessor);
+    const size_t stride = bufferView.byteStride != 0 ? bufferView.byteStride : elementSizeInBytes;
+    CHECK(accessor.count == 0 || accessor.byteOffset + (accessor.count - 1) * stride + elementSizeInBytes <= viewSize);
+
+    return AccessorView{viewData + accessor.byteOffset, stride};
+}
+
+// Quantized attributes (KHR_mesh_quantization) are converted to floats
+float readComponent(const unsigned char* data, int componentType, bool normalized)
+{
+    switch (componentType)
+    {
+    case TINYGLTF_COMPONENT_TYPE_FLOAT:
+    {
+        float value;
+        std::memcpy(&value, data, sizeof(value));
+        return value;
+    }
+    case TINYGLTF_COMPONENT_TYPE_BYTE:
+    {
+        const float value = static_cast<float>(*reinterpret_cast<const int8_t*>(data));
+        return normalized ? std::max(value / 127.0f, -1.0f) : value;
+    }
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+    {
+        const float value = static_cast<float>(*data);
+        return normalized ? value / 255.0f : value;
+    }
+    case TINYGLTF_COMPONENT_TYPE_SHORT:
+    {
+        int16_t value;
+        std::memcpy(&value, data, sizeof(value));
+        return normalized ? std::max(value / 32767.0f, -1.0f) : static_cast<float>(value);
+    }
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
+    {
+        uint16_t value;
+        std::memcpy(&value, data, sizeof(value));
+        return normalized ? value / 65535.0f : static_cast<float>(value);
+    }
+    }
+    LOGE("Unsupported vertex attribute component type");
+    return 0.0f;
+}
 
-        if (vertices.empty())
+void readAttribute(const AccessorView& view, const tinygltf::Accessor& accessor, size_t index, float* destination, size_t componentCount)
+{
+    const size_t componentSize = c_componentTypeSizes.at(accessor.componentType);
+    const size_t count = std::min(componentCount, c_typeCounts.at(accessor.type));
+    const unsigned char* element = view.data + index * view.stride;
+    for (size_t i = 0; i < count; ++i)
+    {
+        destination[i] = readComponent(element + i * componentSize, accessor.componentType, accessor.normalized);
+    }
+}
+
+// Appends the vertices of the primitive and returns how many were added
+size_t loadVertices(const tinygltf::Model& model, const DecodedBufferViews& decoded, const tinygltf::Primitive& primitive, std::vector<Model::Vertex>& vertices)
+{
+    const size_t firstVertex = vertices.size();
+    size_t vertexCount = 0;
+    for (const auto& [attributeName, attributeIndex] : primitive.attributes)
+    {
+        const tinygltf::Accessor& accessor = model.accessors[attributeIndex];
+
+        if (vertexCount == 0)
         {
-            vertices.resize(accessor.count);
+            vertexCount = accessor.count;
+            vertices.resize(firstVertex + vertexCount);
         }
-        CHECK(vertices.size() == accessor.count);
+        CHECK(vertexCount == accessor.count);
 
-        const size_t elementSizeInBytes = getAccessorElementSizeInBytes(accessor);
-        const size_t offset = bufferView.byteOffset + accessor.byteOffset;
-        const unsigned char* bufferPtr = &buffer.data[offset];
+        const AccessorView view = getAccessorView(model, decoded, accessor);
         for (size_t i = 0; i < accessor.count; ++i)
         {
-            CHECK(bufferPtr < &buffer.data[offset + bufferView.byteLength]);
+            Model::Vertex& vertex = vertices[firstVertex + i];
             if (attributeName == "POSITION")
             {
-                std::memcpy(&vertices[i].position, bufferPtr, elementSizeInBytes);
+                readAttribute(view, accessor, i, &vertex.position.x, 3);
             }
             else if (attributeName == "NORMAL")
             {
-                std::memcpy(&vertices[i].normal, bufferPtr, elementSizeInBytes);
+                readAttribute(view, accessor, i, &vertex.normal.x, 3);
             }
             else if (attributeName == "TEXCOORD_0")
             {
-                std::memcpy(&vertices[i].uv, bufferPtr, elementSizeInBytes);
+                readAttribute(view, accessor, i, &vertex.uv.x, 2);
             }
-            bufferPtr += elementSizeInBytes + bufferView.byteStride;
         }
     }
-    return vertices;
+    return vertexCount;
 }
 
-std::vector<uint32_t> loadIndices(const tinygltf::Model& model)
+// Appends the indices of the primitive relative to its first vertex
+void loadIndices(const tinygltf::Model& model, const DecodedBufferViews& decoded, const tinygltf::Primitive& primitive, size_t vertexCount, std::vector<uint32_t>& indices)
 {
-    std::vector<uint32_t> indices;
+    const size_t firstIndex = indices.size();
 
-    const tinygltf::Accessor& indicesAccessor = model.accessors[model.meshes[0].primitives[0].indices];
-    const tinygltf::BufferView& indexBufferView = model.bufferViews[indicesAccessor.bufferView];
-    const tinygltf::Buffer& indexBuffer = model.buffers[indexBufferView.buffer];
-    indices.resize(indicesAccessor.count);
+    if (primitive.indices < 0)
+    {
+        indices.resize(firstIndex + vertexCount);
+        for (size_t i = 0; i < vertexCount; ++i)
+        {
+            indices[firstIndex + i] = static_cast<uint32_t>(i);
+        }
+        return;
+    }
+
+    const tinygltf::Accessor& indicesAccessor = model.accessors[primitive.indices];
+    const AccessorView view = getAccessorView(model, decoded, indicesAccessor);
+    indices.resize(firstIndex + indicesAccessor.count);
 
-    const size_t indexOffset = indexBufferView.byteOffset + indicesAccessor.byteOffset;
-    const unsigned char* indexBufferPtr = &indexBuffer.data[indexOffset];
-    unsigned short indexValue = 0;
     for (size_t i = 0; i < indicesAccessor.count; ++i)
     {
-        CHECK(indexBufferPtr < &indexBuffer.data[indexOffset + indexBufferView.byteLength]);
-        std::memcpy(&indexValue, indexBufferPtr, sizeof(unsigned short));
-        indices[i] = indexValue;
-        indexBufferPtr += indexBufferView.byteStride + sizeof(unsigned short);
+        const unsigned char* element = view.data + i * view.stride;
+        uint32_t& index = indices[firstIndex + i];
+        switch (indicesAccessor.componentType)
+        {
+        case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+            index = *element;
+            break;
+        case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
+        {
+            uint16_t indexValue;
+            std::memcpy(&indexValue, element, sizeof(indexValue));
+            index = indexValue;
+            break;
+        }
+        case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT:
+            std::memcpy(&index, element, sizeof(uint32_t));
+            break;
+        default:
+            LOGE("Unsupported index component type");
+        }
+    }
+}
+
+// Local transform of a node, given either as a matrix or as translation, rotation and scale
+glm::mat4 getNodeMatrix(const tinygltf::Node& node)
+{
+    glm::mat4 matrix(1.0f);
+    if (node.matrix.size() == 16)
+    {
+        for (size_t i = 0; i < 16; ++i)
+        {
+            matrix[i / 4][i % 4] = static_cast<float>(node.matrix[i]);
+        }
+        return matrix;
+    }
+
+    if (node.translation.size() == 3)
+    {
+        matrix = glm::translate(matrix, glm::vec3(node.translation[0], node.translation[1], node.translation[2]));
+    }
+    if (node.rotation.size() == 4)
+    {
+        // glTF stores the quaternion as x, y, z, w
+        const glm::quat rotation(static_cast<float>(node.rotation[3]), static_cast<float>(node.rotation[0]), static_cast<float>(node.rotation[1]), static_cast<float>(node.rotation[2]));
+        matrix *= glm::mat4_cast(rotation);
+    }
+    if (node.scale.size() == 3)
+    {
+        matrix = glm::scale(matrix, glm::vec3(node.scale[0], node.scale[1], node.scale[2]));
+    }
+    return matrix;
+}
+
+// Walks the node hierarchy of the default scene. Files without scenes have no placement so every mesh is used as is.
+std::vector<MeshInstance> getMeshInstances(const tinygltf::Model& model)
+{
+    std::vector<MeshInstance> meshInstances;
+    if (model.scenes.empty())
+    {
+        for (size_t i = 0; i < model.meshes.size(); ++i)
+        {
+            meshInstances.push_back({static_cast<int>(i), glm::mat4(1.0f)});
+        }
+        return meshInstances;
+    }
+
+    const size_t sceneIndex = model.defaultScene >= 0 ? model.defaultScene : 0;
+    CHECK(sceneIndex < model.scenes.size());
+    const std::vector<int>& rootNodes = model.scenes[sceneIndex].nodes;
+
+    // Nodes with their parent's world matrix, in reverse so that the nodes come out in file order
+    std::vector<std::pair<int, glm::mat4>> pending;
+    for (auto node = rootNodes.rbegin(); node != rootNodes.rend(); ++node)
+    {
+        pending.emplace_back(*node, glm::mat4(1.0f));
+    }
+
+    // Every node has one parent at most so a valid file visits each node once, more visits mean a cycle
+    size_t visitCount = 0;
+    while (!pending.empty())
+    {
+        const auto [nodeIndex, parentMatrix] = pending.back();
+        pending.pop_back();
+        CHECK(nodeIndex >= 0 && static_cast<size_t>(nodeIndex) < model.nodes.size());
+        CHECK(++visitCount <= model.nodes.size());
+
+        const tinygltf::Node& node = model.nodes[nodeIndex];
+        const glm::mat4 matrix = parentMatrix * getNodeMatrix(node);
+        if (node.mesh >= 0)
+        {
+            CHECK(static_cast<size_t>(node.mesh) < model.meshes.size());
+            meshInstances.push_back({node.mesh, matrix});
+        }
+        for (auto child = node.children.rbegin(); child != node.children.rend(); ++child)
+        {
+            pending.emplace_back(*child, matrix);
+        }
+    }
+    return meshInstances;
+}
+
+// Bakes the node's world matrix into the vertices of a primitive. Mirroring matrices reverse the winding, so the
+// triangles are flipped back to stay front facing.
+void transformPrimitive(const glm::mat4& matrix, std::vector<Model::Vertex>& vertices, size_t firstVertex, std::vector<uint32_t>& indices, size_t firstIndex)
+{
+    if (matrix == glm::mat4(1.0f))
+    {
+        return;
+    }
+
+    const glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(matrix)));
+    for (size_t i = firstVertex; i < vertices.size(); ++i)
+    {
+        Model::Vertex& vertex = vertices[i];
+        vertex.position = glm::vec3(matrix * glm::vec4(vertex.position, 1.0f));
+        const glm::vec3 normal = normalMatrix * vertex.normal;
+        const float length = glm::length(normal);
+        vertex.normal = length > 0.0f ? normal / length : normal;
+    }
+
+    if (glm::determinant(glm::mat3(matrix)) < 0.0f)
+    {
+        for (size_t i = firstIndex; i + 2 < indices.size(); i += 3)
+        {
+            std::swap(indices[i + 1], indices[i + 2]);
+        }
+    }
+}
+
+// Every triangle primitive of every placed mesh goes into the shared vertex and index arrays with the node transform
+// baked in. A mesh used by several nodes is loaded once per node.
+std::vector<Model::Primitive> loadPrimitives(const tinygltf::Model& model, const DecodedBufferViews& decoded, std::vector<Model::Vertex>& vertices, std::vector<uint32_t>& indices)
+{
+    std::vector<Model::Primitive> primitives;
+    for (const MeshInstance& meshInstance : getMeshInstances(model))
+    {
+        for (const tinygltf::Primitive& gltfPrimitive : model.meshes[meshInstance.mesh].primitives)
+        {
+            if (gltfPrimitive.mode >= 0 && gltfPrimitive.mode != TINYGLTF_MODE_TRIANGLES)
+            {
+                LOGW("Skipping a primitive that is not a triangle list");
+                continue;
+            }
+
+            Model::Primitive primitive;
+            primitive.firstIndex = ui32Size(indices);
+            primitive.vertexOffset = static_cast<int32_t>(vertices.size());
+            primitive.material = gltfPrimitive.material;
+
+            const size_t vertexCount = loadVertices(model, decoded, gltfPrimitive, vertices);
+            loadIndices(model, decoded, gltfPrimitive, vertexCount, indices);
+            primitive.indexCount = ui32Size(indices) - primitive.firstIndex;
+            transformPrimitive(meshInstance.matrix, vertices, primitive.vertexOffset, indices, primitive.firstIndex);
+
+            primitive.boundsMin = glm::vec3(std::numeric_limits<float>::max());
+            primitive.boundsMax = glm::vec3(std::numeric_limits<float>::lowest());
+            for (size_t i = primitive.vertexOffset; i < vertices.size(); ++i)
+            {
+                primitive.boundsMin = glm::min(primitive.boundsMin, vertices[i].position);
+                primitive.boundsMax = glm::max(primitive.boundsMax, vertices[i].position);
+            }
+
+            primitives.push_back(primitive);
+        }
     }
+    return primitives;
+}
 
-    return indices;
+int getTextureSource(const tinygltf::Model& model, int textureIndex)
+{
+    return textureIndex >= 0 ? model.textures[textureIndex].source : -1;
 }
 
 std::vector<Model::Material> loadMaterials(const tinygltf::Model& model)
@@ -105,62 +535,166 @@ std::vector<Model::Material> loadMaterials(const tinygltf::Model& model)
     for (size_t i = 0; i < model.materials.size(); ++i)
     {
         const tinygltf::Material& m = model.materials[i];
-        materials[i].baseColor = model.textures[m.pbrMetallicRoughness.baseColorTexture.index].source;
-        materials[i].metallicRoughnessImage = model.textures[m.pbrMetallicRoughness.metallicRoughnessTexture.index].source;
-        materials[i].normalImage = model.textures[m.normalTexture.index].source;
-        materials[i].emissiveImage = model.textures[m.emissiveTexture.index].source;
-        materials[i].occlusionImage = model.textures[m.occlusionTexture.index].source;
+        materials[i].baseColor = getTextureSource(model, m.pbrMetallicRoughness.baseColorTexture.index);
+        materials[i].metallicRoughnessImage = getTextureSource(model, m.pbrMetallicRoughness.metallicRoughnessTexture.index);
+        materials[i].normalImage = getTextureSource(model, m.normalTexture.index);
+        materials[i].emissiveImage = getTextureSource(model, m.emissiveTexture.index);
+        materials[i].occlusionImage = getTextureSource(model, m.occlusionTexture.index);
     }
 
     return materials;
 }
 
-std::vector<Model::Image> loadImages(tinygltf::Model& model)
+bool storeEncodedImage(tinygltf::Image* image, const int imageIndex, std::string* error, std::string* warning, int requiredWidth, int requiredHeight, const unsigned char* bytes, int size, void* userData)
+{
+    EncodedImages& encodedImages = *static_cast<EncodedImages*>(userData);
+    CHECK(imageIndex >= 0);
+    if (encodedImages.size() <= static_cast<size_t>(imageIndex))
+    {
+        encodedImages.resize(imageIndex + 1);
+    }
+    encodedImages[imageIndex].assign(bytes, bytes + size);
+    return true;
+}
+
+// Everything is expanded to four channels, 16-bit files keep their precision. False for files stb can't decode.
+bool decodeImage(const std::vector<unsigned char>& encoded, Model::Image& image)
+{
+    const int requiredComponents = 4;
+    const int encodedSize = static_cast<int>(encoded.size());
+    int width = 0;
+    int height = 0;
+    int components = 0;
+
+    image.components = requiredComponents;
+    if (stbi_is_16_bit_from_memory(encoded.data(), encodedSize))
+    {
+        stbi_us* pixels = stbi_load_16_from_memory(encoded.data(), encodedSize, &width, &height, &components, requiredComponents);
+        if (!pixels)
+        {
+            return false;
+        }
+        const unsigned char* bytes = reinterpret_cast<const unsigned char*>(pixels);
+        image.data.assign(bytes, bytes + static_cast<size_t>(width) * height * requiredComponents * sizeof(stbi_us));
+        image.bitsPerChannel = 16;
+        stbi_image_free(pixels);
+    }
+    else
+    {
+        stbi_uc* pixels = stbi_load_from_memory(encoded.data(), encodedSize, &width, &height, &components, requiredComponents);
+        if (!pixels)
+        {
+            return false;
+        }
+        image.data.assign(pixels, pixels + static_cast<size_t>(width) * height * requiredComponents);
+        image.bitsPerChannel = 8;
+        stbi_image_free(pixels);
+    }
+    image.width = width;
+    image.height = height;
+    return true;
+}
+
+// Returns an error message naming the first image that failed to decode
+std::string loadImages(const tinygltf::Model& model, const EncodedImages& encodedImages, JobSystem& jobSystem, std::vector<Model::Image>& images)
 {
-    std::vector<Model::Image> images(model.images.size());
+    images.resize(model.images.size());
+    std::vector<char> decoded(images.size(), 1);
+    jobSystem.parallelFor(images.size(), 1, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i)
+        {
+            if (i < encodedImages.size() && !encodedImages[i].empty())
+            {
+                decoded[i] = decodeImage(encodedImages[i], images[i]);
+            }
+        }
+    });
 
-    for (size_t i = 0; i < model.images.size(); ++i)
+    for (size_t i = 0; i < decoded.size(); ++i)
     {
-        images[i].width = model.images[i].width;
-        images[i].height = model.images[i].height;
-        images[i].components = model.images[i].component;
-        images[i].bitsPerChannel = model.images[i].bits;
-        images[i].data = std::move(model.images[i].image);
+        if (!decoded[i])
+        {
+            return "Failed to decode image " + std::to_string(i);
+        }
     }
-    return images;
+    return std::string();
 }
 } // namespace
 
-Model::Model(const std::string& filename)
+Model::Model(const std::string& filename, const std::vector<char>& fileData, JobSystem& jobSystem)
 {
     tinygltf::Model model;
     tinygltf::TinyGLTF loader;
+    EncodedImages encodedImages;
+    loader.SetImageLoader(storeEncodedImage, &encodedImages);
     std::string errorMessage;
     std::string warningMessage;
 
-    const std::string filepath = c_modelsFolder + filename;
-    printf("Loading model %s... ", filepath.c_str());
-    const bool modelLoaded = loader.LoadBinaryFromFile(&model, &errorMessage, &warningMessage, filepath);
+    printf("Loading model %s...\n", filename.c_str());
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(fileData.data());
+    const bool modelLoaded = loader.LoadBinaryFromMemory(&model, &errorMessage, &warningMessage, bytes, ui32Size(fileData), c_modelsFolder);
 
     if (!warningMessage.empty())
     {
         LOGW(warningMessage.c_str());
-        abort();
     }
 
-    if (!errorMessage.empty())
+    if (!modelLoaded || !errorMessage.empty())
+    {
+        error = errorMessage.empty() ? "Not a valid glTF binary" : errorMessage;
+        return;
+    }
+    error = checkExtensions(model);
+    if (error.empty() && model.meshes.empty())
+    {
+        error = "The model has no meshes";
+    }
+    if (!error.empty())
     {
-        LOGE(errorMessage.c_str());
-        abort();
+        return;
     }
 
-    CHECK(modelLoaded);
-    CHECK(!model.meshes.empty());
+    // Images don't depend on the geometry so they are decoded while the primitives are loaded
+    std::string imageError;
+    JobSystem::JobHandle imagesJob = jobSystem.schedule([&]() {
+        imageError = loadImages(model, encodedImages, jobSystem, images);
+    });
 
-    vertices = loadVertices(model);
-    indices = loadIndices(model);
-    materials = loadMaterials(model);
-    images = loadImages(model);
+    DecodedBufferViews decoded;
+    error = decodeBufferViews(model, jobSystem, decoded);
+    if (error.empty())
+    {
+        primitives = loadPrimitives(model, decoded, vertices, indices);
+        materials = loadMaterials(model);
+    }
+    // The job references the locals so it is waited for in any case
+    jobSystem.wait(imagesJob);
 
-    printf("Completed\n");
+    if (error.empty())
+    {
+        error = imageError;
+    }
+    if (error.empty() && primitives.empty())
+    {
+        error = "The model has no triangle primitives";
+    }
+    if (error.empty())
+    {
+        printf("Completed\n");
+    }
+}
+
+size_t Model::getHostMemorySize() const
+{
+    size_t size = 0;
+    size += vertices.capacity() * sizeof(Vertex);
+    size += indices.capacity() * sizeof(uint32_t);
+    size += primitives.capacity() * sizeof(Primitive);
+    size += materials.capacity() * sizeof(Material);
+    size += images.capacity() * sizeof(Image);
+    for (const Image& image : images)
+    {
+        size += image.data.capacity();
+    }
+    return size;
 }
@@ -4,6 +4,8 @@
 #include <vector>
 #include <string>
 
+class JobSystem;
+
 class Model final
 {
 public:
@@ -23,6 +25,18 @@ public:
         int occlusionImage = -1;
     };
 
+    // Range of the shared index buffer, material is -1 when the primitive has none.
+    // Bounds are the axis aligned box of the primitive's vertices.
+    struct Primitive
+    {
+        uint32_t firstIndex;
+        uint32_t indexCount;
+        int32_t vertexOffset;
+        int material;
+        glm::vec3 boundsMin;
+        glm::vec3 boundsMax;
+    };
+
     struct Image
     {
         unsigned int width;
@@ -34,11 +48,18 @@ public:
 
     using Index = uint32_t;
 
-    Model(const std::string& filename);
+    // Files that are not valid glTF binaries or need unsupported extensions set error instead of aborting
+    Model(const std::string& filename, const std::vector<char>& fileData, JobSystem& jobSystem);
     ~Model() {}
 
+    size_t getHostMemorySize() const;
+
+    // Empty when the model loaded, the other members are incomplete otherwise
+    std::string error;
+
     std::vector<Vertex> vertices;
     std::vector<uint32_t> indices;
+    std::vector<Primitive> primitives;
     std::vector<Material> materials;
     std::vector<Image> images;
 };
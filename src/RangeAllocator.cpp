@@ -0,0 +1,103 @@
+#include "RangeAllocator.hpp"
+#include "Utils.hpp"
+#include <algorithm>
+#include <iterator>
+
+RangeAllocator::RangeAllocator(uint32_t capacity) :
+    m_capacity(capacity),
+    m_freeSize(capacity)
+{
+    if (capacity > 0)
+    {
+        m_freeRanges[0] = capacity;
+    }
+}
+
+uint32_t RangeAllocator::allocate(uint32_t size)
+{
+    if (size == 0)
+    {
+        return 0;
+    }
+
+    for (auto it = m_freeRanges.begin(); it != m_freeRanges.end(); ++it)
+    {
+        if (it->second < size)
+        {
+            continue;
+        }
+
+        // The rest of the range stays free behind the allocation
+        const uint32_t offset = it->first;
+        const uint32_t remaining = it->second - size;
+        m_freeRanges.erase(it);
+        if (remaining > 0)
+        {
+            m_freeRanges[offset + size] = remaining;
+        }
+        m_freeSize -= size;
+        return offset;
+    }
+
+    return c_invalidOffset;
+}
+
+void RangeAllocator::free(uint32_t offset, uint32_t size)
+{
+    if (size == 0)
+    {
+        return;
+    }
+    CHECK(offset + size <= m_capacity);
+
+    auto next = m_freeRanges.lower_bound(offset);
+    CHECK(next == m_freeRanges.end() || offset + size <= next->first);
+
+    // Merge with the range ending where this one starts and with the one starting where this one ends
+    uint32_t mergedOffset = offset;
+    uint32_t mergedSize = size;
+    if (next != m_freeRanges.begin())
+    {
+        auto previous = std::prev(next);
+        CHECK(previous->first + previous->second <= offset);
+        if (previous->first + previous->second == offset)
+        {
+            mergedOffset = previous->first;
+            mergedSize += previous->second;
+            m_freeRanges.erase(previous);
+        }
+    }
+    if (next != m_freeRanges.end() && next->first == offset + size)
+    {
+        mergedSize += next->second;
+        m_freeRanges.erase(next);
+    }
+
+    m_freeRanges[mergedOffset] = mergedSize;
+    m_freeSize += size;
+}
+
+uint32_t RangeAllocator::getCapacity() const
+{
+    return m_capacity;
+}
+
+uint32_t RangeAllocator::getUsedSize() const
+{
+    return m_capacity - m_freeSize;
+}
+
+uint32_t RangeAllocator::getLargestFreeRange() const
+{
+    uint32_t largest = 0;
+    for (const auto& [offset, size] : m_freeRanges)
+    {
+        largest = std::max(largest, size);
+    }
+    return largest;
+}
+
+uint32_t RangeAllocator::getFreeRangeCount() const
+{
+    return static_cast<uint32_t>(m_freeRanges.size());
+}
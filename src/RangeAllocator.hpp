@@ -0,0 +1,29 @@
+#pragma once
+
+#include <map>
+#include <cstdint>
+
+// Hands out ranges of [0, capacity) in whatever unit the owner uses. First fit over the free ranges, which are kept
+// sorted by offset so that a freed range merges with its free neighbors.
+class RangeAllocator final
+{
+public:
+    static const uint32_t c_invalidOffset = UINT32_MAX;
+
+    RangeAllocator(uint32_t capacity = 0);
+
+    // Returns c_invalidOffset when no free range is large enough, empty ranges are at offset 0 and take no space
+    uint32_t allocate(uint32_t size);
+    void free(uint32_t offset, uint32_t size);
+
+    uint32_t getCapacity() const;
+    uint32_t getUsedSize() const;
+    uint32_t getLargestFreeRange() const;
+    uint32_t getFreeRangeCount() const;
+
+private:
+    // Offset to size
+    std::map<uint32_t, uint32_t> m_freeRanges;
+    uint32_t m_capacity;
+    uint32_t m_freeSize;
+};
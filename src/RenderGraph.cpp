@@ -0,0 +1,681 @@
+#include "RenderGraph.hpp"
+#include "DeletionQueue.hpp"
+#include "DebugMarker.hpp"
+#include "Utils.hpp"
+#include <algorithm>
+#include <utility>
+
+namespace
+{
+// Writes with any of these read what was there before, so the earlier writers can't be culled
+const VkAccessFlags2 c_readAccess = //
+    VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT | //
+    VK_ACCESS_2_INDEX_READ_BIT | //
+    VK_ACCESS_2_VERTEX_ATTRIBUTE_READ_BIT | //
+    VK_ACCESS_2_UNIFORM_READ_BIT | //
+    VK_ACCESS_2_INPUT_ATTACHMENT_READ_BIT | //
+    VK_ACCESS_2_SHADER_READ_BIT | //
+    VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT | //
+    VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | //
+    VK_ACCESS_2_TRANSFER_READ_BIT | //
+    VK_ACCESS_2_HOST_READ_BIT | //
+    VK_ACCESS_2_MEMORY_READ_BIT;
+
+VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+bool isSameTransient(const RenderGraph::ImageDesc& a, const RenderGraph::ImageDesc& b)
+{
+    return a.format == b.format && a.extent.width == b.extent.width && a.extent.height == b.extent.height && a.usage == b.usage && a.aspect == b.aspect;
+}
+
+bool isSameTransient(const RenderGraph::BufferDesc& a, const RenderGraph::BufferDesc& b)
+{
+    return a.size == b.size && a.usage == b.usage;
+}
+
+// The original barrier API has no empty stage mask
+VkPipelineStageFlags getLegacyStages(VkPipelineStageFlags2 stages, VkPipelineStageFlags emptyStage)
+{
+    return stages == VK_PIPELINE_STAGE_2_NONE ? emptyStage : static_cast<VkPipelineStageFlags>(stages);
+}
+} // namespace
+
+RenderGraph::RenderGraph(Context& context) :
+    m_context(context),
+    m_device(context.getDevice()),
+    m_memoryAllocator(context.getMemoryAllocator()),
+    m_synchronization2(context.isSynchronization2Enabled())
+{
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(context.getPhysicalDevice(), &properties);
+    m_bufferImageGranularity = properties.limits.bufferImageGranularity;
+}
+
+RenderGraph::~RenderGraph()
+{
+    // The owner waits for the submitted frames first
+    for (const Transient& transient : m_transients)
+    {
+        vkDestroyImageView(m_device, transient.imageView, nullptr);
+        vkDestroyImage(m_device, transient.image, nullptr);
+        vkDestroyBuffer(m_device, transient.buffer, nullptr);
+    }
+    for (MemoryAllocation& memory : m_memoryBlocks)
+    {
+        m_memoryAllocator.release(memory);
+    }
+}
+
+void RenderGraph::reset()
+{
+    m_resources.clear();
+    m_passes.clear();
+    m_stats = {};
+}
+
+RenderGraph::Resource RenderGraph::importImage(const char* name, VkImage image, const VkImageSubresourceRange& range, const Access& initialAccess)
+{
+    ResourceNode resource{};
+    resource.name = name;
+    resource.isImage = true;
+    resource.imported = true;
+    resource.range = range;
+    resource.image = image;
+    resource.initialAccess = initialAccess;
+    m_resources.push_back(resource);
+    return ui32Size(m_resources) - 1;
+}
+
+RenderGraph::Resource RenderGraph::importBuffer(const char* name, VkBuffer buffer, const Access& initialAccess)
+{
+    ResourceNode resource{};
+    resource.name = name;
+    resource.isImage = false;
+    resource.imported = true;
+    resource.buffer = buffer;
+    resource.initialAccess = initialAccess;
+    m_resources.push_back(resource);
+    return ui32Size(m_resources) - 1;
+}
+
+RenderGraph::Resource RenderGraph::createImage(const ImageDesc& desc)
+{
+    ResourceNode resource{};
+    resource.name = desc.name;
+    resource.isImage = true;
+    resource.imported = false;
+    resource.imageDesc = desc;
+    resource.range = {desc.aspect, 0, 1, 0, 1};
+    m_resources.push_back(resource);
+    return ui32Size(m_resources) - 1;
+}
+
+RenderGraph::Resource RenderGraph::createBuffer(const BufferDesc& desc)
+{
+    ResourceNode resource{};
+    resource.name = desc.name;
+    resource.isImage = false;
+    resource.imported = false;
+    resource.bufferDesc = desc;
+    m_resources.push_back(resource);
+    return ui32Size(m_resources) - 1;
+}
+
+void RenderGraph::setOutput(Resource resource, const Access& finalAccess)
+{
+    m_resources[resource].output = true;
+    m_resources[resource].finalAccess = finalAccess;
+}
+
+RenderGraph::Pass RenderGraph::addPass(const char* name, std::function<void(VkCommandBuffer)> record)
+{
+    PassNode pass{};
+    pass.name = name;
+    pass.record = std::move(record);
+    m_passes.push_back(std::move(pass));
+    return ui32Size(m_passes) - 1;
+}
+
+void RenderGraph::read(Pass pass, Resource resource, const Access& access)
+{
+    m_passes[pass].accesses.push_back({resource, access, false});
+}
+
+void RenderGraph::write(Pass pass, Resource resource, const Access& access)
+{
+    m_passes[pass].accesses.push_back({resource, access, true});
+}
+
+void RenderGraph::execute(VkCommandBuffer cb)
+{
+    m_stats.passCount = ui32Size(m_passes);
+    cullPasses();
+
+    for (uint32_t passIndex = 0; passIndex < m_passes.size(); ++passIndex)
+    {
+        if (m_passes[passIndex].culled)
+        {
+            continue;
+        }
+        for (const ResourceAccess& access : m_passes[passIndex].accesses)
+        {
+            ResourceNode& resource = m_resources[access.resource];
+            resource.firstPass = std::min(resource.firstPass, passIndex);
+            resource.lastPass = std::max(resource.lastPass, passIndex);
+        }
+    }
+    allocateTransients();
+
+    // Created resources may alias the memory of resources used earlier in this frame or in the previous one, their
+    // first access waits for every access to created resources
+    Access transientAccess;
+    for (const PassNode& pass : m_passes)
+    {
+        for (const ResourceAccess& access : pass.accesses)
+        {
+            if (!pass.culled && !m_resources[access.resource].imported)
+            {
+                transientAccess.stages |= access.access.stages;
+                transientAccess.access |= access.write ? access.access.access & ~c_readAccess : VK_ACCESS_2_NONE;
+            }
+        }
+    }
+
+    std::vector<ResourceState> states(m_resources.size());
+    for (size_t i = 0; i < m_resources.size(); ++i)
+    {
+        const ResourceNode& resource = m_resources[i];
+        states[i].lastWrite = resource.imported ? resource.initialAccess : transientAccess;
+        states[i].layout = resource.imported ? resource.initialAccess.layout : VK_IMAGE_LAYOUT_UNDEFINED;
+    }
+
+    for (const PassNode& pass : m_passes)
+    {
+        if (pass.culled)
+        {
+            continue;
+        }
+
+        DebugMarker::beginLabel(cb, pass.name);
+        for (const ResourceAccess& access : pass.accesses)
+        {
+            addBarrier(m_resources[access.resource], states[access.resource], access.access, access.write);
+        }
+        flushBarriers(cb);
+        pass.record(cb);
+        DebugMarker::endLabel(cb);
+    }
+
+    for (size_t i = 0; i < m_resources.size(); ++i)
+    {
+        const ResourceNode& resource = m_resources[i];
+        if (!resource.output || resource.firstPass == UINT32_MAX)
+        {
+            continue;
+        }
+        Access finalAccess = resource.finalAccess;
+        if (finalAccess.layout == VK_IMAGE_LAYOUT_UNDEFINED)
+        {
+            finalAccess.layout = states[i].layout;
+        }
+        if (finalAccess.stages != VK_PIPELINE_STAGE_2_NONE || (resource.isImage && finalAccess.layout != states[i].layout))
+        {
+            addBarrier(resource, states[i], finalAccess, false);
+        }
+    }
+    flushBarriers(cb);
+}
+
+VkImage RenderGraph::getImage(Resource resource) const
+{
+    return m_resources[resource].image;
+}
+
+VkImageView RenderGraph::getImageView(Resource resource) const
+{
+    return m_resources[resource].imageView;
+}
+
+VkBuffer RenderGraph::getBuffer(Resource resource) const
+{
+    return m_resources[resource].buffer;
+}
+
+const RenderGraph::Stats& RenderGraph::getStats() const
+{
+    return m_stats;
+}
+
+std::vector<RenderGraph::TransientInfo> RenderGraph::getTransients() const
+{
+    std::vector<TransientInfo> transients;
+    for (const Transient& transient : m_transients)
+    {
+        const char* name = transient.isImage ? transient.imageDesc.name : transient.bufferDesc.name;
+        transients.push_back({name, transient.block, transient.offset, transient.size, transient.firstPass, transient.lastPass});
+    }
+    return transients;
+}
+
+// Walks the passes backwards with the set of resources whose contents a later pass or the frame still needs. A
+// pass is kept when it writes one of them. Whole writes satisfy the need, reads and partial writes pass it on to
+// the earlier writers.
+void RenderGraph::cullPasses()
+{
+    std::vector<bool> needed(m_resources.size());
+    for (size_t i = 0; i < m_resources.size(); ++i)
+    {
+        needed[i] = m_resources[i].output;
+    }
+
+    for (size_t i = m_passes.size(); i-- > 0;)
+    {
+        PassNode& pass = m_passes[i];
+        pass.culled = std::none_of(pass.accesses.begin(), pass.accesses.end(), [&needed](const ResourceAccess& access) {
+            return access.write && needed[access.resource];
+        });
+        if (pass.culled)
+        {
+            ++m_stats.culledPassCount;
+            continue;
+        }
+
+        for (const ResourceAccess& access : pass.accesses)
+        {
+            if (access.write && (access.access.access & c_readAccess) == 0)
+            {
+                needed[access.resource] = false;
+            }
+        }
+        for (const ResourceAccess& access : pass.accesses)
+        {
+            if (!access.write || (access.access.access & c_readAccess) != 0)
+            {
+                needed[access.resource] = true;
+            }
+        }
+    }
+}
+
+// The objects and their placement are kept while the created resources and their lifetimes stay the same,
+// otherwise everything is made again and the old objects go to the deletion queue
+void RenderGraph::allocateTransients()
+{
+    std::vector<Transient> transients;
+    for (Resource i = 0; i < m_resources.size(); ++i)
+    {
+        const ResourceNode& resource = m_resources[i];
+        if (resource.imported || resource.firstPass == UINT32_MAX)
+        {
+            continue;
+        }
+        Transient transient{};
+        transient.resource = i;
+        transient.isImage = resource.isImage;
+        transient.imageDesc = resource.imageDesc;
+        transient.bufferDesc = resource.bufferDesc;
+        transient.firstPass = resource.firstPass;
+        transient.lastPass = resource.lastPass;
+        transients.push_back(transient);
+    }
+
+    const bool same = std::equal(transients.begin(), transients.end(), m_transients.begin(), m_transients.end(), [](const Transient& a, const Transient& b) {
+        return a.isImage == b.isImage && a.firstPass == b.firstPass && a.lastPass == b.lastPass &&
+               (a.isImage ? isSameTransient(a.imageDesc, b.imageDesc) : isSameTransient(a.bufferDesc, b.bufferDesc));
+    });
+    if (!same)
+    {
+        destroyTransients();
+        m_transients = std::move(transients);
+        createTransients();
+    }
+
+    for (Transient& transient : m_transients)
+    {
+        ResourceNode& resource = m_resources[transient.resource];
+        resource.image = transient.image;
+        resource.imageView = transient.imageView;
+        resource.buffer = transient.buffer;
+        m_stats.transientResourceSize += transient.size;
+    }
+    m_stats.transientResourceCount = ui32Size(m_transients);
+    for (const MemoryAllocation& memory : m_memoryBlocks)
+    {
+        m_stats.transientBlockCount += memory.memory != VK_NULL_HANDLE ? 1 : 0;
+        m_stats.transientMemorySize += memory.size;
+    }
+}
+
+void RenderGraph::destroyTransients()
+{
+    DeletionQueue& deletionQueue = m_context.getDeletionQueue();
+    for (const Transient& transient : m_transients)
+    {
+        if (transient.isImage)
+        {
+            deletionQueue.destroyImageView(transient.imageView);
+            deletionQueue.destroyImage(transient.image);
+        }
+        else
+        {
+            deletionQueue.destroyBuffer(transient.buffer);
+        }
+    }
+    m_transients.clear();
+    for (MemoryAllocation& memory : m_memoryBlocks)
+    {
+        if (memory.memory != VK_NULL_HANDLE)
+        {
+            deletionQueue.releaseMemory(memory);
+        }
+        memory = {};
+    }
+}
+
+// Images and buffers share a block when a memory type suits all of them, so that an image and a buffer whose
+// passes don't overlap can take the same memory
+void RenderGraph::createTransients()
+{
+    std::vector<VkMemoryRequirements> requirements(m_transients.size());
+    for (size_t i = 0; i < m_transients.size(); ++i)
+    {
+        Transient& transient = m_transients[i];
+        if (transient.isImage)
+        {
+            VkImageCreateInfo imageInfo{};
+            imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+            imageInfo.imageType = VK_IMAGE_TYPE_2D;
+            imageInfo.format = transient.imageDesc.format;
+            imageInfo.extent = {transient.imageDesc.extent.width, transient.imageDesc.extent.height, 1};
+            imageInfo.mipLevels = 1;
+            imageInfo.arrayLayers = 1;
+            imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+            imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+            imageInfo.usage = transient.imageDesc.usage;
+            imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+            imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+            VK_CHECK(vkCreateImage(m_device, &imageInfo, nullptr, &transient.image));
+            DebugMarker::setObjectName(VK_OBJECT_TYPE_IMAGE, (uint64_t)transient.image, transient.imageDesc.name);
+            vkGetImageMemoryRequirements(m_device, transient.image, &requirements[i]);
+        }
+        else
+        {
+            VkBufferCreateInfo bufferInfo{};
+            bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+            bufferInfo.size = transient.bufferDesc.size;
+            bufferInfo.usage = transient.bufferDesc.usage;
+            bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+            VK_CHECK(vkCreateBuffer(m_device, &bufferInfo, nullptr, &transient.buffer));
+            DebugMarker::setObjectName(VK_OBJECT_TYPE_BUFFER, (uint64_t)transient.buffer, transient.bufferDesc.name);
+            vkGetBufferMemoryRequirements(m_device, transient.buffer, &requirements[i]);
+        }
+        transient.size = requirements[i].size;
+    }
+
+    uint32_t imageTypeBits = UINT32_MAX;
+    uint32_t bufferTypeBits = UINT32_MAX;
+    bool hasImages = false;
+    bool hasBuffers = false;
+    for (size_t i = 0; i < m_transients.size(); ++i)
+    {
+        if (m_transients[i].isImage)
+        {
+            imageTypeBits &= requirements[i].memoryTypeBits;
+            hasImages = true;
+        }
+        else
+        {
+            bufferTypeBits &= requirements[i].memoryTypeBits;
+            hasBuffers = true;
+        }
+    }
+    const bool shared = (imageTypeBits & bufferTypeBits) != 0;
+    for (size_t i = 0; i < m_transients.size(); ++i)
+    {
+        m_transients[i].block = m_transients[i].isImage || shared ? 0 : 1;
+        // Buffers and optimal images that are neighbors in memory must be bufferImageGranularity apart
+        if (shared && hasImages && hasBuffers)
+        {
+            requirements[i].alignment = std::max(requirements[i].alignment, m_bufferImageGranularity);
+            requirements[i].size = alignUp(requirements[i].size, m_bufferImageGranularity);
+        }
+    }
+
+    for (uint32_t block = 0; block < m_memoryBlocks.size(); ++block)
+    {
+        VkMemoryRequirements blockRequirements{placeTransients(block, requirements), 1, UINT32_MAX};
+        if (blockRequirements.size == 0)
+        {
+            continue;
+        }
+        bool blockHasImages = false;
+        for (size_t i = 0; i < m_transients.size(); ++i)
+        {
+            if (m_transients[i].block == block)
+            {
+                blockRequirements.alignment = std::max(blockRequirements.alignment, requirements[i].alignment);
+                blockRequirements.memoryTypeBits &= requirements[i].memoryTypeBits;
+                blockHasImages = blockHasImages || m_transients[i].isImage;
+            }
+        }
+        CHECK(blockRequirements.memoryTypeBits != 0);
+        const MemoryCategory category = blockHasImages ? MemoryCategory::RenderTargets : MemoryCategory::Storage;
+        m_memoryBlocks[block] = m_memoryAllocator.allocate(blockRequirements, MemoryUsage::GpuOnly, category);
+    }
+
+    for (Transient& transient : m_transients)
+    {
+        const VkDeviceMemory memory = m_memoryBlocks[transient.block].memory;
+        if (!transient.isImage)
+        {
+            VK_CHECK(vkBindBufferMemory(m_device, transient.buffer, memory, transient.offset));
+            continue;
+        }
+
+        VK_CHECK(vkBindImageMemory(m_device, transient.image, memory, transient.offset));
+
+        VkImageViewCreateInfo viewInfo{};
+        viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        viewInfo.image = transient.image;
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.format = transient.imageDesc.format;
+        viewInfo.subresourceRange = {transient.imageDesc.aspect, 0, 1, 0, 1};
+        VK_CHECK(vkCreateImageView(m_device, &viewInfo, nullptr, &transient.imageView));
+    }
+}
+
+// Largest first, every resource goes to the lowest offset where it overlaps none of the placed resources that are
+// alive at the same time. Returns the size of the memory block.
+VkDeviceSize RenderGraph::placeTransients(uint32_t block, const std::vector<VkMemoryRequirements>& requirements)
+{
+    std::vector<uint32_t> order;
+    for (uint32_t i = 0; i < m_transients.size(); ++i)
+    {
+        if (m_transients[i].block == block)
+        {
+            order.push_back(i);
+        }
+    }
+    std::stable_sort(order.begin(), order.end(), [&requirements](uint32_t a, uint32_t b) {
+        return requirements[a].size > requirements[b].size;
+    });
+
+    VkDeviceSize blockSize = 0;
+    for (size_t i = 0; i < order.size(); ++i)
+    {
+        Transient& transient = m_transients[order[i]];
+        const VkMemoryRequirements& requirement = requirements[order[i]];
+
+        std::vector<std::pair<VkDeviceSize, VkDeviceSize>> taken;
+        for (size_t j = 0; j < i; ++j)
+        {
+            const Transient& placed = m_transients[order[j]];
+            if (placed.firstPass <= transient.lastPass && transient.firstPass <= placed.lastPass)
+            {
+                taken.emplace_back(placed.offset, placed.offset + requirements[order[j]].size);
+            }
+        }
+        std::sort(taken.begin(), taken.end());
+
+        VkDeviceSize offset = 0;
+        for (const auto& [begin, end] : taken)
+        {
+            offset = alignUp(offset, requirement.alignment);
+            if (offset + requirement.size <= begin)
+            {
+                break;
+            }
+            offset = std::max(offset, end);
+        }
+        transient.offset = alignUp(offset, requirement.alignment);
+        blockSize = std::max(blockSize, transient.offset + requirement.size);
+    }
+    return blockSize;
+}
+
+// Writes and layout transitions wait for the last write and every read since, which only need an execution
+// dependency. Reads wait for the last write unless an earlier barrier already made it visible to them.
+void RenderGraph::addBarrier(const ResourceNode& resource, ResourceState& state, const Access& access, bool write)
+{
+    const bool transition = resource.isImage && state.layout != access.layout;
+    VkPipelineStageFlags2 srcStages = state.lastWrite.stages;
+    const VkAccessFlags2 srcAccess = state.lastWrite.access;
+    bool needed;
+    if (write || transition)
+    {
+        srcStages |= state.readStages;
+        needed = transition || srcStages != VK_PIPELINE_STAGE_2_NONE;
+        state.lastWrite = {access.stages, write ? access.access : VK_ACCESS_2_NONE, access.layout};
+        state.readStages = write ? VK_PIPELINE_STAGE_2_NONE : access.stages;
+        state.readAccess = write ? VK_ACCESS_2_NONE : access.access;
+    }
+    else
+    {
+        const bool covered = (access.stages & ~state.readStages) == 0 && (access.access & ~state.readAccess) == 0;
+        needed = !covered && srcStages != VK_PIPELINE_STAGE_2_NONE;
+        state.readStages |= access.stages;
+        state.readAccess |= access.access;
+    }
+
+    if (!needed)
+    {
+        return;
+    }
+
+    if (resource.isImage)
+    {
+        VkImageMemoryBarrier2 barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+        barrier.srcStageMask = srcStages;
+        barrier.srcAccessMask = srcAccess;
+        barrier.dstStageMask = access.stages;
+        barrier.dstAccessMask = access.access;
+        barrier.oldLayout = state.layout;
+        barrier.newLayout = access.layout;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = resource.image;
+        barrier.subresourceRange = resource.range;
+        m_imageBarriers.push_back(barrier);
+        state.layout = access.layout;
+    }
+    else
+    {
+        VkBufferMemoryBarrier2 barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2;
+        barrier.srcStageMask = srcStages;
+        barrier.srcAccessMask = srcAccess;
+        barrier.dstStageMask = access.stages;
+        barrier.dstAccessMask = access.access;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.buffer = resource.buffer;
+        barrier.offset = 0;
+        barrier.size = VK_WHOLE_SIZE;
+        m_bufferBarriers.push_back(barrier);
+    }
+}
+
+// One call for all barriers in front of a pass. Without synchronization2 the stages of the batch are merged, which
+// only widens the dependencies.
+void RenderGraph::flushBarriers(VkCommandBuffer cb)
+{
+    if (m_imageBarriers.empty() && m_bufferBarriers.empty())
+    {
+        return;
+    }
+
+    ++m_stats.barrierBatchCount;
+    m_stats.imageBarrierCount += ui32Size(m_imageBarriers);
+    m_stats.bufferBarrierCount += ui32Size(m_bufferBarriers);
+
+    if (m_synchronization2)
+    {
+        VkDependencyInfo dependencyInfo{};
+        dependencyInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+        dependencyInfo.bufferMemoryBarrierCount = ui32Size(m_bufferBarriers);
+        dependencyInfo.pBufferMemoryBarriers = m_bufferBarriers.data();
+        dependencyInfo.imageMemoryBarrierCount = ui32Size(m_imageBarriers);
+        dependencyInfo.pImageMemoryBarriers = m_imageBarriers.data();
+        vkCmdPipelineBarrier2(cb, &dependencyInfo);
+    }
+    else
+    {
+        VkPipelineStageFlags2 srcStages = VK_PIPELINE_STAGE_2_NONE;
+        VkPipelineStageFlags2 dstStages = VK_PIPELINE_STAGE_2_NONE;
+
+        std::vector<VkImageMemoryBarrier> imageBarriers;
+        for (const VkImageMemoryBarrier2& barrier2 : m_imageBarriers)
+        {
+            VkImageMemoryBarrier barrier{};
+            barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            barrier.srcAccessMask = static_cast<VkAccessFlags>(barrier2.srcAccessMask);
+            barrier.dstAccessMask = static_cast<VkAccessFlags>(barrier2.dstAccessMask);
+            barrier.oldLayout = barrier2.oldLayout;
+            barrier.newLayout = barrier2.newLayout;
+            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.image = barrier2.image;
+            barrier.subresourceRange = barrier2.subresourceRange;
+            imageBarriers.push_back(barrier);
+            srcStages |= barrier2.srcStageMask;
+            dstStages |= barrier2.dstStageMask;
+        }
+
+        std::vector<VkBufferMemoryBarrier> bufferBarriers;
+        for (const VkBufferMemoryBarrier2& barrier2 : m_bufferBarriers)
+        {
+            VkBufferMemoryBarrier barrier{};
+            barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+            barrier.srcAccessMask = static_cast<VkAccessFlags>(barrier2.srcAccessMask);
+            barrier.dstAccessMask = static_cast<VkAccessFlags>(barrier2.dstAccessMask);
+            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.buffer = barrier2.buffer;
+            barrier.offset = barrier2.offset;
+            barrier.size = barrier2.size;
+            bufferBarriers.push_back(barrier);
+            srcStages |= barrier2.srcStageMask;
+            dstStages |= barrier2.dstStageMask;
+        }
+
+        vkCmdPipelineBarrier(cb,
+                             getLegacyStages(srcStages, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT),
+                             getLegacyStages(dstStages, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT),
+                             0,
+                             0,
+                             nullptr,
+                             ui32Size(bufferBarriers),
+                             bufferBarriers.data(),
+                             ui32Size(imageBarriers),
+                             imageBarriers.data());
+    }
+
+    m_imageBarriers.clear();
+    m_bufferBarriers.clear();
+}
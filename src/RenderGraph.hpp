@@ -0,0 +1,185 @@
+#pragma once
+
+#include "Context.hpp"
+#include "MemoryAllocator.hpp"
+#include <functional>
+#include <array>
+#include <vector>
+#include <cstdint>
+
+// Passes of a frame declare how they access images and buffers and run in the order they were added. The graph
+// derives the barriers in front of every pass from the accesses and batches them into one call, drops passes whose
+// writes nobody reads and places the resources it creates in shared memory where resources whose lifetimes don't
+// overlap alias each other. It is built anew every frame, created resources keep their memory while the frame's
+// resources stay the same.
+class RenderGraph final
+{
+public:
+    using Resource = uint32_t;
+    using Pass = uint32_t;
+
+    // Only the stages and accesses of the original barrier API are used so that barriers work without
+    // synchronization2 too. The layout is ignored for buffers.
+    struct Access
+    {
+        VkPipelineStageFlags2 stages = VK_PIPELINE_STAGE_2_NONE;
+        VkAccessFlags2 access = VK_ACCESS_2_NONE;
+        VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+    };
+
+    // 2D images with one mip level
+    struct ImageDesc
+    {
+        const char* name;
+        VkFormat format;
+        VkExtent2D extent;
+        VkImageUsageFlags usage;
+        VkImageAspectFlags aspect;
+    };
+
+    struct BufferDesc
+    {
+        const char* name;
+        VkDeviceSize size;
+        VkBufferUsageFlags usage;
+    };
+
+    struct Stats
+    {
+        uint32_t passCount = 0;
+        uint32_t culledPassCount = 0;
+        uint32_t barrierBatchCount = 0;
+        uint32_t imageBarrierCount = 0;
+        uint32_t bufferBarrierCount = 0;
+        uint32_t transientResourceCount = 0;
+        uint32_t transientBlockCount = 0;
+        VkDeviceSize transientMemorySize = 0;
+        // What the created resources would take without aliasing
+        VkDeviceSize transientResourceSize = 0;
+    };
+
+    // Where a created resource of the last frame lives, resources of the same block whose passes don't overlap may
+    // share their memory
+    struct TransientInfo
+    {
+        const char* name;
+        uint32_t block;
+        VkDeviceSize offset;
+        VkDeviceSize size;
+        uint32_t firstPass;
+        uint32_t lastPass;
+    };
+
+    RenderGraph(Context& context);
+    ~RenderGraph();
+
+    // Forgets the passes and resources of the previous frame
+    void reset();
+    // initialAccess is the last access before the graph, its stages are waited for before the first access
+    Resource importImage(const char* name, VkImage image, const VkImageSubresourceRange& range, const Access& initialAccess);
+    Resource importBuffer(const char* name, VkBuffer buffer, const Access& initialAccess);
+    // Contents are undefined at the first access, the objects exist from execute until the next reset
+    Resource createImage(const ImageDesc& desc);
+    Resource createBuffer(const BufferDesc& desc);
+    // The resource is used after the graph so the passes that write it are kept, it ends in finalAccess. An
+    // undefined layout keeps the last one.
+    void setOutput(Resource resource, const Access& finalAccess);
+
+    Pass addPass(const char* name, std::function<void(VkCommandBuffer)> record);
+    void read(Pass pass, Resource resource, const Access& access);
+    // Writes whose access includes reads keep the earlier writers of the resource too
+    void write(Pass pass, Resource resource, const Access& access);
+
+    // Culls passes, places the created resources and records the remaining passes with their barriers
+    void execute(VkCommandBuffer cb);
+
+    VkImage getImage(Resource resource) const;
+    // Only for created images
+    VkImageView getImageView(Resource resource) const;
+    VkBuffer getBuffer(Resource resource) const;
+    const Stats& getStats() const;
+    std::vector<TransientInfo> getTransients() const;
+
+private:
+    struct ResourceNode
+    {
+        const char* name;
+        bool isImage;
+        bool imported;
+        ImageDesc imageDesc;
+        BufferDesc bufferDesc;
+        VkImageSubresourceRange range;
+        VkImage image = VK_NULL_HANDLE;
+        VkImageView imageView = VK_NULL_HANDLE;
+        VkBuffer buffer = VK_NULL_HANDLE;
+        Access initialAccess;
+        bool output = false;
+        Access finalAccess;
+        // Kept passes that use the resource, set by execute
+        uint32_t firstPass = UINT32_MAX;
+        uint32_t lastPass = 0;
+    };
+
+    struct ResourceAccess
+    {
+        Resource resource;
+        Access access;
+        bool write;
+    };
+
+    struct PassNode
+    {
+        const char* name;
+        std::function<void(VkCommandBuffer)> record;
+        std::vector<ResourceAccess> accesses;
+        bool culled = false;
+    };
+
+    // Access tracking of a resource during execute
+    struct ResourceState
+    {
+        Access lastWrite;
+        VkPipelineStageFlags2 readStages = VK_PIPELINE_STAGE_2_NONE;
+        VkAccessFlags2 readAccess = VK_ACCESS_2_NONE;
+        VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+    };
+
+    // Created resources in the placement of the frame they were made for
+    struct Transient
+    {
+        Resource resource;
+        bool isImage;
+        ImageDesc imageDesc;
+        BufferDesc bufferDesc;
+        uint32_t firstPass;
+        uint32_t lastPass;
+        uint32_t block = 0;
+        VkDeviceSize size = 0;
+        VkDeviceSize offset = 0;
+        VkImage image = VK_NULL_HANDLE;
+        VkImageView imageView = VK_NULL_HANDLE;
+        VkBuffer buffer = VK_NULL_HANDLE;
+    };
+
+    void cullPasses();
+    void allocateTransients();
+    void destroyTransients();
+    void createTransients();
+    VkDeviceSize placeTransients(uint32_t block, const std::vector<VkMemoryRequirements>& requirements);
+    void addBarrier(const ResourceNode& resource, ResourceState& state, const Access& access, bool write);
+    void flushBarriers(VkCommandBuffer cb);
+
+    Context& m_context;
+    VkDevice m_device;
+    MemoryAllocator& m_memoryAllocator;
+    bool m_synchronization2;
+    VkDeviceSize m_bufferImageGranularity;
+    std::vector<ResourceNode> m_resources;
+    std::vector<PassNode> m_passes;
+    std::vector<Transient> m_transients;
+    // Everything goes to the first block, buffers only get the second when no memory type suits images and buffers
+    std::array<MemoryAllocation, 2> m_memoryBlocks;
+    std::vector<VkImageMemoryBarrier2> m_imageBarriers;
+    std::vector<VkBufferMemoryBarrier2> m_bufferBarriers;
+    Stats m_stats;
+};
@@ -0,0 +1,152 @@
+#include "RenderQueue.hpp"
+#include "JobSystem.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+const uint32_t c_pipelineBits = 4;
+const uint32_t c_materialBits = 20;
+const uint32_t c_depthBits = 16;
+const uint32_t c_meshBits = 24;
+const uint32_t c_depthShift = c_meshBits;
+const uint32_t c_materialShift = c_depthShift + c_depthBits;
+const uint32_t c_pipelineShift = c_materialShift + c_materialBits;
+static_assert(c_pipelineShift + c_pipelineBits == 64, "Key fields must fill 64 bits");
+
+const uint32_t c_digitBits = 8;
+const uint32_t c_passCount = 64 / c_digitBits;
+// Smaller chunks spend more time on their histograms than they save by running in parallel
+const size_t c_minChunkSize = 16 * 1024;
+
+uint64_t getMask(uint32_t bits)
+{
+    return (uint64_t(1) << bits) - 1;
+}
+
+uint32_t getDigit(uint64_t key, uint32_t pass)
+{
+    return static_cast<uint32_t>((key >> (pass * c_digitBits)) & getMask(c_digitBits));
+}
+} // namespace
+
+RenderQueue::BindCounts& RenderQueue::BindCounts::operator+=(const BindCounts& other)
+{
+    pipelineBinds += other.pipelineBinds;
+    descriptorSetBinds += other.descriptorSetBinds;
+    vertexBufferBinds += other.vertexBufferBinds;
+    draws += other.draws;
+    return *this;
+}
+
+uint64_t RenderQueue::makeKey(uint32_t pipeline, uint32_t material, uint32_t depthBucket, uint32_t mesh)
+{
+    return ((pipeline & getMask(c_pipelineBits)) << c_pipelineShift) | ((material & getMask(c_materialBits)) << c_materialShift) |
+           ((depthBucket & getMask(c_depthBits)) << c_depthShift) | (mesh & getMask(c_meshBits));
+}
+
+uint32_t RenderQueue::getPipeline(uint64_t key)
+{
+    return static_cast<uint32_t>(key >> c_pipelineShift);
+}
+
+uint32_t RenderQueue::getMaterial(uint64_t key)
+{
+    return static_cast<uint32_t>((key >> c_materialShift) & getMask(c_materialBits));
+}
+
+uint32_t RenderQueue::getDepthBucket(float depth, float nearDistance, float farDistance)
+{
+    const float t = std::log(std::max(depth, nearDistance) / nearDistance) / std::log(farDistance / nearDistance);
+    return static_cast<uint32_t>(std::clamp(t, 0.0f, 1.0f) * static_cast<float>(getMask(c_depthBits)));
+}
+
+RenderQueue::RenderQueue(JobSystem& jobSystem) :
+    m_jobSystem(jobSystem)
+{
+}
+
+void RenderQueue::clear()
+{
+    m_items.clear();
+}
+
+void RenderQueue::push(uint64_t key, uint32_t draw)
+{
+    m_items.push_back({key, draw});
+}
+
+void RenderQueue::sort()
+{
+    const size_t count = m_items.size();
+    if (count < 2)
+    {
+        return;
+    }
+
+    const size_t chunkCount = std::clamp<size_t>(count / c_minChunkSize, 1, m_jobSystem.getWorkerCount() + 1);
+    const size_t chunkSize = (count + chunkCount - 1) / chunkCount;
+    m_scratch.resize(count);
+    m_histograms.resize(chunkCount);
+
+    // Bits in which some key differs from the first, digits without any are already sorted
+    uint64_t differentBits = 0;
+    const uint64_t firstKey = m_items[0].key;
+    for (const Item& item : m_items)
+    {
+        differentBits |= item.key ^ firstKey;
+    }
+
+    for (uint32_t pass = 0; pass < c_passCount; ++pass)
+    {
+        if (getDigit(differentBits, pass) == 0)
+        {
+            continue;
+        }
+
+        m_jobSystem.parallelFor(chunkCount, 1, [this, pass, count, chunkSize](size_t begin, size_t end) {
+            for (size_t chunk = begin; chunk < end; ++chunk)
+            {
+                Histogram& histogram = m_histograms[chunk];
+                histogram.fill(0);
+                const size_t last = std::min(count, (chunk + 1) * chunkSize);
+                for (size_t i = chunk * chunkSize; i < last; ++i)
+                {
+                    ++histogram[getDigit(m_items[i].key, pass)];
+                }
+            }
+        });
+
+        // Every chunk writes its items of a digit after those of the chunks before it, which keeps the sort stable
+        uint32_t offset = 0;
+        for (uint32_t digit = 0; digit < 256; ++digit)
+        {
+            for (Histogram& histogram : m_histograms)
+            {
+                const uint32_t digitCount = histogram[digit];
+                histogram[digit] = offset;
+                offset += digitCount;
+            }
+        }
+
+        m_jobSystem.parallelFor(chunkCount, 1, [this, pass, count, chunkSize](size_t begin, size_t end) {
+            for (size_t chunk = begin; chunk < end; ++chunk)
+            {
+                Histogram& offsets = m_histograms[chunk];
+                const size_t last = std::min(count, (chunk + 1) * chunkSize);
+                for (size_t i = chunk * chunkSize; i < last; ++i)
+                {
+                    const Item& item = m_items[i];
+                    m_scratch[offsets[getDigit(item.key, pass)]++] = item;
+                }
+            }
+        });
+
+        m_items.swap(m_scratch);
+    }
+}
+
+const std::vector<RenderQueue::Item>& RenderQueue::getItems() const
+{
+    return m_items;
+}
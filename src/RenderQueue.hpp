@@ -0,0 +1,56 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <cstdint>
+
+class JobSystem;
+
+// Draws of a frame ordered by 64-bit keys so that draws sharing state are recorded next to each other. From the most
+// to the least significant bits a key holds the pipeline, the material, a depth bucket and the mesh, so sorting groups
+// draws by pipeline, then by material and draws every material front to back.
+class RenderQueue final
+{
+public:
+    struct Item
+    {
+        uint64_t key;
+        // Index into the caller's draws
+        uint32_t draw;
+    };
+
+    // Binds recorded for the queue, compared to the draws they amortize over
+    struct BindCounts
+    {
+        uint32_t pipelineBinds = 0;
+        uint32_t descriptorSetBinds = 0;
+        uint32_t vertexBufferBinds = 0;
+        uint32_t draws = 0;
+
+        BindCounts& operator+=(const BindCounts& other);
+    };
+
+    // Fields wider than their bits are truncated
+    static uint64_t makeKey(uint32_t pipeline, uint32_t material, uint32_t depthBucket, uint32_t mesh);
+    static uint32_t getPipeline(uint64_t key);
+    static uint32_t getMaterial(uint64_t key);
+    // View depth in [nearDistance, farDistance] on a logarithmic scale, near draws get finer buckets
+    static uint32_t getDepthBucket(float depth, float nearDistance, float farDistance);
+
+    RenderQueue(JobSystem& jobSystem);
+
+    void clear();
+    void push(uint64_t key, uint32_t draw);
+    // Stable least significant digit radix sort. Every pass builds per-chunk histograms and scatters the chunks in
+    // parallel, passes over digits that all keys share are skipped.
+    void sort();
+    const std::vector<Item>& getItems() const;
+
+private:
+    using Histogram = std::array<uint32_t, 256>;
+
+    JobSystem& m_jobSystem;
+    std::vector<Item> m_items;
+    std::vector<Item> m_scratch;
+    std::vector<Histogram> m_histograms;
+};
@@ -6,205 +6,1060 @@
 #include <glm/glm.hpp>
 #include <GLFW/glfw3.h>
 #include <array>
+#include <algorithm>
+#include <numeric>
+#include <filesystem>
 
 namespace
 {
 const size_t c_uniformBufferSize = sizeof(glm::mat4);
+const VkDeviceSize c_frameAllocatorSize = 1024 * 1024;
+const std::string c_memoryDumpFilename = "memory.json";
+const uint32_t c_maxRecordingRanges = 8;
+const size_t c_minDrawsPerRange = 256;
+const std::string c_modelFilename = "DamagedHelmet.glb";
+const std::vector<std::string> c_shaderFilenames{"shader.vert.spv", "shader.frag.spv", "depth.vert.spv", "workload.comp.spv", "cull.comp.spv", "pyramid.comp.spv"};
 const VkImageSubresourceRange c_defaultSubresourceRance{VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+const VkImageSubresourceRange c_depthSubresourceRange{VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT, 0, 1, 0, 1};
+const VkImageSubresourceRange c_pyramidSubresourceRange{VK_IMAGE_ASPECT_COLOR_BIT, 0, VK_REMAINING_MIP_LEVELS, 0, 1};
+// Blending and the GUI read the color attachment, depth tests read the depth attachment
+const RenderGraph::Access c_colorAttachmentAccess{VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+                                                  VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+                                                  VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+const RenderGraph::Access c_depthAttachmentAccess{VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
+                                                  VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                                                  VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL};
+const uint32_t c_maxBindlessTextures = 4096;
+// The current scene, one that is uploading and ones whose descriptor sets are still waiting in the deletion queue
+const uint32_t c_maxBindlessSets = 4;
+// Pipeline field of the sort keys of scene draws, the only pipeline so far
+const uint32_t c_scenePipeline = 0;
+const std::array<uint32_t, 7> c_instanceCounts{1, 10, 100, 1'000, 10'000, 100'000, 1'000'000};
+// Results come in the order of the bits, fragment shader invocations against the pixel count give the overdraw
+const VkQueryPipelineStatisticFlags c_pipelineStatistics = VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT | VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT;
+
+float toMiB(VkDeviceSize size)
+{
+    return static_cast<float>(static_cast<double>(size) / (1024.0 * 1024.0));
+}
+
+float toKiB(VkDeviceSize size)
+{
+    return static_cast<float>(static_cast<double>(size) / 1024.0);
+}
+
+// Depth is stored only when the depth pyramid is built from it, the next frame clears it anyway
+std::array<AttachmentOps, 2> getSceneAttachmentOps(bool storeDepth)
+{
+    const AttachmentOps colorOps{"Scene", "Swapchain color", VK_ATTACHMENT_LOAD_OP_CLEAR, VK_ATTACHMENT_STORE_OP_STORE};
+    const AttachmentOps depthOps{"Scene", "Depth", VK_ATTACHMENT_LOAD_OP_CLEAR, storeDepth ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE};
+    return {colorOps, depthOps};
+}
+
+uint32_t getBindlessTextureCapacity(VkPhysicalDevice physicalDevice)
+{
+    VkPhysicalDeviceVulkan12Properties properties12{};
+    properties12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_PROPERTIES;
+
+    VkPhysicalDeviceProperties2 properties{};
+    properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    properties.pNext = &properties12;
+    vkGetPhysicalDeviceProperties2(physicalDevice, &properties);
+
+    uint32_t capacity = c_maxBindlessTextures;
+    capacity = std::min(capacity, properties12.maxDescriptorSetUpdateAfterBindSampledImages);
+    capacity = std::min(capacity, properties12.maxPerStageDescriptorUpdateAfterBindSampledImages);
+    return capacity;
+}
 } // namespace
 
-Renderer::Renderer(Context& context) :
+Renderer::Renderer(Context& context, bool dynamicRendering) :
     m_context(context),
     m_device(context.getDevice()),
-    m_lastRenderTime(std::chrono::high_resolution_clock::now())
+    m_memoryAllocator(context.getMemoryAllocator()),
+    m_extent(context.getSwapchainExtent()),
+    m_swapchainGeneration(context.getSwapchainGeneration()),
+    m_lastRenderTime(std::chrono::high_resolution_clock::now()),
+    m_renderQueue(m_jobSystem)
 {
     DebugMarker::initialize(m_context.getInstance(), m_device);
 
-    loadModel();
+    // Render passes and framebuffers are used when the device or the GUI backend can't render without them
+    m_dynamicRendering = dynamicRendering && m_context.isDynamicRenderingEnabled() && GUI::isDynamicRenderingSupported();
+    if (dynamicRendering && !m_dynamicRendering)
+    {
+        LOGW("Dynamic rendering is not supported, using render passes");
+    }
+
+    requestFiles();
+    requestModel(c_modelFilename);
     setupCamera();
+    createGpuCulling();
     createRenderPass();
     createDepthImage();
     createSwapchainImageViews();
     createFramebuffers();
     createSampler();
-    createTextures();
-    createUboDescriptorSetLayouts();
-    createTexturesDescriptorSetLayouts();
+    createFrameDescriptorSetLayout();
+    createBindlessDescriptorSetLayout();
+    createGeometryPool();
+    createInstances();
     createGraphicsPipeline();
     createDescriptorPool();
-    createUboDescriptorSets();
-    createTextureDescriptorSet();
-    createUniformBuffer();
-    updateUboDescriptorSets();
-    updateTexturesDescriptorSet();
-    createVertexAndIndexBuffer();
+    createFrameDescriptorSet();
+    createFrameAllocator();
+    updateFrameDescriptorSet();
     allocateCommandBuffers();
-    releaseModel();
+    createRecordingContexts();
+    createStatisticsQueries();
+    createAsyncCompute();
+    createRenderGraph();
+    updateSceneLoad(true);
+    findModelFiles();
     initializeGUI();
 }
 
 Renderer::~Renderer()
 {
-    vkDeviceWaitIdle(m_device);
+    // The job of a load in flight references it, scenes go to the deletion queue which is flushed while their
+    // descriptor pool still exists
+    if (m_sceneLoad)
+    {
+        m_jobSystem.wait(m_sceneLoad->job);
+        m_sceneLoad.reset();
+    }
+    m_scene.reset();
+
+    // Waits for the submitted frames rather than the whole device
+    m_context.getDeletionQueue().flush();
 
     m_gui.reset();
+    m_renderGraph.reset();
+    m_gpuCulling.reset();
+    m_instances.reset();
+    m_geometryPool.reset();
+    m_asyncCompute.reset();
 
-    vkDestroyBuffer(m_device, m_attributeBuffer, nullptr);
-    vkFreeMemory(m_device, m_attributeBufferMemory, nullptr);
-    vkDestroyBuffer(m_device, m_uniformBuffer, nullptr);
-    vkFreeMemory(m_device, m_uniformBufferMemory, nullptr);
+    for (const RecordingContext& recordingContext : m_recordingContexts)
+    {
+        vkDestroyCommandPool(m_device, recordingContext.commandPool, nullptr);
+    }
+    for (const RecordingContext& recordingContext : m_guiRecordingContexts)
+    {
+        vkDestroyCommandPool(m_device, recordingContext.commandPool, nullptr);
+    }
+
+    m_frameAllocator.reset();
+    vkDestroyDescriptorPool(m_device, m_bindlessDescriptorPool, nullptr);
     vkDestroyDescriptorPool(m_device, m_descriptorPool, nullptr);
+    for (const StatisticsQuery& query : m_statisticsQueries)
+    {
+        vkDestroyQueryPool(m_device, query.queryPool, nullptr);
+    }
+    vkDestroyPipeline(m_device, m_depthPrePassPipeline, nullptr);
+    vkDestroyPipeline(m_device, m_equalDepthPipeline, nullptr);
     vkDestroyPipeline(m_device, m_graphicsPipeline, nullptr);
     vkDestroyPipelineLayout(m_device, m_pipelineLayout, nullptr);
-    vkDestroyDescriptorSetLayout(m_device, m_texturesDescriptorSetLayout, nullptr);
-    vkDestroyDescriptorSetLayout(m_device, m_uboDescriptorSetLayout, nullptr);
-    vkDestroyImageView(m_device, m_depthImageView, nullptr);
+    vkDestroyDescriptorSetLayout(m_device, m_bindlessDescriptorSetLayout, nullptr);
+    vkDestroyDescriptorSetLayout(m_device, m_frameDescriptorSetLayout, nullptr);
+    vkDestroySampler(m_device, m_sampler, nullptr);
+    destroySwapchainResources();
+    vkDestroyRenderPass(m_device, m_discardDepthRenderPass, nullptr);
+    vkDestroyRenderPass(m_device, m_renderPass, nullptr);
+}
 
-    for (const VkImageView& imageView : m_imageViews)
+bool Renderer::render()
+{
+    // Everything of imageIndex is free to change until the submit, see acquireNextSwapchainImage
+    const uint32_t imageIndex = m_context.acquireNextSwapchainImage();
+    if (m_swapchainGeneration != m_context.getSwapchainGeneration())
     {
-        vkDestroyImageView(m_device, imageView, nullptr);
+        recreateSwapchainResources();
     }
 
-    for (const VkImage& image : m_images)
+    if (!update(imageIndex))
+    {
+        return false;
+    }
+
+    // Submitted before the graphics work so that it can overlap what is still running from the previous frame, its
+    // result is copied back by the next frame
+    m_asyncCompute->submit(imageIndex);
+
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    beginInfo.pInheritanceInfo = nullptr;
+
+    // The primary only holds the passes of the render graph, its memory is kept for the next recording
+    VkCommandBuffer cb = m_commandBuffers[imageIndex];
+    vkResetCommandBuffer(cb, 0);
+    vkBeginCommandBuffer(cb, &beginInfo);
+    m_asyncCompute->beginGraphics(cb, imageIndex);
+
+    buildRenderGraph(imageIndex);
+    m_renderGraph->execute(cb);
+
+    m_asyncCompute->endGraphics(cb, imageIndex);
+    VK_CHECK(vkEndCommandBuffer(cb));
+
+    m_context.submitCommandBuffers({cb}, m_asyncCompute->getGraphicsWaits());
+
+    return true;
+}
+
+void Renderer::requestModel(const std::string& filename)
+{
+    // One model loads at a time, the latest request made meanwhile is loaded next
+    if (m_sceneLoad)
     {
-        vkDestroyImage(m_device, image, nullptr);
+        m_queuedModelFilename = filename;
+        return;
     }
 
-    for (const VkDeviceMemory& imageMemory : m_imageMemories)
+    m_sceneLoad.reset(new SceneLoad());
+    SceneLoad* load = m_sceneLoad.get();
+    load->filename = filename;
+    load->job = m_jobSystem.schedule([this, load]() {
+        const FileReader::Result file = m_fileReader.read(c_modelsFolder + load->filename).get();
+        if (!file.error.empty())
+        {
+            load->error = file.error;
+            return;
+        }
+        std::unique_ptr<Model> model(new Model(load->filename, file.data, m_jobSystem));
+        if (!model->error.empty())
+        {
+            load->error = model->error;
+            return;
+        }
+        load->model = std::move(model);
+    });
+}
+
+bool Renderer::update(uint32_t imageIndex)
+{
+    bool running = m_context.update();
+    if (!running)
     {
-        vkFreeMemory(m_device, imageMemory, nullptr);
+        return false;
     }
 
-    vkDestroySampler(m_device, m_sampler, nullptr);
+    using namespace std::chrono;
+    const double deltaTime = static_cast<double>(duration_cast<nanoseconds>(high_resolution_clock::now() - m_lastRenderTime).count()) / 1'000'000'000.0;
+    m_lastRenderTime = high_resolution_clock::now();
+    m_frameMilliseconds = m_frameMilliseconds * 0.95 + deltaTime * 1000.0 * 0.05;
 
-    for (const VkFramebuffer& framebuffer : m_framebuffers)
+    // Main thread jobs may call GLFW, which is only allowed from the main thread
+    m_jobSystem.runMainThreadJobs();
+
+    updateSceneLoad(false);
+    updateCamera(deltaTime);
+    readSceneStatistics(imageIndex);
+
+    // Built before anything is recorded so that the GUI can be drawn in the scene pass, changes made in the panels
+    // apply to this frame
+    m_gui->beginFrame();
+    drawMemoryPanel();
+    drawRenderingPanel();
+    drawModelPanel();
+    m_gui->endFrame();
+
+    if (m_compactGeometry)
     {
-        vkDestroyFramebuffer(m_device, framebuffer, nullptr);
+        m_geometryPool->compact();
+        m_compactGeometry = false;
     }
 
-    for (const VkImageView& imageView : m_swapchainImageViews)
+    // Draws are recorded with the pool's buffers and offsets
+    if (m_geometryGeneration != m_geometryPool->getGeneration())
     {
-        vkDestroyImageView(m_device, imageView, nullptr);
+        m_geometryGeneration = m_geometryPool->getGeneration();
+        invalidateSceneCommands();
     }
 
-    if (m_depthImage != VK_NULL_HANDLE)
+    if (m_instancesDirty)
     {
-        vkDestroyImage(m_device, m_depthImage, nullptr);
+        updateInstances();
     }
 
-    if (m_depthImageMemory != VK_NULL_HANDLE)
+    // Every pair may be visible
+    const uint32_t pairCount = ui32Size(m_scene->getPrimitives()) * m_instances->getCount();
+    if (m_instances->prepare(imageIndex, std::max(pairCount, 1u)))
     {
-        vkFreeMemory(m_device, m_depthImageMemory, nullptr);
+        m_sceneCommands[imageIndex].dirty = true;
     }
 
-    vkDestroyRenderPass(m_device, m_renderPass, nullptr);
+    if (m_gpuDriven)
+    {
+        if (m_gpuCulling->prepare(imageIndex, *m_scene, *m_instances))
+        {
+            m_sceneCommands[imageIndex].dirty = true;
+        }
+    }
+    else
+    {
+        cullScene(imageIndex);
+        sortDraws();
+    }
+
+    m_frameAllocator->beginFrame(imageIndex);
+    const glm::mat4 viewProjectionMatrix = m_camera.getProjectionMatrix() * m_camera.getViewMatrix();
+    m_viewProjectionOffset = m_frameAllocator->push(viewProjectionMatrix);
+
+    return true;
 }
 
-bool Renderer::render()
+// Passes run in the order they are added, the graph puts the barriers between them and culls the depth pyramid
+// when nothing reads it. Render passes keep their attachments in the attachment layouts.
+void Renderer::buildRenderGraph(uint32_t imageIndex)
 {
-    const uint32_t imageIndex = m_context.acquireNextSwapchainImage();
+    RenderGraph& graph = *m_renderGraph;
+    graph.reset();
+
+    // Acquiring waits for the color output stage. Both attachments are cleared so their old contents are discarded,
+    // the depth image is shared by the frames so the previous one must be done testing against it and building the
+    // pyramid from it.
+    const RenderGraph::Resource color = graph.importImage("Swapchain color",
+                                                          m_context.getSwapchainImages()[imageIndex],
+                                                          c_defaultSubresourceRance,
+                                                          {VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_NONE, VK_IMAGE_LAYOUT_UNDEFINED});
+    // Unless the pyramid is built from it the depth never leaves the scene pass and the graph can give its memory to
+    // resources of other passes. Render passes keep the image, their framebuffers are made for one depth view.
+    const bool depthCreated = m_dynamicRendering && !isDepthStored();
+    const RenderGraph::Resource depth = depthCreated ?
+        graph.createImage({"Depth", c_depthFormat, m_extent, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, c_depthSubresourceRange.aspectMask}) :
+        graph.importImage("Depth",
+                          m_depthImage,
+                          c_depthSubresourceRange,
+                          {VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_NONE, VK_IMAGE_LAYOUT_UNDEFINED});
+    const RenderGraph::Resource drawInstances = graph.importBuffer("Draw instances", m_instances->getDrawInstanceBuffer(imageIndex), {});
+    // Presenting waits for the semaphore of the submission so nothing later in the frame waits for the transition
+    graph.setOutput(color, {VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR});
+
+    RenderGraph::Resource drawCommands = 0;
+    RenderGraph::Resource drawCount = 0;
+    RenderGraph::Resource pyramid = 0;
+    if (m_gpuDriven)
+    {
+        drawCommands = graph.importBuffer("Draw commands", m_gpuCulling->getDrawBuffer(imageIndex), {});
+        drawCount = graph.importBuffer("Draw count", m_gpuCulling->getCountBuffer(imageIndex), {});
+        // Written by the previous frame
+        pyramid = graph.importImage("Depth pyramid",
+                                    m_gpuCulling->getPyramidImage(),
+                                    c_pyramidSubresourceRange,
+                                    {VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL});
+
+        // Compacted commands leave the per-object bins to the cull pass, its memory is free for the rest of the frame
+        RenderGraph::Resource drawBins = drawCommands;
+        if (m_gpuCulling->isDrawCountSupported())
+        {
+            drawBins = graph.createBuffer({"Draw command bins", m_gpuCulling->getBinBufferSize(imageIndex), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT});
+        }
 
-    if (!update(imageIndex))
+        const RenderGraph::Pass cull = graph.addPass("GPU culling", [this, imageIndex, drawBins](VkCommandBuffer cb) {
+            m_gpuCulling->recordCulling(cb, imageIndex, getCullingPlanes(), m_renderGraph->getBuffer(drawBins));
+        });
+        graph.read(cull, pyramid, {VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL});
+        // Cleared first, the instance counts are incremented atomically
+        graph.write(cull,
+                    drawBins,
+                    {VK_PIPELINE_STAGE_2_TRANSFER_BIT | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+                     VK_ACCESS_2_TRANSFER_WRITE_BIT | VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_SHADER_WRITE_BIT});
+        if (drawBins != drawCommands)
+        {
+            graph.write(cull, drawCommands, {VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT});
+        }
+        // Also copied for the statistics
+        graph.write(cull,
+                    drawCount,
+                    {VK_PIPELINE_STAGE_2_TRANSFER_BIT | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+                     VK_ACCESS_2_TRANSFER_READ_BIT | VK_ACCESS_2_TRANSFER_WRITE_BIT | VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_SHADER_WRITE_BIT});
+        graph.write(cull, drawInstances, {VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT});
+    }
+    else
     {
-        return false;
+        const RenderGraph::Pass upload = graph.addPass("Instance upload", [this, imageIndex](VkCommandBuffer cb) {
+            m_instances->recordUpload(cb, imageIndex, m_visibleInstanceCount);
+        });
+        graph.write(upload, drawInstances, {VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT});
     }
 
-    VkCommandBufferBeginInfo beginInfo{};
-    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
-    beginInfo.pInheritanceInfo = nullptr;
+    // Without dynamic rendering the GUI can continue the scene pass so that the attachments are stored only once
+    const bool guiInScenePass = m_guiInScenePass && !m_dynamicRendering;
 
-    VkCommandBuffer cb = m_commandBuffers[imageIndex];
-    vkResetCommandBuffer(cb, VK_COMMAND_BUFFER_RESET_RELEASE_RESOURCES_BIT);
-    vkBeginCommandBuffer(cb, &beginInfo);
+    const RenderGraph::Pass scene = graph.addPass("Scene", [this, imageIndex, guiInScenePass, depthCreated, depth](VkCommandBuffer cb) {
+        if (m_gpuDriven)
+        {
+            m_gpuCulling->recordSceneBegin(cb, imageIndex);
+        }
+
+        // The scene secondaries run the queries, resets aren't allowed inside the pass
+        if (!m_statisticsQueries.empty())
+        {
+            const StatisticsQuery& query = m_statisticsQueries[imageIndex];
+            vkCmdResetQueryPool(cb, query.queryPool, 0, query.capacity);
+        }
+
+        beginScenePass(cb, imageIndex, depthCreated ? m_renderGraph->getImageView(depth) : m_depthImageView, isDepthStored());
+        const std::vector<VkCommandBuffer>& secondaryCommandBuffers = recordScene(imageIndex);
+        vkCmdExecuteCommands(cb, ui32Size(secondaryCommandBuffers), secondaryCommandBuffers.data());
+        if (!m_statisticsQueries.empty())
+        {
+            StatisticsQuery& query = m_statisticsQueries[imageIndex];
+            query.queryCount = ui32Size(secondaryCommandBuffers);
+            query.depthPrePass = m_depthPrePass;
+        }
+        if (guiInScenePass)
+        {
+            const VkCommandBuffer guiCommandBuffer = recordGUI(imageIndex);
+            vkCmdExecuteCommands(cb, 1, &guiCommandBuffer);
+        }
+        endScenePass(cb);
+
+        if (m_gpuDriven)
+        {
+            m_gpuCulling->recordSceneEnd(cb, imageIndex);
+        }
+    });
+    graph.write(scene, color, c_colorAttachmentAccess);
+    graph.write(scene, depth, c_depthAttachmentAccess);
+    graph.read(scene, drawInstances, {VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT});
+
+    if (m_gpuDriven)
+    {
+        graph.read(scene, drawCommands, {VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT, VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT});
+        if (m_gpuCulling->isDrawCountSupported())
+        {
+            graph.read(scene, drawCount, {VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT, VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT});
+        }
+
+        // The GUI doesn't write depth so the pyramid only has the scene, the next frame culls against it
+        const RenderGraph::Pass depthPyramid = graph.addPass("Depth pyramid", [this, imageIndex](VkCommandBuffer cb) {
+            m_gpuCulling->recordDepthPyramid(cb, imageIndex, m_camera.getProjectionMatrix() * m_camera.getViewMatrix());
+        });
+        graph.read(depthPyramid, depth, {VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL});
+        // Each level is reduced from the one before
+        graph.write(depthPyramid, pyramid, {VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL});
+        if (m_gpuCulling->isOcclusionCullingEnabled())
+        {
+            graph.setOutput(pyramid, {});
+        }
+    }
 
+    if (!guiInScenePass)
     {
-        DebugMarker::beginLabel(cb, "Render", DebugMarker::blue);
+        const RenderGraph::Pass gui = graph.addPass("GUI", [this, imageIndex](VkCommandBuffer cb) {
+            if (m_dynamicRendering)
+            {
+                m_gui->recordRendering(cb, m_swapchainImageViews[imageIndex], m_extent);
+            }
+            else
+            {
+                m_gui->recordRenderPass(cb, m_framebuffers[imageIndex], m_extent);
+            }
+        });
+        graph.write(gui, color, c_colorAttachmentAccess);
+        // The render pass has the depth attachment only for compatibility, its ops don't care about the contents
+        if (!m_dynamicRendering)
+        {
+            graph.write(gui, depth, {c_depthAttachmentAccess.stages, VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, c_depthAttachmentAccess.layout});
+        }
+    }
+}
 
-        std::array<VkClearValue, 2> clearValues{};
-        clearValues[0].color = {0.0f, 0.0f, 0.2f, 1.0f};
-        clearValues[1].depthStencil = {1.0f, 0};
+void Renderer::beginScenePass(VkCommandBuffer cb, uint32_t imageIndex, VkImageView depthImageView, bool storeDepth)
+{
+    const std::array<AttachmentOps, 2> attachmentOps = getSceneAttachmentOps(storeDepth);
+    std::array<VkClearValue, 2> clearValues{};
+    clearValues[0].color = {0.0f, 0.0f, 0.2f, 1.0f};
+    clearValues[1].depthStencil = {1.0f, 0};
 
+    if (!m_dynamicRendering)
+    {
         VkRenderPassBeginInfo renderPassInfo{};
         renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-        renderPassInfo.renderPass = m_renderPass;
+        // The passes are compatible so the framebuffers, the pipeline and the recorded secondaries work with either
+        renderPassInfo.renderPass = storeDepth ? m_renderPass : m_discardDepthRenderPass;
         renderPassInfo.framebuffer = m_framebuffers[imageIndex];
         renderPassInfo.renderArea.offset = {0, 0};
-        renderPassInfo.renderArea.extent = c_windowExtent;
+        renderPassInfo.renderArea.extent = m_extent;
         renderPassInfo.clearValueCount = ui32Size(clearValues);
         renderPassInfo.pClearValues = clearValues.data();
 
-        vkCmdBeginRenderPass(cb, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-        vkCmdBindPipeline(cb, VK_PIPELINE_BIND_POINT_GRAPHICS, m_graphicsPipeline);
+        vkCmdBeginRenderPass(cb, &renderPassInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+        return;
+    }
 
-        VkDeviceSize offsets[] = {0};
-        vkCmdBindVertexBuffers(cb, 0, 1, &m_attributeBuffer, offsets);
-        vkCmdBindIndexBuffer(cb, m_attributeBuffer, m_offsetToIndexData, VK_INDEX_TYPE_UINT32);
-        const std::vector<VkDescriptorSet> descriptorSets{m_uboDescriptorSets[imageIndex], m_texturesDescriptorSet};
-        vkCmdBindDescriptorSets(cb, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineLayout, 0, ui32Size(descriptorSets), descriptorSets.data(), 0, nullptr);
-        vkCmdDrawIndexed(cb, m_numIndices, 1, 0, 0, 0);
+    VkRenderingAttachmentInfo colorAttachment{};
+    colorAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+    colorAttachment.imageView = m_swapchainImageViews[imageIndex];
+    colorAttachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    colorAttachment.loadOp = attachmentOps[0].loadOp;
+    colorAttachment.storeOp = attachmentOps[0].storeOp;
+    colorAttachment.clearValue = clearValues[0];
+
+    VkRenderingAttachmentInfo depthAttachment{};
+    depthAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+    depthAttachment.imageView = depthImageView;
+    depthAttachment.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    depthAttachment.loadOp = attachmentOps[1].loadOp;
+    depthAttachment.storeOp = attachmentOps[1].storeOp;
+    depthAttachment.clearValue = clearValues[1];
+
+    VkRenderingInfo renderingInfo{};
+    renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
+    renderingInfo.flags = VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT;
+    renderingInfo.renderArea.offset = {0, 0};
+    renderingInfo.renderArea.extent = m_extent;
+    renderingInfo.layerCount = 1;
+    renderingInfo.colorAttachmentCount = 1;
+    renderingInfo.pColorAttachments = &colorAttachment;
+    renderingInfo.pDepthAttachment = &depthAttachment;
+
+    vkCmdBeginRendering(cb, &renderingInfo);
+}
 
+void Renderer::endScenePass(VkCommandBuffer cb)
+{
+    if (m_dynamicRendering)
+    {
+        vkCmdEndRendering(cb);
+    }
+    else
+    {
         vkCmdEndRenderPass(cb);
+    }
+}
 
-        DebugMarker::endLabel(cb);
+// Continues the scene pass after the scene secondaries, the GUI changes every frame so it is never cached
+VkCommandBuffer Renderer::recordGUI(uint32_t imageIndex)
+{
+    const RecordingContext& recordingContext = m_guiRecordingContexts[imageIndex];
+    VK_CHECK(vkResetCommandPool(m_device, recordingContext.commandPool, 0));
+
+    VkCommandBufferInheritanceInfo inheritanceInfo{};
+    inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+    inheritanceInfo.renderPass = m_renderPass;
+    inheritanceInfo.subpass = 0;
+    inheritanceInfo.framebuffer = m_framebuffers[imageIndex];
+
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    beginInfo.pInheritanceInfo = &inheritanceInfo;
+
+    const VkCommandBuffer cb = recordingContext.commandBuffer;
+    VK_CHECK(vkBeginCommandBuffer(cb, &beginInfo));
+    m_gui->recordDraws(cb);
+    VK_CHECK(vkEndCommandBuffer(cb));
+
+    return cb;
+}
+
+bool Renderer::isDepthStored() const
+{
+    return m_gpuDriven && m_gpuCulling->isOcclusionCullingEnabled();
+}
+
+// Ops of the passes the next frame records
+std::vector<AttachmentOps> Renderer::getAttachmentOps() const
+{
+    const std::array<AttachmentOps, 2> sceneOps = getSceneAttachmentOps(isDepthStored());
+    std::vector<AttachmentOps> attachmentOps(sceneOps.begin(), sceneOps.end());
+    if (!m_guiInScenePass || m_dynamicRendering)
+    {
+        const std::vector<AttachmentOps> guiOps = m_gui->getAttachmentOps();
+        attachmentOps.insert(attachmentOps.end(), guiOps.begin(), guiOps.end());
     }
+    return attachmentOps;
+}
 
+const std::vector<VkCommandBuffer>& Renderer::recordScene(uint32_t imageIndex)
+{
+    // The dynamic offset is baked into the descriptor set bind so a different offset needs a new recording too,
+    // as does a different set of visible draws. GPU-driven recordings don't depend on what is visible.
+    SceneCommands& sceneCommands = m_sceneCommands[imageIndex];
+    const bool drawsChanged = !m_gpuDriven && sceneCommands.draws != m_visibleDraws;
+    if (m_cacheSceneCommands && !sceneCommands.dirty && sceneCommands.viewProjectionOffset == m_viewProjectionOffset && !drawsChanged)
     {
-        DebugMarker::beginLabel(cb, "GUI");
+        m_bindCounts = sceneCommands.bindCounts;
+        return sceneCommands.commandBuffers;
+    }
 
-        m_gui->beginFrame();
-        ImGui::Begin("Hello, world!");
-        ImGui::Text("This is some useful text.");
-        ImGui::End();
-        m_gui->endFrame(cb, m_framebuffers[imageIndex]);
+    std::vector<VkCommandBuffer>& commandBuffers = sceneCommands.commandBuffers;
+    m_bindCounts = RenderQueue::BindCounts();
+    // Depth pre-pass secondaries of every range come first so that the whole scene's depth is there before shading
+    const size_t passCount = m_depthPrePass ? 2 : 1;
+    if (m_gpuDriven)
+    {
+        // One indirect draw covers the whole scene so there is nothing to split
+        const RecordingContext& recordingContext = m_recordingContexts[imageIndex * m_recordingRangeCount];
+        VK_CHECK(vkResetCommandPool(m_device, recordingContext.commandPool, 0));
+        commandBuffers.clear();
+        if (m_depthPrePass)
+        {
+            recordIndirectDraws(recordingContext.depthCommandBuffer, imageIndex, true, 0, m_bindCounts);
+            commandBuffers.push_back(recordingContext.depthCommandBuffer);
+        }
+        recordIndirectDraws(recordingContext.commandBuffer, imageIndex, false, ui32Size(commandBuffers), m_bindCounts);
+        commandBuffers.push_back(recordingContext.commandBuffer);
+    }
+    else
+    {
+        // Small scenes are recorded as one range, splitting them would cost more than the recording
+        const size_t drawCount = m_visibleDraws.size();
+        const size_t maxRanges = (drawCount + c_minDrawsPerRange - 1) / c_minDrawsPerRange;
+        const size_t rangeCount = std::clamp<size_t>(maxRanges, 1, m_recordingRangeCount);
+
+        commandBuffers.resize(rangeCount * passCount);
+        std::vector<RenderQueue::BindCounts> rangeBindCounts(rangeCount);
+        m_jobSystem.parallelFor(rangeCount, 1, [this, imageIndex, rangeCount, passCount, drawCount, &commandBuffers, &rangeBindCounts](size_t begin, size_t end) {
+            for (size_t rangeIndex = begin; rangeIndex < end; ++rangeIndex)
+            {
+                const size_t firstDraw = drawCount * rangeIndex / rangeCount;
+                const size_t lastDraw = drawCount * (rangeIndex + 1) / rangeCount;
+                const RecordingContext& recordingContext = m_recordingContexts[imageIndex * m_recordingRangeCount + rangeIndex];
+                VK_CHECK(vkResetCommandPool(m_device, recordingContext.commandPool, 0));
+                if (m_depthPrePass)
+                {
+                    recordDrawRange(recordingContext.depthCommandBuffer, imageIndex, true, static_cast<uint32_t>(rangeIndex), firstDraw, lastDraw, rangeBindCounts[rangeIndex]);
+                    commandBuffers[rangeIndex] = recordingContext.depthCommandBuffer;
+                }
+                const size_t shadingIndex = (passCount - 1) * rangeCount + rangeIndex;
+                recordDrawRange(recordingContext.commandBuffer, imageIndex, false, static_cast<uint32_t>(shadingIndex), firstDraw, lastDraw, rangeBindCounts[rangeIndex]);
+                commandBuffers[shadingIndex] = recordingContext.commandBuffer;
+            }
+        });
+        for (const RenderQueue::BindCounts& bindCounts : rangeBindCounts)
+        {
+            m_bindCounts += bindCounts;
+        }
+    }
+
+    sceneCommands.viewProjectionOffset = m_viewProjectionOffset;
+    sceneCommands.draws = m_visibleDraws;
+    sceneCommands.bindCounts = m_bindCounts;
+    sceneCommands.dirty = false;
+    ++m_sceneRecordingCount;
+
+    return commandBuffers;
+}
 
-        DebugMarker::endLabel(cb);
+// Materials are bindless and all meshes share the buffers of the geometry pool so only a different pipeline in the key needs a bind
+void Renderer::recordDrawRange(VkCommandBuffer cb, uint32_t imageIndex, bool depthOnly, uint32_t query, size_t firstDraw, size_t lastDraw, RenderQueue::BindCounts& bindCounts)
+{
+    beginSceneCommandBuffer(cb, imageIndex, depthOnly, query, bindCounts);
+
+    // firstInstance points to the draw instances of the draw, which hold the instance and material indices
+    const std::vector<Model::Primitive>& primitives = m_scene->getPrimitives();
+    const std::vector<RenderQueue::Item>& items = m_renderQueue.getItems();
+    const uint32_t firstIndex = m_scene->getFirstIndex();
+    const int32_t vertexOffset = m_scene->getVertexOffset();
+    const VkPipeline scenePipeline = getScenePipeline(depthOnly);
+    uint32_t boundPipeline = UINT32_MAX;
+    for (size_t i = firstDraw; i < lastDraw; ++i)
+    {
+        const uint32_t pipeline = RenderQueue::getPipeline(items[i].key);
+        if (pipeline != boundPipeline)
+        {
+            vkCmdBindPipeline(cb, VK_PIPELINE_BIND_POINT_GRAPHICS, scenePipeline);
+            boundPipeline = pipeline;
+            ++bindCounts.pipelineBinds;
+        }
+
+        const Draw& draw = m_visibleDraws[i];
+        const Model::Primitive& primitive = primitives[draw.primitive];
+        vkCmdDrawIndexed(cb, primitive.indexCount, draw.instanceCount, firstIndex + primitive.firstIndex, vertexOffset + primitive.vertexOffset, draw.firstInstance);
+        ++bindCounts.draws;
     }
 
+    endSceneCommandBuffer(cb, imageIndex, query);
+}
+
+// The draws come from the buffers GpuCulling fills each frame so the recording stays valid while the view changes
+void Renderer::recordIndirectDraws(VkCommandBuffer cb, uint32_t imageIndex, bool depthOnly, uint32_t query, RenderQueue::BindCounts& bindCounts)
+{
+    beginSceneCommandBuffer(cb, imageIndex, depthOnly, query, bindCounts);
+    vkCmdBindPipeline(cb, VK_PIPELINE_BIND_POINT_GRAPHICS, getScenePipeline(depthOnly));
+    ++bindCounts.pipelineBinds;
+    m_gpuCulling->recordDraws(cb, imageIndex);
+    ++bindCounts.draws;
+    endSceneCommandBuffer(cb, imageIndex, query);
+}
+
+// Binds what every draw of the scene uses, the pipeline is left to the caller
+void Renderer::beginSceneCommandBuffer(VkCommandBuffer cb, uint32_t imageIndex, bool depthOnly, uint32_t query, RenderQueue::BindCounts& bindCounts)
+{
+    // Without a render pass the secondaries state the formats of the rendering they continue
+    VkCommandBufferInheritanceRenderingInfo inheritanceRenderingInfo{};
+    inheritanceRenderingInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO;
+    inheritanceRenderingInfo.colorAttachmentCount = 1;
+    inheritanceRenderingInfo.pColorAttachmentFormats = &c_surfaceFormat.format;
+    inheritanceRenderingInfo.depthAttachmentFormat = c_depthFormat;
+    inheritanceRenderingInfo.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+    VkCommandBufferInheritanceInfo inheritanceInfo{};
+    inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+    inheritanceInfo.pNext = m_dynamicRendering ? &inheritanceRenderingInfo : nullptr;
+    inheritanceInfo.renderPass = m_renderPass;
+    inheritanceInfo.subpass = 0;
+    inheritanceInfo.framebuffer = m_dynamicRendering ? VK_NULL_HANDLE : m_framebuffers[imageIndex];
+
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+    beginInfo.flags |= m_cacheSceneCommands ? 0 : VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    beginInfo.pInheritanceInfo = &inheritanceInfo;
+
+    VK_CHECK(vkBeginCommandBuffer(cb, &beginInfo));
+
+    // Viewport and scissor are dynamic so that the pipeline survives swapchain recreation
+    VkViewport viewport{};
+    viewport.x = 0.0f;
+    viewport.y = 0.0f;
+    viewport.width = static_cast<float>(m_extent.width);
+    viewport.height = static_cast<float>(m_extent.height);
+    viewport.minDepth = 0.0f;
+    viewport.maxDepth = 1.0f;
+    vkCmdSetViewport(cb, 0, 1, &viewport);
+
+    VkRect2D scissor{};
+    scissor.offset = {0, 0};
+    scissor.extent = m_extent;
+    vkCmdSetScissor(cb, 0, 1, &scissor);
+
+    const VkBuffer vertexBuffer = depthOnly ? m_geometryPool->getPositionBuffer() : m_geometryPool->getVertexBuffer();
+    VkDeviceSize offsets[] = {0};
+    vkCmdBindVertexBuffers(cb, 0, 1, &vertexBuffer, offsets);
+    vkCmdBindIndexBuffer(cb, m_geometryPool->getIndexBuffer(), 0, VK_INDEX_TYPE_UINT32);
+    const std::array<VkDescriptorSet, 3> descriptorSets{m_frameDescriptorSet, m_scene->getDescriptorSet(), m_instances->getDescriptorSet(imageIndex)};
+    vkCmdBindDescriptorSets(cb, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineLayout, 0, ui32Size(descriptorSets), descriptorSets.data(), 1, &m_viewProjectionOffset);
+    ++bindCounts.vertexBufferBinds;
+    ++bindCounts.descriptorSetBinds;
+
+    if (!m_statisticsQueries.empty())
+    {
+        vkCmdBeginQuery(cb, m_statisticsQueries[imageIndex].queryPool, query, 0);
+    }
+}
+
+void Renderer::endSceneCommandBuffer(VkCommandBuffer cb, uint32_t imageIndex, uint32_t query)
+{
+    if (!m_statisticsQueries.empty())
+    {
+        vkCmdEndQuery(cb, m_statisticsQueries[imageIndex].queryPool, query);
+    }
     VK_CHECK(vkEndCommandBuffer(cb));
+}
 
-    m_context.submitCommandBuffers({cb});
+VkPipeline Renderer::getScenePipeline(bool depthOnly) const
+{
+    if (depthOnly)
+    {
+        return m_depthPrePassPipeline;
+    }
+    return m_depthPrePass ? m_equalDepthPipeline : m_graphicsPipeline;
+}
 
-    return true;
+// The scene's statistics are the sums of those of its secondaries
+void Renderer::readSceneStatistics(uint32_t imageIndex)
+{
+    if (m_statisticsQueries.empty() || m_statisticsQueries[imageIndex].queryCount == 0)
+    {
+        return;
+    }
+
+    const StatisticsQuery& query = m_statisticsQueries[imageIndex];
+    std::vector<std::array<uint64_t, 2>> results(query.queryCount);
+    const size_t dataSize = results.size() * sizeof(results[0]);
+    if (vkGetQueryPoolResults(m_device, query.queryPool, 0, query.queryCount, dataSize, results.data(), sizeof(results[0]), VK_QUERY_RESULT_64_BIT) == VK_SUCCESS)
+    {
+        SceneStatistics& statistics = m_sceneStatistics[query.depthPrePass ? 1 : 0];
+        statistics = SceneStatistics();
+        for (const std::array<uint64_t, 2>& result : results)
+        {
+            statistics.vertexInvocations += result[0];
+            statistics.fragmentInvocations += result[1];
+        }
+        statistics.valid = true;
+    }
 }
 
-bool Renderer::update(uint32_t imageIndex)
+// Instances of primitives outside the view frustum are left out of the recorded draws. The visible pairs are sorted
+// by primitive so every primitive becomes one instanced draw.
+void Renderer::cullScene(uint32_t imageIndex)
 {
-    bool running = m_context.update();
-    if (!running)
+    const auto startTime = std::chrono::steady_clock::now();
+
+    if (m_frustumCulling)
     {
-        return false;
+        Culling::cullBoxes(getCullingPlanes(), m_instanceBounds, m_visibleObjects);
+    }
+    else
+    {
+        m_visibleObjects.resize(m_instanceBounds.count);
+        std::iota(m_visibleObjects.begin(), m_visibleObjects.end(), 0);
     }
 
-    using namespace std::chrono;
-    const double deltaTime = static_cast<double>(duration_cast<nanoseconds>(high_resolution_clock::now() - m_lastRenderTime).count()) / 1'000'000'000.0;
-    m_lastRenderTime = high_resolution_clock::now();
+    // View depth of a point is the dot product with the negated third row of the view matrix
+    const glm::mat4& view = m_camera.getViewMatrix();
+    const glm::vec4 depthRow(-view[0][2], -view[1][2], -view[2][2], -view[3][2]);
 
-    updateCamera(deltaTime);
+    const std::vector<Model::Primitive>& primitives = m_scene->getPrimitives();
+    const uint32_t instanceCount = m_instances->getCount();
+    Instances::DrawInstance* drawInstances = m_instances->getUploadData(imageIndex);
+    m_visibleDraws.clear();
+    m_visibleDrawDepths.clear();
+    for (uint32_t i = 0; i < ui32Size(m_visibleObjects); ++i)
+    {
+        const uint32_t object = m_visibleObjects[i];
+        const uint32_t primitiveIndex = object / instanceCount;
+        const glm::vec4 center(m_instanceBounds.centerX[object], m_instanceBounds.centerY[object], m_instanceBounds.centerZ[object], 1.0f);
+        const float depth = glm::dot(depthRow, center);
+        if (m_visibleDraws.empty() || m_visibleDraws.back().primitive != primitiveIndex)
+        {
+            m_visibleDraws.push_back({primitiveIndex, i, 0});
+            m_visibleDrawDepths.push_back(depth);
+        }
+        ++m_visibleDraws.back().instanceCount;
+        m_visibleDrawDepths.back() = std::min(m_visibleDrawDepths.back(), depth);
 
-    void* dst;
-    VK_CHECK(vkMapMemory(m_device, m_uniformBufferMemory, imageIndex * c_uniformBufferSize, c_uniformBufferSize, 0, &dst));
-    const glm::mat4 viewProjectionMatrix = m_camera.getProjectionMatrix() * m_camera.getViewMatrix();
-    std::memcpy(dst, &viewProjectionMatrix[0], static_cast<size_t>(c_uniformBufferSize));
-    vkUnmapMemory(m_device, m_uniformBufferMemory);
+        drawInstances[i].instanceIndex = object % instanceCount;
+        drawInstances[i].materialIndex = static_cast<uint32_t>(primitives[primitiveIndex].material);
+    }
+    m_visibleInstanceCount = ui32Size(m_visibleObjects);
 
-    return true;
+    m_cullingMicroseconds = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - startTime).count();
 }
 
-void Renderer::loadModel()
+// Orders the visible draws by their keys, unsorted they stay in primitive order with a key of the same pipeline
+void Renderer::sortDraws()
 {
-    m_model.reset(new Model("DamagedHelmet.glb"));
-    m_numIndices = m_model->indices.size();
+    const auto startTime = std::chrono::steady_clock::now();
+
+    const std::vector<Model::Primitive>& primitives = m_scene->getPrimitives();
+    const float nearDistance = m_camera.getNearClipDistance();
+    const float farDistance = m_camera.getFarClipDistance();
+    m_renderQueue.clear();
+    for (uint32_t i = 0; i < ui32Size(m_visibleDraws); ++i)
+    {
+        const uint32_t primitive = m_visibleDraws[i].primitive;
+        const uint32_t material = static_cast<uint32_t>(primitives[primitive].material);
+        const uint32_t depthBucket = RenderQueue::getDepthBucket(m_visibleDrawDepths[i], nearDistance, farDistance);
+        m_renderQueue.push(RenderQueue::makeKey(c_scenePipeline, material, depthBucket, primitive), i);
+    }
+
+    if (m_sortDraws)
+    {
+        m_renderQueue.sort();
+
+        m_sortedDraws.clear();
+        for (const RenderQueue::Item& item : m_renderQueue.getItems())
+        {
+            m_sortedDraws.push_back(m_visibleDraws[item.draw]);
+        }
+        m_visibleDraws.swap(m_sortedDraws);
+    }
+
+    m_sortMicroseconds = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+// With culling disabled every plane is in front of everything
+Culling::Planes Renderer::getCullingPlanes() const
+{
+    if (!m_frustumCulling)
+    {
+        Culling::Planes planes;
+        planes.fill(glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+        return planes;
+    }
+    return m_camera.getFrustumPlanes();
+}
+
+// Must be called when anything a recording references changes: draws, pipelines, descriptor sets, buffers or framebuffers
+void Renderer::invalidateSceneCommands()
+{
+    for (SceneCommands& sceneCommands : m_sceneCommands)
+    {
+        sceneCommands.dirty = true;
+    }
 }
 
-void Renderer::releaseModel()
+// Scatters the instances for the current scene and count and rebuilds the bounds of the pairs for CPU culling
+void Renderer::updateInstances()
 {
-    m_model.reset();
+    m_instancesDirty = false;
+
+    const Culling::Bounds& bounds = m_scene->getBounds();
+    glm::vec3 sceneMin(0.0f);
+    glm::vec3 sceneMax(0.0f);
+    for (size_t i = 0; i < bounds.count; ++i)
+    {
+        const glm::vec3 center(bounds.centerX[i], bounds.centerY[i], bounds.centerZ[i]);
+        const glm::vec3 extent(bounds.extentX[i], bounds.extentY[i], bounds.extentZ[i]);
+        sceneMin = i == 0 ? center - extent : glm::min(sceneMin, center - extent);
+        sceneMax = i == 0 ? center + extent : glm::max(sceneMax, center + extent);
+    }
+
+    // The scatter waits for its upload, which doesn't matter as it only happens on request
+    m_instances->scatter(getInstanceCount(), sceneMin, sceneMax);
+
+    // Instances are only rotated and translated so the box of a transformed box uses the absolute rotation
+    const std::vector<glm::mat4>& transforms = m_instances->getTransforms();
+    Culling::clear(m_instanceBounds);
+    for (size_t i = 0; i < bounds.count; ++i)
+    {
+        const glm::vec4 center(bounds.centerX[i], bounds.centerY[i], bounds.centerZ[i], 1.0f);
+        const glm::vec3 extent(bounds.extentX[i], bounds.extentY[i], bounds.extentZ[i]);
+        for (const glm::mat4& transform : transforms)
+        {
+            const glm::vec3 transformedCenter(transform * center);
+            const glm::mat3 rotation(transform);
+            const glm::vec3 transformedExtent = glm::mat3(glm::abs(rotation[0]), glm::abs(rotation[1]), glm::abs(rotation[2])) * extent;
+            Culling::addBox(m_instanceBounds, transformedCenter - transformedExtent, transformedCenter + transformedExtent);
+        }
+    }
+}
+
+// At least one instance of every primitive fits the draw instance limit
+uint32_t Renderer::getInstanceCount() const
+{
+    const uint32_t primitiveCount = std::max(ui32Size(m_scene->getPrimitives()), 1u);
+    return std::min(m_requestedInstanceCount, std::max(c_maxDrawInstances / primitiveCount, 1u));
+}
+
+// Loading runs in stages so that rendering continues meanwhile: a job reads and parses the model, the main thread
+// creates the GPU resources and submits their upload and the scene is switched once the upload has finished
+void Renderer::updateSceneLoad(bool wait)
+{
+    if (!m_sceneLoad)
+    {
+        return;
+    }
+
+    SceneLoad& load = *m_sceneLoad;
+    if (!load.scene)
+    {
+        if (wait)
+        {
+            m_jobSystem.wait(load.job);
+        }
+        else if (!m_jobSystem.isDone(load.job))
+        {
+            return;
+        }
+
+        // Only the startup model has no scene to fall back to
+        if (!load.error.empty())
+        {
+            printf("Failed to load %s: %s\n", load.filename.c_str(), load.error.c_str());
+            if (!m_scene)
+            {
+                LOGE("Model load failed");
+            }
+            m_modelLoadError = load.filename + ": " + load.error;
+            m_sceneLoad.reset();
+            requestQueuedModel();
+            return;
+        }
+
+        // Sets of retired scenes return to the pool only when the deletion queue collects them
+        if (m_bindlessSetCount == c_maxBindlessSets)
+        {
+            if (!wait)
+            {
+                return;
+            }
+            m_context.getDeletionQueue().flush();
+        }
+
+        // The staging buffers hold a copy of everything so the model is released as soon as they are filled
+        m_memoryAllocator.addHostAssetMemory(load.model->getHostMemorySize());
+        load.uploadCommand = beginSingleTimeCommands(m_context.getGraphicsCommandPool(), m_device);
+        load.scene.reset(new Scene(m_context, m_jobSystem, load.filename, *load.model, *m_geometryPool, m_bindlessDescriptorPool, m_bindlessDescriptorSetLayout, m_bindlessTextureCapacity, load.uploadCommand.commandBuffer));
+        load.uploadValue = submitSingleTimeCommands(m_context.getGraphicsQueue(), m_context.getGraphicsTimeline(), load.uploadCommand);
+        ++m_bindlessSetCount;
+        m_memoryAllocator.removeHostAssetMemory(load.model->getHostMemorySize());
+        load.model.reset();
+    }
+
+    Timeline& graphicsTimeline = m_context.getGraphicsTimeline();
+    if (wait)
+    {
+        graphicsTimeline.wait(load.uploadValue);
+    }
+    else if (!graphicsTimeline.isCompleted(load.uploadValue))
+    {
+        return;
+    }
+
+    vkFreeCommandBuffers(m_device, load.uploadCommand.commandPool, 1, &load.uploadCommand.commandBuffer);
+    load.scene->releaseStagingBuffers();
+
+    // Frames in flight still reference the old scene, destroying it hands its objects to the deletion queue
+    if (m_scene)
+    {
+        m_scene.reset();
+        m_context.getDeletionQueue().push([this]() {
+            --m_bindlessSetCount;
+        });
+    }
+    m_scene = std::move(load.scene);
+    m_sceneLoad.reset();
+    m_modelLoadError.clear();
+    invalidateSceneCommands();
+    m_instancesDirty = true;
+
+    requestQueuedModel();
+}
+
+void Renderer::requestQueuedModel()
+{
+    if (!m_queuedModelFilename.empty())
+    {
+        requestModel(m_queuedModelFilename);
+        m_queuedModelFilename.clear();
+    }
+}
+
+void Renderer::requestFiles()
+{
+    // Shaders are requested up front so that their reads overlap with loading the first model
+    for (const std::string& filename : c_shaderFilenames)
+    {
+        m_shaderFiles[filename] = m_fileReader.read("shaders/" + filename);
+    }
+}
+
+// Shaders are part of the build, the renderer can't run without them
+FileReader::Data Renderer::getShaderFile(const std::string& filename)
+{
+    FileReader::Result file = m_shaderFiles.at(filename).get();
+    if (!file.error.empty())
+    {
+        LOGE(file.error.c_str());
+    }
+    return std::move(file.data);
+}
+
+void Renderer::findModelFiles()
+{
+    m_modelFilenames.clear();
+    for (const std::filesystem::directory_entry& entry : std::filesystem::directory_iterator(c_modelsFolder))
+    {
+        if (entry.is_regular_file() && entry.path().extension() == ".glb")
+        {
+            m_modelFilenames.push_back(entry.path().filename().string());
+        }
+    }
+    std::sort(m_modelFilenames.begin(), m_modelFilenames.end());
 }
 
 void Renderer::setupCamera()
 {
     m_camera.setPosition(glm::vec3{0.0f, 0.0f, 10.0f});
+    m_camera.setAspectRatio(static_cast<float>(m_extent.width) / static_cast<float>(m_extent.height));
 }
 
 void Renderer::updateCamera(double deltaTime)
@@ -260,8 +1115,359 @@ void Renderer::updateCamera(double deltaTime)
     }
 }
 
+void Renderer::drawMemoryPanel()
+{
+    ImGui::Begin("Memory");
+
+    const std::vector<MemoryAllocator::HeapBudget>& heapBudgets = m_memoryAllocator.getHeapBudgets();
+    ImGui::Text("Heaps (%s)", m_memoryAllocator.hasMemoryBudget() ? "VK_EXT_memory_budget" : "estimated budget");
+    if (ImGui::BeginTable("Heaps", 5, ImGuiTableFlags_Borders))
+    {
+        ImGui::TableSetupColumn("Heap");
+        ImGui::TableSetupColumn("Budget MiB");
+        ImGui::TableSetupColumn("Usage MiB");
+        ImGui::TableSetupColumn("Ours MiB");
+        ImGui::TableSetupColumn("Peak MiB");
+        ImGui::TableHeadersRow();
+        for (size_t i = 0; i < heapBudgets.size(); ++i)
+        {
+            const MemoryAllocator::HeapBudget& heap = heapBudgets[i];
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::Text("%zu%s", i, heap.deviceLocal ? " (device)" : "");
+            ImGui::TableNextColumn();
+            ImGui::Text("%.1f", toMiB(heap.budget));
+            ImGui::TableNextColumn();
+            ImGui::Text("%.1f", toMiB(heap.usage));
+            ImGui::TableNextColumn();
+            ImGui::Text("%.1f", toMiB(heap.allocated));
+            ImGui::TableNextColumn();
+            ImGui::Text("%.1f", toMiB(heap.peak));
+        }
+        ImGui::EndTable();
+    }
+
+    if (ImGui::BeginTable("Categories", 4, ImGuiTableFlags_Borders))
+    {
+        ImGui::TableSetupColumn("Category");
+        ImGui::TableSetupColumn("Current MiB");
+        ImGui::TableSetupColumn("Peak MiB");
+        ImGui::TableSetupColumn("Allocations");
+        ImGui::TableHeadersRow();
+
+        auto addRow = [](const char* name, const MemoryAllocator::Stats& stats) {
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::Text("%s", name);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.1f", toMiB(stats.current));
+            ImGui::TableNextColumn();
+            ImGui::Text("%.1f", toMiB(stats.peak));
+            ImGui::TableNextColumn();
+            ImGui::Text("%u", stats.allocationCount);
+        };
+
+        for (size_t i = 0; i < static_cast<size_t>(MemoryCategory::Count); ++i)
+        {
+            const MemoryCategory category = static_cast<MemoryCategory>(i);
+            addRow(MemoryAllocator::getCategoryName(category), m_memoryAllocator.getCategoryStats(category));
+        }
+        addRow("Host assets", m_memoryAllocator.getHostAssetStats());
+        ImGui::EndTable();
+    }
+
+    // Transients of the same block whose passes don't overlap take the same memory
+    const std::vector<RenderGraph::TransientInfo> transients = m_renderGraph->getTransients();
+    const RenderGraph::Stats& graphStats = m_renderGraph->getStats();
+    ImGui::Text("Render graph: %u transients in %u blocks of %.1f KiB, %.1f KiB without aliasing",
+                graphStats.transientResourceCount,
+                graphStats.transientBlockCount,
+                toKiB(graphStats.transientMemorySize),
+                toKiB(graphStats.transientResourceSize));
+    if (!transients.empty() && ImGui::BeginTable("Transients", 5, ImGuiTableFlags_Borders))
+    {
+        ImGui::TableSetupColumn("Transient");
+        ImGui::TableSetupColumn("Block");
+        ImGui::TableSetupColumn("Offset KiB");
+        ImGui::TableSetupColumn("Size KiB");
+        ImGui::TableSetupColumn("Passes");
+        ImGui::TableHeadersRow();
+        for (const RenderGraph::TransientInfo& transient : transients)
+        {
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::Text("%s", transient.name);
+            ImGui::TableNextColumn();
+            ImGui::Text("%u", transient.block);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.1f", toKiB(transient.offset));
+            ImGui::TableNextColumn();
+            ImGui::Text("%.1f", toKiB(transient.size));
+            ImGui::TableNextColumn();
+            ImGui::Text("%u - %u", transient.firstPass, transient.lastPass);
+        }
+        ImGui::EndTable();
+    }
+
+    const GeometryPool::Stats geometryStats = m_geometryPool->getStats();
+    ImGui::Text("Geometry pool: %u allocations, repacked %u times", geometryStats.allocationCount, geometryStats.repackCount);
+    ImGui::Text("Vertices %u / %u, largest free range %u", geometryStats.usedVertices, geometryStats.vertexCapacity, geometryStats.largestFreeVertexRange);
+    ImGui::Text("Indices %u / %u, largest free range %u", geometryStats.usedIndices, geometryStats.indexCapacity, geometryStats.largestFreeIndexRange);
+    if (ImGui::Button("Compact geometry"))
+    {
+        m_compactGeometry = true;
+    }
+
+    if (ImGui::Button("Dump JSON"))
+    {
+        m_memoryAllocator.writeJson(c_memoryDumpFilename);
+    }
+
+    ImGui::End();
+}
+
+void Renderer::drawRenderingPanel()
+{
+    ImGui::Begin("Rendering");
+
+    // Cached recordings can't be one time submit so everything is recorded again after switching
+    if (ImGui::Checkbox("Cache scene commands", &m_cacheSceneCommands))
+    {
+        invalidateSceneCommands();
+    }
+    ImGui::Text("Scene recordings: %llu", static_cast<unsigned long long>(m_sceneRecordingCount));
+    ImGui::Text("Pending deletions: %zu", m_context.getDeletionQueue().getPendingCount());
+    ImGui::Text("Binds per frame: %u pipeline, %u descriptor set, %u vertex buffer", m_bindCounts.pipelineBinds, m_bindCounts.descriptorSetBinds, m_bindCounts.vertexBufferBinds);
+    ImGui::Text("Draw calls per frame: %u", m_bindCounts.draws);
+
+    ImGui::Separator();
+    if (m_dynamicRendering)
+    {
+        ImGui::Text("Dynamic rendering, the GUI loads the color attachment");
+    }
+    else
+    {
+        ImGui::Checkbox("GUI in scene pass", &m_guiInScenePass);
+    }
+    for (const AttachmentOps& ops : getAttachmentOps())
+    {
+        ImGui::Text("%s, %s: %s, %s", ops.pass, ops.attachment, getLoadOpName(ops.loadOp), getStoreOpName(ops.storeOp));
+    }
+    if (m_dynamicRendering && !isDepthStored())
+    {
+        ImGui::Text("Depth is created by the render graph");
+    }
+    else if (m_depthTransient)
+    {
+        ImGui::Text("Depth is transient%s", m_memoryAllocator.isLazilyAllocated(m_depthImageMemory) ? " and lazily allocated" : "");
+    }
+    // Of the last frame
+    const RenderGraph::Stats& graphStats = m_renderGraph->getStats();
+    ImGui::Text("Render graph: %u passes, %u culled", graphStats.passCount, graphStats.culledPassCount);
+    ImGui::Text("Barriers: %u batches, %u image, %u buffer (%s)",
+                graphStats.barrierBatchCount,
+                graphStats.imageBarrierCount,
+                graphStats.bufferBarrierCount,
+                m_context.isSynchronization2Enabled() ? "synchronization2" : "original API");
+    ImGui::Text("Transient resources: %u, see the Memory panel", graphStats.transientResourceCount);
+
+    ImGui::Separator();
+    if (ImGui::Checkbox("GPU driven", &m_gpuDriven))
+    {
+        invalidateSceneCommands();
+    }
+    ImGui::Checkbox("Frustum culling", &m_frustumCulling);
+    if (ImGui::BeginCombo("Instances", std::to_string(m_requestedInstanceCount).c_str()))
+    {
+        for (uint32_t instanceCount : c_instanceCounts)
+        {
+            if (ImGui::Selectable(std::to_string(instanceCount).c_str(), instanceCount == m_requestedInstanceCount))
+            {
+                m_requestedInstanceCount = instanceCount;
+                m_instancesDirty = true;
+            }
+        }
+        ImGui::EndCombo();
+    }
+    if (m_instances->getCount() < m_requestedInstanceCount)
+    {
+        ImGui::Text("Limited to %u instances by %u draw instances", m_instances->getCount(), c_maxDrawInstances);
+    }
+    const size_t objectCount = m_scene->getPrimitives().size() * m_instances->getCount();
+    if (m_gpuDriven)
+    {
+        bool occlusionCulling = m_gpuCulling->isOcclusionCullingEnabled();
+        if (!m_gpuCulling->isOcclusionCullingSupported())
+        {
+            ImGui::Text("Occlusion culling is not supported");
+        }
+        else if (ImGui::Checkbox("Occlusion culling", &occlusionCulling))
+        {
+            m_gpuCulling->setOcclusionCulling(occlusionCulling);
+        }
+
+        const GpuCulling::Statistics& statistics = m_gpuCulling->getStatistics();
+        ImGui::Text("Visible instances %u / %zu in %u draws", statistics.visibleCount, objectCount, statistics.drawCount);
+        ImGui::TextUnformatted(m_gpuCulling->isDrawCountSupported() ? "Compacted draws with a count buffer" : "Draws of every object, no draw indirect count");
+        ImGui::Text("Frustum culled %u, occlusion culled %u", statistics.frustumCulledCount, statistics.occlusionCulledCount);
+        ImGui::Text("Cull %.3f ms, pyramid %.3f ms", statistics.cullMilliseconds, statistics.pyramidMilliseconds);
+        ImGui::Text("Scene %.3f ms, without occlusion culling %.3f ms", statistics.sceneMilliseconds, statistics.unoccludedSceneMilliseconds);
+    }
+    else
+    {
+        ImGui::Text("Visible instances %u / %zu in %zu draws", m_visibleInstanceCount, objectCount, m_visibleDraws.size());
+        ImGui::Text("Culling %.1f us (%s)", m_cullingMicroseconds, Culling::getInstructionSet());
+        ImGui::Checkbox("Sort draws", &m_sortDraws);
+        ImGui::Text("Sort keys %.1f us", m_sortMicroseconds);
+    }
+
+    ImGui::Separator();
+    if (ImGui::Checkbox("Depth pre-pass", &m_depthPrePass))
+    {
+        invalidateSceneCommands();
+    }
+    if (m_statisticsQueries.empty())
+    {
+        ImGui::Text("Pipeline statistics are not supported");
+    }
+    else
+    {
+        // Fragment shader invocations per pixel of the swapchain are the overdraw
+        const double pixelCount = static_cast<double>(m_extent.width) * m_extent.height;
+        for (size_t i = 0; i < m_sceneStatistics.size(); ++i)
+        {
+            const SceneStatistics& statistics = m_sceneStatistics[i];
+            const char* mode = i == 0 ? "Without pre-pass" : "With pre-pass";
+            if (!statistics.valid)
+            {
+                ImGui::Text("%s: not measured", mode);
+                continue;
+            }
+            ImGui::Text("%s: %llu vertex, %llu fragment invocations, %.2f fragments per pixel",
+                        mode,
+                        static_cast<unsigned long long>(statistics.vertexInvocations),
+                        static_cast<unsigned long long>(statistics.fragmentInvocations),
+                        pixelCount > 0.0 ? statistics.fragmentInvocations / pixelCount : 0.0);
+        }
+    }
+
+    ImGui::Separator();
+    const VkPresentModeKHR presentMode = m_context.getPresentMode();
+    if (ImGui::BeginCombo("Present mode", getPresentModeName(presentMode)))
+    {
+        for (VkPresentModeKHR supportedMode : m_context.getSupportedPresentModes())
+        {
+            if (ImGui::Selectable(getPresentModeName(supportedMode), supportedMode == presentMode))
+            {
+                m_context.setPresentMode(supportedMode);
+            }
+        }
+        ImGui::EndCombo();
+    }
+    ImGui::Text("Frame %.2f ms (%.0f fps)", m_frameMilliseconds, m_frameMilliseconds > 0.0 ? 1000.0 / m_frameMilliseconds : 0.0);
+    ImGui::Text("Acquire wait %.2f ms", m_context.getAcquireMilliseconds());
+    ImGui::Text("Swapchain %ux%u", m_extent.width, m_extent.height);
+
+    ImGui::Separator();
+    bool asyncComputeEnabled = m_asyncCompute->isEnabled();
+    if (ImGui::Checkbox("Async compute", &asyncComputeEnabled))
+    {
+        m_asyncCompute->setEnabled(asyncComputeEnabled);
+    }
+    int iterationCount = static_cast<int>(m_asyncCompute->getIterationCount());
+    if (ImGui::SliderInt("Iterations", &iterationCount, 1, 4096))
+    {
+        m_asyncCompute->setIterationCount(static_cast<uint32_t>(iterationCount));
+    }
+    ImGui::Text("Queue: %s", m_asyncCompute->hasDedicatedQueue() ? "dedicated compute family" : "shared with graphics");
+    if (m_asyncCompute->hasTimestamps())
+    {
+        const AsyncCompute::Timings& timings = m_asyncCompute->getTimings();
+        ImGui::Text("Compute %.3f ms, graphics %.3f ms", timings.computeMilliseconds, timings.graphicsMilliseconds);
+        ImGui::Text("Overlap with its frame %.3f ms", timings.overlapMilliseconds);
+    }
+    ImGui::Text("Result sample: %.4f", m_asyncCompute->getResultSample());
+
+    ImGui::End();
+}
+
+void Renderer::drawModelPanel()
+{
+    ImGui::Begin("Models");
+
+    ImGui::Text("Current: %s", m_scene->getName().c_str());
+    if (m_sceneLoad)
+    {
+        const bool uploading = m_sceneLoad->scene != nullptr;
+        ImGui::Text("%s %s", uploading ? "Uploading" : "Reading", m_sceneLoad->filename.c_str());
+    }
+    if (!m_queuedModelFilename.empty())
+    {
+        ImGui::Text("Next: %s", m_queuedModelFilename.c_str());
+    }
+    if (!m_modelLoadError.empty())
+    {
+        ImGui::TextWrapped("Failed: %s", m_modelLoadError.c_str());
+    }
+
+    if (ImGui::Button("Refresh"))
+    {
+        findModelFiles();
+    }
+
+    for (const std::string& filename : m_modelFilenames)
+    {
+        if (ImGui::Selectable(filename.c_str(), filename == m_scene->getName()))
+        {
+            requestModel(filename);
+        }
+    }
+
+    ImGui::End();
+}
+
+// Context has waited for every submission before recreating the swapchain so the old resources are destroyed directly
+void Renderer::recreateSwapchainResources()
+{
+    destroySwapchainResources();
+
+    m_extent = m_context.getSwapchainExtent();
+    m_swapchainGeneration = m_context.getSwapchainGeneration();
+    createDepthImage();
+    createSwapchainImageViews();
+    createFramebuffers();
+
+    m_camera.setAspectRatio(static_cast<float>(m_extent.width) / static_cast<float>(m_extent.height));
+    invalidateSceneCommands();
+}
+
+void Renderer::destroySwapchainResources()
+{
+    for (const VkFramebuffer& framebuffer : m_framebuffers)
+    {
+        vkDestroyFramebuffer(m_device, framebuffer, nullptr);
+    }
+    m_framebuffers.clear();
+
+    for (const VkImageView& imageView : m_swapchainImageViews)
+    {
+        vkDestroyImageView(m_device, imageView, nullptr);
+    }
+    m_swapchainImageViews.clear();
+
+    vkDestroyImageView(m_device, m_depthImageView, nullptr);
+    vkDestroyImage(m_device, m_depthImage, nullptr);
+    m_memoryAllocator.release(m_depthImageMemory);
+}
+
 void Renderer::createRenderPass()
 {
+    // Dynamic rendering describes the attachments when the scene is recorded
+    if (m_dynamicRendering)
+    {
+        return;
+    }
+
     VkAttachmentReference colorAttachmentRef{};
     colorAttachmentRef.attachment = 0;
     colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
@@ -279,43 +1485,41 @@ void Renderer::createRenderPass()
     VkAttachmentDescription colorAttachment{};
     colorAttachment.format = c_surfaceFormat.format;
     colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
-    colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-    colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
     colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
     colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-    colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    // The render graph transitions the attachments and orders the pass after the work before it
+    colorAttachment.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    colorAttachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
+    // Stencil is never used
     VkAttachmentDescription depthAttachment{};
     depthAttachment.format = c_depthFormat;
     depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
-    depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-    depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-    depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-    depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_STORE;
-    depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    depthAttachment.initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
     depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
 
-    VkSubpassDependency dependency{};
-    dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-    dependency.dstSubpass = 0;
-    dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    dependency.srcAccessMask = 0;
-    dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-
-    const std::array<VkAttachmentDescription, 2> attachments = {colorAttachment, depthAttachment};
-
-    VkRenderPassCreateInfo renderPassInfo{};
-    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-    renderPassInfo.attachmentCount = ui32Size(attachments);
-    renderPassInfo.pAttachments = attachments.data();
-    renderPassInfo.subpassCount = 1;
-    renderPassInfo.pSubpasses = &subpass;
-    renderPassInfo.dependencyCount = 1;
-    renderPassInfo.pDependencies = &dependency;
-
-    VK_CHECK(vkCreateRenderPass(m_device, &renderPassInfo, nullptr, &m_renderPass));
+    // The passes differ only in the store op of depth so they stay compatible
+    for (const bool storeDepth : {true, false})
+    {
+        const std::array<AttachmentOps, 2> attachmentOps = getSceneAttachmentOps(storeDepth);
+        colorAttachment.loadOp = attachmentOps[0].loadOp;
+        colorAttachment.storeOp = attachmentOps[0].storeOp;
+        depthAttachment.loadOp = attachmentOps[1].loadOp;
+        depthAttachment.storeOp = attachmentOps[1].storeOp;
+
+        const std::array<VkAttachmentDescription, 2> attachments = {colorAttachment, depthAttachment};
+
+        VkRenderPassCreateInfo renderPassInfo{};
+        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+        renderPassInfo.attachmentCount = ui32Size(attachments);
+        renderPassInfo.pAttachments = attachments.data();
+        renderPassInfo.subpassCount = 1;
+        renderPassInfo.pSubpasses = &subpass;
+
+        VK_CHECK(vkCreateRenderPass(m_device, &renderPassInfo, nullptr, storeDepth ? &m_renderPass : &m_discardDepthRenderPass));
+    }
 }
 
 void Renderer::createDepthImage()
@@ -323,34 +1527,37 @@ void Renderer::createDepthImage()
     VkImageCreateInfo imageInfo{};
     imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
     imageInfo.imageType = VK_IMAGE_TYPE_2D;
-    imageInfo.extent.width = c_windowWidth;
-    imageInfo.extent.height = c_windowHeight;
+    imageInfo.extent.width = m_extent.width;
+    imageInfo.extent.height = m_extent.height;
     imageInfo.extent.depth = 1;
     imageInfo.mipLevels = 1;
     imageInfo.arrayLayers = 1;
     imageInfo.format = c_depthFormat;
     imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
     imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    // Sampled when building the depth pyramid. Without occlusion culling it never leaves the scene pass, the render
+    // graph then creates it with dynamic rendering. Render passes get an image that tile-based GPUs keep in tile
+    // memory and never back with memory.
+    m_depthTransient = !m_gpuCulling->isOcclusionCullingSupported();
+    if (m_depthTransient && m_dynamicRendering)
+    {
+        m_depthImage = VK_NULL_HANDLE;
+        m_depthImageView = VK_NULL_HANDLE;
+        m_depthImageMemory = {};
+        m_gpuCulling->setDepthImage(VK_NULL_HANDLE, m_extent);
+        return;
+    }
+
     imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+    imageInfo.usage |= m_depthTransient ? VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT : VK_IMAGE_USAGE_SAMPLED_BIT;
     imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
     imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
     imageInfo.flags = 0;
 
     VK_CHECK(vkCreateImage(m_device, &imageInfo, nullptr, &m_depthImage));
 
-    VkMemoryRequirements memRequirements;
-    vkGetImageMemoryRequirements(m_device, m_depthImage, &memRequirements);
-
-    const MemoryTypeResult memoryTypeResult = findMemoryType(m_context.getPhysicalDevice(), memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-    CHECK(memoryTypeResult.found);
-
-    VkMemoryAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize = memRequirements.size;
-    allocInfo.memoryTypeIndex = memoryTypeResult.typeIndex;
-
-    VK_CHECK(vkAllocateMemory(m_device, &allocInfo, nullptr, &m_depthImageMemory));
-    VK_CHECK(vkBindImageMemory(m_device, m_depthImage, m_depthImageMemory, 0));
+    const MemoryUsage memoryUsage = m_depthTransient ? MemoryUsage::Transient : MemoryUsage::GpuOnly;
+    m_depthImageMemory = m_memoryAllocator.allocateForImage(m_depthImage, memoryUsage, MemoryCategory::RenderTargets);
 
     VkImageMemoryBarrier barrier{};
     barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
@@ -371,7 +1578,19 @@ void Renderer::createDepthImage()
 
     vkCmdPipelineBarrier(command.commandBuffer, barrierSrcFlags, barrierDstFlags, 0, 0, nullptr, 0, nullptr, 1, &barrier);
 
-    endSingleTimeCommands(m_context.getGraphicsQueue(), command);
+    endSingleTimeCommands(m_context.getGraphicsQueue(), m_context.getGraphicsTimeline(), command);
+
+    VkImageViewCreateInfo viewInfo{};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = m_depthImage;
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = c_depthFormat;
+    viewInfo.subresourceRange = c_defaultSubresourceRance;
+    viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+
+    VK_CHECK(vkCreateImageView(m_device, &viewInfo, nullptr, &m_depthImageView));
+
+    m_gpuCulling->setDepthImage(m_depthImageView, m_extent);
 }
 
 void Renderer::createSwapchainImageViews()
@@ -394,27 +1613,22 @@ void Renderer::createSwapchainImageViews()
 
         VK_CHECK(vkCreateImageView(m_device, &createInfo, nullptr, &m_swapchainImageViews[i]));
     }
-
-    VkImageViewCreateInfo createInfo{};
-    createInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-    createInfo.image = m_depthImage;
-    createInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-    createInfo.format = c_depthFormat;
-    createInfo.subresourceRange = c_defaultSubresourceRance;
-    createInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
-
-    VK_CHECK(vkCreateImageView(m_device, &createInfo, nullptr, &m_depthImageView));
 }
 
 void Renderer::createFramebuffers()
 {
+    if (m_dynamicRendering)
+    {
+        return;
+    }
+
     m_framebuffers.resize(m_swapchainImageViews.size());
 
     VkFramebufferCreateInfo framebufferInfo{};
     framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
     framebufferInfo.renderPass = m_renderPass;
-    framebufferInfo.width = c_windowWidth;
-    framebufferInfo.height = c_windowHeight;
+    framebufferInfo.width = m_extent.width;
+    framebufferInfo.height = m_extent.height;
     framebufferInfo.layers = 1;
 
     for (size_t i = 0; i < m_swapchainImageViews.size(); ++i)
@@ -450,120 +1664,11 @@ void Renderer::createSampler()
     VK_CHECK(vkCreateSampler(m_device, &samplerInfo, nullptr, &m_sampler));
 }
 
-void Renderer::createTextures()
-{
-    const size_t numImages = m_model->images.size();
-    m_images.resize(numImages);
-    m_imageMemories.resize(numImages);
-    m_imageViews.resize(numImages);
-    const VkPhysicalDevice physicalDevice = m_context.getPhysicalDevice();
-    const VkFormat format = VK_FORMAT_R8G8B8A8_UNORM;
-    const Model::Material& mat = m_model->materials[0];
-    const std::vector<int> imageIndices{mat.baseColor, mat.metallicRoughnessImage, mat.normalImage, mat.emissiveImage, mat.occlusionImage};
-
-    for (size_t i = 0; i < imageIndices.size(); ++i)
-    {
-        const Model::Image& image = m_model->images[imageIndices[i]];
-
-        const StagingBuffer stagingBuffer = createStagingBuffer(m_device, physicalDevice, image.data.data(), image.data.size());
-
-        const VkImageUsageFlags imageUsage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
-
-        VkImageCreateInfo imageInfo{};
-        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
-        imageInfo.imageType = VK_IMAGE_TYPE_2D;
-        imageInfo.extent.width = image.width;
-        imageInfo.extent.height = image.height;
-        imageInfo.extent.depth = 1;
-        imageInfo.mipLevels = 1;
-        imageInfo.arrayLayers = 1;
-        imageInfo.format = format;
-        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
-        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-        imageInfo.usage = imageUsage;
-        imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
-        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-        imageInfo.flags = 0;
-
-        VK_CHECK(vkCreateImage(m_device, &imageInfo, nullptr, &m_images[i]));
-
-        VkMemoryRequirements memRequirements;
-        vkGetImageMemoryRequirements(m_device, m_images[i], &memRequirements);
-
-        VkMemoryAllocateInfo allocInfo{};
-        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-        allocInfo.allocationSize = memRequirements.size;
-
-        const VkMemoryPropertyFlags memoryProperties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
-        const MemoryTypeResult memoryTypeResult = findMemoryType(physicalDevice, memRequirements.memoryTypeBits, memoryProperties);
-        CHECK(memoryTypeResult.found);
-
-        VK_CHECK(vkAllocateMemory(m_device, &allocInfo, nullptr, &m_imageMemories[i]));
-
-        vkBindImageMemory(m_device, m_images[i], m_imageMemories[i], 0);
-
-        {
-            VkImageMemoryBarrier transferDstBarrier{};
-            transferDstBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-            transferDstBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-            transferDstBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-            transferDstBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-            transferDstBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-            transferDstBarrier.image = m_images[i];
-            transferDstBarrier.subresourceRange = c_defaultSubresourceRance;
-            transferDstBarrier.srcAccessMask = 0;
-            transferDstBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-
-            VkImageMemoryBarrier readOnlyBarrier = transferDstBarrier;
-            readOnlyBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-            readOnlyBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-            readOnlyBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-            readOnlyBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-
-            const VkPipelineStageFlags transferSrcFlags = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-            const VkPipelineStageFlags transferDstFlags = VK_PIPELINE_STAGE_TRANSFER_BIT;
-            const VkPipelineStageFlags readOnlySrcFlags = transferDstFlags;
-            const VkPipelineStageFlags readOnlyDstFlags = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-
-            VkBufferImageCopy region{};
-            region.bufferOffset = 0;
-            region.bufferRowLength = 0;
-            region.bufferImageHeight = 0;
-            region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-            region.imageSubresource.mipLevel = 0;
-            region.imageSubresource.baseArrayLayer = 0;
-            region.imageSubresource.layerCount = 1;
-            region.imageOffset = {0, 0, 0};
-            region.imageExtent = {image.width, image.height, 1};
-
-            const SingleTimeCommand command = beginSingleTimeCommands(m_context.getGraphicsCommandPool(), m_device);
-            const VkCommandBuffer& cb = command.commandBuffer;
-
-            vkCmdPipelineBarrier(cb, transferSrcFlags, transferDstFlags, 0, 0, nullptr, 0, nullptr, 1, &transferDstBarrier);
-            vkCmdCopyBufferToImage(cb, stagingBuffer.buffer, m_images[i], VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
-            vkCmdPipelineBarrier(cb, readOnlySrcFlags, readOnlyDstFlags, 0, 0, nullptr, 0, nullptr, 1, &readOnlyBarrier);
-
-            endSingleTimeCommands(m_context.getGraphicsQueue(), command);
-        }
-
-        VkImageViewCreateInfo viewInfo{};
-        viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-        viewInfo.image = m_images[i];
-        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-        viewInfo.format = format;
-        viewInfo.subresourceRange = c_defaultSubresourceRance;
-
-        VK_CHECK(vkCreateImageView(m_device, &viewInfo, nullptr, &m_imageViews[i]));
-
-        releaseStagingBuffer(m_device, stagingBuffer);
-    }
-}
-
-void Renderer::createUboDescriptorSetLayouts()
+void Renderer::createFrameDescriptorSetLayout()
 {
     VkDescriptorSetLayoutBinding uboLayoutBinding{};
     uboLayoutBinding.binding = 0;
-    uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
     uboLayoutBinding.descriptorCount = 1;
     uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
     uboLayoutBinding.pImmutableSamplers = nullptr;
@@ -574,38 +1679,75 @@ void Renderer::createUboDescriptorSetLayouts()
     layoutInfo.bindingCount = ui32Size(bindings);
     layoutInfo.pBindings = bindings.data();
 
-    VK_CHECK(vkCreateDescriptorSetLayout(m_device, &layoutInfo, nullptr, &m_uboDescriptorSetLayout));
+    VK_CHECK(vkCreateDescriptorSetLayout(m_device, &layoutInfo, nullptr, &m_frameDescriptorSetLayout));
 }
 
-void Renderer::createTexturesDescriptorSetLayouts()
+void Renderer::createBindlessDescriptorSetLayout()
 {
-    const uint32_t imageCount = ui32Size(m_model->images);
-    std::vector<VkDescriptorSetLayoutBinding> bindings(imageCount);
-
-    for (uint32_t i = 0; i < imageCount; ++i)
-    {
-        bindings[i].binding = i;
-        bindings[i].descriptorCount = 1;
-        bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-        bindings[i].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
-        bindings[i].pImmutableSamplers = nullptr;
-    }
+    m_bindlessTextureCapacity = getBindlessTextureCapacity(m_context.getPhysicalDevice());
+
+    // Binding 0 is the shared sampler, 1 holds every texture array and 2 the material buffer
+    std::array<VkDescriptorSetLayoutBinding, 3> bindings{};
+    bindings[0].binding = 0;
+    bindings[0].descriptorCount = 1;
+    bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER;
+    bindings[0].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+    bindings[0].pImmutableSamplers = &m_sampler;
+
+    bindings[1].binding = 1;
+    bindings[1].descriptorCount = m_bindlessTextureCapacity;
+    bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+    bindings[1].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+    bindings[1].pImmutableSamplers = nullptr;
+
+    bindings[2].binding = 2;
+    bindings[2].descriptorCount = 1;
+    bindings[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    bindings[2].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+    bindings[2].pImmutableSamplers = nullptr;
+
+    // Unwritten texture slots are allowed and new textures can be written while the set is in use
+    const std::array<VkDescriptorBindingFlags, 3> bindingFlags{
+        0,
+        VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT,
+        0 //
+    };
+
+    VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo{};
+    bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+    bindingFlagsInfo.bindingCount = ui32Size(bindingFlags);
+    bindingFlagsInfo.pBindingFlags = bindingFlags.data();
 
     VkDescriptorSetLayoutCreateInfo layoutInfo{};
     layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.pNext = &bindingFlagsInfo;
+    layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
     layoutInfo.bindingCount = ui32Size(bindings);
     layoutInfo.pBindings = bindings.data();
 
-    VK_CHECK(vkCreateDescriptorSetLayout(m_device, &layoutInfo, nullptr, &m_texturesDescriptorSetLayout));
+    VK_CHECK(vkCreateDescriptorSetLayout(m_device, &layoutInfo, nullptr, &m_bindlessDescriptorSetLayout));
+}
+
+void Renderer::createGeometryPool()
+{
+    m_geometryPool.reset(new GeometryPool(m_context));
+}
+
+void Renderer::createInstances()
+{
+    m_instances.reset(new Instances(m_context));
 }
 
 void Renderer::createGraphicsPipeline()
 {
-    const std::array<VkDescriptorSetLayout, 2> descriptorSetLayouts{m_uboDescriptorSetLayout, m_texturesDescriptorSetLayout};
+    const std::array<VkDescriptorSetLayout, 3> descriptorSetLayouts{m_frameDescriptorSetLayout, m_bindlessDescriptorSetLayout, m_instances->getDescriptorSetLayout()};
+
     VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
     pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
     pipelineLayoutInfo.setLayoutCount = ui32Size(descriptorSetLayouts);
     pipelineLayoutInfo.pSetLayouts = descriptorSetLayouts.data();
+    pipelineLayoutInfo.pushConstantRangeCount = 0;
+    pipelineLayoutInfo.pPushConstantRanges = nullptr;
 
     VK_CHECK(vkCreatePipelineLayout(m_device, &pipelineLayoutInfo, nullptr, &m_pipelineLayout));
 
@@ -643,24 +1785,19 @@ void Renderer::createGraphicsPipeline()
     inputAssemblyState.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
     inputAssemblyState.primitiveRestartEnable = VK_FALSE;
 
-    VkViewport viewport{};
-    viewport.x = 0.0f;
-    viewport.y = 0.0f;
-    viewport.width = static_cast<float>(c_windowExtent.width);
-    viewport.height = static_cast<float>(c_windowExtent.height);
-    viewport.minDepth = 0.0f;
-    viewport.maxDepth = 1.0f;
-
-    VkRect2D scissor{};
-    scissor.offset = {0, 0};
-    scissor.extent = c_windowExtent;
-
     VkPipelineViewportStateCreateInfo viewportState{};
     viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
     viewportState.viewportCount = 1;
-    viewportState.pViewports = &viewport;
+    viewportState.pViewports = nullptr;
     viewportState.scissorCount = 1;
-    viewportState.pScissors = &scissor;
+    viewportState.pScissors = nullptr;
+
+    const std::array<VkDynamicState, 2> dynamicStates{VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+
+    VkPipelineDynamicStateCreateInfo dynamicState{};
+    dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamicState.dynamicStateCount = ui32Size(dynamicStates);
+    dynamicState.pDynamicStates = dynamicStates.data();
 
     VkPipelineRasterizationStateCreateInfo rasterizationState{};
     rasterizationState.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
@@ -713,8 +1850,8 @@ void Renderer::createGraphicsPipeline()
     colorBlendState.blendConstants[2] = 0.0f;
     colorBlendState.blendConstants[3] = 0.0f;
 
-    VkShaderModule vertexShaderModule = createShaderModule(m_device, "shaders/shader.vert.spv");
-    VkShaderModule fragmentShaderModule = createShaderModule(m_device, "shaders/shader.frag.spv");
+    VkShaderModule vertexShaderModule = createShaderModule(m_device, getShaderFile("shader.vert.spv"));
+    VkShaderModule fragmentShaderModule = createShaderModule(m_device, getShaderFile("shader.frag.spv"));
 
     VkPipelineShaderStageCreateInfo vertexShaderStageInfo{};
     vertexShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
@@ -730,8 +1867,16 @@ void Renderer::createGraphicsPipeline()
 
     std::vector<VkPipelineShaderStageCreateInfo> shaderStages{vertexShaderStageInfo, fragmentShaderStageInfo};
 
+    // Without a render pass the pipeline states the formats of the attachments it draws to
+    VkPipelineRenderingCreateInfo renderingInfo{};
+    renderingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO;
+    renderingInfo.colorAttachmentCount = 1;
+    renderingInfo.pColorAttachmentFormats = &c_surfaceFormat.format;
+    renderingInfo.depthAttachmentFormat = c_depthFormat;
+
     VkGraphicsPipelineCreateInfo pipelineInfo{};
     pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pipelineInfo.pNext = m_dynamicRendering ? &renderingInfo : nullptr;
     pipelineInfo.stageCount = ui32Size(shaderStages);
     pipelineInfo.pStages = shaderStages.data();
     pipelineInfo.pVertexInputState = &vertexInputState;
@@ -741,7 +1886,7 @@ void Renderer::createGraphicsPipeline()
     pipelineInfo.pMultisampleState = &multisampleState;
     pipelineInfo.pDepthStencilState = &depthStencilState;
     pipelineInfo.pColorBlendState = &colorBlendState;
-    pipelineInfo.pDynamicState = nullptr;
+    pipelineInfo.pDynamicState = &dynamicState;
     pipelineInfo.layout = m_pipelineLayout;
     pipelineInfo.renderPass = m_renderPass;
     pipelineInfo.subpass = 0;
@@ -750,6 +1895,40 @@ void Renderer::createGraphicsPipeline()
 
     VK_CHECK(vkCreateGraphicsPipelines(m_device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &m_graphicsPipeline));
 
+    // After the depth pre-pass only the nearest surface of every pixel is shaded. Both vertex shaders declare the
+    // position invariant so that the depths are equal.
+    depthStencilState.depthWriteEnable = VK_FALSE;
+    depthStencilState.depthCompareOp = VK_COMPARE_OP_EQUAL;
+    VK_CHECK(vkCreateGraphicsPipelines(m_device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &m_equalDepthPipeline));
+
+    // The depth pre-pass reads only positions, from their own stream, and has no fragment shader
+    VkVertexInputBindingDescription positionDescription{};
+    positionDescription.binding = 0;
+    positionDescription.stride = sizeof(glm::vec3);
+    positionDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+    VkVertexInputAttributeDescription positionAttribute{};
+    positionAttribute.binding = 0;
+    positionAttribute.location = 0;
+    positionAttribute.format = VK_FORMAT_R32G32B32_SFLOAT;
+    positionAttribute.offset = 0;
+
+    vertexInputState.pVertexBindingDescriptions = &positionDescription;
+    vertexInputState.vertexAttributeDescriptionCount = 1;
+    vertexInputState.pVertexAttributeDescriptions = &positionAttribute;
+
+    depthStencilState.depthWriteEnable = VK_TRUE;
+    depthStencilState.depthCompareOp = VK_COMPARE_OP_LESS;
+    colorBlendAttachmentState.colorWriteMask = 0;
+
+    VkPipelineShaderStageCreateInfo depthShaderStageInfo = vertexShaderStageInfo;
+    depthShaderStageInfo.module = createShaderModule(m_device, getShaderFile("depth.vert.spv"));
+    shaderStages.push_back(depthShaderStageInfo);
+
+    pipelineInfo.stageCount = 1;
+    pipelineInfo.pStages = &depthShaderStageInfo;
+    VK_CHECK(vkCreateGraphicsPipelines(m_device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &m_depthPrePassPipeline));
+
     for (const VkPipelineShaderStageCreateInfo& stage : shaderStages)
     {
         vkDestroyShaderModule(m_device, stage.module, nullptr);
@@ -758,19 +1937,16 @@ void Renderer::createGraphicsPipeline()
 
 void Renderer::createDescriptorPool()
 {
-    const uint32_t swapchainLength = static_cast<uint32_t>(m_context.getSwapchainImages().size());
+    const uint32_t numSetsForFrame = 1;
     const uint32_t numSetsForGUI = 1;
-    const uint32_t numSetsForModel = 1;
-
-    const uint32_t descriptorCount = ui32Size(m_model->images) + numSetsForGUI;
 
     std::array<VkDescriptorPoolSize, 2> poolSizes{};
-    poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    poolSizes[0].descriptorCount = swapchainLength;
+    poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    poolSizes[0].descriptorCount = numSetsForFrame;
     poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-    poolSizes[1].descriptorCount = descriptorCount;
+    poolSizes[1].descriptorCount = numSetsForGUI;
 
-    const uint32_t maxSets = swapchainLength + numSetsForModel + numSetsForGUI;
+    const uint32_t maxSets = numSetsForFrame + numSetsForGUI;
 
     VkDescriptorPoolCreateInfo poolInfo{};
     poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
@@ -779,176 +1955,154 @@ void Renderer::createDescriptorPool()
     poolInfo.maxSets = maxSets;
 
     VK_CHECK(vkCreateDescriptorPool(m_device, &poolInfo, nullptr, &m_descriptorPool));
+
+    // Bindless sets need a pool that allows update after bind, every scene allocates and frees its own set
+    std::array<VkDescriptorPoolSize, 3> bindlessPoolSizes{};
+    bindlessPoolSizes[0].type = VK_DESCRIPTOR_TYPE_SAMPLER;
+    bindlessPoolSizes[0].descriptorCount = c_maxBindlessSets;
+    bindlessPoolSizes[1].type = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+    bindlessPoolSizes[1].descriptorCount = m_bindlessTextureCapacity * c_maxBindlessSets;
+    bindlessPoolSizes[2].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    bindlessPoolSizes[2].descriptorCount = c_maxBindlessSets;
+
+    VkDescriptorPoolCreateInfo bindlessPoolInfo{};
+    bindlessPoolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    bindlessPoolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT | VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+    bindlessPoolInfo.poolSizeCount = ui32Size(bindlessPoolSizes);
+    bindlessPoolInfo.pPoolSizes = bindlessPoolSizes.data();
+    bindlessPoolInfo.maxSets = c_maxBindlessSets;
+
+    VK_CHECK(vkCreateDescriptorPool(m_device, &bindlessPoolInfo, nullptr, &m_bindlessDescriptorPool));
 }
 
-void Renderer::createUboDescriptorSets()
+void Renderer::createFrameDescriptorSet()
 {
-    const uint32_t swapchainLength = static_cast<uint32_t>(m_context.getSwapchainImages().size());
-    m_uboDescriptorSets.resize(swapchainLength);
-
-    std::vector<VkDescriptorSetLayout> layouts(swapchainLength, m_uboDescriptorSetLayout);
-
     VkDescriptorSetAllocateInfo allocInfo{};
     allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
     allocInfo.descriptorPool = m_descriptorPool;
-    allocInfo.descriptorSetCount = ui32Size(layouts);
-    allocInfo.pSetLayouts = layouts.data();
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &m_frameDescriptorSetLayout;
 
-    VK_CHECK(vkAllocateDescriptorSets(m_device, &allocInfo, m_uboDescriptorSets.data()));
+    VK_CHECK(vkAllocateDescriptorSets(m_device, &allocInfo, &m_frameDescriptorSet));
 }
 
-void Renderer::createTextureDescriptorSet()
+void Renderer::createFrameAllocator()
 {
-    std::vector<VkDescriptorSetLayout> layouts{m_texturesDescriptorSetLayout};
-
-    VkDescriptorSetAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-    allocInfo.descriptorPool = m_descriptorPool;
-    allocInfo.descriptorSetCount = ui32Size(layouts);
-    allocInfo.pSetLayouts = layouts.data();
-    VK_ERROR_FRAGMENTED_POOL;
-    VK_CHECK(vkAllocateDescriptorSets(m_device, &allocInfo, &m_texturesDescriptorSet));
+    const uint32_t frameCount = ui32Size(m_context.getSwapchainImages());
+    m_frameAllocator.reset(new FrameAllocator(m_device, m_context.getPhysicalDevice(), m_memoryAllocator, frameCount, c_frameAllocatorSize));
 }
 
-void Renderer::createUniformBuffer()
+void Renderer::updateFrameDescriptorSet()
 {
-    const VkMemoryPropertyFlags memoryProperties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
-    const uint64_t bufferSize = c_uniformBufferSize * m_context.getSwapchainImages().size();
-
-    VkBufferCreateInfo bufferInfo{};
-    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-    bufferInfo.size = bufferSize;
-    bufferInfo.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
-    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    // The offset of each frame's data is given as a dynamic offset when the set is bound
+    VkDescriptorBufferInfo bufferInfo{};
+    bufferInfo.buffer = m_frameAllocator->getBuffer();
+    bufferInfo.offset = 0;
+    bufferInfo.range = c_uniformBufferSize;
 
-    VK_CHECK(vkCreateBuffer(m_device, &bufferInfo, nullptr, &m_uniformBuffer));
+    VkWriteDescriptorSet descriptorWrite{};
+    descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    descriptorWrite.dstSet = m_frameDescriptorSet;
+    descriptorWrite.dstBinding = 0;
+    descriptorWrite.dstArrayElement = 0;
+    descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    descriptorWrite.descriptorCount = 1;
+    descriptorWrite.pBufferInfo = &bufferInfo;
 
-    VkMemoryRequirements memRequirements;
-    vkGetBufferMemoryRequirements(m_device, m_uniformBuffer, &memRequirements);
+    vkUpdateDescriptorSets(m_device, 1, &descriptorWrite, 0, nullptr);
+}
 
-    const MemoryTypeResult memoryTypeResult = findMemoryType(m_context.getPhysicalDevice(), memRequirements.memoryTypeBits, memoryProperties);
-    CHECK(memoryTypeResult.found);
+void Renderer::allocateCommandBuffers()
+{
+    m_commandBuffers.resize(m_swapchainImageViews.size());
 
-    VkMemoryAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize = memRequirements.size;
-    allocInfo.memoryTypeIndex = memoryTypeResult.typeIndex;
+    VkCommandBufferAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.commandPool = m_context.getGraphicsCommandPool();
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandBufferCount = ui32Size(m_commandBuffers);
 
-    VK_CHECK(vkAllocateMemory(m_device, &allocInfo, nullptr, &m_uniformBufferMemory));
-    VK_CHECK(vkBindBufferMemory(m_device, m_uniformBuffer, m_uniformBufferMemory, 0));
+    VK_CHECK(vkAllocateCommandBuffers(m_device, &allocInfo, m_commandBuffers.data()));
 }
 
-void Renderer::updateUboDescriptorSets()
+void Renderer::createRecordingContexts()
 {
-    VkDescriptorBufferInfo bufferInfo{};
-    bufferInfo.buffer = m_uniformBuffer;
-    bufferInfo.range = c_uniformBufferSize;
-
-    std::vector<VkWriteDescriptorSet> descriptorWrites(m_uboDescriptorSets.size());
+    // More ranges than threads that can record them would only add command buffers to execute
+    m_recordingRangeCount = std::min(m_jobSystem.getWorkerCount() + 1, c_maxRecordingRanges);
 
-    for (size_t i = 0; i < m_uboDescriptorSets.size(); ++i)
+    const QueueFamilyIndices indices = getQueueFamilies(m_context.getPhysicalDevice(), m_context.getSurface());
+    const size_t frameCount = m_context.getSwapchainImages().size();
+
+    // Command pools are externally synchronized so every range of every frame and the GUI of every frame get their own
+    auto createRecordingContext = [this, &indices](RecordingContext& recordingContext) {
+        VkCommandPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        poolInfo.queueFamilyIndex = indices.graphicsFamily;
+        poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+        VK_CHECK(vkCreateCommandPool(m_device, &poolInfo, nullptr, &recordingContext.commandPool));
+
+        VkCommandBufferAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.commandPool = recordingContext.commandPool;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+        allocInfo.commandBufferCount = 2;
+
+        std::array<VkCommandBuffer, 2> commandBuffers;
+        VK_CHECK(vkAllocateCommandBuffers(m_device, &allocInfo, commandBuffers.data()));
+        recordingContext.commandBuffer = commandBuffers[0];
+        recordingContext.depthCommandBuffer = commandBuffers[1];
+    };
+
+    m_recordingContexts.resize(frameCount * m_recordingRangeCount);
+    m_guiRecordingContexts.resize(frameCount);
+    m_sceneCommands.resize(frameCount);
+    for (RecordingContext& recordingContext : m_recordingContexts)
     {
-        bufferInfo.offset = i * c_uniformBufferSize;
-        descriptorWrites[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        descriptorWrites[i].dstSet = m_uboDescriptorSets[i];
-        descriptorWrites[i].dstBinding = 0;
-        descriptorWrites[i].dstArrayElement = 0;
-        descriptorWrites[i].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-        descriptorWrites[i].descriptorCount = 1;
-        descriptorWrites[i].pBufferInfo = &bufferInfo;
+        createRecordingContext(recordingContext);
+    }
+    for (RecordingContext& recordingContext : m_guiRecordingContexts)
+    {
+        createRecordingContext(recordingContext);
     }
-
-    vkUpdateDescriptorSets(m_device, ui32Size(descriptorWrites), descriptorWrites.data(), 0, nullptr);
 }
 
-void Renderer::updateTexturesDescriptorSet()
+void Renderer::createStatisticsQueries()
 {
-    std::vector<VkWriteDescriptorSet> descriptorWrites(m_imageViews.size());
-    std::vector<VkDescriptorImageInfo> imageInfos(m_imageViews.size());
-
-    for (size_t i = 0; i < m_imageViews.size(); ++i)
+    if (!m_context.isPipelineStatisticsEnabled())
     {
-        VkDescriptorImageInfo& imageInfo = imageInfos[i];
-        imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-        imageInfo.imageView = m_imageViews[i];
-        imageInfo.sampler = m_sampler;
-
-        descriptorWrites[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        descriptorWrites[i].dstSet = m_texturesDescriptorSet;
-        descriptorWrites[i].dstBinding = i;
-        descriptorWrites[i].dstArrayElement = 0;
-        descriptorWrites[i].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-        descriptorWrites[i].descriptorCount = 1;
-        descriptorWrites[i].pImageInfo = &imageInfo;
+        return;
     }
 
-    vkUpdateDescriptorSets(m_device, ui32Size(descriptorWrites), descriptorWrites.data(), 0, nullptr);
+    VkQueryPoolCreateInfo queryPoolInfo{};
+    queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    queryPoolInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+    // Every recording range has a depth pre-pass and a shading secondary at most
+    queryPoolInfo.queryCount = m_recordingRangeCount * 2;
+    queryPoolInfo.pipelineStatistics = c_pipelineStatistics;
+
+    m_statisticsQueries.resize(m_context.getSwapchainImages().size());
+    for (StatisticsQuery& query : m_statisticsQueries)
+    {
+        VK_CHECK(vkCreateQueryPool(m_device, &queryPoolInfo, nullptr, &query.queryPool));
+        query.capacity = queryPoolInfo.queryCount;
+    }
 }
 
-void Renderer::createVertexAndIndexBuffer()
+void Renderer::createAsyncCompute()
 {
-    VkPhysicalDevice physicalDevice = m_context.getPhysicalDevice();
-    const VkMemoryPropertyFlags memoryProperties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
-
-    const uint64_t vertexBufferSize = sizeof(Model::Vertex) * m_model->vertices.size();
-    const uint64_t indexBufferSize = sizeof(Model::Index) * m_model->indices.size();
-    const uint64_t bufferSize = vertexBufferSize + indexBufferSize;
-    m_offsetToIndexData = vertexBufferSize;
-    std::vector<uint8_t> data(bufferSize, 0);
-    std::memcpy(&data[0], m_model->vertices.data(), vertexBufferSize);
-    std::memcpy(&data[m_offsetToIndexData], m_model->indices.data(), indexBufferSize);
-    StagingBuffer stagingBuffer = createStagingBuffer(m_device, physicalDevice, data.data(), bufferSize);
-
-    VkBufferCreateInfo bufferInfo{};
-    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-    bufferInfo.size = bufferSize;
-    bufferInfo.usage = //
-        VK_BUFFER_USAGE_TRANSFER_DST_BIT | //
-        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | //
-        VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
-    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-
-    VK_CHECK(vkCreateBuffer(m_device, &bufferInfo, nullptr, &m_attributeBuffer));
-
-    VkMemoryRequirements memRequirements;
-    vkGetBufferMemoryRequirements(m_device, m_attributeBuffer, &memRequirements);
-
-    const MemoryTypeResult memoryTypeResult = findMemoryType(physicalDevice, memRequirements.memoryTypeBits, memoryProperties);
-    CHECK(memoryTypeResult.found);
-
-    VkMemoryAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize = memRequirements.size;
-    allocInfo.memoryTypeIndex = memoryTypeResult.typeIndex;
-
-    VK_CHECK(vkAllocateMemory(m_device, &allocInfo, nullptr, &m_attributeBufferMemory));
-    VK_CHECK(vkBindBufferMemory(m_device, m_attributeBuffer, m_attributeBufferMemory, 0));
-
-    const SingleTimeCommand command = beginSingleTimeCommands(m_context.getGraphicsCommandPool(), m_device);
-
-    VkBufferCopy vertexCopyRegion{};
-    vertexCopyRegion.size = bufferSize;
-    vertexCopyRegion.srcOffset = 0;
-    vertexCopyRegion.dstOffset = 0;
-
-    vkCmdCopyBuffer(command.commandBuffer, stagingBuffer.buffer, m_attributeBuffer, 1, &vertexCopyRegion);
-
-    endSingleTimeCommands(m_context.getGraphicsQueue(), command);
-
-    releaseStagingBuffer(m_device, stagingBuffer);
+    m_asyncCompute.reset(new AsyncCompute(m_context, getShaderFile("workload.comp.spv")));
 }
 
-void Renderer::allocateCommandBuffers()
+// Created before the depth image, which can only be transient when the pyramid is never built from it
+void Renderer::createGpuCulling()
 {
-    m_commandBuffers.resize(m_framebuffers.size());
-
-    VkCommandBufferAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-    allocInfo.commandPool = m_context.getGraphicsCommandPool();
-    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    allocInfo.commandBufferCount = ui32Size(m_commandBuffers);
+    m_gpuCulling.reset(new GpuCulling(m_context, getShaderFile("cull.comp.spv"), getShaderFile("pyramid.comp.spv")));
+}
 
-    VK_CHECK(vkAllocateCommandBuffers(m_device, &allocInfo, m_commandBuffers.data()));
+void Renderer::createRenderGraph()
+{
+    m_renderGraph.reset(new RenderGraph(m_context));
 }
 
 void Renderer::initializeGUI()
@@ -962,11 +2116,13 @@ void Renderer::initializeGUI()
     initData.instance = m_context.getInstance();
     initData.graphicsFamily = indices.graphicsFamily;
     initData.graphicsQueue = m_context.getGraphicsQueue();
+    initData.graphicsTimeline = &m_context.getGraphicsTimeline();
     initData.colorFormat = c_surfaceFormat.format;
     initData.depthFormat = c_depthFormat;
     initData.glfwWindow = m_context.getGlfwWindow();
     initData.imageCount = c_swapchainImageCount;
     initData.descriptorPool = m_descriptorPool;
+    initData.dynamicRendering = m_dynamicRendering;
 
     m_gui.reset(new GUI(initData));
 }
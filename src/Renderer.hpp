@@ -4,75 +4,245 @@
 #include "Camera.hpp"
 #include "Model.hpp"
 #include "GUI.hpp"
+#include "FileReader.hpp"
+#include "FrameAllocator.hpp"
+#include "JobSystem.hpp"
+#include "AsyncCompute.hpp"
+#include "GpuCulling.hpp"
+#include "Instances.hpp"
+#include "RenderQueue.hpp"
+#include "Scene.hpp"
+#include "GeometryPool.hpp"
+#include "RenderGraph.hpp"
 #include <vector>
+#include <array>
 #include <chrono>
 #include <unordered_map>
 #include <memory>
+#include <future>
+#include <string>
 
 class Renderer final
 {
 public:
-    Renderer(Context& context);
+    // Dynamic rendering replaces the render passes and framebuffers when the device supports it
+    Renderer(Context& context, bool dynamicRendering);
     ~Renderer();
 
     bool render();
+    // Loads a model of the models folder in the background and switches to it once it is on the GPU
+    void requestModel(const std::string& filename);
 
 private:
+    struct RecordingContext
+    {
+        VkCommandPool commandPool;
+        VkCommandBuffer commandBuffer;
+        // Depth pre-pass draws of the same range
+        VkCommandBuffer depthCommandBuffer;
+    };
+
+    // Visible instances of a primitive, their draw instances are consecutive
+    struct Draw
+    {
+        uint32_t primitive;
+        uint32_t firstInstance;
+        uint32_t instanceCount;
+
+        bool operator==(const Draw& other) const
+        {
+            return primitive == other.primitive && firstInstance == other.firstInstance && instanceCount == other.instanceCount;
+        }
+    };
+
+    // Secondaries of one swapchain image, reused until something they reference changes
+    struct SceneCommands
+    {
+        std::vector<VkCommandBuffer> commandBuffers;
+        uint32_t viewProjectionOffset = 0;
+        std::vector<Draw> draws;
+        RenderQueue::BindCounts bindCounts;
+        bool dirty = true;
+    };
+
+    // Pipeline statistics of the scene draws of one frame in flight, a query per scene secondary so that the GUI
+    // in the same pass isn't counted
+    struct StatisticsQuery
+    {
+        VkQueryPool queryPool = VK_NULL_HANDLE;
+        uint32_t capacity = 0;
+        // Secondaries executed by the last submission
+        uint32_t queryCount = 0;
+        bool depthPrePass = false;
+    };
+
+    struct SceneStatistics
+    {
+        uint64_t vertexInvocations = 0;
+        uint64_t fragmentInvocations = 0;
+        bool valid = false;
+    };
+
+    // A model that is being read by a job or uploaded by the graphics queue
+    struct SceneLoad
+    {
+        std::string filename;
+        JobSystem::JobHandle job;
+        std::unique_ptr<Model> model;
+        // Set instead of the model when the file can't be read or loaded
+        std::string error;
+        std::unique_ptr<Scene> scene;
+        SingleTimeCommand uploadCommand;
+        uint64_t uploadValue = 0;
+    };
+
     bool update(uint32_t imageIndex);
+    void buildRenderGraph(uint32_t imageIndex);
+    // The depth view is only used by dynamic rendering, the framebuffers have the depth image
+    void beginScenePass(VkCommandBuffer cb, uint32_t imageIndex, VkImageView depthImageView, bool storeDepth);
+    void endScenePass(VkCommandBuffer cb);
+    VkCommandBuffer recordGUI(uint32_t imageIndex);
+    // Whether the frame builds the depth pyramid, which is the only reader of the depth after the scene pass
+    bool isDepthStored() const;
+    std::vector<AttachmentOps> getAttachmentOps() const;
+    const std::vector<VkCommandBuffer>& recordScene(uint32_t imageIndex);
+    // depthOnly records the draws of the depth pre-pass, query is the secondary's index in the scene pass
+    void recordDrawRange(VkCommandBuffer cb, uint32_t imageIndex, bool depthOnly, uint32_t query, size_t firstDraw, size_t lastDraw, RenderQueue::BindCounts& bindCounts);
+    void recordIndirectDraws(VkCommandBuffer cb, uint32_t imageIndex, bool depthOnly, uint32_t query, RenderQueue::BindCounts& bindCounts);
+    void beginSceneCommandBuffer(VkCommandBuffer cb, uint32_t imageIndex, bool depthOnly, uint32_t query, RenderQueue::BindCounts& bindCounts);
+    void endSceneCommandBuffer(VkCommandBuffer cb, uint32_t imageIndex, uint32_t query);
+    VkPipeline getScenePipeline(bool depthOnly) const;
+    void readSceneStatistics(uint32_t imageIndex);
+    void cullScene(uint32_t imageIndex);
+    void sortDraws();
+    Culling::Planes getCullingPlanes() const;
+    void invalidateSceneCommands();
+    void updateInstances();
+    uint32_t getInstanceCount() const;
+    void updateSceneLoad(bool wait);
+    void requestQueuedModel();
 
-    void loadModel();
-    void releaseModel();
+    void requestFiles();
+    FileReader::Data getShaderFile(const std::string& filename);
+    void findModelFiles();
     void setupCamera();
     void updateCamera(double deltaTime);
+    void drawMemoryPanel();
+    void drawRenderingPanel();
+    void drawModelPanel();
+    void recreateSwapchainResources();
+    void destroySwapchainResources();
     void createRenderPass();
     void createDepthImage();
     void createSwapchainImageViews();
     void createFramebuffers();
     void createSampler();
-    void createTextures();
-    void createUboDescriptorSetLayouts();
-    void createTexturesDescriptorSetLayouts();
+    void createFrameDescriptorSetLayout();
+    void createBindlessDescriptorSetLayout();
+    void createGeometryPool();
+    void createInstances();
     void createGraphicsPipeline();
     void createDescriptorPool();
-    void createUboDescriptorSets();
-    void createTextureDescriptorSet();
-    void createUniformBuffer();
-    void updateUboDescriptorSets();
-    void updateTexturesDescriptorSet();
-    void createVertexAndIndexBuffer();
+    void createFrameDescriptorSet();
+    void createFrameAllocator();
+    void updateFrameDescriptorSet();
     void allocateCommandBuffers();
+    void createRecordingContexts();
+    void createStatisticsQueries();
+    void createAsyncCompute();
+    void createGpuCulling();
+    void createRenderGraph();
     void initializeGUI();
 
     Context& m_context;
     VkDevice m_device;
+    MemoryAllocator& m_memoryAllocator;
+    VkExtent2D m_extent;
+    uint32_t m_swapchainGeneration;
 
-    std::unique_ptr<Model> m_model{nullptr};
+    JobSystem m_jobSystem;
+    FileReader m_fileReader;
+    std::unordered_map<std::string, std::future<FileReader::Result>> m_shaderFiles;
+    std::vector<std::string> m_modelFilenames;
+    std::unique_ptr<GeometryPool> m_geometryPool;
+    // Generation of the pool that the recorded scene commands use
+    uint32_t m_geometryGeneration = 0;
+    // Compaction retires the buffers the current frame's commands use so it waits for the next update
+    bool m_compactGeometry = false;
+    std::unique_ptr<Scene> m_scene;
+    std::unique_ptr<SceneLoad> m_sceneLoad;
+    std::string m_queuedModelFilename;
+    // Of the last load that failed, the current scene stays
+    std::string m_modelLoadError;
     Camera m_camera;
     std::chrono::steady_clock::time_point m_lastRenderTime;
+    double m_frameMilliseconds = 0.0;
     std::unordered_map<int, bool> m_keysDown;
-    VkRenderPass m_renderPass;
+    // Draws of the scene that are recorded this frame, in the order of m_renderQueue once sorted
+    std::vector<Draw> m_visibleDraws;
+    // View depth of the nearest visible instance of every draw
+    std::vector<float> m_visibleDrawDepths;
+    std::vector<Draw> m_sortedDraws;
+    RenderQueue m_renderQueue;
+    bool m_sortDraws = true;
+    double m_sortMicroseconds = 0.0;
+    // Binds of the scene commands submitted last
+    RenderQueue::BindCounts m_bindCounts;
+    // Indices of the visible (primitive, instance) pairs, primitive * instance count + instance
+    std::vector<uint32_t> m_visibleObjects;
+    // Bounds of every (primitive, instance) pair in the same order
+    Culling::Bounds m_instanceBounds;
+    uint32_t m_visibleInstanceCount = 0;
+    // Copies of the scene for stress tests, limited by c_maxDrawInstances for scenes with many primitives
+    uint32_t m_requestedInstanceCount = 1;
+    bool m_instancesDirty = true;
+    bool m_frustumCulling = true;
+    // Culls and emits the draws on the GPU instead of the CPU
+    bool m_gpuDriven = true;
+    double m_cullingMicroseconds = 0.0;
+    // Set once at startup, the pipeline and the recordings are made for one or the other
+    bool m_dynamicRendering = false;
+    // Draws the GUI in a secondary of the scene pass instead of a render pass of its own that loads the attachments again
+    bool m_guiInScenePass = true;
+    VkRenderPass m_renderPass = VK_NULL_HANDLE;
+    VkRenderPass m_discardDepthRenderPass = VK_NULL_HANDLE;
     VkImage m_depthImage;
-    VkDeviceMemory m_depthImageMemory;
+    MemoryAllocation m_depthImageMemory;
+    // Nothing ever samples the depth without occlusion culling support
+    bool m_depthTransient = false;
     std::vector<VkImageView> m_swapchainImageViews;
     VkImageView m_depthImageView;
     std::vector<VkFramebuffer> m_framebuffers;
     VkSampler m_sampler;
-    std::vector<VkImage> m_images;
-    std::vector<VkDeviceMemory> m_imageMemories;
-    std::vector<VkImageView> m_imageViews;
-    VkDescriptorSetLayout m_uboDescriptorSetLayout;
-    VkDescriptorSetLayout m_texturesDescriptorSetLayout;
+    uint32_t m_bindlessTextureCapacity;
+    uint32_t m_bindlessSetCount = 0;
+    VkDescriptorSetLayout m_frameDescriptorSetLayout;
+    VkDescriptorSetLayout m_bindlessDescriptorSetLayout;
     VkPipelineLayout m_pipelineLayout;
     VkPipeline m_graphicsPipeline;
+    // Draws depth from the position stream, then the scene is shaded where the depth is equal
+    bool m_depthPrePass = false;
+    VkPipeline m_depthPrePassPipeline;
+    VkPipeline m_equalDepthPipeline;
+    // Empty without pipeline statistics support
+    std::vector<StatisticsQuery> m_statisticsQueries;
+    // Last results without and with the depth pre-pass
+    std::array<SceneStatistics, 2> m_sceneStatistics;
     VkDescriptorPool m_descriptorPool;
-    std::vector<VkDescriptorSet> m_uboDescriptorSets;
-    VkDescriptorSet m_texturesDescriptorSet;
-    VkBuffer m_uniformBuffer;
-    VkDeviceMemory m_uniformBufferMemory;
-    VkDeviceSize m_offsetToIndexData;
-    VkBuffer m_attributeBuffer;
-    VkDeviceMemory m_attributeBufferMemory;
-    size_t m_numIndices;
+    VkDescriptorPool m_bindlessDescriptorPool;
+    VkDescriptorSet m_frameDescriptorSet;
+    std::unique_ptr<FrameAllocator> m_frameAllocator;
+    uint32_t m_viewProjectionOffset;
     std::vector<VkCommandBuffer> m_commandBuffers;
+    uint32_t m_recordingRangeCount;
+    std::vector<RecordingContext> m_recordingContexts;
+    std::vector<RecordingContext> m_guiRecordingContexts;
+    std::vector<SceneCommands> m_sceneCommands;
+    bool m_cacheSceneCommands = true;
+    uint64_t m_sceneRecordingCount = 0;
+    std::unique_ptr<AsyncCompute> m_asyncCompute;
+    std::unique_ptr<GpuCulling> m_gpuCulling;
+    std::unique_ptr<Instances> m_instances;
+    std::unique_ptr<RenderGraph> m_renderGraph;
     std::unique_ptr<GUI> m_gui;
 };
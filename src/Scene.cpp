@@ -0,0 +1,564 @@
+#include "Scene.hpp"
+#include "DeletionQueue.hpp"
+#include "JobSystem.hpp"
+#include "DebugMarker.hpp"
+#include "Utils.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <tuple>
+#include <unordered_map>
+
+namespace
+{
+const VkImageSubresourceRange c_defaultSubresourceRance{VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+
+VkFormat getImageFormat(const Model::Image& image)
+{
+    CHECK(image.components == 4);
+    if (image.bitsPerChannel == 8)
+    {
+        return VK_FORMAT_R8G8B8A8_UNORM;
+    }
+    if (image.bitsPerChannel == 16)
+    {
+        return VK_FORMAT_R16G16B16A16_UNORM;
+    }
+    LOGE("Unsupported image format");
+    return VK_FORMAT_UNDEFINED;
+}
+
+// FNV-1a over the dimensions and pixels
+uint64_t hashImage(const Model::Image& image)
+{
+    uint64_t hash = 14695981039346656037ull;
+    auto add = [&hash](const unsigned char* data, size_t size) {
+        for (size_t i = 0; i < size; ++i)
+        {
+            hash = (hash ^ data[i]) * 1099511628211ull;
+        }
+    };
+    const uint32_t dimensions[] = {image.width, image.height, image.components, image.bitsPerChannel};
+    add(reinterpret_cast<const unsigned char*>(dimensions), sizeof(dimensions));
+    add(image.data.data(), image.data.size());
+    return hash;
+}
+
+// Returns the images that materials use, imageRemap maps every image to the unique image it was merged with
+std::vector<int> getUniqueImages(const Model& model, JobSystem& jobSystem, std::vector<int>& imageRemap)
+{
+    const std::vector<Model::Image>& images = model.images;
+    imageRemap.resize(images.size());
+
+    std::vector<bool> used(images.size(), false);
+    for (const Model::Material& material : model.materials)
+    {
+        for (int imageIndex : {material.baseColor, material.metallicRoughnessImage, material.normalImage, material.emissiveImage, material.occlusionImage})
+        {
+            if (imageIndex >= 0)
+            {
+                used[imageIndex] = true;
+            }
+        }
+    }
+
+    // Hashing reads every pixel so it runs in parallel, merging stays sequential to keep the first image of a group
+    std::vector<uint64_t> hashes(images.size(), 0);
+    jobSystem.parallelFor(images.size(), 1, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i)
+        {
+            if (used[i])
+            {
+                hashes[i] = hashImage(images[i]);
+            }
+        }
+    });
+
+    // Different image entries can still carry identical pixels, those are merged by content hash
+    std::unordered_map<uint64_t, std::vector<int>> imagesByHash;
+    std::vector<int> uniqueImages;
+    for (size_t i = 0; i < images.size(); ++i)
+    {
+        imageRemap[i] = static_cast<int>(i);
+        if (!used[i])
+        {
+            continue;
+        }
+
+        std::vector<int>& candidates = imagesByHash[hashes[i]];
+        for (int candidate : candidates)
+        {
+            const Model::Image& other = images[candidate];
+            if (other.width == images[i].width && other.height == images[i].height && other.data == images[i].data)
+            {
+                imageRemap[i] = candidate;
+                break;
+            }
+        }
+
+        if (imageRemap[i] == static_cast<int>(i))
+        {
+            candidates.push_back(static_cast<int>(i));
+            uniqueImages.push_back(static_cast<int>(i));
+        }
+    }
+
+    return uniqueImages;
+}
+} // namespace
+
+Scene::Scene(Context& context,
+             JobSystem& jobSystem,
+             const std::string& name,
+             const Model& model,
+             GeometryPool& geometryPool,
+             VkDescriptorPool descriptorPool,
+             VkDescriptorSetLayout descriptorSetLayout,
+             uint32_t textureCapacity,
+             VkCommandBuffer uploadCommandBuffer) :
+    m_context(context),
+    m_device(context.getDevice()),
+    m_memoryAllocator(context.getMemoryAllocator()),
+    m_geometryPool(geometryPool),
+    m_name(name),
+    m_descriptorPool(descriptorPool),
+    m_textureCapacity(textureCapacity)
+{
+    createDescriptorSet(descriptorSetLayout);
+    createTextures(model, jobSystem, uploadCommandBuffer);
+    createMaterialBuffer(uploadCommandBuffer);
+    createGeometry(model, uploadCommandBuffer);
+    createPrimitives(model);
+    createObjectBuffer(uploadCommandBuffer);
+    addUploadBarrier(uploadCommandBuffer);
+}
+
+Scene::~Scene()
+{
+    DeletionQueue& deletionQueue = m_context.getDeletionQueue();
+
+    // Staging buffers are only left when the upload was never waited for
+    for (StagingBuffer& stagingBuffer : m_stagingBuffers)
+    {
+        deletionQueue.destroyBuffer(stagingBuffer.buffer);
+        deletionQueue.releaseMemory(stagingBuffer.allocation);
+    }
+
+    GeometryPool& geometryPool = m_geometryPool;
+    const uint32_t geometry = m_geometry;
+    deletionQueue.push([&geometryPool, geometry]() {
+        geometryPool.free(geometry);
+    });
+    deletionQueue.destroyBuffer(m_materialBuffer);
+    deletionQueue.releaseMemory(m_materialBufferMemory);
+    deletionQueue.destroyBuffer(m_objectBuffer);
+    deletionQueue.releaseMemory(m_objectBufferMemory);
+
+    for (const VkImageView& imageView : m_imageViews)
+    {
+        deletionQueue.destroyImageView(imageView);
+    }
+
+    for (const VkImage& image : m_images)
+    {
+        deletionQueue.destroyImage(image);
+    }
+
+    for (MemoryAllocation& imageMemory : m_imageMemories)
+    {
+        deletionQueue.releaseMemory(imageMemory);
+    }
+
+    deletionQueue.freeDescriptorSet(m_descriptorPool, m_descriptorSet);
+}
+
+// Must only be called once the upload command buffer has finished
+void Scene::releaseStagingBuffers()
+{
+    for (StagingBuffer& stagingBuffer : m_stagingBuffers)
+    {
+        m_memoryAllocator.releaseStagingBuffer(stagingBuffer);
+    }
+    m_stagingBuffers.clear();
+}
+
+const std::string& Scene::getName() const
+{
+    return m_name;
+}
+
+VkDescriptorSet Scene::getDescriptorSet() const
+{
+    return m_descriptorSet;
+}
+
+int32_t Scene::getVertexOffset() const
+{
+    return m_geometryPool.getVertexOffset(m_geometry);
+}
+
+uint32_t Scene::getFirstIndex() const
+{
+    return m_geometryPool.getFirstIndex(m_geometry);
+}
+
+const std::vector<Model::Primitive>& Scene::getPrimitives() const
+{
+    return m_primitives;
+}
+
+const Culling::Bounds& Scene::getBounds() const
+{
+    return m_bounds;
+}
+
+VkBuffer Scene::getObjectBuffer() const
+{
+    return m_objectBuffer;
+}
+
+void Scene::createDescriptorSet(VkDescriptorSetLayout descriptorSetLayout)
+{
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = m_descriptorPool;
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &descriptorSetLayout;
+
+    VK_CHECK(vkAllocateDescriptorSets(m_device, &allocInfo, &m_descriptorSet));
+    DebugMarker::setObjectName(VK_OBJECT_TYPE_DESCRIPTOR_SET, (uint64_t)m_descriptorSet, m_name + " bindless set");
+}
+
+void Scene::createTextures(const Model& model, JobSystem& jobSystem, VkCommandBuffer cb)
+{
+    const std::vector<Model::Image>& images = model.images;
+    std::vector<int> imageRemap;
+    const std::vector<int> uniqueImages = getUniqueImages(model, jobSystem, imageRemap);
+
+    // Images with the same size and format are packed as layers of one array image
+    std::map<std::tuple<uint32_t, uint32_t, VkFormat>, std::vector<int>> groups;
+    for (int imageIndex : uniqueImages)
+    {
+        const Model::Image& image = images[imageIndex];
+        groups[{image.width, image.height, getImageFormat(image)}].push_back(imageIndex);
+    }
+
+    std::vector<TextureSlot> imageSlots(images.size());
+    for (const auto& [key, group] : groups)
+    {
+        const int32_t arrayIndex = static_cast<int32_t>(m_images.size());
+        createTextureArray(model, group, cb);
+        for (size_t layer = 0; layer < group.size(); ++layer)
+        {
+            imageSlots[group[layer]] = {arrayIndex, static_cast<int32_t>(layer)};
+        }
+    }
+
+    // Duplicates point to the slot of the image they were merged with
+    for (size_t i = 0; i < images.size(); ++i)
+    {
+        if (imageRemap[i] != static_cast<int>(i))
+        {
+            imageSlots[i] = imageSlots[imageRemap[i]];
+        }
+    }
+
+    auto getSlot = [&imageSlots](int imageIndex) {
+        return imageIndex >= 0 ? imageSlots[imageIndex] : TextureSlot{};
+    };
+
+    for (const Model::Material& material : model.materials)
+    {
+        MaterialData materialData;
+        materialData.baseColor = getSlot(material.baseColor);
+        materialData.metallicRoughness = getSlot(material.metallicRoughnessImage);
+        materialData.normal = getSlot(material.normalImage);
+        materialData.emissive = getSlot(material.emissiveImage);
+        materialData.occlusion = getSlot(material.occlusionImage);
+        m_materialData.push_back(materialData);
+    }
+
+    // Default material for primitives that have none
+    m_materialData.push_back(MaterialData{});
+
+    printf("%s: %zu unique images of %zu in %zu texture arrays\n", m_name.c_str(), uniqueImages.size(), images.size(), m_images.size());
+}
+
+void Scene::createTextureArray(const Model& model, const std::vector<int>& imageIndices, VkCommandBuffer cb)
+{
+    CHECK(m_images.size() < m_textureCapacity);
+
+    const Model::Image& firstImage = model.images[imageIndices[0]];
+    const VkFormat format = getImageFormat(firstImage);
+    const uint32_t layerCount = ui32Size(imageIndices);
+    const size_t layerSize = firstImage.data.size();
+
+    std::vector<unsigned char> data(layerSize * layerCount);
+    for (size_t layer = 0; layer < imageIndices.size(); ++layer)
+    {
+        const Model::Image& image = model.images[imageIndices[layer]];
+        CHECK(image.data.size() == layerSize);
+        std::memcpy(&data[layer * layerSize], image.data.data(), layerSize);
+    }
+
+    const VkBuffer stagingBuffer = createStagingBuffer(data.data(), data.size());
+
+    VkImageCreateInfo imageInfo{};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.extent.width = firstImage.width;
+    imageInfo.extent.height = firstImage.height;
+    imageInfo.extent.depth = 1;
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = layerCount;
+    imageInfo.format = format;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    imageInfo.flags = 0;
+
+    VkImage image;
+    VK_CHECK(vkCreateImage(m_device, &imageInfo, nullptr, &image));
+    DebugMarker::setObjectName(VK_OBJECT_TYPE_IMAGE, (uint64_t)image, m_name + " texture array " + std::to_string(m_images.size()));
+
+    const MemoryAllocation memory = m_memoryAllocator.allocateForImage(image, MemoryUsage::GpuOnly, MemoryCategory::Textures);
+
+    VkImageSubresourceRange subresourceRange = c_defaultSubresourceRance;
+    subresourceRange.layerCount = layerCount;
+
+    {
+        VkImageMemoryBarrier transferDstBarrier{};
+        transferDstBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        transferDstBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        transferDstBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        transferDstBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        transferDstBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        transferDstBarrier.image = image;
+        transferDstBarrier.subresourceRange = subresourceRange;
+        transferDstBarrier.srcAccessMask = 0;
+        transferDstBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+        VkImageMemoryBarrier readOnlyBarrier = transferDstBarrier;
+        readOnlyBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        readOnlyBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        readOnlyBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        readOnlyBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+        const VkPipelineStageFlags transferSrcFlags = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+        const VkPipelineStageFlags transferDstFlags = VK_PIPELINE_STAGE_TRANSFER_BIT;
+        const VkPipelineStageFlags readOnlySrcFlags = transferDstFlags;
+        const VkPipelineStageFlags readOnlyDstFlags = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+
+        std::vector<VkBufferImageCopy> regions(layerCount);
+        for (uint32_t layer = 0; layer < layerCount; ++layer)
+        {
+            VkBufferImageCopy& region = regions[layer];
+            region.bufferOffset = layer * layerSize;
+            region.bufferRowLength = 0;
+            region.bufferImageHeight = 0;
+            region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            region.imageSubresource.mipLevel = 0;
+            region.imageSubresource.baseArrayLayer = layer;
+            region.imageSubresource.layerCount = 1;
+            region.imageOffset = {0, 0, 0};
+            region.imageExtent = {firstImage.width, firstImage.height, 1};
+        }
+
+        vkCmdPipelineBarrier(cb, transferSrcFlags, transferDstFlags, 0, 0, nullptr, 0, nullptr, 1, &transferDstBarrier);
+        vkCmdCopyBufferToImage(cb, stagingBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, ui32Size(regions), regions.data());
+        vkCmdPipelineBarrier(cb, readOnlySrcFlags, readOnlyDstFlags, 0, 0, nullptr, 0, nullptr, 1, &readOnlyBarrier);
+    }
+
+    VkImageViewCreateInfo viewInfo{};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = image;
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+    viewInfo.format = format;
+    viewInfo.subresourceRange = subresourceRange;
+
+    VkImageView imageView;
+    VK_CHECK(vkCreateImageView(m_device, &viewInfo, nullptr, &imageView));
+
+    m_images.push_back(image);
+    m_imageMemories.push_back(memory);
+    m_imageViews.push_back(imageView);
+
+    writeTextureDescriptor(ui32Size(m_imageViews) - 1);
+}
+
+void Scene::writeTextureDescriptor(uint32_t arrayIndex)
+{
+    VkDescriptorImageInfo imageInfo{};
+    imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    imageInfo.imageView = m_imageViews[arrayIndex];
+    imageInfo.sampler = VK_NULL_HANDLE;
+
+    VkWriteDescriptorSet descriptorWrite{};
+    descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    descriptorWrite.dstSet = m_descriptorSet;
+    descriptorWrite.dstBinding = 1;
+    descriptorWrite.dstArrayElement = arrayIndex;
+    descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+    descriptorWrite.descriptorCount = 1;
+    descriptorWrite.pImageInfo = &imageInfo;
+
+    vkUpdateDescriptorSets(m_device, 1, &descriptorWrite, 0, nullptr);
+}
+
+void Scene::createMaterialBuffer(VkCommandBuffer cb)
+{
+    const uint64_t bufferSize = sizeof(MaterialData) * m_materialData.size();
+    const VkBuffer stagingBuffer = createStagingBuffer(m_materialData.data(), bufferSize);
+
+    VkBufferCreateInfo bufferInfo{};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = bufferSize;
+    bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    VK_CHECK(vkCreateBuffer(m_device, &bufferInfo, nullptr, &m_materialBuffer));
+    DebugMarker::setObjectName(VK_OBJECT_TYPE_BUFFER, (uint64_t)m_materialBuffer, m_name + " material buffer");
+
+    m_materialBufferMemory = m_memoryAllocator.allocateForBuffer(m_materialBuffer, MemoryUsage::GpuOnly, MemoryCategory::Uniform);
+
+    VkBufferCopy copyRegion{};
+    copyRegion.size = bufferSize;
+    vkCmdCopyBuffer(cb, stagingBuffer, m_materialBuffer, 1, &copyRegion);
+
+    VkDescriptorBufferInfo materialBufferInfo{};
+    materialBufferInfo.buffer = m_materialBuffer;
+    materialBufferInfo.offset = 0;
+    materialBufferInfo.range = VK_WHOLE_SIZE;
+
+    VkWriteDescriptorSet descriptorWrite{};
+    descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    descriptorWrite.dstSet = m_descriptorSet;
+    descriptorWrite.dstBinding = 2;
+    descriptorWrite.dstArrayElement = 0;
+    descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    descriptorWrite.descriptorCount = 1;
+    descriptorWrite.pBufferInfo = &materialBufferInfo;
+
+    vkUpdateDescriptorSets(m_device, 1, &descriptorWrite, 0, nullptr);
+}
+
+// The copies target the pool's current buffers, allocating may replace them but nothing else allocates until the
+// upload has been submitted
+void Scene::createGeometry(const Model& model, VkCommandBuffer cb)
+{
+    m_geometry = m_geometryPool.allocate(ui32Size(model.vertices), ui32Size(model.indices));
+
+    const uint64_t vertexDataSize = sizeof(Model::Vertex) * model.vertices.size();
+    const uint64_t positionDataSize = sizeof(glm::vec3) * model.vertices.size();
+    const uint64_t indexDataSize = sizeof(Model::Index) * model.indices.size();
+    if (vertexDataSize + indexDataSize == 0)
+    {
+        return;
+    }
+
+    // Vertices, their positions alone and indices
+    std::vector<uint8_t> data(vertexDataSize + positionDataSize + indexDataSize, 0);
+    std::memcpy(&data[0], model.vertices.data(), vertexDataSize);
+    glm::vec3* positions = reinterpret_cast<glm::vec3*>(&data[vertexDataSize]);
+    for (size_t i = 0; i < model.vertices.size(); ++i)
+    {
+        positions[i] = model.vertices[i].position;
+    }
+    std::memcpy(&data[vertexDataSize + positionDataSize], model.indices.data(), indexDataSize);
+    const VkBuffer stagingBuffer = createStagingBuffer(data.data(), data.size());
+
+    VkBufferCopy copyRegion{};
+    if (vertexDataSize > 0)
+    {
+        const uint64_t vertexOffset = static_cast<uint64_t>(m_geometryPool.getVertexOffset(m_geometry));
+        copyRegion.srcOffset = 0;
+        copyRegion.dstOffset = sizeof(Model::Vertex) * vertexOffset;
+        copyRegion.size = vertexDataSize;
+        vkCmdCopyBuffer(cb, stagingBuffer, m_geometryPool.getVertexBuffer(), 1, &copyRegion);
+
+        copyRegion.srcOffset = vertexDataSize;
+        copyRegion.dstOffset = sizeof(glm::vec3) * vertexOffset;
+        copyRegion.size = positionDataSize;
+        vkCmdCopyBuffer(cb, stagingBuffer, m_geometryPool.getPositionBuffer(), 1, &copyRegion);
+    }
+    if (indexDataSize > 0)
+    {
+        copyRegion.srcOffset = vertexDataSize + positionDataSize;
+        copyRegion.dstOffset = sizeof(Model::Index) * static_cast<uint64_t>(m_geometryPool.getFirstIndex(m_geometry));
+        copyRegion.size = indexDataSize;
+        vkCmdCopyBuffer(cb, stagingBuffer, m_geometryPool.getIndexBuffer(), 1, &copyRegion);
+    }
+}
+
+void Scene::createPrimitives(const Model& model)
+{
+    m_primitives = model.primitives;
+    const int defaultMaterial = static_cast<int>(model.materials.size());
+    for (Model::Primitive& primitive : m_primitives)
+    {
+        if (primitive.material < 0)
+        {
+            primitive.material = defaultMaterial;
+        }
+        Culling::addBox(m_bounds, primitive.boundsMin, primitive.boundsMax);
+    }
+}
+
+void Scene::createObjectBuffer(VkCommandBuffer cb)
+{
+    std::vector<ObjectData> objects(m_primitives.size());
+    for (size_t i = 0; i < m_primitives.size(); ++i)
+    {
+        const Model::Primitive& primitive = m_primitives[i];
+        ObjectData& object = objects[i];
+        object.center = glm::vec4((primitive.boundsMin + primitive.boundsMax) * 0.5f, 0.0f);
+        object.extent = glm::vec4((primitive.boundsMax - primitive.boundsMin) * 0.5f, 0.0f);
+        object.indexCount = primitive.indexCount;
+        object.firstIndex = primitive.firstIndex;
+        object.vertexOffset = primitive.vertexOffset;
+        object.materialIndex = static_cast<uint32_t>(primitive.material);
+    }
+
+    // An empty model still gets a buffer so that descriptors never point to a null buffer
+    objects.resize(std::max<size_t>(objects.size(), 1));
+    const uint64_t bufferSize = sizeof(ObjectData) * objects.size();
+    const VkBuffer stagingBuffer = createStagingBuffer(objects.data(), bufferSize);
+
+    VkBufferCreateInfo bufferInfo{};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = bufferSize;
+    bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    VK_CHECK(vkCreateBuffer(m_device, &bufferInfo, nullptr, &m_objectBuffer));
+    DebugMarker::setObjectName(VK_OBJECT_TYPE_BUFFER, (uint64_t)m_objectBuffer, m_name + " object buffer");
+
+    m_objectBufferMemory = m_memoryAllocator.allocateForBuffer(m_objectBuffer, MemoryUsage::GpuOnly, MemoryCategory::Geometry);
+
+    VkBufferCopy copyRegion{};
+    copyRegion.size = bufferSize;
+    vkCmdCopyBuffer(cb, stagingBuffer, m_objectBuffer, 1, &copyRegion);
+}
+
+// Frames submitted after the upload read the buffers without waiting on it, so the copies are made visible here
+void Scene::addUploadBarrier(VkCommandBuffer cb)
+{
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+
+    const VkPipelineStageFlags srcFlags = VK_PIPELINE_STAGE_TRANSFER_BIT;
+    const VkPipelineStageFlags dstFlags = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+
+    vkCmdPipelineBarrier(cb, srcFlags, dstFlags, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+VkBuffer Scene::createStagingBuffer(const void* data, VkDeviceSize size)
+{
+    m_stagingBuffers.push_back(m_memoryAllocator.createStagingBuffer(data, size));
+    return m_stagingBuffers.back().buffer;
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include "Context.hpp"
+#include "Model.hpp"
+#include "MemoryAllocator.hpp"
+#include "Culling.hpp"
+#include "GeometryPool.hpp"
+#include <vector>
+#include <string>
+
+class JobSystem;
+
+// GPU copy of one model: texture arrays, materials, a range of the geometry pool and the bindless descriptor set that
+// points to them.
+// Uploads are recorded into a command buffer of the caller so that a scene can be built while another one renders,
+// the staging buffers are released once that command buffer has finished. Destroying a scene retires its objects
+// through the deletion queue so frames that are still in flight can keep using them.
+class Scene final
+{
+public:
+    Scene(Context& context,
+          JobSystem& jobSystem,
+          const std::string& name,
+          const Model& model,
+          GeometryPool& geometryPool,
+          VkDescriptorPool descriptorPool,
+          VkDescriptorSetLayout descriptorSetLayout,
+          uint32_t textureCapacity,
+          VkCommandBuffer uploadCommandBuffer);
+    ~Scene();
+
+    void releaseStagingBuffers();
+
+    const std::string& getName() const;
+    VkDescriptorSet getDescriptorSet() const;
+    // Start of the scene's range in the geometry pool, added to the offsets of its primitives when drawing
+    int32_t getVertexOffset() const;
+    uint32_t getFirstIndex() const;
+    // Primitives without a material point to the default material after the model's own. Their offsets are relative
+    // to the scene's range of the geometry pool.
+    const std::vector<Model::Primitive>& getPrimitives() const;
+    // Bounds of the primitives in the same order
+    const Culling::Bounds& getBounds() const;
+    // Bounds and draw arguments of every primitive for culling on the GPU
+    VkBuffer getObjectBuffer() const;
+
+private:
+    // Array -1 means the slot has no texture
+    struct TextureSlot
+    {
+        int32_t array = -1;
+        int32_t layer = -1;
+    };
+
+    // Matches the Material struct of the material buffer in shader.frag
+    struct MaterialData
+    {
+        TextureSlot baseColor;
+        TextureSlot metallicRoughness;
+        TextureSlot normal;
+        TextureSlot emissive;
+        TextureSlot occlusion;
+    };
+
+    // Matches the Object struct of cull.comp
+    struct ObjectData
+    {
+        glm::vec4 center;
+        glm::vec4 extent;
+        uint32_t indexCount;
+        uint32_t firstIndex;
+        int32_t vertexOffset;
+        uint32_t materialIndex;
+    };
+
+    void createDescriptorSet(VkDescriptorSetLayout descriptorSetLayout);
+    void createTextures(const Model& model, JobSystem& jobSystem, VkCommandBuffer cb);
+    void createTextureArray(const Model& model, const std::vector<int>& imageIndices, VkCommandBuffer cb);
+    void writeTextureDescriptor(uint32_t arrayIndex);
+    void createMaterialBuffer(VkCommandBuffer cb);
+    void createGeometry(const Model& model, VkCommandBuffer cb);
+    void createPrimitives(const Model& model);
+    void createObjectBuffer(VkCommandBuffer cb);
+    void addUploadBarrier(VkCommandBuffer cb);
+    VkBuffer createStagingBuffer(const void* data, VkDeviceSize size);
+
+    Context& m_context;
+    VkDevice m_device;
+    MemoryAllocator& m_memoryAllocator;
+    GeometryPool& m_geometryPool;
+    std::string m_name;
+    VkDescriptorPool m_descriptorPool;
+    uint32_t m_textureCapacity;
+    VkDescriptorSet m_descriptorSet;
+    std::vector<VkImage> m_images;
+    std::vector<MemoryAllocation> m_imageMemories;
+    std::vector<VkImageView> m_imageViews;
+    std::vector<MaterialData> m_materialData;
+    VkBuffer m_materialBuffer;
+    MemoryAllocation m_materialBufferMemory;
+    uint32_t m_geometry;
+    std::vector<Model::Primitive> m_primitives;
+    Culling::Bounds m_bounds;
+    VkBuffer m_objectBuffer;
+    MemoryAllocation m_objectBufferMemory;
+    std::vector<StagingBuffer> m_stagingBuffers;
+};
@@ -0,0 +1,76 @@
+#include "Timeline.hpp"
+
+namespace
+{
+const uint64_t c_timeout = 10'000'000'000;
+} // namespace
+
+Timeline::Timeline(VkDevice device) :
+    m_device(device)
+{
+    VkSemaphoreTypeCreateInfo typeInfo{};
+    typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+    typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    typeInfo.initialValue = 0;
+
+    VkSemaphoreCreateInfo semaphoreInfo{};
+    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    semaphoreInfo.pNext = &typeInfo;
+
+    VK_CHECK(vkCreateSemaphore(m_device, &semaphoreInfo, nullptr, &m_semaphore));
+}
+
+Timeline::~Timeline()
+{
+    vkDestroySemaphore(m_device, m_semaphore, nullptr);
+}
+
+VkSemaphore Timeline::getSemaphore() const
+{
+    return m_semaphore;
+}
+
+uint64_t Timeline::advance()
+{
+    return ++m_lastSubmittedValue;
+}
+
+uint64_t Timeline::getNextValue() const
+{
+    return m_lastSubmittedValue + 1;
+}
+
+uint64_t Timeline::getLastSubmittedValue() const
+{
+    return m_lastSubmittedValue;
+}
+
+uint64_t Timeline::getCompletedValue()
+{
+    VK_CHECK(vkGetSemaphoreCounterValue(m_device, m_semaphore, &m_completedValue));
+    return m_completedValue;
+}
+
+// The cached value answers most polls without a call into the driver
+bool Timeline::isCompleted(uint64_t value)
+{
+    return value <= m_completedValue || value <= getCompletedValue();
+}
+
+void Timeline::wait(uint64_t value)
+{
+    if (isCompleted(value))
+    {
+        return;
+    }
+    CHECK(value <= m_lastSubmittedValue);
+
+    VkSemaphoreWaitInfo waitInfo{};
+    waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+    waitInfo.semaphoreCount = 1;
+    waitInfo.pSemaphores = &m_semaphore;
+    waitInfo.pValues = &value;
+
+    VK_CHECK(vkWaitSemaphores(m_device, &waitInfo, c_timeout));
+    m_completedValue = value;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include "VulkanUtils.hpp"
+#include <cstdint>
+
+// Timeline semaphore of one queue. Every submission to the queue signals the next value so a value identifies a
+// submission: resources remember the value of their last use and are free once the timeline has reached it.
+class Timeline final
+{
+public:
+    explicit Timeline(VkDevice device);
+    ~Timeline();
+
+    VkSemaphore getSemaphore() const;
+
+    // Reserves the value that the next submission signals
+    uint64_t advance();
+    uint64_t getNextValue() const;
+    uint64_t getLastSubmittedValue() const;
+
+    uint64_t getCompletedValue();
+    bool isCompleted(uint64_t value);
+    void wait(uint64_t value);
+
+private:
+    VkDevice m_device;
+    VkSemaphore m_semaphore;
+    uint64_t m_lastSubmittedValue = 0;
+    uint64_t m_completedValue = 0;
+};
@@ -1,9 +1,8 @@
 #include "VulkanUtils.hpp"
-#include "DebugMarker.hpp"
+#include "Timeline.hpp"
 #include <GLFW/glfw3.h>
 #include <set>
 #include <string>
-#include <fstream>
 
 void printInstanceLayers()
 {
@@ -63,30 +62,34 @@ QueueFamilyIndices getQueueFamilies(VkPhysicalDevice physicalDevice, VkSurfaceKH
     std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
     vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilies.data());
 
+    // Compute prefers a family without graphics so that its work can run alongside the graphics queue
     QueueFamilyIndices indices;
+    bool dedicatedCompute = false;
     for (unsigned int i = 0; i < queueFamilies.size(); ++i)
     {
-        if (queueFamilies[i].queueCount > 0 && queueFamilies[i].queueFlags & VK_QUEUE_GRAPHICS_BIT)
+        if (queueFamilies[i].queueCount == 0)
+        {
+            continue;
+        }
+
+        const VkQueueFlags flags = queueFamilies[i].queueFlags;
+        if (indices.graphicsFamily == -1 && flags & VK_QUEUE_GRAPHICS_BIT)
         {
             indices.graphicsFamily = i;
         }
 
-        if (queueFamilies[i].queueCount > 0 && queueFamilies[i].queueFlags & VK_QUEUE_COMPUTE_BIT)
+        if (flags & VK_QUEUE_COMPUTE_BIT && (indices.computeFamily == -1 || (!dedicatedCompute && !(flags & VK_QUEUE_GRAPHICS_BIT))))
         {
             indices.computeFamily = i;
+            dedicatedCompute = !(flags & VK_QUEUE_GRAPHICS_BIT);
         }
 
         VkBool32 presentSupport = false;
         vkGetPhysicalDeviceSurfaceSupportKHR(physicalDevice, i, surface, &presentSupport);
-        if (queueFamilies[i].queueCount > 0 && presentSupport)
+        if (presentSupport && (indices.presentFamily == -1 || static_cast<int>(i) == indices.graphicsFamily))
         {
             indices.presentFamily = i;
         }
-
-        if (hasAllQueueFamilies(indices))
-        {
-            break;
-        }
     }
 
     return indices;
@@ -109,6 +112,23 @@ bool hasDeviceExtensionSupport(VkPhysicalDevice physicalDevice)
     return requiredExtensions.empty();
 }
 
+bool isDeviceExtensionSupported(VkPhysicalDevice physicalDevice, const char* extensionName)
+{
+    uint32_t extensionCount;
+    vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, nullptr);
+    std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+    vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, availableExtensions.data());
+
+    for (const auto& extension : availableExtensions)
+    {
+        if (std::string(extension.extensionName) == extensionName)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
 SwapchainCapabilities getSwapchainCapabilities(VkPhysicalDevice physicalDevice, VkSurfaceKHR surface)
 {
     SwapchainCapabilities capabilities;
@@ -138,31 +158,60 @@ bool areSwapchainCapabilitiesAdequate(const SwapchainCapabilities& capabilities)
     return !capabilities.formats.empty() && !capabilities.presentModes.empty();
 }
 
-bool isDeviceSuitable(VkPhysicalDevice physicalDevice, VkSurfaceKHR surface)
+const char* getPresentModeName(VkPresentModeKHR presentMode)
 {
-    const bool allQueueFamilies = hasAllQueueFamilies(getQueueFamilies(physicalDevice, surface));
-    const bool deviceExtensionSupport = hasDeviceExtensionSupport(physicalDevice);
-    const bool swapchainCapabilitiesAdequate = areSwapchainCapabilitiesAdequate(getSwapchainCapabilities(physicalDevice, surface));
-    return allQueueFamilies && deviceExtensionSupport && swapchainCapabilitiesAdequate;
+    switch (presentMode)
+    {
+    case VK_PRESENT_MODE_IMMEDIATE_KHR:
+        return "Immediate";
+    case VK_PRESENT_MODE_MAILBOX_KHR:
+        return "Mailbox";
+    case VK_PRESENT_MODE_FIFO_KHR:
+        return "FIFO";
+    case VK_PRESENT_MODE_FIFO_RELAXED_KHR:
+        return "FIFO relaxed";
+    default:
+        break;
+    }
+    return "Unknown";
 }
 
-MemoryTypeResult findMemoryType(VkPhysicalDevice physicalDevice, uint32_t typeFilter, VkMemoryPropertyFlags properties)
+const char* getLoadOpName(VkAttachmentLoadOp loadOp)
 {
-    VkPhysicalDeviceMemoryProperties memoryProperties;
-    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
-
-    MemoryTypeResult result;
-    result.found = false;
+    switch (loadOp)
+    {
+    case VK_ATTACHMENT_LOAD_OP_LOAD:
+        return "Load";
+    case VK_ATTACHMENT_LOAD_OP_CLEAR:
+        return "Clear";
+    case VK_ATTACHMENT_LOAD_OP_DONT_CARE:
+        return "Don't care";
+    default:
+        break;
+    }
+    return "Unknown";
+}
 
-    for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; ++i)
+const char* getStoreOpName(VkAttachmentStoreOp storeOp)
+{
+    switch (storeOp)
     {
-        if ((typeFilter & (1 << i)) && (memoryProperties.memoryTypes[i].propertyFlags & properties) == properties)
-        {
-            result.typeIndex = i;
-            result.found = true;
-        }
+    case VK_ATTACHMENT_STORE_OP_STORE:
+        return "Store";
+    case VK_ATTACHMENT_STORE_OP_DONT_CARE:
+        return "Don't care";
+    default:
+        break;
     }
-    return result;
+    return "Unknown";
+}
+
+bool isDeviceSuitable(VkPhysicalDevice physicalDevice, VkSurfaceKHR surface)
+{
+    const bool allQueueFamilies = hasAllQueueFamilies(getQueueFamilies(physicalDevice, surface));
+    const bool deviceExtensionSupport = hasDeviceExtensionSupport(physicalDevice);
+    const bool swapchainCapabilitiesAdequate = areSwapchainCapabilitiesAdequate(getSwapchainCapabilities(physicalDevice, surface));
+    return allQueueFamilies && deviceExtensionSupport && swapchainCapabilitiesAdequate;
 }
 
 SingleTimeCommand beginSingleTimeCommands(VkCommandPool commandPool, VkDevice device)
@@ -189,96 +238,49 @@ SingleTimeCommand beginSingleTimeCommands(VkCommandPool commandPool, VkDevice de
     return command;
 }
 
-void endSingleTimeCommands(VkQueue queue, SingleTimeCommand command)
+// Returns without waiting, the commands have finished when the timeline reaches the returned value
+uint64_t submitSingleTimeCommands(VkQueue queue, Timeline& timeline, const SingleTimeCommand& command)
 {
     VK_CHECK(vkEndCommandBuffer(command.commandBuffer));
 
+    const uint64_t signalValue = timeline.advance();
+    const VkSemaphore signalSemaphore = timeline.getSemaphore();
+
+    VkTimelineSemaphoreSubmitInfo timelineInfo{};
+    timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timelineInfo.signalSemaphoreValueCount = 1;
+    timelineInfo.pSignalSemaphoreValues = &signalValue;
+
     VkSubmitInfo submitInfo{};
     submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.pNext = &timelineInfo;
     submitInfo.commandBufferCount = 1;
     submitInfo.pCommandBuffers = &command.commandBuffer;
+    submitInfo.signalSemaphoreCount = 1;
+    submitInfo.pSignalSemaphores = &signalSemaphore;
 
     VK_CHECK(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
-    VK_CHECK(vkQueueWaitIdle(queue));
+    return signalValue;
+}
 
+// Waits only for this submission, frames that are still in flight on the queue keep running
+void endSingleTimeCommands(VkQueue queue, Timeline& timeline, SingleTimeCommand command)
+{
+    timeline.wait(submitSingleTimeCommands(queue, timeline, command));
     vkFreeCommandBuffers(command.device, command.commandPool, 1, &command.commandBuffer);
 }
 
-VkShaderModule createShaderModule(VkDevice device, const std::filesystem::path& path)
+VkShaderModule createShaderModule(VkDevice device, const std::vector<char>& code)
 {
-    printf("Creating shader module from %s\n", std::filesystem::absolute(path).string().c_str());
-
-    std::ifstream file(path.string().c_str(), std::ios::ate | std::ios::binary);
-    CHECK(file.is_open());
-
-    const size_t fileSize = static_cast<size_t>(file.tellg());
-    std::vector<char> buffer(fileSize);
-    file.seekg(0);
-    file.read(buffer.data(), fileSize);
-    file.close();
+    CHECK(!code.empty() && code.size() % sizeof(uint32_t) == 0);
 
     VkShaderModuleCreateInfo createInfo{};
     createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-    createInfo.codeSize = buffer.size();
-    createInfo.pCode = reinterpret_cast<const uint32_t*>(buffer.data());
+    createInfo.codeSize = code.size();
+    createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
 
     VkShaderModule shaderModule;
     VK_CHECK(vkCreateShaderModule(device, &createInfo, nullptr, &shaderModule));
 
     return shaderModule;
 }
-
-StagingBuffer createStagingBuffer(VkDevice device, VkPhysicalDevice physicalDevice, const void* data, uint64_t size)
-{
-    VkBufferCreateInfo bufferInfo{};
-    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-    bufferInfo.size = size;
-    bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-
-    VkBuffer buffer;
-    VK_CHECK(vkCreateBuffer(device, &bufferInfo, nullptr, &buffer));
-    DebugMarker::setObjectName(VK_OBJECT_TYPE_BUFFER, (uint64_t)buffer, "Staging buffer");
-
-    VkMemoryRequirements memRequirements;
-    vkGetBufferMemoryRequirements(device, buffer, &memRequirements);
-
-    const VkMemoryPropertyFlags properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
-
-    const MemoryTypeResult memoryTypeResult = findMemoryType(physicalDevice, memRequirements.memoryTypeBits, properties);
-    CHECK(memoryTypeResult.found);
-
-    VkMemoryAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize = memRequirements.size;
-    allocInfo.memoryTypeIndex = memoryTypeResult.typeIndex;
-
-    VkDeviceMemory memory;
-    VK_CHECK(vkAllocateMemory(device, &allocInfo, nullptr, &memory));
-    DebugMarker::setObjectName(VK_OBJECT_TYPE_DEVICE_MEMORY, (uint64_t)memory, "Staging buffer memory");
-
-    VK_CHECK(vkBindBufferMemory(device, buffer, memory, 0));
-
-    void* dst;
-    VK_CHECK(vkMapMemory(device, memory, 0, size, 0, &dst));
-    std::memcpy(dst, data, static_cast<size_t>(size));
-    vkUnmapMemory(device, memory);
-
-    StagingBuffer stagingBuffer;
-    stagingBuffer.buffer = buffer;
-    stagingBuffer.memory = memory;
-
-    return stagingBuffer;
-}
-
-void releaseStagingBuffer(VkDevice device, const StagingBuffer& buffer)
-{
-    if (buffer.buffer)
-    {
-        vkDestroyBuffer(device, buffer.buffer, nullptr);
-    }
-    if (buffer.memory)
-    {
-        vkFreeMemory(device, buffer.memory, nullptr);
-    }
-}
@@ -5,13 +5,13 @@
 #include <vector>
 #include <cstdint>
 #include <cassert>
-#include <filesystem>
+
+class Timeline;
 
 const std::vector<const char*> c_validationLayers = {"VK_LAYER_KHRONOS_validation"};
 const std::vector<const char*> c_instanceExtensions = {VK_EXT_DEBUG_UTILS_EXTENSION_NAME};
 const std::vector<const char*> c_deviceExtensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
 
-const VkExtent2D c_windowExtent{c_windowWidth, c_windowHeight};
 const VkSurfaceFormatKHR c_surfaceFormat{VK_FORMAT_B8G8R8A8_UNORM, VK_COLOR_SPACE_SRGB_NONLINEAR_KHR};
 const VkFormat c_depthFormat = VK_FORMAT_D24_UNORM_S8_UINT;
 const uint32_t c_swapchainImageCount = 3;
@@ -41,12 +41,6 @@ struct SwapchainCapabilities
     std::vector<VkPresentModeKHR> presentModes;
 };
 
-struct MemoryTypeResult
-{
-    bool found;
-    uint32_t typeIndex;
-};
-
 struct SingleTimeCommand
 {
     VkCommandPool commandPool;
@@ -54,18 +48,29 @@ struct SingleTimeCommand
     VkCommandBuffer commandBuffer;
 };
 
-struct StagingBuffer
-{
-    VkBuffer buffer;
-    VkDeviceMemory memory;
-};
-
 struct BarrierStageFlags
 {
     VkPipelineStageFlags src;
     VkPipelineStageFlags dst;
 };
 
+// Load and store ops of one attachment in one pass, reported by the attachment audit
+struct AttachmentOps
+{
+    const char* pass;
+    const char* attachment;
+    VkAttachmentLoadOp loadOp;
+    VkAttachmentStoreOp storeOp;
+};
+
+// Value is ignored for binary semaphores
+struct SemaphoreWait
+{
+    VkSemaphore semaphore;
+    uint64_t value;
+    VkPipelineStageFlags stage;
+};
+
 void printInstanceLayers();
 void printDeviceExtensions(VkPhysicalDevice physicalDevice);
 void printPhysicalDeviceName(VkPhysicalDeviceProperties properties);
@@ -73,12 +78,14 @@ std::vector<const char*> getRequiredInstanceExtensions();
 bool hasAllQueueFamilies(const QueueFamilyIndices& indices);
 QueueFamilyIndices getQueueFamilies(VkPhysicalDevice physicalDevice, VkSurfaceKHR surface);
 bool hasDeviceExtensionSupport(VkPhysicalDevice physicalDevice);
+bool isDeviceExtensionSupported(VkPhysicalDevice physicalDevice, const char* extensionName);
 SwapchainCapabilities getSwapchainCapabilities(VkPhysicalDevice physicalDevice, VkSurfaceKHR surface);
 bool areSwapchainCapabilitiesAdequate(const SwapchainCapabilities& capabilities);
+const char* getPresentModeName(VkPresentModeKHR presentMode);
+const char* getLoadOpName(VkAttachmentLoadOp loadOp);
+const char* getStoreOpName(VkAttachmentStoreOp storeOp);
 bool isDeviceSuitable(VkPhysicalDevice physicalDevice, VkSurfaceKHR surface);
-MemoryTypeResult findMemoryType(VkPhysicalDevice physicalDevice, uint32_t typeFilter, VkMemoryPropertyFlags properties);
 SingleTimeCommand beginSingleTimeCommands(VkCommandPool commandPool, VkDevice device);
-void endSingleTimeCommands(VkQueue queue, SingleTimeCommand command);
-VkShaderModule createShaderModule(VkDevice device, const std::filesystem::path& path);
-StagingBuffer createStagingBuffer(VkDevice device, VkPhysicalDevice physicalDevice, const void* data, uint64_t size);
-void releaseStagingBuffer(VkDevice device, const StagingBuffer& buffer);
\ No newline at end of file
+uint64_t submitSingleTimeCommands(VkQueue queue, Timeline& timeline, const SingleTimeCommand& command);
+void endSingleTimeCommands(VkQueue queue, Timeline& timeline, SingleTimeCommand command);
+VkShaderModule createShaderModule(VkDevice device, const std::vector<char>& code);
\ No newline at end of file
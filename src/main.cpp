@@ -1,11 +1,33 @@
 
 #include "Context.hpp"
 #include "Renderer.hpp"
+#include "Benchmark.hpp"
+#include <string>
 
-int main(void)
+int main(int argc, char** argv)
 {
+    if (argc > 1 && std::string(argv[1]) == "--bench-jobs")
+    {
+        Benchmark::runJobSystem();
+        return 0;
+    }
+
+    if (argc > 1 && std::string(argv[1]) == "--bench-culling")
+    {
+        Benchmark::runCulling();
+        return 0;
+    }
+
+    if (argc > 1 && std::string(argv[1]) == "--bench-sort")
+    {
+        Benchmark::runSort();
+        return 0;
+    }
+
+    const bool dynamicRendering = argc > 1 && std::string(argv[1]) == "--dynamic-rendering";
+
     Context context;
-    Renderer renderer(context);
+    Renderer renderer(context, dynamicRendering);
 
     bool running = true;
     while (running)
@@ -14,4 +36,4 @@ int main(void)
     }
 
     return 0;
-}
\ No newline at end of file
+}